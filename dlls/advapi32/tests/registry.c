@@ -4459,6 +4459,122 @@ static void test_RegRenameKey(void)
     RegCloseKey(key);
 }
 
+static void test_large_key(void)
+{
+    DWORD i, j, count, step = 7919, subkeys, values, len, start, times[4];
+    char name[32], prev[32];
+    HKEY hkey, subkey;
+    LONG res;
+
+    /* enough entries for keys to be indexed; run as a benchmark in interactive mode */
+    count = winetest_interactive ? 1000000 : 500;
+
+    res = RegCreateKeyExA( hkey_main, "LargeKey", 0, NULL, 0, KEY_ALL_ACCESS, NULL, &hkey, NULL );
+    ok( !res, "RegCreateKeyExA failed: %ld\n", res );
+
+    start = GetTickCount();
+    for (i = 0; i < count; i++)
+    {
+        j = (i * step) % count;
+        sprintf( name, (j & 1) ? "KEY%07lu" : "key%07lu", j );
+        res = RegCreateKeyExA( hkey, name, 0, NULL, 0, KEY_ALL_ACCESS, NULL, &subkey, NULL );
+        ok( !res, "RegCreateKeyExA %s failed: %ld\n", name, res );
+        RegCloseKey( subkey );
+        sprintf( name, "val%07lu", j );
+        res = RegSetValueExA( hkey, name, 0, REG_DWORD, (BYTE *)&j, sizeof(j) );
+        ok( !res, "RegSetValueExA %s failed: %ld\n", name, res );
+    }
+    times[0] = GetTickCount() - start;
+
+    start = GetTickCount();
+    for (i = 0; i < count; i++)
+    {
+        sprintf( name, (i & 1) ? "key%07lu" : "KEY%07lu", i );
+        res = RegOpenKeyExA( hkey, name, 0, KEY_READ, &subkey );
+        ok( !res, "RegOpenKeyExA %s failed: %ld\n", name, res );
+        RegCloseKey( subkey );
+        sprintf( name, "VAL%07lu", i );
+        len = sizeof(j);
+        res = RegQueryValueExA( hkey, name, NULL, NULL, (BYTE *)&j, &len );
+        ok( !res, "RegQueryValueExA %s failed: %ld\n", name, res );
+        ok( j == i, "got %lu for %s\n", j, name );
+    }
+    times[1] = GetTickCount() - start;
+
+    /* subkeys are enumerated in sorted order */
+    start = GetTickCount();
+    for (i = 0; ; i++)
+    {
+        res = RegEnumKeyA( hkey, i, name, sizeof(name) );
+        if (res) break;
+        if (i) ok( lstrcmpiA( prev, name ) < 0, "%s enumerated before %s\n", prev, name );
+        strcpy( prev, name );
+    }
+    ok( res == ERROR_NO_MORE_ITEMS, "RegEnumKeyA failed: %ld\n", res );
+    ok( i == count, "enumerated %lu subkeys\n", i );
+    times[2] = GetTickCount() - start;
+
+    /* delete a third of the entries, and create some of them again */
+    for (i = 0; i < count; i += 3)
+    {
+        sprintf( name, "key%07lu", i );
+        res = RegDeleteKeyA( hkey, name );
+        ok( !res, "RegDeleteKeyA %s failed: %ld\n", name, res );
+        sprintf( name, "val%07lu", i );
+        res = RegDeleteValueA( hkey, name );
+        ok( !res, "RegDeleteValueA %s failed: %ld\n", name, res );
+    }
+    for (i = 0; i < count; i += 6)
+    {
+        sprintf( name, "key%07lu", i );
+        res = RegCreateKeyExA( hkey, name, 0, NULL, 0, KEY_ALL_ACCESS, NULL, &subkey, NULL );
+        ok( !res, "RegCreateKeyExA %s failed: %ld\n", name, res );
+        RegCloseKey( subkey );
+    }
+    for (i = 0; i < count; i++)
+    {
+        sprintf( name, "key%07lu", i );
+        res = RegOpenKeyExA( hkey, name, 0, KEY_READ, &subkey );
+        if (i % 3 || !(i % 6)) ok( !res, "RegOpenKeyExA %s failed: %ld\n", name, res );
+        else ok( res == ERROR_FILE_NOT_FOUND, "RegOpenKeyExA %s returned %ld\n", name, res );
+        if (!res) RegCloseKey( subkey );
+        sprintf( name, "val%07lu", i );
+        res = RegQueryValueExA( hkey, name, NULL, NULL, NULL, NULL );
+        if (i % 3) ok( !res, "RegQueryValueExA %s failed: %ld\n", name, res );
+        else ok( res == ERROR_FILE_NOT_FOUND, "RegQueryValueExA %s returned %ld\n", name, res );
+    }
+
+    res = RegQueryInfoKeyA( hkey, NULL, NULL, NULL, &subkeys, NULL, NULL, &values, NULL, NULL, NULL, NULL );
+    ok( !res, "RegQueryInfoKeyA failed: %ld\n", res );
+    ok( subkeys == count - (count + 2) / 3 + (count + 5) / 6, "got %lu subkeys\n", subkeys );
+    ok( values == count - (count + 2) / 3, "got %lu values\n", values );
+
+    for (i = 0; !RegEnumKeyA( hkey, i, name, sizeof(name) ); i++)
+    {
+        if (i) ok( lstrcmpiA( prev, name ) < 0, "%s enumerated before %s\n", prev, name );
+        strcpy( prev, name );
+    }
+    ok( i == subkeys, "enumerated %lu subkeys\n", i );
+
+    /* delete from the end to keep it fast */
+    start = GetTickCount();
+    while (subkeys--)
+    {
+        res = RegEnumKeyA( hkey, subkeys, name, sizeof(name) );
+        ok( !res, "RegEnumKeyA %lu failed: %ld\n", subkeys, res );
+        res = RegDeleteKeyA( hkey, name );
+        ok( !res, "RegDeleteKeyA %s failed: %ld\n", name, res );
+    }
+    times[3] = GetTickCount() - start;
+
+    if (winetest_interactive)
+        trace( "%lu subkeys and values: create %lu ms, open %lu ms, enum %lu ms, delete %lu ms\n",
+               count, times[0], times[1], times[2], times[3] );
+
+    RegDeleteKeyA( hkey, "" );
+    RegCloseKey( hkey );
+}
+
 START_TEST(registry)
 {
     /* Load pointers for functions that are not available in all Windows versions */
@@ -4499,6 +4615,7 @@ START_TEST(registry)
     test_EnumDynamicTimeZoneInformation();
     test_perflib_key();
     test_RegRenameKey();
+    test_large_key();
 
     /* cleanup */
     delete_key( hkey_main );
@@ -26,6 +26,7 @@
 #include "winbase.h"
 #include "wingdi.h"
 #include "winuser.h"
+#include "winreg.h"
 #include "wincrypt.h"
 #include "mmsystem.h" /* DIBINDEX */
 
@@ -3529,11 +3530,392 @@ static void test_simple_graphics(void)
     DeleteDC(mem_dc);
 }
 
+static double get_pixel_rate( LARGE_INTEGER start, LARGE_INTEGER end, LARGE_INTEGER freq, int pixels )
+{
+    return (double)pixels * freq.QuadPart / (end.QuadPart - start.QuadPart) / 1000000.0;
+}
+
+/* rough throughput of the most used primitives, only run in interactive mode */
+static void test_primitives_performance(void)
+{
+    static const int bpps[] = { 32, 24 };
+    static const int size = 1024, loops = 20;
+    BITMAPINFO bmi;
+    BLENDFUNCTION blend = { AC_SRC_OVER, 0, 128, 0 };
+    LARGE_INTEGER freq, start, end;
+    HDC dst_dc, src_dc;
+    HBITMAP dst_dib, src_dib;
+    DWORD *src_bits;
+    void *dst_bits;
+    HBRUSH brush;
+    int i, j;
+
+    memset( &bmi, 0, sizeof(bmi) );
+    bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+    bmi.bmiHeader.biWidth = size;
+    bmi.bmiHeader.biHeight = -size;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    src_dc = CreateCompatibleDC( NULL );
+    src_dib = CreateDIBSection( 0, &bmi, DIB_RGB_COLORS, (void **)&src_bits, NULL, 0 );
+    for (i = 0; i < size * size; i++)
+    {
+        BYTE alpha = i % 251;
+        src_bits[i] = alpha << 24 | (i * 7 % (alpha + 1)) << 16 | (i * 13 % (alpha + 1)) << 8 | (i % (alpha + 1));
+    }
+    SelectObject( src_dc, src_dib );
+    QueryPerformanceFrequency( &freq );
+
+    for (i = 0; i < ARRAY_SIZE(bpps); i++)
+    {
+        bmi.bmiHeader.biBitCount = bpps[i];
+        dst_dc = CreateCompatibleDC( NULL );
+        dst_dib = CreateDIBSection( 0, &bmi, DIB_RGB_COLORS, &dst_bits, NULL, 0 );
+        SelectObject( dst_dc, dst_dib );
+        brush = CreateSolidBrush( RGB( 0x12, 0x34, 0x56 ));
+        SelectObject( dst_dc, brush );
+
+        QueryPerformanceCounter( &start );
+        for (j = 0; j < loops; j++) PatBlt( dst_dc, 0, 0, size, size, PATCOPY );
+        QueryPerformanceCounter( &end );
+        trace( "%d-bpp PATCOPY: %.1f Mpixels/s\n", bpps[i], get_pixel_rate( start, end, freq, loops * size * size ));
+
+        QueryPerformanceCounter( &start );
+        for (j = 0; j < loops; j++) PatBlt( dst_dc, 0, 0, size, size, PATINVERT );
+        QueryPerformanceCounter( &end );
+        trace( "%d-bpp PATINVERT: %.1f Mpixels/s\n", bpps[i], get_pixel_rate( start, end, freq, loops * size * size ));
+
+        QueryPerformanceCounter( &start );
+        for (j = 0; j < loops; j++) BitBlt( dst_dc, 0, 0, size, size, src_dc, 0, 0, SRCCOPY );
+        QueryPerformanceCounter( &end );
+        trace( "%d-bpp SRCCOPY: %.1f Mpixels/s\n", bpps[i], get_pixel_rate( start, end, freq, loops * size * size ));
+
+        QueryPerformanceCounter( &start );
+        for (j = 0; j < loops; j++) StretchBlt( dst_dc, 0, 0, size, size, src_dc, 0, 0, size / 2, size / 2, SRCCOPY );
+        QueryPerformanceCounter( &end );
+        trace( "%d-bpp StretchBlt: %.1f Mpixels/s\n", bpps[i], get_pixel_rate( start, end, freq, loops * size * size ));
+
+        blend.AlphaFormat = 0;
+        QueryPerformanceCounter( &start );
+        for (j = 0; j < loops; j++) GdiAlphaBlend( dst_dc, 0, 0, size, size, src_dc, 0, 0, size, size, blend );
+        QueryPerformanceCounter( &end );
+        trace( "%d-bpp AlphaBlend constant: %.1f Mpixels/s\n", bpps[i], get_pixel_rate( start, end, freq, loops * size * size ));
+
+        blend.AlphaFormat = AC_SRC_ALPHA;
+        QueryPerformanceCounter( &start );
+        for (j = 0; j < loops; j++) GdiAlphaBlend( dst_dc, 0, 0, size, size, src_dc, 0, 0, size, size, blend );
+        QueryPerformanceCounter( &end );
+        trace( "%d-bpp AlphaBlend per-pixel: %.1f Mpixels/s\n", bpps[i], get_pixel_rate( start, end, freq, loops * size * size ));
+
+        DeleteDC( dst_dc );
+        DeleteObject( dst_dib );
+        DeleteObject( brush );
+    }
+
+    DeleteDC( src_dc );
+    DeleteObject( src_dib );
+}
+
+#define LARGE_OPS 6
+
+/* operations large enough to be split in bands by the Wine DIB engine */
+static void draw_large_operations( char *hashes[LARGE_OPS] )
+{
+    static const int size = 1024;
+    BITMAPINFO bmi;
+    BLENDFUNCTION blend = { AC_SRC_OVER, 0, 255, AC_SRC_ALPHA };
+    TRIVERTEX vert[3];
+    GRADIENT_RECT rect = { 0, 1 };
+    GRADIENT_TRIANGLE tri = { 0, 1, 2 };
+    HDC dst_dc, src_dc;
+    HBITMAP dst_dib, src_dib, old_dst, old_src;
+    DWORD *src_bits;
+    BYTE *dst_bits;
+    int i, op = 0;
+
+    memset( &bmi, 0, sizeof(bmi) );
+    bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+    bmi.bmiHeader.biWidth = size;
+    bmi.bmiHeader.biHeight = -size;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    src_dc = CreateCompatibleDC( NULL );
+    src_dib = CreateDIBSection( 0, &bmi, DIB_RGB_COLORS, (void **)&src_bits, NULL, 0 );
+    for (i = 0; i < size * size; i++)
+    {
+        BYTE alpha = i % 251;
+        src_bits[i] = alpha << 24 | (i * 7 % (alpha + 1)) << 16 | (i * 13 % (alpha + 1)) << 8 | (i % (alpha + 1));
+    }
+    old_src = SelectObject( src_dc, src_dib );
+
+    dst_dc = CreateCompatibleDC( NULL );
+    dst_dib = CreateDIBSection( 0, &bmi, DIB_RGB_COLORS, (void **)&dst_bits, NULL, 0 );
+    old_dst = SelectObject( dst_dc, dst_dib );
+
+    /* rows are duplicated */
+    reset_bits( dst_dc, &bmi, dst_bits );
+    SetStretchBltMode( dst_dc, COLORONCOLOR );
+    StretchBlt( dst_dc, 3, 5, size - 7, size - 9, src_dc, 10, 20, 333, 517, SRCCOPY );
+    hashes[op++] = hash_dib( dst_dc, &bmi, dst_bits );
+
+    /* rows are merged */
+    reset_bits( dst_dc, &bmi, dst_bits );
+    SetStretchBltMode( dst_dc, BLACKONWHITE );
+    StretchBlt( dst_dc, 0, 0, size - 24, size - 300, src_dc, 0, 0, size, size, SRCCOPY );
+    hashes[op++] = hash_dib( dst_dc, &bmi, dst_bits );
+
+    /* mirrored */
+    reset_bits( dst_dc, &bmi, dst_bits );
+    SetStretchBltMode( dst_dc, COLORONCOLOR );
+    StretchBlt( dst_dc, size - 1, size - 1, -(size - 1), -(size - 1), src_dc, 1, 2, 700, 611, SRCCOPY );
+    hashes[op++] = hash_dib( dst_dc, &bmi, dst_bits );
+
+    memset( dst_bits, 0x55, size * size * 4 );
+    GdiAlphaBlend( dst_dc, 2, 1, size - 4, size - 3, src_dc, 0, 0, size - 4, size - 3, blend );
+    hashes[op++] = hash_dib( dst_dc, &bmi, dst_bits );
+
+    vert[0].x = 0;
+    vert[0].y = 0;
+    vert[0].Red = 0xff00;
+    vert[0].Green = 0x1200;
+    vert[0].Blue = 0x3400;
+    vert[0].Alpha = 0;
+    vert[1].x = size;
+    vert[1].y = size - 17;
+    vert[1].Red = 0x0100;
+    vert[1].Green = 0xee00;
+    vert[1].Blue = 0x8000;
+    vert[1].Alpha = 0xff00;
+    vert[2].x = size / 3;
+    vert[2].y = size;
+    vert[2].Red = 0x5500;
+    vert[2].Green = 0x0000;
+    vert[2].Blue = 0xff00;
+    vert[2].Alpha = 0x8000;
+
+    reset_bits( dst_dc, &bmi, dst_bits );
+    GdiGradientFill( dst_dc, vert, 2, &rect, 1, GRADIENT_FILL_RECT_V );
+    hashes[op++] = hash_dib( dst_dc, &bmi, dst_bits );
+
+    reset_bits( dst_dc, &bmi, dst_bits );
+    GdiGradientFill( dst_dc, vert, 3, &tri, 1, GRADIENT_FILL_TRIANGLE );
+    hashes[op++] = hash_dib( dst_dc, &bmi, dst_bits );
+
+    SelectObject( dst_dc, old_dst );
+    SelectObject( src_dc, old_src );
+    DeleteDC( dst_dc );
+    DeleteDC( src_dc );
+    DeleteObject( dst_dib );
+    DeleteObject( src_dib );
+}
+
+/* runs with the Wine parallel band processing disabled */
+static void test_serial_operations( char **expect )
+{
+    char *hashes[LARGE_OPS];
+    int i;
+
+    draw_large_operations( hashes );
+    for (i = 0; i < LARGE_OPS; i++)
+    {
+        ok( hashes[i] && !strcmp( hashes[i], expect[i] ), "%d: got hash %s, expected %s\n",
+            i, hashes[i], expect[i] );
+        HeapFree( GetProcessHeap(), 0, hashes[i] );
+    }
+}
+
+/* run a child with a Wine setting, the setting is only read by new processes */
+static void run_child_with_setting( const char *key_name, const char *value, const char *data,
+                                    const char *args )
+{
+    char cmdline[MAX_PATH + 512], **argv;
+    STARTUPINFOA si = { sizeof(si) };
+    PROCESS_INFORMATION pi;
+    DWORD disp;
+    HKEY key;
+    LONG ret;
+
+    ret = RegCreateKeyExA( HKEY_CURRENT_USER, key_name, 0, NULL, 0, KEY_ALL_ACCESS, NULL, &key, &disp );
+    ok( !ret, "RegCreateKeyExA failed %ld\n", ret );
+    if (ret) return;
+    ret = RegSetValueExA( key, value, 0, REG_SZ, (const BYTE *)data, strlen(data) + 1 );
+    ok( !ret, "RegSetValueExA failed %ld\n", ret );
+
+    winetest_get_mainargs( &argv );
+    sprintf( cmdline, "\"%s\" dib %s", argv[0], args );
+    ret = CreateProcessA( NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi );
+    ok( ret, "CreateProcessA failed %lu\n", GetLastError() );
+    if (ret)
+    {
+        wait_child_process( pi.hProcess );
+        CloseHandle( pi.hProcess );
+        CloseHandle( pi.hThread );
+    }
+
+    RegDeleteValueA( key, value );
+    RegCloseKey( key );
+    if (disp == REG_CREATED_NEW_KEY) RegDeleteKeyA( HKEY_CURRENT_USER, key_name );
+}
+
+static void test_parallel_operations(void)
+{
+    char args[16 + LARGE_OPS * 41];
+    char *hashes[LARGE_OPS];
+    int i;
+
+    if (!crypt_prov)
+    {
+        skip( "no crypto provider\n" );
+        return;
+    }
+
+    draw_large_operations( hashes );
+    for (i = 0; i < LARGE_OPS; i++)
+    {
+        if (hashes[i]) continue;
+        skip( "failed to hash the bits\n" );
+        goto done;
+    }
+
+    strcpy( args, "serial" );
+    for (i = 0; i < LARGE_OPS; i++) sprintf( args + strlen(args), " %s", hashes[i] );
+    run_child_with_setting( "Software\\Wine\\Gdi", "ParallelBands", "N", args );
+
+done:
+    for (i = 0; i < LARGE_OPS; i++) HeapFree( GetProcessHeap(), 0, hashes[i] );
+}
+
+/* draw a few hundred different glyphs, twice */
+static char *draw_glyphs(void)
+{
+    BITMAPINFO bmi;
+    HDC dc;
+    HBITMAP dib, old_dib;
+    HFONT font, old_font;
+    WCHAR str[32];
+    BYTE *bits;
+    char *hash;
+    int i, j, y;
+
+    memset( &bmi, 0, sizeof(bmi) );
+    bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+    bmi.bmiHeader.biWidth = 640;
+    bmi.bmiHeader.biHeight = -480;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    dc = CreateCompatibleDC( NULL );
+    dib = CreateDIBSection( 0, &bmi, DIB_RGB_COLORS, (void **)&bits, NULL, 0 );
+    old_dib = SelectObject( dc, dib );
+    font = CreateFontA( -16, 0, 0, 0, FW_NORMAL, 0, 0, 0, DEFAULT_CHARSET, 0, 0,
+                        ANTIALIASED_QUALITY, 0, "Tahoma" );
+    old_font = SelectObject( dc, font );
+    memset( bits, 0xcc, 640 * 480 * 4 );
+
+    for (i = 0; i < 2; i++)
+    {
+        for (y = 0; y < 25; y++)
+        {
+            for (j = 0; j < ARRAY_SIZE(str); j++) str[j] = 0x20 + y * ARRAY_SIZE(str) + j;
+            ExtTextOutW( dc, 0, y * 18, ETO_OPAQUE, NULL, str, ARRAY_SIZE(str), NULL );
+        }
+    }
+    hash = hash_dib( dc, &bmi, bits );
+
+    SelectObject( dc, old_font );
+    SelectObject( dc, old_dib );
+    DeleteObject( font );
+    DeleteObject( dib );
+    DeleteDC( dc );
+    return hash;
+}
+
+static DWORD WINAPI draw_glyphs_thread( void *arg )
+{
+    const char *expect = arg;
+    char *hash;
+    int i;
+
+    for (i = 0; i < 5; i++)
+    {
+        hash = draw_glyphs();
+        ok( hash && !strcmp( hash, expect ), "%d: got hash %s, expected %s\n", i, hash, expect );
+        HeapFree( GetProcessHeap(), 0, hash );
+    }
+    return 0;
+}
+
+/* runs with a tiny Wine glyph cache, so that glyphs are constantly evicted */
+static void test_glyph_cache_eviction( char *expect )
+{
+    HANDLE threads[4];
+    char *hash;
+    int i;
+
+    hash = draw_glyphs();
+    ok( hash && !strcmp( hash, expect ), "got hash %s, expected %s\n", hash, expect );
+    HeapFree( GetProcessHeap(), 0, hash );
+
+    /* glyphs get evicted while other threads are drawing with them */
+    for (i = 0; i < ARRAY_SIZE(threads); i++)
+        threads[i] = CreateThread( NULL, 0, draw_glyphs_thread, expect, 0, NULL );
+    for (i = 0; i < ARRAY_SIZE(threads); i++)
+    {
+        WaitForSingleObject( threads[i], INFINITE );
+        CloseHandle( threads[i] );
+    }
+}
+
+static void test_glyph_cache(void)
+{
+    char args[64], *hash;
+
+    if (!crypt_prov)
+    {
+        skip( "no crypto provider\n" );
+        return;
+    }
+    if (!(hash = draw_glyphs()))
+    {
+        skip( "failed to hash the bits\n" );
+        return;
+    }
+
+    /* budget of 1 KB, only a few glyphs fit */
+    sprintf( args, "glyph_cache %s", hash );
+    run_child_with_setting( "Software\\Wine\\Fonts", "GlyphCacheSize", "1", args );
+    HeapFree( GetProcessHeap(), 0, hash );
+}
+
 START_TEST(dib)
 {
+    char **argv;
+    int argc = winetest_get_mainargs( &argv );
+
     CryptAcquireContextW(&crypt_prov, NULL, NULL, PROV_RSA_FULL, CRYPT_VERIFYCONTEXT);
 
+    if (argc >= 3 + LARGE_OPS && !strcmp( argv[2], "serial" ))
+    {
+        test_serial_operations( argv + 3 );
+        CryptReleaseContext(crypt_prov, 0);
+        return;
+    }
+    if (argc >= 4 && !strcmp( argv[2], "glyph_cache" ))
+    {
+        test_glyph_cache_eviction( argv[3] );
+        CryptReleaseContext(crypt_prov, 0);
+        return;
+    }
+
     test_simple_graphics();
+    test_parallel_operations();
+    test_glyph_cache();
+    if (winetest_interactive) test_primitives_performance();
 
     CryptReleaseContext(crypt_prov, 0);
 }
@@ -7760,6 +7760,52 @@ static void test_GetOutlineTextMetrics_subst(void)
     ReleaseDC(0, hdc);
 }
 
+static void run_font_resource_child(BOOL installed)
+{
+    char path_name[MAX_PATH + 64];
+    PROCESS_INFORMATION info;
+    STARTUPINFOA startup;
+    char **argv;
+
+    winetest_get_mainargs(&argv);
+    memset(&startup, 0, sizeof(startup));
+    startup.cb = sizeof(startup);
+    sprintf(path_name, "%s font font_resource %d", argv[0], installed);
+    ok(CreateProcessA(NULL, path_name, NULL, NULL, FALSE, 0, NULL, NULL, &startup, &info),
+       "CreateProcess failed.\n");
+    wait_child_process(info.hProcess);
+    CloseHandle(info.hProcess);
+    CloseHandle(info.hThread);
+}
+
+static void test_font_resource_process(void)
+{
+    char ttf_name[MAX_PATH];
+    int ret;
+
+    if (!write_ttf_file("wine_test.ttf", ttf_name))
+    {
+        skip("Failed to create ttf file for testing\n");
+        return;
+    }
+
+    ok(!is_truetype_font_installed("wine_test"), "font wine_test should not be enumerated\n");
+
+    /* public font resources are seen by the processes started afterwards */
+    ret = AddFontResourceExA(ttf_name, 0, 0);
+    ok(ret, "AddFontResourceEx() failed\n");
+    ok(is_truetype_font_installed("wine_test"), "font wine_test should be enumerated\n");
+    run_font_resource_child(TRUE);
+    run_font_resource_child(TRUE);
+
+    ret = RemoveFontResourceExA(ttf_name, 0, 0);
+    ok(ret, "RemoveFontResourceEx() failed\n");
+    ok(!is_truetype_font_installed("wine_test"), "font wine_test should not be enumerated\n");
+    run_font_resource_child(FALSE);
+
+    DeleteFileA(ttf_name);
+}
+
 START_TEST(font)
 {
     static const char *test_names[] =
@@ -7778,6 +7824,12 @@ START_TEST(font)
     {
         if (!strcmp(argv[2], "AddFontMemResource"))
             test_AddFontMemResource();
+        else if (!strcmp(argv[2], "font_resource") && argc >= 4)
+        {
+            BOOL installed = atoi(argv[3]);
+            ok(is_truetype_font_installed("wine_test") == installed,
+               "font wine_test should%s be enumerated\n", installed ? "" : " not");
+        }
         return;
     }
 
@@ -7849,6 +7901,7 @@ START_TEST(font)
     test_lang_names();
     test_char_width();
     test_select_object();
+    test_font_resource_process();
 
     /* These tests should be last test until RemoveFontResource
      * is properly implemented.
@@ -826,11 +826,8 @@ static void test_HeapCreate(void)
     size = 0;
     SetLastError( 0xdeadbeef );
     ret = pHeapQueryInformation( 0, HeapCompatibilityInformation, &compat_info, sizeof(compat_info), &size );
-    todo_wine
     ok( !ret, "HeapQueryInformation succeeded\n" );
-    todo_wine
     ok( GetLastError() == ERROR_NOACCESS, "got error %lu\n", GetLastError() );
-    todo_wine
     ok( size == 0, "got size %Iu\n", size );
 
     size = 0;
@@ -870,7 +867,6 @@ static void test_HeapCreate(void)
     ok( ret, "HeapSetInformation failed, error %lu\n", GetLastError() );
     ret = pHeapQueryInformation( heap, HeapCompatibilityInformation, &compat_info, sizeof(compat_info), &size );
     ok( ret, "HeapQueryInformation failed, error %lu\n", GetLastError() );
-    todo_wine
     ok( compat_info == 2, "got HeapCompatibilityInformation %lu\n", compat_info );
 
     /* cannot be undone */
@@ -878,20 +874,15 @@ static void test_HeapCreate(void)
     compat_info = 0;
     SetLastError( 0xdeadbeef );
     ret = pHeapSetInformation( heap, HeapCompatibilityInformation, &compat_info, sizeof(compat_info) );
-    todo_wine
     ok( !ret, "HeapSetInformation succeeded\n" );
-    todo_wine
     ok( GetLastError() == ERROR_GEN_FAILURE, "got error %lu\n", GetLastError() );
     compat_info = 1;
     SetLastError( 0xdeadbeef );
     ret = pHeapSetInformation( heap, HeapCompatibilityInformation, &compat_info, sizeof(compat_info) );
-    todo_wine
     ok( !ret, "HeapSetInformation succeeded\n" );
-    todo_wine
     ok( GetLastError() == ERROR_GEN_FAILURE, "got error %lu\n", GetLastError() );
     ret = pHeapQueryInformation( heap, HeapCompatibilityInformation, &compat_info, sizeof(compat_info), &size );
     ok( ret, "HeapQueryInformation failed, error %lu\n", GetLastError() );
-    todo_wine
     ok( compat_info == 2, "got HeapCompatibilityInformation %lu\n", compat_info );
 
     ret = HeapDestroy( heap );
@@ -930,7 +921,6 @@ static void test_HeapCreate(void)
     ok( ret, "HeapSetInformation failed, error %lu\n", GetLastError() );
     ret = pHeapQueryInformation( heap, HeapCompatibilityInformation, &compat_info, sizeof(compat_info), &size );
     ok( ret, "HeapQueryInformation failed, error %lu\n", GetLastError() );
-    todo_wine
     ok( compat_info == 2, "got HeapCompatibilityInformation %lu\n", compat_info );
 
     for (i = 0; i < 0x11; i++) ptrs[i] = pHeapAlloc( heap, 0, 24 + 2 * sizeof(void *) );
@@ -963,7 +953,6 @@ static void test_HeapCreate(void)
     SetLastError( 0xdeadbeef );
     while ((ret = HeapWalk( heap, &entry ))) entries[count++] = entry;
     ok( GetLastError() == ERROR_NO_MORE_ITEMS, "got error %lu\n", GetLastError() );
-    todo_wine
     ok( count > 24, "got count %lu\n", count );
     if (count < 2) count = 2;
 
@@ -976,11 +965,8 @@ static void test_HeapCreate(void)
 
     for (i = 0; i < 0x12; i++)
     {
-        todo_wine
         ok( entries[4 + i].wFlags == 0, "got wFlags %#x\n", entries[4 + i].wFlags );
-        todo_wine
         ok( entries[4 + i].cbData == 0x20, "got cbData %#lx\n", entries[4 + i].cbData );
-        todo_wine
         ok( entries[4 + i].cbOverhead == 2 * sizeof(void *), "got cbOverhead %#x\n", entries[4 + i].cbOverhead );
     }
 
@@ -995,7 +981,6 @@ static void test_HeapCreate(void)
     rtl_entry.lpData = NULL;
     SetLastError( 0xdeadbeef );
     while (!RtlWalkHeap( heap, &rtl_entry )) rtl_entries[count++] = rtl_entry;
-    todo_wine
     ok( count > 24, "got count %lu\n", count );
     if (count < 2) count = 2;
 
@@ -1038,7 +1023,6 @@ static void test_HeapCreate(void)
     SetLastError( 0xdeadbeef );
     while ((ret = HeapWalk( heap, &entry ))) entries[count++] = entry;
     ok( GetLastError() == ERROR_NO_MORE_ITEMS, "got error %lu\n", GetLastError() );
-    todo_wine
     ok( count > 24, "got count %lu\n", count );
     if (count < 2) count = 2;
 
@@ -1067,7 +1051,6 @@ static void test_HeapCreate(void)
     rtl_entry.lpData = NULL;
     SetLastError( 0xdeadbeef );
     while (!RtlWalkHeap( heap, &rtl_entry )) rtl_entries[count++] = rtl_entry;
-    todo_wine
     ok( count > 24, "got count %lu\n", count );
     if (count < 2) count = 2;
 
@@ -1081,11 +1064,8 @@ static void test_HeapCreate(void)
         if (!entries[i].wFlags)
             ok( rtl_entries[i].wFlags == 0 || rtl_entries[i].wFlags == RTL_HEAP_ENTRY_LFH, "got wFlags %#x\n", rtl_entries[i].wFlags );
         else if (entries[i].wFlags & PROCESS_HEAP_ENTRY_BUSY)
-        {
-            todo_wine
             ok( rtl_entries[i].wFlags == (RTL_HEAP_ENTRY_LFH|RTL_HEAP_ENTRY_BUSY) || broken(rtl_entries[i].wFlags == 1) /* win7 */,
                 "got wFlags %#x\n", rtl_entries[i].wFlags );
-        }
         else if (entries[i].wFlags & PROCESS_HEAP_UNCOMMITTED_RANGE)
             ok( rtl_entries[i].wFlags == RTL_HEAP_ENTRY_UNCOMMITTED || broken(rtl_entries[i].wFlags == 0x100) /* win7 */,
                 "got wFlags %#x\n", rtl_entries[i].wFlags );
@@ -1104,6 +1084,44 @@ static void test_HeapCreate(void)
         winetest_pop_context();
     }
 
+    ret = HeapValidate( heap, 0, NULL );
+    ok( ret, "HeapValidate failed, error %lu\n", GetLastError() );
+    ret = HeapValidate( heap, 0, ptrs[0] );
+    ok( ret, "HeapValidate failed, error %lu\n", GetLastError() );
+    size = HeapSize( heap, 0, ptrs[0] );
+    ok( size == 24 + 2 * sizeof(void *), "got size %Iu\n", size );
+    memset( ptrs[0], 0xa5, size );
+    ptr = HeapReAlloc( heap, HEAP_ZERO_MEMORY, ptrs[0], 0x100 );
+    ok( !!ptr, "HeapReAlloc failed, error %lu\n", GetLastError() );
+    ok( ptr[size - 1] == 0xa5, "got %#x\n", ptr[size - 1] );
+    ok( ptr[size] == 0, "got %#x\n", ptr[size] );
+    ptrs[0] = ptr;
+    size = HeapSize( heap, 0, ptrs[0] );
+    ok( size == 0x100, "got size %Iu\n", size );
+
+    for (i = 0; i < 0x12; i++) HeapFree( heap, 0, ptrs[i] );
+
+    /* shrinking a large LFH block */
+    for (i = 0; i < 0x12; i++)
+    {
+        ptrs[i] = pHeapAlloc( heap, 0, 0x1f00 );
+        ok( !!ptrs[i], "HeapAlloc failed, error %lu\n", GetLastError() );
+    }
+    memset( ptrs[0x11], 0xa5, 0x1f00 );
+    ptr = HeapReAlloc( heap, 0, ptrs[0x11], 0x1e80 );
+    ok( !!ptr, "HeapReAlloc failed, error %lu\n", GetLastError() );
+    ptrs[0x11] = ptr;
+    size = HeapSize( heap, 0, ptrs[0x11] );
+    ok( size == 0x1e80, "got size %Iu\n", size );
+    ptr = HeapReAlloc( heap, 0, ptrs[0x11], 16 );
+    ok( !!ptr, "HeapReAlloc failed, error %lu\n", GetLastError() );
+    ptrs[0x11] = ptr;
+    size = HeapSize( heap, 0, ptrs[0x11] );
+    ok( size == 16, "got size %Iu\n", size );
+    ok( ptr[0] == 0xa5 && ptr[15] == 0xa5, "got %#x %#x\n", ptr[0], ptr[15] );
+    ret = HeapValidate( heap, 0, NULL );
+    ok( ret, "HeapValidate failed, error %lu\n", GetLastError() );
+
     for (i = 0; i < 0x12; i++) HeapFree( heap, 0, ptrs[i] );
 
     ret = HeapDestroy( heap );
@@ -2769,6 +2787,190 @@ static void test_GlobalMemoryStatus(void)
 #undef IS_WITHIN_RANGE
 }
 
+struct heap_stress_params
+{
+    HANDLE heap;
+    UINT seed;
+    UINT count;
+};
+
+static UINT heap_stress_rand( UINT *seed )
+{
+    *seed = *seed * 1103515245 + 12345;
+    return *seed >> 16;
+}
+
+static SIZE_T heap_stress_size( UINT *seed )
+{
+    static const SIZE_T sizes[] = {8, 16, 24, 32, 48, 64, 100, 128, 200, 256, 500, 1000, 2000, 4000, 0x10000};
+    UINT r = heap_stress_rand( seed );
+    /* large allocations are much less frequent than small ones */
+    if (r % 64) return sizes[r % (ARRAY_SIZE(sizes) - 1)] + (r >> 8) % 8;
+    return sizes[ARRAY_SIZE(sizes) - 1];
+}
+
+static DWORD WINAPI heap_stress_thread( void *arg )
+{
+    struct heap_stress_params *params = arg;
+    BYTE *ptrs[256] = {0};
+    SIZE_T sizes[256];
+    UINT i, j, seed = params->seed, errors = 0;
+
+    for (i = 0; i < params->count; i++)
+    {
+        j = heap_stress_rand( &seed ) % ARRAY_SIZE(ptrs);
+        if (ptrs[j])
+        {
+            if (ptrs[j][0] != (BYTE)j || ptrs[j][sizes[j] - 1] != (BYTE)j) errors++;
+            if (!HeapFree( params->heap, 0, ptrs[j] )) errors++;
+            ptrs[j] = NULL;
+            continue;
+        }
+
+        sizes[j] = heap_stress_size( &seed );
+        if (!(ptrs[j] = HeapAlloc( params->heap, 0, sizes[j] ))) errors++;
+        else ptrs[j][0] = ptrs[j][sizes[j] - 1] = j;
+    }
+
+    for (j = 0; j < ARRAY_SIZE(ptrs); j++)
+    {
+        if (!ptrs[j]) continue;
+        if (ptrs[j][0] != (BYTE)j || ptrs[j][sizes[j] - 1] != (BYTE)j) errors++;
+        if (!HeapFree( params->heap, 0, ptrs[j] )) errors++;
+    }
+
+    return errors;
+}
+
+static void test_heap_stress_threads( HANDLE heap, const char *name, UINT count )
+{
+    struct heap_stress_params params[4];
+    HANDLE threads[4];
+    DWORD i, ret, errors, start;
+
+    start = GetTickCount();
+    for (i = 0; i < ARRAY_SIZE(threads); i++)
+    {
+        params[i].heap = heap;
+        params[i].seed = 0xdeadbeef + i;
+        params[i].count = count;
+        threads[i] = CreateThread( NULL, 0, heap_stress_thread, &params[i], 0, NULL );
+        ok( !!threads[i], "CreateThread failed, error %lu\n", GetLastError() );
+    }
+
+    for (i = 0; i < ARRAY_SIZE(threads); i++)
+    {
+        ret = WaitForSingleObject( threads[i], 60000 );
+        ok( !ret, "WaitForSingleObject returned %#lx\n", ret );
+        ret = GetExitCodeThread( threads[i], &errors );
+        ok( ret, "GetExitCodeThread failed, error %lu\n", GetLastError() );
+        ok( !errors, "thread %lu got %lu errors\n", i, errors );
+        CloseHandle( threads[i] );
+    }
+
+    if (winetest_interactive)
+        trace( "%s: %lu threads x %u alloc/free in %lu ms\n", name, i, count, GetTickCount() - start );
+
+    ret = HeapValidate( heap, 0, NULL );
+    ok( ret, "HeapValidate failed\n" );
+}
+
+static SIZE_T heap_committed_size( HANDLE heap )
+{
+    PROCESS_HEAP_ENTRY entry = {0};
+    SIZE_T committed = 0;
+
+    while (HeapWalk( heap, &entry ))
+        if (entry.wFlags & PROCESS_HEAP_REGION) committed += entry.Region.dwCommittedSize;
+
+    return committed;
+}
+
+static void test_heap_stress(void)
+{
+    UINT count = winetest_interactive ? 1000000 : 10000;
+    SIZE_T size, committed, initial;
+    ULONG compat_info = 2;
+    BYTE *ptr, *ptrs[1024];
+    UINT i, pass, seed = 0x12345678;
+    DWORD start;
+    HANDLE heap;
+    BOOL ret;
+
+    /* multi-threaded alloc / free mix */
+
+    heap = HeapCreate( 0, 0, 0 );
+    ok( !!heap, "HeapCreate failed, error %lu\n", GetLastError() );
+    test_heap_stress_threads( heap, "default heap", count );
+    HeapDestroy( heap );
+
+    heap = HeapCreate( 0, 0, 0 );
+    ok( !!heap, "HeapCreate failed, error %lu\n", GetLastError() );
+    ret = HeapSetInformation( heap, HeapCompatibilityInformation, &compat_info, sizeof(compat_info) );
+    ok( ret, "HeapSetInformation failed, error %lu\n", GetLastError() );
+    test_heap_stress_threads( heap, "LFH heap", count );
+    HeapDestroy( heap );
+
+    /* realloc growth interleaved with small allocations */
+
+    heap = HeapCreate( HEAP_NO_SERIALIZE, 0, 0 );
+    ok( !!heap, "HeapCreate failed, error %lu\n", GetLastError() );
+
+    start = GetTickCount();
+    ptr = HeapAlloc( heap, 0, 1 );
+    ok( !!ptr, "HeapAlloc failed, error %lu\n", GetLastError() );
+    ptr[0] = 0x5a;
+    for (i = 0, size = 1; i < ARRAY_SIZE(ptrs); i++)
+    {
+        size += size / 8 + 16;
+        ptr = HeapReAlloc( heap, 0, ptr, size );
+        ok( !!ptr, "HeapReAlloc %#Ix failed, error %lu\n", size, GetLastError() );
+        if (!ptr) break;
+        ok( ptr[0] == 0x5a, "got %#x\n", ptr[0] );
+        ptrs[i] = HeapAlloc( heap, 0, heap_stress_size( &seed ) );
+        ok( !!ptrs[i], "HeapAlloc failed, error %lu\n", GetLastError() );
+        if (size > 0x1000000) break;
+    }
+    if (winetest_interactive)
+        trace( "realloc growth: %u steps up to %#Ix in %lu ms\n", i, size, GetTickCount() - start );
+    while (i--) HeapFree( heap, 0, ptrs[i] );
+    HeapFree( heap, 0, ptr );
+
+    ret = HeapValidate( heap, 0, NULL );
+    ok( ret, "HeapValidate failed\n" );
+    HeapDestroy( heap );
+
+    /* fragmentation: free every other block then allocate bigger ones */
+
+    heap = HeapCreate( HEAP_NO_SERIALIZE, 0, 0 );
+    ok( !!heap, "HeapCreate failed, error %lu\n", GetLastError() );
+    initial = heap_committed_size( heap );
+
+    start = GetTickCount();
+    for (pass = 0; pass < (winetest_interactive ? 100 : 4); pass++)
+    {
+        for (i = 0; i < ARRAY_SIZE(ptrs); i++)
+        {
+            ptrs[i] = HeapAlloc( heap, 0, heap_stress_size( &seed ) % 0x1000 );
+            ok( !!ptrs[i], "HeapAlloc failed, error %lu\n", GetLastError() );
+        }
+        for (i = 0; i < ARRAY_SIZE(ptrs); i += 2) HeapFree( heap, 0, ptrs[i] );
+        for (i = 0; i < ARRAY_SIZE(ptrs); i += 2)
+        {
+            ptrs[i] = HeapAlloc( heap, 0, 2 * (heap_stress_size( &seed ) % 0x1000) );
+            ok( !!ptrs[i], "HeapAlloc failed, error %lu\n", GetLastError() );
+        }
+        for (i = 0; i < ARRAY_SIZE(ptrs); i++) HeapFree( heap, 0, ptrs[i] );
+    }
+    committed = heap_committed_size( heap );
+    if (winetest_interactive)
+        trace( "fragmentation: committed %#Ix -> %#Ix in %lu ms\n", initial, committed, GetTickCount() - start );
+
+    ret = HeapValidate( heap, 0, NULL );
+    ok( ret, "HeapValidate failed\n" );
+    HeapDestroy( heap );
+}
+
 START_TEST(heap)
 {
     int argc;
@@ -2786,6 +2988,7 @@ START_TEST(heap)
     test_HeapCreate();
     test_GlobalAlloc();
     test_LocalAlloc();
+    test_heap_stress();
 
     test_GetPhysicallyInstalledSystemMemory();
     test_GlobalMemoryStatus();
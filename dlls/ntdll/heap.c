@@ -38,6 +38,7 @@
 #include "wine/debug.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(heap);
+WINE_DECLARE_DEBUG_CHANNEL(heapstats);
 
 /* undocumented RtlWalkHeap structure */
 
@@ -92,6 +93,7 @@ C_ASSERT( sizeof(struct block) == 8 );
 #define BLOCK_FLAG_PREV_FREE   0x00000002
 #define BLOCK_FLAG_FREE_LINK   0x00000003
 #define BLOCK_FLAG_LARGE       0x00000004
+#define BLOCK_FLAG_LFH         0x00000008
 
 
 /* entry to link free blocks in free lists */
@@ -126,6 +128,8 @@ C_ASSERT( sizeof(ARENA_LARGE) == 4 * ALIGNMENT );
 #define ARENA_PENDING_MAGIC    0xbedead
 #define ARENA_FREE_MAGIC       0x45455246
 #define ARENA_LARGE_MAGIC      0x6752614c
+#define ARENA_GROUP_MAGIC      0x756f7247
+#define ARENA_LFH_MAGIC        0x48464c00  /* low byte is the index of the block in its group */
 
 #define ARENA_INUSE_FILLER     0x55
 #define ARENA_TAIL_FILLER      0xab
@@ -174,6 +178,70 @@ typedef struct DECLSPEC_ALIGN(ALIGNMENT) tagSUBHEAP
 C_ASSERT( sizeof(SUBHEAP) == offsetof(SUBHEAP, block) + sizeof(struct block) );
 C_ASSERT( sizeof(SUBHEAP) == 4 * ALIGNMENT );
 
+/* low fragmentation heap front end: small blocks are sorted in size classes (bins) and
+ * allocated from groups of GROUP_BLOCK_COUNT blocks of the bin size. Groups are regular
+ * heap blocks, and are owned by at most one thread at a time, either through a thread
+ * affinity slot or after being popped from the bin list. Other threads only set free
+ * bits, so that allocation and free don't need the heap lock. */
+
+struct group
+{
+    SLIST_ENTRY   entry;      /* entry in the bin list of groups */
+    volatile LONG free_bits;  /* bitmask of the free blocks, GROUP_FLAG_FREE if owned by no thread */
+};
+
+#define GROUP_BLOCK_COUNT    31
+#define GROUP_FLAG_FREE      ((LONG)0x80000000)
+#define GROUP_FREE_BITS_ALL  ((LONG)0x7fffffff)
+#define GROUP_BLOCKS_OFFSET  (ROUND_SIZE( sizeof(struct group) + sizeof(struct block), ALIGNMENT - 1 ) - sizeof(struct block))
+
+/* the block index is stored in the low byte of the block magic */
+C_ASSERT( GROUP_BLOCK_COUNT <= 0x100 );
+
+/* bins below HEAP_MAX_SMALL_FREE_LIST match the small free lists, and use a coarser step above */
+#define BIN_MEDIUM_STEP          0x80
+#define HEAP_MAX_BIN_BLOCK_SIZE  0x2000
+#define HEAP_NB_BINS             (HEAP_NB_SMALL_FREE_LISTS + (HEAP_MAX_BIN_BLOCK_SIZE - HEAP_MAX_SMALL_FREE_LIST) / BIN_MEDIUM_STEP)
+#define HEAP_NB_AFFINITY         8
+
+/* unused size must fit in the block tail_size */
+C_ASSERT( BIN_MEDIUM_STEP <= 0x100 );
+
+struct bin
+{
+    SLIST_HEADER  groups;       /* groups with free blocks, not owned by any thread */
+    LONG          count_alloc;  /* number of regular allocations of this size */
+    LONG          count_freed;  /* number of regular frees of this size */
+    volatile LONG enabled;      /* whether the bin is used for allocations */
+};
+
+struct lfh
+{
+    struct bin    bins[HEAP_NB_BINS];
+    struct group *affinity_groups[HEAP_NB_AFFINITY][HEAP_NB_BINS];  /* groups owned by thread affinity slots */
+};
+
+/* heap statistics, only collected for heaps created with WINEDEBUG=+heapstats */
+struct heap_stats
+{
+    SIZE_T lock_count;      /* number of lock acquisitions */
+    SIZE_T lock_waits;      /* number of lock acquisitions that had to wait */
+    SIZE_T search_count;    /* number of free block searches */
+    SIZE_T search_length;   /* total number of free list entries walked by searches */
+    SIZE_T search_max;      /* longest free block search */
+    SIZE_T commit_count;    /* number of subheap commits */
+    SIZE_T commit_size;     /* total size committed */
+    SIZE_T decommit_count;  /* number of subheap decommits */
+    SIZE_T decommit_size;   /* total size decommitted */
+    SIZE_T subheap_count;   /* number of subheaps created after the main one */
+    SIZE_T group_count;     /* number of LFH groups allocated */
+    SIZE_T group_released;  /* number of LFH groups released */
+};
+
+/* HeapCompatibilityInformation values */
+#define HEAP_STD 0
+#define HEAP_LFH 2
+
 struct heap
 {                                  /* win32/win64 */
     DWORD_PTR        unknown1[2];   /* 0000/0000 */
@@ -195,6 +263,10 @@ struct heap
     DWORD            magic;         /* Magic number */
     DWORD            pending_pos;   /* Position in pending free requests ring */
     struct block   **pending_free;  /* Ring buffer for pending free requests */
+    LONG             compat_info;   /* HeapCompatibilityInformation value */
+    struct lfh      *lfh;           /* Low fragmentation heap front end */
+    BOOL             collect_stats; /* Instrumentation mode, statistics are collected */
+    struct heap_stats stats;        /* Statistics, updated with the heap lock held */
     RTL_CRITICAL_SECTION cs;
     struct entry     free_lists[HEAP_NB_FREE_LISTS];
     SUBHEAP          subheap;
@@ -314,6 +386,59 @@ static inline BOOL check_subheap( const SUBHEAP *subheap )
     return contains( &subheap->block, subheap->block_size, subheap + 1, subheap->data_size );
 }
 
+static inline UINT bin_from_block_size( SIZE_T block_size )
+{
+    if (block_size <= HEAP_MAX_SMALL_FREE_LIST) return (block_size - HEAP_MIN_BLOCK_SIZE) / ALIGNMENT;
+    return HEAP_NB_SMALL_FREE_LISTS + (block_size - HEAP_MAX_SMALL_FREE_LIST - 1) / BIN_MEDIUM_STEP;
+}
+
+static inline SIZE_T bin_block_size( UINT bin )
+{
+    if (bin < HEAP_NB_SMALL_FREE_LISTS) return HEAP_MIN_BLOCK_SIZE + bin * ALIGNMENT;
+    return HEAP_MAX_SMALL_FREE_LIST + (bin - HEAP_NB_SMALL_FREE_LISTS + 1) * BIN_MEDIUM_STEP;
+}
+
+static inline struct block *group_get_block( const struct group *group, SIZE_T block_size, UINT index )
+{
+    return (struct block *)((char *)group + GROUP_BLOCKS_OFFSET + index * block_size);
+}
+
+static inline UINT lfh_block_get_index( const struct block *block )
+{
+    return block_get_type( block ) & 0xff;
+}
+
+static inline struct group *lfh_block_get_group( const struct block *block )
+{
+    return (struct group *)((char *)block - lfh_block_get_index( block ) * block_get_size( block ) - GROUP_BLOCKS_OFFSET);
+}
+
+static inline BOOL lfh_block_is_free( const struct block *block )
+{
+    return (lfh_block_get_group( block )->free_bits & (1 << lfh_block_get_index( block ))) != 0;
+}
+
+/* check the header of a block allocated from a LFH group, return an error string if invalid */
+static const char *check_lfh_block( const struct block *block )
+{
+    SIZE_T block_size = block_get_size( block );
+    const struct block *container;
+
+    if ((ULONG_PTR)(block + 1) % ALIGNMENT) return "invalid block alignment";
+    if (block_get_flags( block ) != BLOCK_FLAG_LFH) return "invalid block flags";
+    if ((block_get_type( block ) & ~0xff) != ARENA_LFH_MAGIC) return "invalid block header";
+    if (lfh_block_get_index( block ) >= GROUP_BLOCK_COUNT) return "invalid block index";
+    if (block_size < HEAP_MIN_BLOCK_SIZE || block_size > HEAP_MAX_BIN_BLOCK_SIZE ||
+        bin_block_size( bin_from_block_size( block_size ) ) != block_size) return "invalid block size";
+    if (block->tail_size > block_size - sizeof(*block)) return "invalid block unused size";
+
+    container = (const struct block *)lfh_block_get_group( block ) - 1;
+    if (block_get_type( container ) != ARENA_GROUP_MAGIC) return "invalid block group";
+    if (block_get_size( container ) < sizeof(*container) + GROUP_BLOCKS_OFFSET + GROUP_BLOCK_COUNT * block_size)
+        return "invalid block group size";
+    return NULL;
+}
+
 static BOOL heap_validate( const struct heap *heap );
 
 /* mark a block of memory as innacessible for debugging purposes */
@@ -467,10 +592,21 @@ static inline ULONG heap_get_flags( const struct heap *heap, ULONG flags )
     return heap->flags | flags;
 }
 
+static void heap_lock_stats( struct heap *heap )
+{
+    if (!RtlTryEnterCriticalSection( &heap->cs ))
+    {
+        RtlEnterCriticalSection( &heap->cs );
+        heap->stats.lock_waits++;
+    }
+    heap->stats.lock_count++;
+}
+
 static void heap_lock( struct heap *heap, ULONG flags )
 {
     if (heap_get_flags( heap, flags ) & HEAP_NO_SERIALIZE) return;
-    RtlEnterCriticalSection( &heap->cs );
+    if (heap->collect_stats) heap_lock_stats( heap );
+    else RtlEnterCriticalSection( &heap->cs );
 }
 
 static void heap_unlock( struct heap *heap, ULONG flags )
@@ -570,6 +706,30 @@ static void heap_dump( const struct heap *heap )
     }
 }
 
+static void heap_dump_stats( const struct heap *heap )
+{
+    const struct heap_stats *stats = &heap->stats;
+
+    TRACE_(heapstats)( "heap %p: locks %Iu, waits %Iu, searches %Iu, average length %Iu, max length %Iu\n",
+                       heap, stats->lock_count, stats->lock_waits, stats->search_count,
+                       stats->search_count ? stats->search_length / stats->search_count : 0, stats->search_max );
+    TRACE_(heapstats)( "heap %p: commits %Iu (%#Ix bytes), decommits %Iu (%#Ix bytes), subheaps %Iu, LFH groups %Iu (%Iu released)\n",
+                       heap, stats->commit_count, stats->commit_size, stats->decommit_count, stats->decommit_size,
+                       stats->subheap_count, stats->group_count, stats->group_released );
+}
+
+/* report the statistics of all heaps on process exit, other threads are gone so don't take any lock */
+void heap_dump_all_stats(void)
+{
+    const struct heap *heap;
+
+    if (!TRACE_ON(heapstats) || !process_heap) return;
+
+    if (process_heap->collect_stats) heap_dump_stats( process_heap );
+    LIST_FOR_EACH_ENTRY( heap, &process_heap->entry, struct heap, entry )
+        if (heap->collect_stats) heap_dump_stats( heap );
+}
+
 static const char *debugstr_heap_entry( struct rtl_heap_entry *entry )
 {
     const char *str = wine_dbg_sprintf( "data %p, size %#Ix, overhead %#x, region %#x, flags %#x", entry->lpData,
@@ -623,7 +783,7 @@ static SUBHEAP *find_subheap( const struct heap *heap, const struct block *block
 }
 
 
-static inline BOOL subheap_commit( const struct heap *heap, SUBHEAP *subheap, const struct block *block, SIZE_T block_size )
+static inline BOOL subheap_commit( struct heap *heap, SUBHEAP *subheap, const struct block *block, SIZE_T block_size )
 {
     const char *end = (char *)subheap_base( subheap ) + subheap_size( subheap ), *commit_end;
     ULONG flags = heap->flags;
@@ -646,11 +806,16 @@ static inline BOOL subheap_commit( const struct heap *heap, SUBHEAP *subheap, co
         return FALSE;
     }
 
+    if (heap->collect_stats)
+    {
+        heap->stats.commit_count++;
+        heap->stats.commit_size += size;
+    }
     subheap->data_size = (char *)commit_end - (char *)(subheap + 1);
     return TRUE;
 }
 
-static inline BOOL subheap_decommit( const struct heap *heap, SUBHEAP *subheap, const void *commit_end )
+static inline BOOL subheap_decommit( struct heap *heap, SUBHEAP *subheap, const void *commit_end )
 {
     char *base = subheap_base( subheap );
     SIZE_T size;
@@ -669,6 +834,11 @@ static inline BOOL subheap_decommit( const struct heap *heap, SUBHEAP *subheap,
         return FALSE;
     }
 
+    if (heap->collect_stats)
+    {
+        heap->stats.decommit_count++;
+        heap->stats.decommit_size += size;
+    }
     subheap->data_size = (char *)commit_end - (char *)(subheap + 1);
     return TRUE;
 }
@@ -959,6 +1129,10 @@ static SUBHEAP *HEAP_CreateSubHeap( struct heap **heap_ptr, LPVOID address, DWOR
         heap->magic         = HEAP_MAGIC;
         heap->grow_size     = max( HEAP_DEF_SIZE, totalSize );
         heap->min_size      = commitSize;
+        heap->compat_info   = HEAP_STD;
+        heap->lfh           = NULL;
+        heap->collect_stats = FALSE;
+        memset( &heap->stats, 0, sizeof(heap->stats) );
         list_init( &heap->subheap_list );
         list_init( &heap->large_list );
 
@@ -1017,12 +1191,20 @@ static SUBHEAP *HEAP_CreateSubHeap( struct heap **heap_ptr, LPVOID address, DWOR
 }
 
 
+static inline void heap_count_search( struct heap *heap, SIZE_T length )
+{
+    if (!heap->collect_stats) return;
+    heap->stats.search_count++;
+    heap->stats.search_length += length;
+    if (length > heap->stats.search_max) heap->stats.search_max = length;
+}
+
 static struct block *find_free_block( struct heap *heap, SIZE_T block_size, SUBHEAP **subheap )
 {
     struct list *ptr = &find_free_list( heap, block_size, FALSE )->entry;
+    SIZE_T total_size, length = 0;
     struct entry *entry;
     struct block *block;
-    SIZE_T total_size;
 
     /* Find a suitable free list, and in it find a block large enough */
 
@@ -1030,9 +1212,11 @@ static struct block *find_free_block( struct heap *heap, SIZE_T block_size, SUBH
     {
         entry = LIST_ENTRY( ptr, struct entry, entry );
         block = (struct block *)entry;
+        length++;
         if (block_get_flags( block ) == BLOCK_FLAG_FREE_LINK) continue;
         if (block_get_size( block ) >= block_size)
         {
+            heap_count_search( heap, length );
             *subheap = find_subheap( heap, block, FALSE );
             if (!subheap_commit( heap, *subheap, block, block_size )) return NULL;
             list_remove( &entry->entry );
@@ -1042,6 +1226,7 @@ static struct block *find_free_block( struct heap *heap, SIZE_T block_size, SUBH
 
     /* If no block was found, attempt to grow the heap */
 
+    heap_count_search( heap, length );
     if (!(heap->flags & HEAP_GROWABLE))
     {
         WARN("Not enough space in heap %p for %08lx bytes\n", heap, block_size );
@@ -1066,6 +1251,7 @@ static struct block *find_free_block( struct heap *heap, SIZE_T block_size, SUBH
     }
 
     TRACE( "created new sub-heap %p of %08lx bytes for heap %p\n", *subheap, subheap_size( *subheap ), heap );
+    if (heap->collect_stats) heap->stats.subheap_count++;
 
     entry = first_block( *subheap );
     list_remove( &entry->entry );
@@ -1145,9 +1331,10 @@ static BOOL validate_used_block( const struct heap *heap, const SUBHEAP *subheap
 
     if ((ULONG_PTR)(block + 1) % ALIGNMENT)
         err = "invalid block alignment";
-    else if (block_get_type( block ) != ARENA_INUSE_MAGIC && block_get_type( block ) != ARENA_PENDING_MAGIC)
+    else if (block_get_type( block ) != ARENA_INUSE_MAGIC && block_get_type( block ) != ARENA_PENDING_MAGIC &&
+             block_get_type( block ) != ARENA_GROUP_MAGIC)
         err = "invalid block header";
-    else if (block_get_flags( block ) & BLOCK_FLAG_FREE)
+    else if (block_get_flags( block ) & (BLOCK_FLAG_FREE | BLOCK_FLAG_LFH))
         err = "invalid block flags";
     else if (!contains( base, commit_end - base, block, block_get_size( block ) ))
         err = "invalid block size";
@@ -1191,6 +1378,50 @@ static BOOL validate_used_block( const struct heap *heap, const SUBHEAP *subheap
 }
 
 
+static BOOL validate_lfh_block( const struct heap *heap, const struct block *block )
+{
+    const char *err;
+
+    if (!(err = check_lfh_block( block )) && lfh_block_is_free( block )) err = "already freed block";
+
+    if (err)
+    {
+        ERR( "heap %p, block %p: %s\n", heap, block, err );
+        if (TRACE_ON(heap)) heap_dump( heap );
+    }
+
+    return !err;
+}
+
+static BOOL validate_group( const struct heap *heap, const struct block *container )
+{
+    const struct group *group = (struct group *)(container + 1);
+    const struct block *block = group_get_block( group, 0, 0 );
+    const char *err;
+    SIZE_T block_size;
+    UINT i;
+
+    if (!(err = check_lfh_block( block )))
+    {
+        block_size = block_get_size( block );
+        for (i = 1; !err && i < GROUP_BLOCK_COUNT; i++)
+        {
+            block = group_get_block( group, block_size, i );
+            if ((err = check_lfh_block( block ))) break;
+            if (lfh_block_get_index( block ) != i || block_get_size( block ) != block_size)
+                err = "invalid group block";
+        }
+    }
+
+    if (err)
+    {
+        ERR( "heap %p, block %p: %s\n", heap, block, err );
+        if (TRACE_ON(heap)) heap_dump( heap );
+    }
+
+    return !err;
+}
+
 static BOOL heap_validate_ptr( const struct heap *heap, const void *ptr, SUBHEAP **subheap )
 {
     const struct block *block = (struct block *)ptr - 1;
@@ -1206,6 +1437,7 @@ static BOOL heap_validate_ptr( const struct heap *heap, const void *ptr, SUBHEAP
         return validate_large_block( heap, block );
     }
 
+    if (block_get_flags( block ) & BLOCK_FLAG_LFH) return validate_lfh_block( heap, block );
     return validate_used_block( heap, *subheap, block );
 }
 
@@ -1233,6 +1465,7 @@ static BOOL heap_validate( const struct heap *heap )
             else
             {
                 if (!validate_used_block( heap, subheap, block )) return FALSE;
+                if (block_get_type( block ) == ARENA_GROUP_MAGIC && !validate_group( heap, block )) return FALSE;
             }
         }
     }
@@ -1267,6 +1500,10 @@ static inline struct block *unsafe_block_from_ptr( const struct heap *heap, cons
     }
     else if ((ULONG_PTR)ptr % ALIGNMENT)
         err = "invalid ptr alignment";
+    else if (block_get_flags( block ) & BLOCK_FLAG_LFH)
+    {
+        if (!(err = check_lfh_block( block )) && lfh_block_is_free( block )) err = "already freed block";
+    }
     else if (block_get_type( block ) == ARENA_PENDING_MAGIC || (block_get_flags( block ) & BLOCK_FLAG_FREE))
         err = "already freed block";
     else if (block_get_type( block ) != ARENA_INUSE_MAGIC)
@@ -1320,6 +1557,7 @@ static void heap_set_debug_flags( HANDLE handle )
 
     heap->flags |= flags;
     heap->force_flags |= force_flags;
+    heap->collect_stats = TRACE_ON(heapstats);
 
     if (flags & (HEAP_FREE_CHECKING_ENABLED | HEAP_TAIL_CHECKING_ENABLED))  /* fix existing blocks */
     {
@@ -1454,6 +1692,8 @@ HANDLE WINAPI RtlDestroyHeap( HANDLE handle )
 
     if (heap == process_heap) return handle; /* cannot delete the main process heap */
 
+    if (heap->collect_stats) heap_dump_stats( heap );
+
     /* remove it from the per-process list */
     RtlEnterCriticalSection( &process_heap->cs );
     list_remove( &heap->entry );
@@ -1462,6 +1702,13 @@ HANDLE WINAPI RtlDestroyHeap( HANDLE handle )
     heap->cs.DebugInfo->Spare[0] = 0;
     RtlDeleteCriticalSection( &heap->cs );
 
+    if (heap->lfh)
+    {
+        size = 0;
+        addr = heap->lfh;
+        NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
+    }
+
     LIST_FOR_EACH_ENTRY_SAFE( arena, arena_next, &heap->large_list, ARENA_LARGE, entry )
     {
         list_remove( &arena->entry );
@@ -1534,12 +1781,174 @@ static NTSTATUS heap_allocate( struct heap *heap, ULONG flags, SIZE_T size, void
     return STATUS_SUCCESS;
 }
 
+static LONG next_heap_affinity;
+
+/* return the LFH affinity slot of the current thread */
+static UINT heap_current_thread_affinity(void)
+{
+    ULONG affinity;
+
+    if (!(affinity = NtCurrentTeb()->HeapVirtualAffinity))
+    {
+        affinity = 1 + (ULONG)InterlockedIncrement( &next_heap_affinity ) % HEAP_NB_AFFINITY;
+        NtCurrentTeb()->HeapVirtualAffinity = affinity;
+    }
+
+    return affinity - 1;
+}
+
+/* allocate a new group of blocks for a bin, from the regular heap */
+static struct group *group_allocate( struct heap *heap, UINT bin )
+{
+    SIZE_T block_size = bin_block_size( bin );
+    struct group *group;
+    struct block *block;
+    NTSTATUS status;
+    void *ptr;
+    UINT i;
+
+    heap_lock( heap, 0 );
+    if (!(status = heap_allocate( heap, heap->flags, GROUP_BLOCKS_OFFSET + GROUP_BLOCK_COUNT * block_size, &ptr )))
+    {
+        block_set_type( (struct block *)ptr - 1, ARENA_GROUP_MAGIC );
+        if (heap->collect_stats) heap->stats.group_count++;
+    }
+    heap_unlock( heap, 0 );
+    if (status) return NULL;
+
+    group = ptr;
+    group->free_bits = GROUP_FREE_BITS_ALL;
+    for (i = 0; i < GROUP_BLOCK_COUNT; i++)
+    {
+        block = group_get_block( group, block_size, i );
+        block_set_type( block, ARENA_LFH_MAGIC | i );
+        block_set_size( block, BLOCK_FLAG_LFH, block_size );
+        block->tail_size = 0;
+        mark_block_free( block + 1, block_size - sizeof(*block), heap->flags );
+    }
+
+    return group;
+}
+
+/* release a group with all its blocks free back to the regular heap */
+static void group_release( struct heap *heap, struct group *group )
+{
+    struct block *block = (struct block *)group - 1;
+    SUBHEAP *subheap;
+
+    heap_lock( heap, 0 );
+    block_set_type( block, ARENA_INUSE_MAGIC );
+    if ((subheap = find_subheap( heap, block, FALSE ))) free_used_block( heap, subheap, block );
+    if (heap->collect_stats) heap->stats.group_released++;
+    heap_unlock( heap, 0 );
+}
+
+/* take ownership of a group with free blocks, from the affinity slot, the bin list, or a new one */
+static struct group *heap_acquire_bin_group( struct heap *heap, UINT bin, UINT affinity )
+{
+    struct lfh *lfh = heap->lfh;
+    struct group *group;
+    SLIST_ENTRY *entry;
+
+    if ((group = InterlockedExchangePointer( (void **)&lfh->affinity_groups[affinity][bin], NULL ))) return group;
+    if ((entry = RtlInterlockedPopEntrySList( &lfh->bins[bin].groups ))) return CONTAINING_RECORD( entry, struct group, entry );
+    return group_allocate( heap, bin );
+}
+
+/* give up ownership of a group, keeping it in the affinity slot and moving the previous one to the bin list */
+static void heap_release_bin_group( struct heap *heap, UINT bin, UINT affinity, struct group *group )
+{
+    struct lfh *lfh = heap->lfh;
+
+    if (!(group = InterlockedExchangePointer( (void **)&lfh->affinity_groups[affinity][bin], group ))) return;
+    if (group->free_bits == GROUP_FREE_BITS_ALL) group_release( heap, group );
+    else RtlInterlockedPushEntrySList( &lfh->bins[bin].groups, &group->entry );
+}
+
+static NTSTATUS heap_allocate_block_lfh( struct heap *heap, ULONG flags, SIZE_T size, void **ret )
+{
+    struct group *group;
+    struct block *block;
+    SIZE_T block_size;
+    UINT bin, affinity;
+    DWORD index;
+
+    if (flags & (HEAP_NO_SERIALIZE | HEAP_ADD_USER_INFO | HEAP_CHECKING_ENABLED)) return STATUS_UNSUCCESSFUL;
+
+    block_size = heap_get_block_size( heap, flags, size );
+    if (block_size < size || block_size > HEAP_MAX_BIN_BLOCK_SIZE) return STATUS_UNSUCCESSFUL;
+    if (block_size < HEAP_MIN_BLOCK_SIZE) block_size = HEAP_MIN_BLOCK_SIZE;
+
+    bin = bin_from_block_size( block_size );
+    if (!heap->lfh->bins[bin].enabled) return STATUS_UNSUCCESSFUL;
+    block_size = bin_block_size( bin );
+    affinity = heap_current_thread_affinity();
+
+    for (;;)
+    {
+        if (!(group = heap_acquire_bin_group( heap, bin, affinity ))) return STATUS_NO_MEMORY;
+        /* other threads can only free blocks of a group we own, if it is full, give
+         * it up atomically and the thread that frees one of its blocks will take it */
+        if (group->free_bits || InterlockedCompareExchange( &group->free_bits, GROUP_FLAG_FREE, 0 )) break;
+    }
+
+    BitScanForward( &index, group->free_bits );
+    InterlockedAnd( &group->free_bits, ~(1 << index) );
+    heap_release_bin_group( heap, bin, affinity, group );
+
+    block = group_get_block( group, block_size, index );
+    block->tail_size = block_size - sizeof(*block) - size;
+    initialize_block( block + 1, size, flags );
+
+    *ret = block + 1;
+    return STATUS_SUCCESS;
+}
+
+static void heap_free_block_lfh( struct heap *heap, struct block *block )
+{
+    struct group *group = lfh_block_get_group( block );
+    UINT index = lfh_block_get_index( block ), bin = bin_from_block_size( block_get_size( block ) );
+
+    mark_block_free( block + 1, block_get_size( block ) - sizeof(*block), heap->flags );
+
+    /* the group was full and owned by no thread, take it back */
+    if (InterlockedOr( &group->free_bits, 1 << index ) != GROUP_FLAG_FREE) return;
+    InterlockedAnd( &group->free_bits, ~GROUP_FLAG_FREE );
+    heap_release_bin_group( heap, bin, heap_current_thread_affinity(), group );
+}
+
+/* lock-free lookup of an allocated LFH block, returns NULL if ptr doesn't point to one */
+static struct block *unsafe_lfh_block_from_ptr( const struct heap *heap, const void *ptr )
+{
+    struct block *block = (struct block *)ptr - 1;
+
+    if ((ULONG_PTR)ptr % ALIGNMENT || !(block_get_flags( block ) & BLOCK_FLAG_LFH)) return NULL;
+    if (check_lfh_block( block ) || lfh_block_is_free( block )) return NULL;
+    return block;
+}
+
+/* count regular allocations and frees, enabling the LFH bin once a size is used often enough */
+static void heap_update_bin_counts( struct heap *heap, const struct block *block, BOOL alloc )
+{
+    SIZE_T block_size = block_get_size( block );
+    struct bin *bin;
+
+    if (!heap->lfh || (block_get_flags( block ) & BLOCK_FLAG_LARGE) || block_size > HEAP_MAX_BIN_BLOCK_SIZE) return;
+
+    bin = heap->lfh->bins + bin_from_block_size( block_size );
+    if (bin->enabled) return;
+    if (!alloc) bin->count_freed++;
+    else if (++bin->count_alloc - bin->count_freed > 0x10 || bin->count_alloc > 0x800)
+        InterlockedExchange( &bin->enabled, TRUE );
+}
+
 /***********************************************************************
  *           RtlAllocateHeap   (NTDLL.@)
  */
 void *WINAPI DECLSPEC_HOTPATCH RtlAllocateHeap( HANDLE handle, ULONG flags, SIZE_T size )
 {
     struct heap *heap;
+    ULONG heap_flags;
     void *ptr = NULL;
     NTSTATUS status;
 
@@ -1547,9 +1956,14 @@ void *WINAPI DECLSPEC_HOTPATCH RtlAllocateHeap( HANDLE handle, ULONG flags, SIZE
         status = STATUS_INVALID_HANDLE;
     else
     {
-        heap_lock( heap, flags );
-        status = heap_allocate( heap, heap_get_flags( heap, flags ), size, &ptr );
-        heap_unlock( heap, flags );
+        heap_flags = heap_get_flags( heap, flags );
+        if (!heap->lfh || (status = heap_allocate_block_lfh( heap, heap_flags, size, &ptr )))
+        {
+            heap_lock( heap, flags );
+            if (!(status = heap_allocate( heap, heap_flags, size, &ptr )))
+                heap_update_bin_counts( heap, (struct block *)ptr - 1, TRUE );
+            heap_unlock( heap, flags );
+        }
     }
 
     if (!status) valgrind_notify_alloc( ptr, size, flags & HEAP_ZERO_MEMORY );
@@ -1567,7 +1981,12 @@ static NTSTATUS heap_free( struct heap *heap, void *ptr )
 
     if (!(block = unsafe_block_from_ptr( heap, ptr, &subheap ))) return STATUS_INVALID_PARAMETER;
     if (!subheap) free_large_block( heap, block );
-    else free_used_block( heap, subheap, block );
+    else if (block_get_flags( block ) & BLOCK_FLAG_LFH) heap_free_block_lfh( heap, block );
+    else
+    {
+        heap_update_bin_counts( heap, block, FALSE );
+        free_used_block( heap, subheap, block );
+    }
 
     return STATUS_SUCCESS;
 }
@@ -1577,6 +1996,7 @@ static NTSTATUS heap_free( struct heap *heap, void *ptr )
  */
 BOOLEAN WINAPI DECLSPEC_HOTPATCH RtlFreeHeap( HANDLE handle, ULONG flags, void *ptr )
 {
+    struct block *block;
     struct heap *heap;
     NTSTATUS status;
 
@@ -1586,6 +2006,11 @@ BOOLEAN WINAPI DECLSPEC_HOTPATCH RtlFreeHeap( HANDLE handle, ULONG flags, void *
 
     if (!(heap = unsafe_heap_from_handle( handle )))
         status = STATUS_INVALID_PARAMETER;
+    else if (heap->lfh && (block = unsafe_lfh_block_from_ptr( heap, ptr )))
+    {
+        heap_free_block_lfh( heap, block );
+        status = STATUS_SUCCESS;
+    }
     else
     {
         heap_lock( heap, flags );
@@ -1599,6 +2024,36 @@ BOOLEAN WINAPI DECLSPEC_HOTPATCH RtlFreeHeap( HANDLE handle, ULONG flags, void *
 }
 
 
+static NTSTATUS heap_reallocate_lfh( struct heap *heap, ULONG flags, struct block *block,
+                                     SIZE_T block_size, SIZE_T size, void **ret )
+{
+    SIZE_T old_block_size = block_get_size( block ), old_size = old_block_size - block_get_overhead( block );
+    NTSTATUS status;
+
+    /* the block can only be kept if the unused size still fits in tail_size */
+    if (block_size <= old_block_size && old_block_size - sizeof(*block) - size <= 0xff)
+    {
+        valgrind_notify_resize( block + 1, old_size, size );
+        block->tail_size = old_block_size - sizeof(*block) - size;
+        if (size > old_size) initialize_block( (char *)(block + 1) + old_size, size - old_size, flags );
+
+        *ret = block + 1;
+        return STATUS_SUCCESS;
+    }
+
+    if (flags & HEAP_REALLOC_IN_PLACE_ONLY) return STATUS_NO_MEMORY;
+    if (heap_allocate_block_lfh( heap, flags & ~HEAP_ZERO_MEMORY, size, ret ) &&
+        (status = heap_allocate( heap, flags & ~HEAP_ZERO_MEMORY, size, ret )))
+        return status;
+
+    valgrind_notify_alloc( *ret, size, 0 );
+    memcpy( *ret, block + 1, min( old_size, size ) );
+    if ((flags & HEAP_ZERO_MEMORY) && size > old_size) memset( (char *)*ret + old_size, 0, size - old_size );
+    valgrind_notify_free( block + 1 );
+    heap_free_block_lfh( heap, block );
+    return STATUS_SUCCESS;
+}
+
 static NTSTATUS heap_reallocate( struct heap *heap, ULONG flags, void *ptr, SIZE_T size, void **ret )
 {
     SIZE_T old_block_size, old_size, block_size;
@@ -1618,6 +2073,8 @@ static NTSTATUS heap_reallocate( struct heap *heap, ULONG flags, void *ptr, SIZE
         *ret = block + 1;
         return STATUS_SUCCESS;
     }
+    if (block_get_flags( block ) & BLOCK_FLAG_LFH)
+        return heap_reallocate_lfh( heap, flags, block, block_size, size, ret );
 
     /* Check if we need to grow the block */
 
@@ -1820,17 +2277,46 @@ static NTSTATUS heap_walk_blocks( const struct heap *heap, const SUBHEAP *subhea
 
     if (entry->lpData == commit_end) return STATUS_NO_MORE_ENTRIES;
     if (entry->lpData == base) block = blocks;
-    else if (!(block = next_block( subheap, block )))
+    else if ((block_get_flags( block ) & BLOCK_FLAG_LFH) && lfh_block_get_index( block ) < GROUP_BLOCK_COUNT - 1)
+        block = (struct block *)((char *)block + block_get_size( block ));
+    else
     {
-        entry->lpData = (void *)commit_end;
-        entry->cbData = end - commit_end;
-        entry->cbOverhead = 0;
-        entry->iRegionIndex = 0;
-        entry->wFlags = RTL_HEAP_ENTRY_UNCOMMITTED;
-        return STATUS_SUCCESS;
+        /* continue after the group block once all its LFH blocks have been enumerated */
+        if (block_get_flags( block ) & BLOCK_FLAG_LFH) block = (struct block *)lfh_block_get_group( block ) - 1;
+        if (!(block = next_block( subheap, block )))
+        {
+            entry->lpData = (void *)commit_end;
+            entry->cbData = end - commit_end;
+            entry->cbOverhead = 0;
+            entry->iRegionIndex = 0;
+            entry->wFlags = RTL_HEAP_ENTRY_UNCOMMITTED;
+            return STATUS_SUCCESS;
+        }
     }
 
-    if (block_get_flags( block ) & BLOCK_FLAG_FREE)
+    /* enumerate the LFH blocks instead of the group block itself */
+    if (block_get_type( block ) == ARENA_GROUP_MAGIC) block = group_get_block( (struct group *)(block + 1), 0, 0 );
+
+    if (block_get_flags( block ) & BLOCK_FLAG_LFH)
+    {
+        if (lfh_block_is_free( block ))
+        {
+            entry->lpData = (char *)(block + 1) + sizeof(struct list);
+            entry->cbData = block_get_size( block ) - 2 * sizeof(void *);
+            entry->cbOverhead = 2 * sizeof(void *);
+            entry->iRegionIndex = 0;
+            entry->wFlags = RTL_HEAP_ENTRY_LFH;
+        }
+        else
+        {
+            entry->lpData = (void *)(block + 1);
+            entry->cbData = block_get_size( block ) - block_get_overhead( block );
+            entry->cbOverhead = block_get_overhead( block );
+            entry->iRegionIndex = 0;
+            entry->wFlags = RTL_HEAP_ENTRY_LFH|RTL_HEAP_ENTRY_BUSY;
+        }
+    }
+    else if (block_get_flags( block ) & BLOCK_FLAG_FREE)
     {
         entry->lpData = (char *)block + block_get_overhead( block );
         entry->cbData = block_get_size( block ) - block_get_overhead( block );
@@ -1971,21 +2457,45 @@ ULONG WINAPI RtlGetProcessHeaps( ULONG count, HANDLE *heaps )
     return total;
 }
 
+/* allocate the LFH front end, it is only used on private growable heaps without debug flags */
+static void heap_create_lfh( struct heap *heap )
+{
+    static const ULONG debug_flags = HEAP_TAIL_CHECKING_ENABLED | HEAP_FREE_CHECKING_ENABLED | HEAP_CHECKING_ENABLED |
+                                     HEAP_VALIDATE | HEAP_VALIDATE_ALL | HEAP_VALIDATE_PARAMS;
+    SIZE_T size = sizeof(*heap->lfh);
+    void *addr = NULL;
+
+    if (!(heap->flags & HEAP_GROWABLE) || (heap->flags & debug_flags) || heap->shared || RUNNING_ON_VALGRIND) return;
+
+    if (NtAllocateVirtualMemory( NtCurrentProcess(), &addr, 0, &size, MEM_COMMIT, PAGE_READWRITE ))
+    {
+        WARN( "Could not allocate LFH data for heap %p\n", heap );
+        return;
+    }
+
+    InterlockedExchangePointer( (void **)&heap->lfh, addr );
+}
+
 /***********************************************************************
  *           RtlQueryHeapInformation    (NTDLL.@)
  */
 NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE handle, HEAP_INFORMATION_CLASS info_class,
                                          void *info, SIZE_T size_in, PSIZE_T size_out )
 {
+    struct heap *heap;
+
+    TRACE( "handle %p, info_class %u, info %p, size_in %Iu, size_out %p.\n", handle, info_class, info, size_in, size_out );
+
     switch (info_class)
     {
     case HeapCompatibilityInformation:
+        if (!(heap = unsafe_heap_from_handle( handle ))) return STATUS_ACCESS_VIOLATION;
         if (size_out) *size_out = sizeof(ULONG);
 
         if (size_in < sizeof(ULONG))
             return STATUS_BUFFER_TOO_SMALL;
 
-        *(ULONG *)info = 0; /* standard heap */
+        *(ULONG *)info = heap->compat_info;
         return STATUS_SUCCESS;
 
     default:
@@ -1999,8 +2509,34 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE handle, HEAP_INFORMATION_CLASS i
  */
 NTSTATUS WINAPI RtlSetHeapInformation( HANDLE handle, HEAP_INFORMATION_CLASS info_class, void *info, SIZE_T size )
 {
-    FIXME( "handle %p, info_class %d, info %p, size %ld stub!\n", handle, info_class, info, size );
-    return STATUS_SUCCESS;
+    struct heap *heap;
+    ULONG compat_info;
+
+    TRACE( "handle %p, info_class %u, info %p, size %Iu.\n", handle, info_class, info, size );
+
+    switch (info_class)
+    {
+    case HeapCompatibilityInformation:
+        if (size < sizeof(ULONG)) return STATUS_BUFFER_TOO_SMALL;
+        if (!(heap = unsafe_heap_from_handle( handle ))) return STATUS_INVALID_HANDLE;
+        if (heap->flags & HEAP_NO_SERIALIZE) return STATUS_INVALID_PARAMETER;
+
+        compat_info = *(ULONG *)info;
+        if (compat_info != HEAP_STD && compat_info != HEAP_LFH)
+        {
+            FIXME( "HeapCompatibilityInformation %u not implemented!\n", compat_info );
+            return STATUS_UNSUCCESSFUL;
+        }
+        /* the compatibility mode cannot be changed once LFH is enabled */
+        if (InterlockedCompareExchange( &heap->compat_info, compat_info, HEAP_STD ) != HEAP_STD)
+            return STATUS_UNSUCCESSFUL;
+        if (compat_info == HEAP_LFH) heap_create_lfh( heap );
+        return STATUS_SUCCESS;
+
+    default:
+        FIXME( "handle %p, info_class %u, info %p, size %Iu stub!\n", handle, info_class, info, size );
+        return STATUS_SUCCESS;
+    }
 }
 
 /***********************************************************************
@@ -2027,7 +2563,7 @@ BOOLEAN WINAPI RtlGetUserInfoHeap( HANDLE handle, ULONG flags, void *ptr, void *
         const ARENA_LARGE *large = CONTAINING_RECORD( block, ARENA_LARGE, block );
         *user_value = large->user_value;
     }
-    else if (block)
+    else if (block && !(block_get_flags( block ) & BLOCK_FLAG_LFH))
     {
         tmp = (char *)block + block_get_size( block ) - block->tail_size + sizeof(void *);
         if ((heap_get_flags( heap, flags ) & HEAP_TAIL_CHECKING_ENABLED) || RUNNING_ON_VALGRIND) tmp += ALIGNMENT;
@@ -2060,6 +2596,7 @@ BOOLEAN WINAPI RtlSetUserValueHeap( HANDLE handle, ULONG flags, void *ptr, void
         ARENA_LARGE *large = CONTAINING_RECORD( block, ARENA_LARGE, block );
         large->user_value = user_value;
     }
+    else if (block_get_flags( block ) & BLOCK_FLAG_LFH) ret = FALSE;  /* no room for user info */
     else
     {
         tmp = (char *)block + block_get_size( block ) - block->tail_size + sizeof(void *);
@@ -125,6 +125,15 @@ struct file_id
     BYTE ObjectId[16];
 };
 
+/* hashed index of the export names of a module */
+struct export_index
+{
+    ULONG mask;        /* number of entries - 1 */
+    DWORD entries[1];  /* name index + 1, or 0 for an empty entry */
+};
+
+#define EXPORT_INDEX_MIN_NAMES 128  /* smaller export tables use a binary search */
+
 /* internal representation of loaded modules */
 typedef struct _wine_modref
 {
@@ -132,6 +141,9 @@ typedef struct _wine_modref
     struct file_id        id;
     ULONG                 CheckSum;
     BOOL                  system;
+    LIST_ENTRY            fullname_hash_links;
+    LIST_ENTRY            fileid_hash_links;
+    struct export_index  *export_index;
 } WINE_MODREF;
 
 static UINT tls_module_count;      /* number of modules with TLS directory */
@@ -180,13 +192,19 @@ static WINE_MODREF *cached_modref;
 static WINE_MODREF *current_modref;
 static WINE_MODREF *last_failed_modref;
 
+/* loaded modules hashed by base name (through ldr.HashLinks), full name and file id */
+#define HASH_MAP_SIZE 256
+static LIST_ENTRY hash_table[HASH_MAP_SIZE];
+static LIST_ENTRY fullname_hash_table[HASH_MAP_SIZE];
+static LIST_ENTRY fileid_hash_table[HASH_MAP_SIZE];
+
 static LDR_DDAG_NODE *node_ntdll, *node_kernel32;
 
 static NTSTATUS load_dll( const WCHAR *load_path, const WCHAR *libname, DWORD flags, WINE_MODREF** pwm, BOOL system );
 static NTSTATUS process_attach( LDR_DDAG_NODE *node, LPVOID lpReserved );
 static FARPROC find_ordinal_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *exports,
                                     DWORD exp_size, DWORD ordinal, LPCWSTR load_path );
-static FARPROC find_named_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *exports,
+static FARPROC find_named_export( WINE_MODREF *wm, const IMAGE_EXPORT_DIRECTORY *exports,
                                   DWORD exp_size, const char *name, int hint, LPCWSTR load_path );
 
 /* convert PE image VirtualAddress to Real Address */
@@ -518,6 +536,73 @@ static WINE_MODREF *get_modref( HMODULE hmod )
 }
 
 
+/**********************************************************************
+ *	    hash_module_name
+ */
+static ULONG hash_module_name( const UNICODE_STRING *name )
+{
+    ULONG hash;
+
+    RtlHashUnicodeString( name, TRUE, HASH_STRING_ALGORITHM_X65599, &hash );
+    return hash % HASH_MAP_SIZE;
+}
+
+
+/**********************************************************************
+ *	    hash_file_id
+ */
+static ULONG hash_file_id( const struct file_id *id )
+{
+    ULONG i, hash = 0;
+
+    for (i = 0; i < sizeof(id->ObjectId); i++) hash = hash * 31 + id->ObjectId[i];
+    return hash % HASH_MAP_SIZE;
+}
+
+
+/**********************************************************************
+ *	    init_module_hash_tables
+ */
+static void init_module_hash_tables(void)
+{
+    ULONG i;
+
+    for (i = 0; i < HASH_MAP_SIZE; i++)
+    {
+        InitializeListHead( &hash_table[i] );
+        InitializeListHead( &fullname_hash_table[i] );
+        InitializeListHead( &fileid_hash_table[i] );
+    }
+}
+
+
+/**********************************************************************
+ *	    insert_module_hash_links
+ *
+ * Add a module to the lookup hash tables, in load order.
+ * The loader_section must be locked while calling this function
+ */
+static void insert_module_hash_links( WINE_MODREF *wm )
+{
+    InsertTailList( &hash_table[hash_module_name( &wm->ldr.BaseDllName )], &wm->ldr.HashLinks );
+    InsertTailList( &fullname_hash_table[hash_module_name( &wm->ldr.FullDllName )], &wm->fullname_hash_links );
+    InsertTailList( &fileid_hash_table[hash_file_id( &wm->id )], &wm->fileid_hash_links );
+}
+
+
+/**********************************************************************
+ *	    remove_module_hash_links
+ *
+ * The loader_section must be locked while calling this function
+ */
+static void remove_module_hash_links( WINE_MODREF *wm )
+{
+    RemoveEntryList( &wm->ldr.HashLinks );
+    RemoveEntryList( &wm->fullname_hash_links );
+    RemoveEntryList( &wm->fileid_hash_links );
+}
+
+
 /**********************************************************************
  *	    find_basename_module
  *
@@ -534,10 +619,10 @@ static WINE_MODREF *find_basename_module( LPCWSTR name )
     if (cached_modref && RtlEqualUnicodeString( &name_str, &cached_modref->ldr.BaseDllName, TRUE ))
         return cached_modref;
 
-    mark = &NtCurrentTeb()->Peb->LdrData->InLoadOrderModuleList;
+    mark = &hash_table[hash_module_name( &name_str )];
     for (entry = mark->Flink; entry != mark; entry = entry->Flink)
     {
-        WINE_MODREF *mod = CONTAINING_RECORD(entry, WINE_MODREF, ldr.InLoadOrderLinks);
+        WINE_MODREF *mod = CONTAINING_RECORD(entry, WINE_MODREF, ldr.HashLinks);
         if (RtlEqualUnicodeString( &name_str, &mod->ldr.BaseDllName, TRUE ) && !mod->system)
         {
             cached_modref = CONTAINING_RECORD(mod, WINE_MODREF, ldr);
@@ -566,13 +651,13 @@ static WINE_MODREF *find_fullname_module( const UNICODE_STRING *nt_name )
     if (cached_modref && RtlEqualUnicodeString( &name, &cached_modref->ldr.FullDllName, TRUE ))
         return cached_modref;
 
-    mark = &NtCurrentTeb()->Peb->LdrData->InLoadOrderModuleList;
+    mark = &fullname_hash_table[hash_module_name( &name )];
     for (entry = mark->Flink; entry != mark; entry = entry->Flink)
     {
-        LDR_DATA_TABLE_ENTRY *mod = CONTAINING_RECORD(entry, LDR_DATA_TABLE_ENTRY, InLoadOrderLinks);
-        if (RtlEqualUnicodeString( &name, &mod->FullDllName, TRUE ))
+        WINE_MODREF *mod = CONTAINING_RECORD(entry, WINE_MODREF, fullname_hash_links);
+        if (RtlEqualUnicodeString( &name, &mod->ldr.FullDllName, TRUE ))
         {
-            cached_modref = CONTAINING_RECORD(mod, WINE_MODREF, ldr);
+            cached_modref = mod;
             return cached_modref;
         }
     }
@@ -592,11 +677,10 @@ static WINE_MODREF *find_fileid_module( const struct file_id *id )
 
     if (cached_modref && !memcmp( &cached_modref->id, id, sizeof(*id) )) return cached_modref;
 
-    mark = &NtCurrentTeb()->Peb->LdrData->InLoadOrderModuleList;
+    mark = &fileid_hash_table[hash_file_id( id )];
     for (entry = mark->Flink; entry != mark; entry = entry->Flink)
     {
-        LDR_DATA_TABLE_ENTRY *mod = CONTAINING_RECORD( entry, LDR_DATA_TABLE_ENTRY, InLoadOrderLinks );
-        WINE_MODREF *wm = CONTAINING_RECORD( mod, WINE_MODREF, ldr );
+        WINE_MODREF *wm = CONTAINING_RECORD( entry, WINE_MODREF, fileid_hash_links );
 
         if (!memcmp( &wm->id, id, sizeof(*id) ))
         {
@@ -898,7 +982,7 @@ static FARPROC find_forwarded_export( HMODULE module, const char *forward, LPCWS
             proc = find_ordinal_export( wm->ldr.DllBase, exports, exp_size,
                                         atoi(name+1) - exports->Base, load_path );
         } else
-            proc = find_named_export( wm->ldr.DllBase, exports, exp_size, name, -1, load_path );
+            proc = find_named_export( wm, exports, exp_size, name, -1, load_path );
     }
 
     if (!proc)
@@ -976,15 +1060,76 @@ static int find_name_in_exports( HMODULE module, const IMAGE_EXPORT_DIRECTORY *e
 }
 
 
+/*************************************************************************
+ *		hash_export_name
+ */
+static ULONG hash_export_name( const char *name )
+{
+    ULONG hash = 0;
+
+    while (*name) hash = hash * 65599 + (unsigned char)*name++;
+    return hash;
+}
+
+
+/*************************************************************************
+ *		build_export_index
+ *
+ * Build the hashed index of the export names of a module.
+ */
+static struct export_index *build_export_index( HMODULE module, const IMAGE_EXPORT_DIRECTORY *exports )
+{
+    const DWORD *names = get_rva( module, exports->AddressOfNames );
+    struct export_index *index;
+    ULONG i, pos, size = 2;
+
+    while (size < 2 * exports->NumberOfNames) size *= 2;
+    if (!(index = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                   offsetof( struct export_index, entries[size] ) )))
+        return NULL;
+    index->mask = size - 1;
+
+    for (i = 0; i < exports->NumberOfNames; i++)
+    {
+        pos = hash_export_name( get_rva( module, names[i] )) & index->mask;
+        while (index->entries[pos]) pos = (pos + 1) & index->mask;
+        index->entries[pos] = i + 1;
+    }
+    return index;
+}
+
+
+/*************************************************************************
+ *		find_name_in_export_index
+ *
+ * Helper for find_named_export.
+ */
+static int find_name_in_export_index( HMODULE module, const IMAGE_EXPORT_DIRECTORY *exports,
+                                      const struct export_index *index, const char *name )
+{
+    const WORD *ordinals = get_rva( module, exports->AddressOfNameOrdinals );
+    const DWORD *names = get_rva( module, exports->AddressOfNames );
+    ULONG pos = hash_export_name( name ) & index->mask;
+
+    for ( ; index->entries[pos]; pos = (pos + 1) & index->mask)
+    {
+        DWORD i = index->entries[pos] - 1;
+        if (!strcmp( get_rva( module, names[i] ), name )) return ordinals[i];
+    }
+    return -1;
+}
+
+
 /*************************************************************************
  *		find_named_export
  *
  * Find an exported function by name.
  * The loader_section must be locked while calling this function.
  */
-static FARPROC find_named_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *exports,
+static FARPROC find_named_export( WINE_MODREF *wm, const IMAGE_EXPORT_DIRECTORY *exports,
                                   DWORD exp_size, const char *name, int hint, LPCWSTR load_path )
 {
+    HMODULE module = wm->ldr.DllBase;
     const WORD *ordinals = get_rva( module, exports->AddressOfNameOrdinals );
     const DWORD *names = get_rva( module, exports->AddressOfNames );
     int ordinal;
@@ -997,10 +1142,15 @@ static FARPROC find_named_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *
             return find_ordinal_export( module, exports, exp_size, ordinals[hint], load_path );
     }
 
-    /* then do a binary search */
-    if ((ordinal = find_name_in_exports( module, exports, name )) == -1) return NULL;
-    return find_ordinal_export( module, exports, exp_size, ordinal, load_path );
+    /* then use the hashed index, built on the first lookup without a valid hint */
+    if (exports->NumberOfNames >= EXPORT_INDEX_MIN_NAMES &&
+        (wm->export_index || (wm->export_index = build_export_index( module, exports ))))
+        ordinal = find_name_in_export_index( module, exports, wm->export_index, name );
+    else  /* or a binary search */
+        ordinal = find_name_in_exports( module, exports, name );
 
+    if (ordinal == -1) return NULL;
+    return find_ordinal_export( module, exports, exp_size, ordinal, load_path );
 }
 
 
@@ -1133,7 +1283,7 @@ static BOOL import_dll( HMODULE module, const IMAGE_IMPORT_DESCRIPTOR *descr, LP
         {
             IMAGE_IMPORT_BY_NAME *pe_name;
             pe_name = get_rva( module, (DWORD)import_list->u1.AddressOfData );
-            thunk_list->u1.Function = (ULONG_PTR)find_named_export( imp_mod, exports, exp_size,
+            thunk_list->u1.Function = (ULONG_PTR)find_named_export( wmImp, exports, exp_size,
                                                                     (const char*)pe_name->Name,
                                                                     pe_name->Hint, load_path );
             if (!thunk_list->u1.Function)
@@ -1467,6 +1617,7 @@ static WINE_MODREF *alloc_module( HMODULE hModule, const UNICODE_STRING *nt_name
                    &wm->ldr.InLoadOrderLinks);
     InsertTailList(&NtCurrentTeb()->Peb->LdrData->InMemoryOrderModuleList,
                    &wm->ldr.InMemoryOrderLinks);
+    insert_module_hash_links( wm );
     /* wait until init is called for inserting into InInitializationOrderModuleList */
 
     if (!(nt->OptionalHeader.DllCharacteristics & IMAGE_DLLCHARACTERISTICS_NX_COMPAT))
@@ -1949,17 +2100,18 @@ NTSTATUS WINAPI LdrGetProcedureAddress(HMODULE module, const ANSI_STRING *name,
                                        ULONG ord, PVOID *address)
 {
     IMAGE_EXPORT_DIRECTORY *exports;
+    WINE_MODREF *wm;
     DWORD exp_size;
     NTSTATUS ret = STATUS_PROCEDURE_NOT_FOUND;
 
     RtlEnterCriticalSection( &loader_section );
 
     /* check if the module itself is invalid to return the proper error */
-    if (!get_modref( module )) ret = STATUS_DLL_NOT_FOUND;
+    if (!(wm = get_modref( module ))) ret = STATUS_DLL_NOT_FOUND;
     else if ((exports = RtlImageDirectoryEntryToData( module, TRUE,
                                                       IMAGE_DIRECTORY_ENTRY_EXPORT, &exp_size )))
     {
-        void *proc = name ? find_named_export( module, exports, exp_size, name->Buffer, -1, NULL )
+        void *proc = name ? find_named_export( wm, exports, exp_size, name->Buffer, -1, NULL )
                           : find_ordinal_export( module, exports, exp_size, ord - exports->Base, NULL );
         if (proc)
         {
@@ -2126,7 +2278,12 @@ static NTSTATUS build_module( LPCWSTR load_path, const UNICODE_STRING *nt_name,
 
     if (!(wm = alloc_module( *module, nt_name, is_builtin ))) return STATUS_NO_MEMORY;
 
-    if (id) wm->id = *id;
+    if (id)
+    {
+        wm->id = *id;
+        RemoveEntryList( &wm->fileid_hash_links );
+        InsertTailList( &fileid_hash_table[hash_file_id( id )], &wm->fileid_hash_links );
+    }
     if (image_info->LoaderFlags) wm->ldr.Flags |= LDR_COR_IMAGE;
     if (image_info->u.s.ComPlusILOnly) wm->ldr.Flags |= LDR_COR_ILONLY;
     wm->system = system;
@@ -2148,6 +2305,7 @@ static NTSTATUS build_module( LPCWSTR load_path, const UNICODE_STRING *nt_name,
             /* the module has only be inserted in the load & memory order lists */
             RemoveEntryList(&wm->ldr.InLoadOrderLinks);
             RemoveEntryList(&wm->ldr.InMemoryOrderLinks);
+            remove_module_hash_links( wm );
 
             /* FIXME: there are several more dangling references
              * left. Including dlls loaded by this dll before the
@@ -3652,6 +3810,8 @@ void WINAPI LdrShutdownProcess(void)
         RtlProcessFlsData( NtCurrentTeb()->FlsSlots, 1 );
 
     process_detach();
+    heap_dump_all_stats();
+    threadpool_dump_timer_stats();
 }
 
 
@@ -3736,6 +3896,7 @@ static void free_modref( WINE_MODREF *wm )
 
     RemoveEntryList(&wm->ldr.InLoadOrderLinks);
     RemoveEntryList(&wm->ldr.InMemoryOrderLinks);
+    remove_module_hash_links( wm );
     if (wm->ldr.InInitializationOrderLinks.Flink)
         RemoveEntryList(&wm->ldr.InInitializationOrderLinks);
 
@@ -3768,6 +3929,7 @@ static void free_modref( WINE_MODREF *wm )
     NtUnmapViewOfSection( NtCurrentProcess(), wm->ldr.DllBase );
     if (cached_modref == wm) cached_modref = NULL;
     RtlFreeUnicodeString( &wm->ldr.FullDllName );
+    RtlFreeHeap( GetProcessHeap(), 0, wm->export_index );
     RtlFreeHeap( GetProcessHeap(), 0, wm );
 }
 
@@ -4120,6 +4282,7 @@ void WINAPI LdrInitializeThunk( CONTEXT *context, ULONG_PTR unknown2, ULONG_PTR
 
         get_env_var( L"WINESYSTEMDLLPATH", 0, &system_dll_path );
 
+        init_module_hash_tables();
         wm = build_main_module();
         wm->ldr.LoadCount = -1;
 
@@ -122,6 +122,12 @@ static inline void ascii_to_unicode( WCHAR *dst, const char *src, size_t len )
     while (len--) *dst++ = (unsigned char)*src++;
 }
 
+/* heap */
+extern void heap_dump_all_stats(void) DECLSPEC_HIDDEN;
+
+/* threadpool */
+extern void threadpool_dump_timer_stats(void) DECLSPEC_HIDDEN;
+
 /* FLS data */
 extern TEB_FLS_DATA *fls_alloc_data(void) DECLSPEC_HIDDEN;
 
@@ -1272,6 +1272,96 @@ static void test_file_io_completion(void)
     pNtClose( h );
 }
 
+static void test_file_overlapped_completion(void)
+{
+    static const unsigned int count = 64, block = 512;
+    OVERLAPPED ovl[64], *povl;
+    BYTE *data, *buffer;
+    HANDLE file, port;
+    unsigned int i, j;
+    ULONG_PTR key;
+    DWORD size;
+    BOOL ret;
+
+    data = HeapAlloc( GetProcessHeap(), 0, count * block );
+    buffer = HeapAlloc( GetProcessHeap(), 0, count * block );
+    for (i = 0; i < count * block; i++) data[i] = i * 7 + i / block;
+
+    if (!(file = create_temp_file( FILE_FLAG_OVERLAPPED ))) return;
+    port = CreateIoCompletionPort( file, NULL, CKEY_FIRST, 0 );
+    ok( port != NULL, "CreateIoCompletionPort failed, error %lu\n", GetLastError() );
+
+    /* overlapped writes at distinct offsets, queued back to back */
+    for (i = 0; i < count; i++)
+    {
+        memset( &ovl[i], 0, sizeof(ovl[i]) );
+        ovl[i].Offset = i * block;
+        ret = WriteFile( file, data + i * block, block, NULL, &ovl[i] );
+        ok( ret || GetLastError() == ERROR_IO_PENDING, "%u: WriteFile failed, error %lu\n", i, GetLastError() );
+    }
+    for (i = 0; i < count; i++)
+    {
+        ret = GetQueuedCompletionStatus( port, &size, &key, &povl, 1000 );
+        ok( ret, "GetQueuedCompletionStatus failed, error %lu\n", GetLastError() );
+        if (!ret) break;
+        ok( key == CKEY_FIRST, "got key %#Ix\n", key );
+        ok( size == block, "got size %lu\n", size );
+        ok( povl >= ovl && povl < ovl + count, "got overlapped %p\n", povl );
+    }
+
+    /* overlapped reads of the same blocks in reverse order */
+    memset( buffer, 0xcc, count * block );
+    for (i = 0; i < count; i++)
+    {
+        j = count - 1 - i;
+        memset( &ovl[j], 0, sizeof(ovl[j]) );
+        ovl[j].Offset = j * block;
+        ret = ReadFile( file, buffer + j * block, block, NULL, &ovl[j] );
+        ok( ret || GetLastError() == ERROR_IO_PENDING, "%u: ReadFile failed, error %lu\n", j, GetLastError() );
+    }
+    for (i = 0; i < count; i++)
+    {
+        ret = GetQueuedCompletionStatus( port, &size, &key, &povl, 1000 );
+        ok( ret, "GetQueuedCompletionStatus failed, error %lu\n", GetLastError() );
+        if (!ret) break;
+        ok( size == block, "got size %lu\n", size );
+        ok( povl->Internal == STATUS_SUCCESS, "got status %#Ix\n", povl->Internal );
+        ok( povl->InternalHigh == block, "got information %Iu\n", povl->InternalHigh );
+    }
+    ok( !memcmp( buffer, data, count * block ), "data mismatch\n" );
+
+    /* reading past the end completes with STATUS_END_OF_FILE */
+    memset( &ovl[0], 0, sizeof(ovl[0]) );
+    ovl[0].Offset = count * block;
+    ret = ReadFile( file, buffer, block, NULL, &ovl[0] );
+    ok( !ret, "ReadFile succeeded\n" );
+    ok( GetLastError() == ERROR_HANDLE_EOF, "got error %lu\n", GetLastError() );
+    ret = GetQueuedCompletionStatus( port, &size, &key, &povl, 0 );
+    ok( !ret && GetLastError() == WAIT_TIMEOUT, "got ret %d, error %lu\n", ret, GetLastError() );
+
+    /* closing the handle with reads in flight still reports every completion */
+    for (i = 0; i < count; i++)
+    {
+        memset( &ovl[i], 0, sizeof(ovl[i]) );
+        ovl[i].Offset = i * block;
+        ret = ReadFile( file, buffer + i * block, block, NULL, &ovl[i] );
+        ok( ret || GetLastError() == ERROR_IO_PENDING, "%u: ReadFile failed, error %lu\n", i, GetLastError() );
+    }
+    CloseHandle( file );
+    for (i = 0; i < count; i++)
+    {
+        ret = GetQueuedCompletionStatus( port, &size, &key, &povl, 1000 );
+        ok( ret, "GetQueuedCompletionStatus failed, error %lu\n", GetLastError() );
+        if (!ret) break;
+        ok( povl->Internal == STATUS_SUCCESS, "got status %#Ix\n", povl->Internal );
+    }
+    ok( !memcmp( buffer, data, count * block ), "data mismatch\n" );
+
+    CloseHandle( port );
+    HeapFree( GetProcessHeap(), 0, buffer );
+    HeapFree( GetProcessHeap(), 0, data );
+}
+
 static void test_file_full_size_information(void)
 {
     IO_STATUS_BLOCK io;
@@ -5251,6 +5341,67 @@ static void test_mailslot_name(void)
     CloseHandle( device );
 }
 
+static void test_case_insensitive_lookup(void)
+{
+    WCHAR path[MAX_PATH], name[MAX_PATH], file[MAX_PATH];
+    HANDLE handle;
+    unsigned int i;
+    BOOL ret;
+
+    GetTempPathW( MAX_PATH, path );
+    wcscat( path, L"casetest" );
+    ret = CreateDirectoryW( path, NULL );
+    ok( ret, "CreateDirectory failed, error %lu\n", GetLastError() );
+
+    for (i = 0; i < 100; i++)
+    {
+        swprintf( name, ARRAY_SIZE(name), L"%s\\MixedCase%u.Txt", path, i );
+        handle = CreateFileW( name, GENERIC_WRITE, 0, NULL, CREATE_NEW, 0, 0 );
+        ok( handle != INVALID_HANDLE_VALUE, "CreateFile %s failed, error %lu\n", debugstr_w(name), GetLastError() );
+        CloseHandle( handle );
+    }
+    /* make sure the directory isn't considered as recently modified */
+    Sleep( 1100 );
+
+    for (i = 0; i < 100; i += 7)
+    {
+        swprintf( name, ARRAY_SIZE(name), L"%s\\MIXEDCASE%u.TXT", path, i );
+        handle = CreateFileW( name, GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, 0 );
+        ok( handle != INVALID_HANDLE_VALUE, "CreateFile %s failed, error %lu\n", debugstr_w(name), GetLastError() );
+        CloseHandle( handle );
+    }
+
+    swprintf( name, ARRAY_SIZE(name), L"%s\\mixedcase100.txt", path );
+    handle = CreateFileW( name, GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, 0 );
+    ok( handle == INVALID_HANDLE_VALUE, "CreateFile %s succeeded\n", debugstr_w(name) );
+    ok( GetLastError() == ERROR_FILE_NOT_FOUND, "got error %lu\n", GetLastError() );
+
+    /* the lookup has to notice directory changes */
+    swprintf( name, ARRAY_SIZE(name), L"%s\\mixedcase7.txt", path );
+    ret = DeleteFileW( name );
+    ok( ret, "DeleteFile %s failed, error %lu\n", debugstr_w(name), GetLastError() );
+    handle = CreateFileW( name, GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, 0 );
+    ok( handle == INVALID_HANDLE_VALUE, "CreateFile %s succeeded\n", debugstr_w(name) );
+    ok( GetLastError() == ERROR_FILE_NOT_FOUND, "got error %lu\n", GetLastError() );
+
+    swprintf( name, ARRAY_SIZE(name), L"%s\\MixedCase100.Txt", path );
+    handle = CreateFileW( name, GENERIC_WRITE, 0, NULL, CREATE_NEW, 0, 0 );
+    ok( handle != INVALID_HANDLE_VALUE, "CreateFile %s failed, error %lu\n", debugstr_w(name), GetLastError() );
+    CloseHandle( handle );
+    swprintf( name, ARRAY_SIZE(name), L"%s\\MIXEDCASE100.TXT", path );
+    handle = CreateFileW( name, GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, 0 );
+    ok( handle != INVALID_HANDLE_VALUE, "CreateFile %s failed, error %lu\n", debugstr_w(name), GetLastError() );
+    CloseHandle( handle );
+
+    for (i = 0; i <= 100; i++)
+    {
+        swprintf( file, ARRAY_SIZE(file), L"%s\\mixedcase%u.txt", path, i );
+        DeleteFileW( file );
+    }
+    ret = RemoveDirectoryW( path );
+    ok( ret, "RemoveDirectory failed, error %lu\n", GetLastError() );
+}
+
 START_TEST(file)
 {
     HMODULE hkernel32 = GetModuleHandleA("kernel32.dll");
@@ -5296,12 +5447,14 @@ START_TEST(file)
     test_NtCreateFile();
     create_file_test();
     open_file_test();
+    test_case_insensitive_lookup();
     delete_file_test();
     read_file_test();
     append_file_test();
     nt_mailslot_test();
     test_set_io_completion();
     test_file_io_completion();
+    test_file_overlapped_completion();
     test_file_basic_information();
     test_file_all_information();
     test_file_both_information();
@@ -136,6 +136,7 @@ static NTSTATUS (WINAPI * pNtQueryKey)(HANDLE,KEY_INFORMATION_CLASS,PVOID,ULONG,
 static NTSTATUS (WINAPI * pNtQueryLicenseValue)(const UNICODE_STRING *,ULONG *,PVOID,ULONG,ULONG *);
 static NTSTATUS (WINAPI * pNtQueryObject)(HANDLE, OBJECT_INFORMATION_CLASS, void *, ULONG, ULONG *);
 static NTSTATUS (WINAPI * pNtQueryValueKey)(HANDLE,const UNICODE_STRING *,KEY_VALUE_INFORMATION_CLASS,void *,DWORD,DWORD *);
+static NTSTATUS (WINAPI * pNtQueryMultipleValueKey)(HANDLE,KEY_MULTIPLE_VALUE_INFORMATION *,ULONG,void *,ULONG,ULONG *);
 static NTSTATUS (WINAPI * pNtSetValueKey)(HANDLE, const PUNICODE_STRING, ULONG,
                                ULONG, const void*, ULONG  );
 static NTSTATUS (WINAPI * pRtlFormatCurrentUserKeyPath)(PUNICODE_STRING);
@@ -190,6 +191,7 @@ static BOOL InitFunctionPtrs(void)
     NTDLL_GET_PROC(NtQueryKey)
     NTDLL_GET_PROC(NtQueryObject)
     NTDLL_GET_PROC(NtQueryValueKey)
+    NTDLL_GET_PROC(NtQueryMultipleValueKey)
     NTDLL_GET_PROC(NtSetValueKey)
     NTDLL_GET_PROC(NtOpenKey)
     NTDLL_GET_PROC(NtNotifyChangeKey)
@@ -1853,6 +1855,76 @@ static void test_redirection(void)
     pNtClose( root32 );
 }
 
+static void test_NtQueryMultipleValueKey(void)
+{
+    static const WCHAR str_data[] = L"multiple values";
+    KEY_MULTIPLE_VALUE_INFORMATION info[3];
+    UNICODE_STRING names[3];
+    OBJECT_ATTRIBUTES attr;
+    DWORD dword_data = 0x12345678;
+    BYTE bin_data[5] = {1, 2, 3, 4, 5};
+    char buffer[256];
+    NTSTATUS status;
+    ULONG len;
+    HANDLE key;
+    DWORD i;
+
+    InitializeObjectAttributes(&attr, &winetestpath, 0, 0, 0);
+    status = pNtOpenKey(&key, KEY_WRITE|KEY_READ, &attr);
+    ok(status == STATUS_SUCCESS, "NtOpenKey Failed: 0x%08lx\n", status);
+
+    pRtlInitUnicodeString(&names[0], L"multi_str");
+    pRtlInitUnicodeString(&names[1], L"multi_bin");
+    pRtlInitUnicodeString(&names[2], L"multi_dword");
+    status = pNtSetValueKey(key, &names[0], 0, REG_SZ, (void *)str_data, sizeof(str_data));
+    ok(status == STATUS_SUCCESS, "NtSetValueKey failed: 0x%08lx\n", status);
+    status = pNtSetValueKey(key, &names[1], 0, REG_BINARY, bin_data, sizeof(bin_data));
+    ok(status == STATUS_SUCCESS, "NtSetValueKey failed: 0x%08lx\n", status);
+    status = pNtSetValueKey(key, &names[2], 0, REG_DWORD, &dword_data, sizeof(dword_data));
+    ok(status == STATUS_SUCCESS, "NtSetValueKey failed: 0x%08lx\n", status);
+
+    for (i = 0; i < ARRAY_SIZE(info); i++) info[i].ValueName = &names[i];
+
+    len = 0xdeadbeef;
+    status = pNtQueryMultipleValueKey(key, info, 0, buffer, sizeof(buffer), &len);
+    ok(status == STATUS_SUCCESS, "got 0x%08lx\n", status);
+
+    len = 0xdeadbeef;
+    memset(buffer, 0xcc, sizeof(buffer));
+    status = pNtQueryMultipleValueKey(key, info, ARRAY_SIZE(info), buffer, sizeof(buffer), &len);
+    ok(status == STATUS_SUCCESS, "got 0x%08lx\n", status);
+    ok(len >= sizeof(str_data) + sizeof(bin_data) + sizeof(dword_data) && len <= sizeof(buffer),
+       "got length %lu\n", len);
+    ok(info[0].Type == REG_SZ, "got type %lu\n", info[0].Type);
+    ok(info[0].DataLength == sizeof(str_data), "got data length %lu\n", info[0].DataLength);
+    ok(info[1].Type == REG_BINARY, "got type %lu\n", info[1].Type);
+    ok(info[1].DataLength == sizeof(bin_data), "got data length %lu\n", info[1].DataLength);
+    ok(info[2].Type == REG_DWORD, "got type %lu\n", info[2].Type);
+    ok(info[2].DataLength == sizeof(dword_data), "got data length %lu\n", info[2].DataLength);
+    for (i = 0; i < ARRAY_SIZE(info); i++)
+        ok(info[i].DataOffset + info[i].DataLength <= len, "%lu: got offset %lu\n", i, info[i].DataOffset);
+    ok(!memcmp(buffer + info[0].DataOffset, str_data, sizeof(str_data)), "wrong string data\n");
+    ok(!memcmp(buffer + info[1].DataOffset, bin_data, sizeof(bin_data)), "wrong binary data\n");
+    ok(!memcmp(buffer + info[2].DataOffset, &dword_data, sizeof(dword_data)), "wrong dword data\n");
+
+    /* buffer too small for the data */
+    len = 0xdeadbeef;
+    status = pNtQueryMultipleValueKey(key, info, ARRAY_SIZE(info), buffer, sizeof(str_data), &len);
+    ok(status == STATUS_BUFFER_OVERFLOW, "got 0x%08lx\n", status);
+    ok(len >= sizeof(str_data) + sizeof(bin_data) + sizeof(dword_data) && len <= sizeof(buffer),
+       "got length %lu\n", len);
+
+    /* one of the values is missing */
+    status = pNtDeleteValueKey(key, &names[1]);
+    ok(status == STATUS_SUCCESS, "NtDeleteValueKey failed: 0x%08lx\n", status);
+    status = pNtQueryMultipleValueKey(key, info, ARRAY_SIZE(info), buffer, sizeof(buffer), &len);
+    ok(status == STATUS_OBJECT_NAME_NOT_FOUND, "got 0x%08lx\n", status);
+
+    pNtDeleteValueKey(key, &names[0]);
+    pNtDeleteValueKey(key, &names[2]);
+    pNtClose(key);
+}
+
 static void test_long_value_name(void)
 {
     HANDLE key;
@@ -2291,6 +2363,7 @@ START_TEST(reg)
     test_NtQueryKey();
     test_NtQueryLicenseKey();
     test_NtQueryValueKey();
+    test_NtQueryMultipleValueKey();
     test_long_value_name();
     test_notify();
     test_RtlCreateRegistryKey();
@@ -147,6 +147,115 @@ static void test_event(void)
     pNtClose(event);
 }
 
+static DWORD WINAPI pulse_wait_thread( void *arg )
+{
+    return WaitForSingleObject( arg, 5000 );
+}
+
+static void test_pulse_event(void)
+{
+    EVENT_BASIC_INFORMATION info;
+    HANDLE event, threads[2];
+    NTSTATUS status;
+    DWORD ret, code;
+    LONG prev;
+    int i;
+
+    /* a pulse releases all the waiters of a manual-reset event */
+    status = pNtCreateEvent( &event, GENERIC_ALL, NULL, NotificationEvent, 0 );
+    ok( !status, "NtCreateEvent failed %08lx\n", status );
+    for (i = 0; i < 2; i++) threads[i] = CreateThread( NULL, 0, pulse_wait_thread, event, 0, NULL );
+    Sleep( 100 );
+
+    status = pNtPulseEvent( event, &prev );
+    ok( !status, "NtPulseEvent failed %08lx\n", status );
+    ok( !prev, "prev_state = %lx\n", prev );
+    ret = WaitForMultipleObjects( 2, threads, TRUE, 1000 );
+    ok( ret == WAIT_OBJECT_0, "WaitForMultipleObjects returned %lu\n", ret );
+    for (i = 0; i < 2; i++)
+    {
+        GetExitCodeThread( threads[i], &code );
+        ok( code == WAIT_OBJECT_0, "thread %u returned %lu\n", i, code );
+        CloseHandle( threads[i] );
+    }
+    status = pNtQueryEvent( event, EventBasicInformation, &info, sizeof(info), NULL );
+    ok( !status, "NtQueryEvent failed %08lx\n", status );
+    ok( !info.EventState, "got state %ld\n", info.EventState );
+    pNtClose( event );
+
+    /* and a single one of an auto-reset event */
+    status = pNtCreateEvent( &event, GENERIC_ALL, NULL, SynchronizationEvent, 0 );
+    ok( !status, "NtCreateEvent failed %08lx\n", status );
+    for (i = 0; i < 2; i++) threads[i] = CreateThread( NULL, 0, pulse_wait_thread, event, 0, NULL );
+    Sleep( 100 );
+
+    status = pNtPulseEvent( event, &prev );
+    ok( !status, "NtPulseEvent failed %08lx\n", status );
+    ret = WaitForMultipleObjects( 2, threads, FALSE, 1000 );
+    ok( ret == WAIT_OBJECT_0 || ret == WAIT_OBJECT_0 + 1, "WaitForMultipleObjects returned %lu\n", ret );
+    i = (ret == WAIT_OBJECT_0) ? 1 : 0;
+    ret = WaitForSingleObject( threads[i], 100 );
+    ok( ret == WAIT_TIMEOUT, "both threads were released\n" );
+
+    status = pNtPulseEvent( event, &prev );
+    ok( !status, "NtPulseEvent failed %08lx\n", status );
+    ret = WaitForSingleObject( threads[i], 1000 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %lu\n", ret );
+    for (i = 0; i < 2; i++)
+    {
+        GetExitCodeThread( threads[i], &code );
+        ok( code == WAIT_OBJECT_0, "thread %u returned %lu\n", i, code );
+        CloseHandle( threads[i] );
+    }
+    status = pNtQueryEvent( event, EventBasicInformation, &info, sizeof(info), NULL );
+    ok( !status, "NtQueryEvent failed %08lx\n", status );
+    ok( !info.EventState, "got state %ld\n", info.EventState );
+    pNtClose( event );
+}
+
+static DWORD WINAPI suspend_wait_thread( void *arg )
+{
+    return WaitForSingleObject( arg, 5000 );
+}
+
+static void test_suspend_wait(void)
+{
+    EVENT_BASIC_INFORMATION info;
+    HANDLE event, thread;
+    NTSTATUS status;
+    DWORD ret, code;
+
+    status = pNtCreateEvent( &event, GENERIC_ALL, NULL, SynchronizationEvent, 0 );
+    ok( !status, "NtCreateEvent failed %08lx\n", status );
+    thread = CreateThread( NULL, 0, suspend_wait_thread, event, 0, NULL );
+    Sleep( 100 );
+
+    ret = SuspendThread( thread );
+    ok( !ret, "SuspendThread returned %lu\n", ret );
+
+    /* a suspended thread doesn't acquire the event */
+    status = pNtSetEvent( event, NULL );
+    ok( !status, "NtSetEvent failed %08lx\n", status );
+    ret = WaitForSingleObject( thread, 100 );
+    ok( ret == WAIT_TIMEOUT, "WaitForSingleObject returned %lu\n", ret );
+    status = pNtQueryEvent( event, EventBasicInformation, &info, sizeof(info), NULL );
+    ok( !status, "NtQueryEvent failed %08lx\n", status );
+    ok( info.EventState == 1, "got state %ld\n", info.EventState );
+
+    ret = ResumeThread( thread );
+    ok( ret == 1, "ResumeThread returned %lu\n", ret );
+    ret = WaitForSingleObject( thread, 1000 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %lu\n", ret );
+    GetExitCodeThread( thread, &code );
+    ok( code == WAIT_OBJECT_0, "thread returned %lu\n", code );
+    status = pNtQueryEvent( event, EventBasicInformation, &info, sizeof(info), NULL );
+    ok( !status, "NtQueryEvent failed %08lx\n", status );
+    ok( !info.EventState, "got state %ld\n", info.EventState );
+
+    CloseHandle( thread );
+    pNtClose( event );
+}
+
 static const WCHAR keyed_nameW[] = L"\\BaseNamedObjects\\WineTestEvent";
 
 static DWORD WINAPI keyed_event_thread( void *arg )
@@ -453,6 +562,52 @@ static void test_mutant(void)
     NtClose( mutant );
 }
 
+static DWORD WINAPI mutant_many_thread( void *arg )
+{
+    HANDLE *mutants = arg;
+    unsigned int i;
+    DWORD ret;
+
+    for (i = 0; i < 40; i++)
+    {
+        ret = WaitForSingleObject( mutants[i], 1000 );
+        ok( ret == WAIT_OBJECT_0, "%u: WaitForSingleObject failed %08lx\n", i, ret );
+    }
+    /* abandon them all */
+    return 0;
+}
+
+static void test_mutant_abandon_many(void)
+{
+    MUTANT_BASIC_INFORMATION info;
+    HANDLE mutants[40], thread;
+    NTSTATUS status;
+    unsigned int i;
+    DWORD ret;
+
+    for (i = 0; i < ARRAY_SIZE(mutants); i++)
+    {
+        status = pNtCreateMutant( &mutants[i], GENERIC_ALL, NULL, FALSE );
+        ok( !status, "NtCreateMutant failed %08lx\n", status );
+    }
+
+    thread = CreateThread( NULL, 0, mutant_many_thread, mutants, 0, NULL );
+    ret = WaitForSingleObject( thread, 5000 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject failed %08lx\n", ret );
+    CloseHandle( thread );
+
+    for (i = 0; i < ARRAY_SIZE(mutants); i++)
+    {
+        status = pNtQueryMutant( mutants[i], MutantBasicInformation, &info, sizeof(info), NULL );
+        ok( !status, "NtQueryMutant failed %08lx\n", status );
+        ok( info.AbandonedState == TRUE, "%u: expected TRUE, got %d\n", i, info.AbandonedState );
+        ret = WaitForSingleObject( mutants[i], 0 );
+        ok( ret == WAIT_ABANDONED_0, "%u: WaitForSingleObject failed %08lx\n", i, ret );
+        pNtReleaseMutant( mutants[i], NULL );
+        pNtClose( mutants[i] );
+    }
+}
+
 static void test_semaphore(void)
 {
     SEMAPHORE_BASIC_INFORMATION info;
@@ -879,7 +1034,10 @@ START_TEST(sync)
 
     test_wait_on_address();
     test_event();
+    test_pulse_event();
+    test_suspend_wait();
     test_mutant();
+    test_mutant_abandon_many();
     test_semaphore();
     test_keyed_events();
     test_resource();
@@ -811,6 +811,63 @@ static void test_tp_work_scheduler(void)
     pTpReleasePool(pool);
 }
 
+static LONG nested_work_posted, nested_work_executed, nested_work_total;
+
+static void CALLBACK nested_work_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_WORK *work)
+{
+    int i;
+
+    InterlockedIncrement(&nested_work_executed);
+    for (i = 0; i < 2; i++)
+        if (InterlockedIncrement(&nested_work_posted) <= nested_work_total) pTpPostWork(work);
+}
+
+static void test_tp_work_nested(void)
+{
+    static const int max_threads[] = {1, 2, 4, 8};
+    TP_CALLBACK_ENVIRON environment;
+    TP_WORK *work;
+    TP_POOL *pool;
+    NTSTATUS status;
+    DWORD ticks;
+    int i;
+
+    nested_work_total = winetest_interactive ? 1000000 : 20000;
+
+    for (i = 0; i < ARRAY_SIZE(max_threads); i++)
+    {
+        pool = NULL;
+        status = pTpAllocPool(&pool, NULL);
+        ok(!status, "TpAllocPool failed with status %lx\n", status);
+        ok(pool != NULL, "expected pool != NULL\n");
+        pTpSetPoolMaxThreads(pool, max_threads[i]);
+
+        work = NULL;
+        memset(&environment, 0, sizeof(environment));
+        environment.Version = 1;
+        environment.Pool = pool;
+        status = pTpAllocWork(&work, nested_work_cb, NULL, &environment);
+        ok(!status, "TpAllocWork failed with status %lx\n", status);
+        ok(work != NULL, "expected work != NULL\n");
+
+        /* the callbacks post the work item again from the worker threads,
+         * until nested_work_total callbacks have been posted */
+        nested_work_posted = 1;
+        nested_work_executed = 0;
+        ticks = GetTickCount();
+        pTpPostWork(work);
+        pTpWaitForWork(work, FALSE);
+        ticks = GetTickCount() - ticks;
+        ok(nested_work_executed == nested_work_total, "%d threads: expected %ld callbacks, got %ld\n",
+           max_threads[i], nested_work_total, nested_work_executed);
+        if (winetest_interactive)
+            trace("%d threads: %ld callbacks in %lu ms\n", max_threads[i], nested_work_executed, ticks);
+
+        pTpReleaseWork(work);
+        pTpReleasePool(pool);
+    }
+}
+
 static void CALLBACK simple_release_cb(TP_CALLBACK_INSTANCE *instance, void *userdata)
 {
     HANDLE *semaphores = userdata;
@@ -1606,6 +1663,82 @@ static void test_tp_window_length(void)
     CloseHandle(semaphore);
 }
 
+static void CALLBACK many_timers_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_TIMER *timer)
+{
+    InterlockedIncrement((LONG *)userdata);
+}
+
+static void test_tp_many_timers(void)
+{
+    static LONG fired[1000];
+    TP_CALLBACK_ENVIRON environment;
+    TP_TIMER *timers[1000];
+    LARGE_INTEGER when;
+    NTSTATUS status;
+    TP_POOL *pool;
+    LONG total, expected = 0;
+    DWORD ticks;
+    int i;
+
+    pool = NULL;
+    status = pTpAllocPool(&pool, NULL);
+    ok(!status, "TpAllocPool failed with status %lx\n", status);
+    ok(pool != NULL, "expected pool != NULL\n");
+
+    memset(&environment, 0, sizeof(environment));
+    environment.Version = 1;
+    environment.Pool = pool;
+
+    for (i = 0; i < ARRAY_SIZE(timers); i++)
+    {
+        fired[i] = 0;
+        timers[i] = NULL;
+        status = pTpAllocTimer(&timers[i], many_timers_cb, &fired[i], &environment);
+        ok(!status, "TpAllocTimer failed with status %lx\n", status);
+        ok(timers[i] != NULL, "expected timers[%d] != NULL\n", i);
+
+        /* the timers that are cancelled or moved below must not expire before that */
+        if (i % 4 < 2) when.QuadPart = -(LONGLONG)60000 * 10000;
+        else when.QuadPart = -(LONGLONG)(10 + (i * 37) % 100) * 10000;
+        pTpSetTimer(timers[i], &when, 0, i % 2 ? 20 : 0);
+    }
+
+    /* cancel a quarter of the timers, and move another quarter */
+    for (i = 0; i < ARRAY_SIZE(timers); i++)
+    {
+        if (i % 4 == 0)
+        {
+            pTpSetTimer(timers[i], NULL, 0, 0);
+            ok(!pTpIsTimerSet(timers[i]), "expected timer %d to be unset\n", i);
+            continue;
+        }
+        if (i % 4 == 1)
+        {
+            when.QuadPart = -(LONGLONG)(150 + i % 50) * 10000;
+            pTpSetTimer(timers[i], &when, 0, 0);
+        }
+        expected++;
+    }
+
+    ticks = GetTickCount();
+    for (;;)
+    {
+        for (i = total = 0; i < ARRAY_SIZE(timers); i++) total += fired[i];
+        if (total >= expected || GetTickCount() - ticks > 5000) break;
+        Sleep(10);
+    }
+    ok(total == expected, "expected %ld callbacks, got %ld\n", expected, total);
+
+    for (i = 0; i < ARRAY_SIZE(timers); i++)
+    {
+        pTpWaitForTimer(timers[i], FALSE);
+        ok(fired[i] == (i % 4 ? 1 : 0), "timer %d fired %ld times\n", i, fired[i]);
+        pTpReleaseTimer(timers[i]);
+    }
+
+    pTpReleasePool(pool);
+}
+
 struct wait_info
 {
     HANDLE semaphore;
@@ -2370,12 +2503,14 @@ START_TEST(threadpool)
     test_tp_simple();
     test_tp_work();
     test_tp_work_scheduler();
+    test_tp_work_nested();
     test_tp_group_wait();
     test_tp_group_cancel();
     test_tp_instance();
     test_tp_disassociate();
     test_tp_timer();
     test_tp_window_length();
+    test_tp_many_timers();
     test_tp_wait();
     test_tp_multi_wait();
     test_tp_io();
@@ -34,6 +34,7 @@
 #include "ntdll_misc.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(threadpool);
+WINE_DECLARE_DEBUG_CHANNEL(timerstats);
 
 /*
  * Old thread pooling API
@@ -68,11 +69,38 @@ static RTL_CRITICAL_SECTION_DEBUG critsect_compl_debug =
       0, 0, { (DWORD_PTR)(__FILE__ ": threadpool_compl_cs") }
 };
 
+/* binary min-heap of timers, ordered by expiration time */
+struct timer_heap_entry
+{
+    ULONGLONG time;             /* expiration time */
+    unsigned int index;         /* index in the heap array */
+};
+
+struct timer_heap
+{
+    struct timer_heap_entry **entries;
+    unsigned int count;
+    unsigned int size;
+};
+
+/* timer statistics, reported with WINEDEBUG=+timerstats */
+static struct
+{
+    LONG64 fired;               /* number of timer expirations */
+    LONG64 late;                /* number of expirations handled after their window */
+    LONG64 late_total;          /* total delay of the late expirations, in 100ns units */
+    LONG64 late_max;            /* longest delay of a late expiration */
+} timer_stats;
+
+/* delay after which an expiration counts as late, in 100ns units */
+#define TIMER_LATE_SLACK 10000
+
 struct timer_queue;
 struct queue_timer
 {
     struct timer_queue *q;
     struct list entry;
+    struct timer_heap_entry heap_entry; /* entry in the queue heap, unless expire is EXPIRE_NEVER */
     ULONG runcount;             /* number of callbacks pending execution */
     RTL_WAITORTIMERCALLBACKFUNC callback;
     PVOID param;
@@ -87,7 +115,8 @@ struct timer_queue
 {
     DWORD magic;
     RTL_CRITICAL_SECTION cs;
-    struct list timers;         /* sorted by expiration time */
+    struct list timers;         /* all the timers of the queue */
+    struct timer_heap heap;     /* pending timers */
     BOOL quit;                  /* queue should be deleted; once set, never unset */
     HANDLE event;
     HANDLE thread;
@@ -100,6 +129,28 @@ struct timer_queue
 #define THREADPOOL_WORKER_TIMEOUT 5000
 #define MAXIMUM_WAITQUEUE_OBJECTS (MAXIMUM_WAIT_OBJECTS - 1)
 
+/* internal queue of threadpool objects with pending callbacks */
+struct threadpool_queue
+{
+    RTL_SRWLOCK             lock;
+    /* Objects, locked via .lock, order matches TP_CALLBACK_PRIORITY - high, normal, low. */
+    struct list             items[3];
+    LONG                    count;
+};
+
+/* internal threadpool worker thread representation */
+struct threadpool_worker
+{
+    struct threadpool      *pool;
+    struct list             entry;          /* entry in pool workers list, locked via .pool->workers_lock */
+    struct threadpool_queue queue;          /* objects submitted from the callbacks of this worker */
+    unsigned int            local_count;    /* number of consecutive objects taken from .queue */
+    /* idle state, locked via .pool->cs */
+    struct list             idle_entry;
+    BOOL                    idle;
+    RTL_CONDITION_VARIABLE  wake_event;
+};
+
 /* internal threadpool representation */
 struct threadpool
 {
@@ -107,14 +158,21 @@ struct threadpool
     LONG                    objcount;
     BOOL                    shutdown;
     CRITICAL_SECTION        cs;
-    /* Pools of work items, locked via .cs, order matches TP_CALLBACK_PRIORITY - high, normal, low. */
-    struct list             pools[3];
-    RTL_CONDITION_VARIABLE  update_event;
+    /* objects submitted from threads that are not workers of the pool */
+    struct threadpool_queue queue;
+    /* worker threads, other workers only take the lock shared to steal objects */
+    RTL_SRWLOCK             workers_lock;
+    struct list             workers;
     /* information about worker threads, locked via .cs */
+    struct list             idle_workers;
     int                     max_workers;
     int                     min_workers;
     int                     num_workers;
-    int                     num_busy_workers;
+    /* updated with interlocked operations, so that submitting doesn't need .cs */
+    LONG                    num_idle_workers;
+    LONG                    num_starting_workers;
+    LONG                    num_busy_workers;
+    LONG                    num_queued;
     HANDLE                  compl_port;
     TP_POOL_STACK_INFORMATION stack_info;
 };
@@ -153,7 +211,10 @@ struct threadpool_object
     /* information about the group, locked via .group->cs */
     struct list             group_entry;
     BOOL                    is_group_member;
-    /* information about the pool, locked via .pool->cs */
+    /* information about the callbacks, locked via .lock */
+    RTL_SRWLOCK             lock;
+    /* queue the object is linked in, locked via .queue->lock */
+    struct threadpool_queue *queue;
     struct list             pool_entry;
     RTL_CONDITION_VARIABLE  finished_event;
     RTL_CONDITION_VARIABLE  group_finished_event;
@@ -178,7 +239,7 @@ struct threadpool_object
             /* information about the timer, locked via timerqueue.cs */
             BOOL            timer_initialized;
             BOOL            timer_pending;
-            struct list     timer_entry;
+            struct timer_heap_entry timer_entry;
             BOOL            timer_set;
             ULONGLONG       timeout;
             LONG            period;
@@ -200,7 +261,7 @@ struct threadpool_object
         struct
         {
             PTP_IO_CALLBACK callback;
-            /* locked via .pool->cs */
+            /* locked via .lock */
             unsigned int    pending_count, skipped_count, completion_count, completion_max;
             BOOL            shutting_down;
             struct io_completion *completions;
@@ -244,7 +305,7 @@ static struct
     CRITICAL_SECTION        cs;
     LONG                    objcount;
     BOOL                    thread_running;
-    struct list             pending_timers;
+    struct timer_heap       pending_timers;
     RTL_CONDITION_VARIABLE  update_event;
 }
 timerqueue =
@@ -252,7 +313,7 @@ timerqueue =
     { &timerqueue_debug, -1, 0, 0, 0, 0 },      /* cs */
     0,                                          /* objcount */
     FALSE,                                      /* thread_running */
-    LIST_INIT( timerqueue.pending_timers ),     /* pending_timers */
+    { NULL, 0, 0 },                             /* pending_timers */
     RTL_CONDITION_VARIABLE_INIT                 /* update_event */
 };
 
@@ -363,6 +424,8 @@ static inline struct threadpool_instance *impl_from_TP_CALLBACK_INSTANCE( TP_CAL
 }
 
 static void CALLBACK threadpool_worker_proc( void *param );
+static void tp_threadpool_wake( struct threadpool *pool );
+static void tp_object_prio_queue( struct threadpool_object *object, BOOL signaled );
 static void tp_object_submit( struct threadpool_object *object, BOOL signaled );
 static void tp_object_execute( struct threadpool_object *object, BOOL wait_thread );
 static void tp_object_prepare_shutdown( struct threadpool_object *object );
@@ -547,6 +610,121 @@ static inline PLARGE_INTEGER get_nt_timeout( PLARGE_INTEGER pTime, ULONG timeout
 }
 
 
+/************************** Timer Heap Impl **************************/
+
+/* make sure that the heap can hold count entries, so that insertions can't fail */
+static BOOL timer_heap_reserve( struct timer_heap *heap, unsigned int count )
+{
+    struct timer_heap_entry **entries;
+    unsigned int size;
+
+    if (count <= heap->size) return TRUE;
+
+    size = max( 16, max( count, heap->size * 2 ));
+    if (heap->entries)
+        entries = RtlReAllocateHeap( GetProcessHeap(), 0, heap->entries, size * sizeof(*entries) );
+    else
+        entries = RtlAllocateHeap( GetProcessHeap(), 0, size * sizeof(*entries) );
+    if (!entries) return FALSE;
+
+    heap->entries = entries;
+    heap->size = size;
+    return TRUE;
+}
+
+static void timer_heap_destroy( struct timer_heap *heap )
+{
+    RtlFreeHeap( GetProcessHeap(), 0, heap->entries );
+    heap->entries = NULL;
+    heap->count = heap->size = 0;
+}
+
+static inline void timer_heap_set( struct timer_heap *heap, unsigned int index, struct timer_heap_entry *entry )
+{
+    heap->entries[index] = entry;
+    entry->index = index;
+}
+
+static void timer_heap_sift_up( struct timer_heap *heap, struct timer_heap_entry *entry, unsigned int index )
+{
+    unsigned int parent;
+
+    while (index && entry->time < heap->entries[(parent = (index - 1) / 2)]->time)
+    {
+        timer_heap_set( heap, index, heap->entries[parent] );
+        index = parent;
+    }
+    timer_heap_set( heap, index, entry );
+}
+
+static void timer_heap_sift_down( struct timer_heap *heap, struct timer_heap_entry *entry, unsigned int index )
+{
+    unsigned int child;
+
+    while ((child = 2 * index + 1) < heap->count)
+    {
+        if (child + 1 < heap->count && heap->entries[child + 1]->time < heap->entries[child]->time) child++;
+        if (heap->entries[child]->time >= entry->time) break;
+        timer_heap_set( heap, index, heap->entries[child] );
+        index = child;
+    }
+    timer_heap_set( heap, index, entry );
+}
+
+/* insert an entry, space has to be reserved with timer_heap_reserve */
+static void timer_heap_insert( struct timer_heap *heap, struct timer_heap_entry *entry, ULONGLONG time )
+{
+    assert( heap->count < heap->size );
+    entry->time = time;
+    timer_heap_sift_up( heap, entry, heap->count++ );
+}
+
+static void timer_heap_remove( struct timer_heap *heap, struct timer_heap_entry *entry )
+{
+    struct timer_heap_entry *last = heap->entries[--heap->count];
+    unsigned int index = entry->index;
+
+    assert( index <= heap->count && heap->entries[index] == entry );
+    if (last == entry) return;
+    if (index && last->time < heap->entries[(index - 1) / 2]->time)
+        timer_heap_sift_up( heap, last, index );
+    else
+        timer_heap_sift_down( heap, last, index );
+}
+
+static inline struct timer_heap_entry *timer_heap_head( const struct timer_heap *heap )
+{
+    return heap->count ? heap->entries[0] : NULL;
+}
+
+/* account for an expiration handled at time now, for a timer that was supposed to fire before deadline */
+static void timer_stats_add( ULONGLONG deadline, ULONGLONG now )
+{
+    LONG64 delay, max_delay;
+
+    InterlockedIncrement64( &timer_stats.fired );
+    if (now <= deadline + TIMER_LATE_SLACK) return;
+
+    delay = now - deadline;
+    InterlockedIncrement64( &timer_stats.late );
+    InterlockedExchangeAdd64( &timer_stats.late_total, delay );
+    while ((max_delay = timer_stats.late_max) < delay &&
+           InterlockedCompareExchange64( &timer_stats.late_max, delay, max_delay ) != max_delay)
+        /* nothing */;
+}
+
+/* report the timer statistics on process exit */
+void threadpool_dump_timer_stats(void)
+{
+    if (!TRACE_ON(timerstats)) return;
+
+    TRACE_(timerstats)( "fired %I64d, late %I64d, average delay %I64d us, max delay %I64d us\n",
+                        timer_stats.fired, timer_stats.late,
+                        timer_stats.late ? timer_stats.late_total / timer_stats.late / 10 : 0,
+                        timer_stats.late_max / 10 );
+}
+
+
 /************************** Timer Queue Impl **************************/
 
 static void queue_remove_timer(struct queue_timer *t)
@@ -560,6 +738,8 @@ static void queue_remove_timer(struct queue_timer *t)
     assert(t->destroy);
 
     list_remove(&t->entry);
+    if (t->expire != EXPIRE_NEVER)
+        timer_heap_remove(&q->heap, &t->heap_entry);
     if (t->event)
         NtSetEvent(t->event, NULL);
     RtlFreeHeap(GetProcessHeap(), 0, t);
@@ -600,26 +780,22 @@ static inline ULONGLONG queue_current_time(void)
 static void queue_add_timer(struct queue_timer *t, ULONGLONG time,
                             BOOL set_event)
 {
-    /* We MUST hold the queue cs while calling this function.  */
+    /* We MUST hold the queue cs while calling this function.  The timer
+       must not be pending.  Space in the heap was reserved when the
+       timer was created.  */
     struct timer_queue *q = t->q;
-    struct list *ptr = &q->timers;
 
     assert(!q->quit || (t->destroy && time == EXPIRE_NEVER));
 
-    if (time != EXPIRE_NEVER)
-        LIST_FOR_EACH(ptr, &q->timers)
-        {
-            struct queue_timer *cur = LIST_ENTRY(ptr, struct queue_timer, entry);
-            if (time < cur->expire)
-                break;
-        }
-    list_add_before(ptr, &t->entry);
-
     t->expire = time;
+    if (time == EXPIRE_NEVER)
+        return;
+
+    timer_heap_insert(&q->heap, &t->heap_entry, time);
 
-    /* If we insert at the head of the list, we need to expire sooner
+    /* If we insert at the head of the heap, we need to expire sooner
        than expected.  */
-    if (set_event && &t->entry == list_head(&q->timers))
+    if (set_event && &t->heap_entry == timer_heap_head(&q->heap))
         NtSetEvent(q->event, NULL);
 }
 
@@ -627,21 +803,24 @@ static inline void queue_move_timer(struct queue_timer *t, ULONGLONG time,
                                     BOOL set_event)
 {
     /* We MUST hold the queue cs while calling this function.  */
-    list_remove(&t->entry);
+    if (t->expire != EXPIRE_NEVER)
+        timer_heap_remove(&t->q->heap, &t->heap_entry);
     queue_add_timer(t, time, set_event);
 }
 
 static void queue_timer_expire(struct timer_queue *q)
 {
+    struct timer_heap_entry *entry;
     struct queue_timer *t = NULL;
 
     RtlEnterCriticalSection(&q->cs);
-    if (list_head(&q->timers))
+    if ((entry = timer_heap_head(&q->heap)))
     {
         ULONGLONG now, next;
-        t = LIST_ENTRY(list_head(&q->timers), struct queue_timer, entry);
+        t = CONTAINING_RECORD(entry, struct queue_timer, heap_entry);
         if (!t->destroy && t->expire <= ((now = queue_current_time())))
         {
+            timer_stats_add(t->expire * 10000, now * 10000);
             ++t->runcount;
             if (t->period)
             {
@@ -678,13 +857,14 @@ static void queue_timer_expire(struct timer_queue *q)
 
 static ULONG queue_get_timeout(struct timer_queue *q)
 {
+    struct timer_heap_entry *entry;
     struct queue_timer *t;
     ULONG timeout = INFINITE;
 
     RtlEnterCriticalSection(&q->cs);
-    if (list_head(&q->timers))
+    if ((entry = timer_heap_head(&q->heap)))
     {
-        t = LIST_ENTRY(list_head(&q->timers), struct queue_timer, entry);
+        t = CONTAINING_RECORD(entry, struct queue_timer, heap_entry);
         assert(!t->destroy || t->expire == EXPIRE_NEVER);
 
         if (t->expire != EXPIRE_NEVER)
@@ -735,6 +915,7 @@ static void WINAPI timer_queue_thread_proc(LPVOID p)
 
     NtClose(q->event);
     RtlDeleteCriticalSection(&q->cs);
+    timer_heap_destroy(&q->heap);
     q->magic = 0;
     RtlFreeHeap(GetProcessHeap(), 0, q);
     RtlExitUserThread( 0 );
@@ -751,7 +932,7 @@ static void queue_destroy_timer(struct queue_timer *t)
         queue_remove_timer(t);
     else
         /* Make sure no destroyed timer masks an active timer at the head
-           of the sorted list.  */
+           of the heap.  */
         queue_move_timer(t, EXPIRE_NEVER, FALSE);
 }
 
@@ -776,6 +957,7 @@ NTSTATUS WINAPI RtlCreateTimerQueue(PHANDLE NewTimerQueue)
 
     RtlInitializeCriticalSection(&q->cs);
     list_init(&q->timers);
+    memset(&q->heap, 0, sizeof(q->heap));
     q->quit = FALSE;
     q->magic = TIMER_QUEUE_MAGIC;
     status = NtCreateEvent(&q->event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE);
@@ -928,6 +1110,7 @@ NTSTATUS WINAPI RtlCreateTimer(HANDLE TimerQueue, HANDLE *NewTimer,
     t->param = Parameter;
     t->period = Period;
     t->flags = Flags;
+    t->expire = EXPIRE_NEVER;
     t->destroy = FALSE;
     t->event = NULL;
 
@@ -935,8 +1118,13 @@ NTSTATUS WINAPI RtlCreateTimer(HANDLE TimerQueue, HANDLE *NewTimer,
     RtlEnterCriticalSection(&q->cs);
     if (q->quit)
         status = STATUS_INVALID_HANDLE;
+    else if (!timer_heap_reserve(&q->heap, q->heap.count + 1))
+        status = STATUS_NO_MEMORY;
     else
+    {
+        list_add_tail(&q->timers, &t->entry);
         queue_add_timer(t, queue_current_time() + DueTime, TRUE);
+    }
     RtlLeaveCriticalSection(&q->cs);
 
     if (status == STATUS_SUCCESS)
@@ -1041,15 +1229,56 @@ NTSTATUS WINAPI RtlDeleteTimer(HANDLE TimerQueue, HANDLE Timer,
     return status;
 }
 
+/***********************************************************************
+ *           timerqueue_get_timeout_upper    (internal)
+ *
+ * Returns the earliest end of the window of the timers that expire before
+ * it. Subtrees of timers expiring after the current bound are skipped.
+ */
+static ULONGLONG timerqueue_get_timeout_upper( unsigned int index, ULONGLONG upper )
+{
+    struct threadpool_object *timer;
+    ULONGLONG new_timeout;
+
+    if (index >= timerqueue.pending_timers.count) return upper;
+    timer = CONTAINING_RECORD( timerqueue.pending_timers.entries[index], struct threadpool_object, u.timer.timer_entry );
+    assert( timer->type == TP_OBJECT_TYPE_TIMER );
+    if (timer->u.timer.timeout >= upper) return upper;
+
+    new_timeout = timer->u.timer.timeout + (ULONGLONG)timer->u.timer.window_length * 10000;
+    if (new_timeout < upper) upper = new_timeout;
+
+    upper = timerqueue_get_timeout_upper( 2 * index + 1, upper );
+    return timerqueue_get_timeout_upper( 2 * index + 2, upper );
+}
+
+/***********************************************************************
+ *           timerqueue_get_timeout_lower    (internal)
+ *
+ * Returns the latest expiration time that isn't after upper.
+ */
+static ULONGLONG timerqueue_get_timeout_lower( unsigned int index, ULONGLONG upper, ULONGLONG lower )
+{
+    struct threadpool_object *timer;
+
+    if (index >= timerqueue.pending_timers.count) return lower;
+    timer = CONTAINING_RECORD( timerqueue.pending_timers.entries[index], struct threadpool_object, u.timer.timer_entry );
+    if (timer->u.timer.timeout > upper) return lower;
+
+    if (timer->u.timer.timeout > lower) lower = timer->u.timer.timeout;
+
+    lower = timerqueue_get_timeout_lower( 2 * index + 1, upper, lower );
+    return timerqueue_get_timeout_lower( 2 * index + 2, upper, lower );
+}
+
 /***********************************************************************
  *           timerqueue_thread_proc    (internal)
  */
 static void CALLBACK timerqueue_thread_proc( void *param )
 {
-    ULONGLONG timeout_lower, timeout_upper, new_timeout;
-    struct threadpool_object *other_timer;
+    ULONGLONG timeout_lower, timeout_upper;
+    struct timer_heap_entry *entry;
     LARGE_INTEGER now, timeout;
-    struct list *ptr;
 
     TRACE( "starting timer queue thread\n" );
 
@@ -1059,16 +1288,19 @@ static void CALLBACK timerqueue_thread_proc( void *param )
         NtQuerySystemTime( &now );
 
         /* Check for expired timers. */
-        while ((ptr = list_head( &timerqueue.pending_timers )))
+        while ((entry = timer_heap_head( &timerqueue.pending_timers )))
         {
-            struct threadpool_object *timer = LIST_ENTRY( ptr, struct threadpool_object, u.timer.timer_entry );
+            struct threadpool_object *timer = CONTAINING_RECORD( entry, struct threadpool_object, u.timer.timer_entry );
             assert( timer->type == TP_OBJECT_TYPE_TIMER );
             assert( timer->u.timer.timer_pending );
             if (timer->u.timer.timeout > now.QuadPart)
                 break;
 
+            timer_stats_add( timer->u.timer.timeout + (ULONGLONG)timer->u.timer.window_length * 10000,
+                             now.QuadPart );
+
             /* Queue a new callback in one of the worker threads. */
-            list_remove( &timer->u.timer.timer_entry );
+            timer_heap_remove( &timerqueue.pending_timers, entry );
             timer->u.timer.timer_pending = FALSE;
             tp_object_submit( timer, FALSE );
 
@@ -1079,32 +1311,17 @@ static void CALLBACK timerqueue_thread_proc( void *param )
                 if (timer->u.timer.timeout <= now.QuadPart)
                     timer->u.timer.timeout = now.QuadPart + 1;
 
-                LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
-                                     struct threadpool_object, u.timer.timer_entry )
-                {
-                    assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
-                    if (timer->u.timer.timeout < other_timer->u.timer.timeout)
-                        break;
-                }
-                list_add_before( &other_timer->u.timer.timer_entry, &timer->u.timer.timer_entry );
+                timer_heap_insert( &timerqueue.pending_timers, entry, timer->u.timer.timeout );
                 timer->u.timer.timer_pending = TRUE;
             }
         }
 
-        timeout_lower = timeout_upper = MAXLONGLONG;
-
         /* Determine next timeout and use the window length to optimize wakeup times. */
-        LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
-                             struct threadpool_object, u.timer.timer_entry )
+        timeout_lower = MAXLONGLONG;
+        if (timerqueue.pending_timers.count)
         {
-            assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
-            if (other_timer->u.timer.timeout >= timeout_upper)
-                break;
-
-            timeout_lower = other_timer->u.timer.timeout;
-            new_timeout   = timeout_lower + (ULONGLONG)other_timer->u.timer.window_length * 10000;
-            if (new_timeout < timeout_upper)
-                timeout_upper = new_timeout;
+            timeout_upper = timerqueue_get_timeout_upper( 0, MAXLONGLONG );
+            timeout_lower = timerqueue_get_timeout_lower( 0, timeout_upper, 0 );
         }
 
         /* Wait for timer update events or until the next timer expires. */
@@ -1132,6 +1349,16 @@ static void CALLBACK timerqueue_thread_proc( void *param )
     RtlExitUserThread( 0 );
 }
 
+static void tp_queue_init( struct threadpool_queue *queue )
+{
+    unsigned int i;
+
+    RtlInitializeSRWLock( &queue->lock );
+    for (i = 0; i < ARRAY_SIZE(queue->items); ++i)
+        list_init( &queue->items[i] );
+    queue->count = 0;
+}
+
 /***********************************************************************
  *           tp_new_worker_thread    (internal)
  *
@@ -1139,17 +1366,40 @@ static void CALLBACK timerqueue_thread_proc( void *param )
  */
 static NTSTATUS tp_new_worker_thread( struct threadpool *pool )
 {
+    struct threadpool_worker *worker;
     HANDLE thread;
     NTSTATUS status;
 
+    if (!(worker = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*worker) )))
+        return STATUS_NO_MEMORY;
+
+    worker->pool        = pool;
+    worker->local_count = 0;
+    worker->idle        = FALSE;
+    tp_queue_init( &worker->queue );
+    RtlInitializeConditionVariable( &worker->wake_event );
+
+    RtlAcquireSRWLockExclusive( &pool->workers_lock );
+    list_add_tail( &pool->workers, &worker->entry );
+    RtlReleaseSRWLockExclusive( &pool->workers_lock );
+
+    InterlockedIncrement( &pool->num_starting_workers );
     status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, 0, 0, 0,
-                                  threadpool_worker_proc, pool, &thread, NULL );
+                                  threadpool_worker_proc, worker, &thread, NULL );
     if (status == STATUS_SUCCESS)
     {
         InterlockedIncrement( &pool->refcount );
         pool->num_workers++;
         NtClose( thread );
     }
+    else
+    {
+        InterlockedDecrement( &pool->num_starting_workers );
+        RtlAcquireSRWLockExclusive( &pool->workers_lock );
+        list_remove( &worker->entry );
+        RtlReleaseSRWLockExclusive( &pool->workers_lock );
+        RtlFreeHeap( GetProcessHeap(), 0, worker );
+    }
     return status;
 }
 
@@ -1186,6 +1436,10 @@ static NTSTATUS tp_timerqueue_lock( struct threadpool_object *timer )
         }
     }
 
+    /* Reserve space for the timer, so that setting it can't fail. */
+    if (status == STATUS_SUCCESS && !timer_heap_reserve( &timerqueue.pending_timers, timerqueue.objcount + 1 ))
+        status = STATUS_NO_MEMORY;
+
     if (status == STATUS_SUCCESS)
     {
         timer->u.timer.timer_initialized = TRUE;
@@ -1211,14 +1465,14 @@ static void tp_timerqueue_unlock( struct threadpool_object *timer )
         /* If timer was pending, remove it. */
         if (timer->u.timer.timer_pending)
         {
-            list_remove( &timer->u.timer.timer_entry );
+            timer_heap_remove( &timerqueue.pending_timers, &timer->u.timer.timer_entry );
             timer->u.timer.timer_pending = FALSE;
         }
 
         /* If the last timer object was destroyed, then wake up the thread. */
         if (!--timerqueue.objcount)
         {
-            assert( list_empty( &timerqueue.pending_timers ) );
+            assert( !timerqueue.pending_timers.count );
             RtlWakeAllConditionVariable( &timerqueue.update_event );
         }
 
@@ -1265,10 +1519,10 @@ static void CALLBACK waitqueue_thread_proc( void *param )
                 if ((wait->u.wait.flags & (WT_EXECUTEINWAITTHREAD | WT_EXECUTEINIOTHREAD)))
                 {
                     InterlockedIncrement( &wait->refcount );
+                    RtlAcquireSRWLockExclusive( &wait->lock );
                     wait->num_pending_callbacks++;
-                    RtlEnterCriticalSection( &wait->pool->cs );
                     tp_object_execute( wait, TRUE );
-                    RtlLeaveCriticalSection( &wait->pool->cs );
+                    RtlReleaseSRWLockExclusive( &wait->lock );
                     tp_object_release( wait );
                 }
                 else tp_object_submit( wait, FALSE );
@@ -1321,11 +1575,11 @@ static void CALLBACK waitqueue_thread_proc( void *param )
                     }
                     if ((wait->u.wait.flags & (WT_EXECUTEINWAITTHREAD | WT_EXECUTEINIOTHREAD)))
                     {
+                        RtlAcquireSRWLockExclusive( &wait->lock );
                         wait->u.wait.signaled++;
                         wait->num_pending_callbacks++;
-                        RtlEnterCriticalSection( &wait->pool->cs );
                         tp_object_execute( wait, TRUE );
-                        RtlLeaveCriticalSection( &wait->pool->cs );
+                        RtlReleaseSRWLockExclusive( &wait->lock );
                     }
                     else tp_object_submit( wait, TRUE );
                 }
@@ -1528,7 +1782,7 @@ static void CALLBACK ioqueue_thread_proc( void *param )
 
         if (io && (io->shutdown || io->u.io.shutting_down))
         {
-            RtlEnterCriticalSection( &io->pool->cs );
+            RtlAcquireSRWLockExclusive( &io->lock );
             if (!io->u.io.pending_count)
             {
                 if (io->u.io.skipped_count)
@@ -1539,7 +1793,7 @@ static void CALLBACK ioqueue_thread_proc( void *param )
                 else
                     destroy = TRUE;
             }
-            RtlLeaveCriticalSection( &io->pool->cs );
+            RtlReleaseSRWLockExclusive( &io->lock );
             if (skip) continue;
         }
 
@@ -1552,7 +1806,9 @@ static void CALLBACK ioqueue_thread_proc( void *param )
         }
         else if (io)
         {
-            RtlEnterCriticalSection( &io->pool->cs );
+            BOOL submit = FALSE;
+
+            RtlAcquireSRWLockExclusive( &io->lock );
 
             TRACE( "pending_count %u.\n", io->u.io.pending_count );
 
@@ -1563,7 +1819,7 @@ static void CALLBACK ioqueue_thread_proc( void *param )
                         io->u.io.completion_count + 1, sizeof(*io->u.io.completions)))
                 {
                     ERR( "Failed to allocate memory.\n" );
-                    RtlLeaveCriticalSection( &io->pool->cs );
+                    RtlReleaseSRWLockExclusive( &io->lock );
                     continue;
                 }
 
@@ -1571,9 +1827,12 @@ static void CALLBACK ioqueue_thread_proc( void *param )
                 completion->iosb = iosb;
                 completion->cvalue = value;
 
-                tp_object_submit( io, FALSE );
+                tp_object_prio_queue( io, FALSE );
+                submit = TRUE;
             }
-            RtlLeaveCriticalSection( &io->pool->cs );
+            RtlReleaseSRWLockExclusive( &io->lock );
+
+            if (submit) tp_threadpool_wake( io->pool );
         }
 
         if (!ioqueue.objcount)
@@ -1653,7 +1912,6 @@ static NTSTATUS tp_threadpool_alloc( struct threadpool **out )
 {
     IMAGE_NT_HEADERS *nt = RtlImageNtHeader( NtCurrentTeb()->Peb->ImageBaseAddress );
     struct threadpool *pool;
-    unsigned int i;
 
     pool = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*pool) );
     if (!pool)
@@ -1666,14 +1924,18 @@ static NTSTATUS tp_threadpool_alloc( struct threadpool **out )
     RtlInitializeCriticalSection( &pool->cs );
     pool->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": threadpool.cs");
 
-    for (i = 0; i < ARRAY_SIZE(pool->pools); ++i)
-        list_init( &pool->pools[i] );
-    RtlInitializeConditionVariable( &pool->update_event );
+    tp_queue_init( &pool->queue );
+    RtlInitializeSRWLock( &pool->workers_lock );
+    list_init( &pool->workers );
+    list_init( &pool->idle_workers );
 
     pool->max_workers             = 500;
     pool->min_workers             = 0;
     pool->num_workers             = 0;
+    pool->num_idle_workers        = 0;
+    pool->num_starting_workers    = 0;
     pool->num_busy_workers        = 0;
+    pool->num_queued              = 0;
     pool->stack_info.StackReserve = nt->OptionalHeader.SizeOfStackReserve;
     pool->stack_info.StackCommit  = nt->OptionalHeader.SizeOfStackCommit;
 
@@ -1692,10 +1954,15 @@ static NTSTATUS tp_threadpool_alloc( struct threadpool **out )
  */
 static void tp_threadpool_shutdown( struct threadpool *pool )
 {
+    struct threadpool_worker *worker;
+
     assert( pool != default_threadpool );
 
+    RtlEnterCriticalSection( &pool->cs );
     pool->shutdown = TRUE;
-    RtlWakeAllConditionVariable( &pool->update_event );
+    LIST_FOR_EACH_ENTRY( worker, &pool->idle_workers, struct threadpool_worker, idle_entry )
+        RtlWakeConditionVariable( &worker->wake_event );
+    RtlLeaveCriticalSection( &pool->cs );
 }
 
 /***********************************************************************
@@ -1705,8 +1972,6 @@ static void tp_threadpool_shutdown( struct threadpool *pool )
  */
 static BOOL tp_threadpool_release( struct threadpool *pool )
 {
-    unsigned int i;
-
     if (InterlockedDecrement( &pool->refcount ))
         return FALSE;
 
@@ -1714,8 +1979,8 @@ static BOOL tp_threadpool_release( struct threadpool *pool )
 
     assert( pool->shutdown );
     assert( !pool->objcount );
-    for (i = 0; i < ARRAY_SIZE(pool->pools); ++i)
-        assert( list_empty( &pool->pools[i] ) );
+    assert( !pool->num_queued );
+    assert( list_empty( &pool->workers ) );
 
     pool->cs.DebugInfo->Spare[0] = 0;
     RtlDeleteCriticalSection( &pool->cs );
@@ -1895,6 +2160,8 @@ static void tp_object_initialize( struct threadpool_object *object, struct threa
     memset( &object->group_entry, 0, sizeof(object->group_entry) );
     object->is_group_member         = FALSE;
 
+    RtlInitializeSRWLock( &object->lock );
+    object->queue                   = NULL;
     memset( &object->pool_entry, 0, sizeof(object->pool_entry) );
     RtlInitializeConditionVariable( &object->finished_event );
     RtlInitializeConditionVariable( &object->group_finished_event );
@@ -1918,7 +2185,7 @@ static void tp_object_initialize( struct threadpool_object *object, struct threa
             TP_CALLBACK_ENVIRON_V3 *environment_v3 = (TP_CALLBACK_ENVIRON_V3 *)environment;
 
             object->priority = environment_v3->CallbackPriority;
-            assert( object->priority < ARRAY_SIZE(pool->pools) );
+            assert( object->priority < ARRAY_SIZE(pool->queue.items) );
         }
 
         if (environment->ActivationContext)
@@ -1955,50 +2222,160 @@ static void tp_object_initialize( struct threadpool_object *object, struct threa
         tp_object_release( object );
 }
 
-static void tp_object_prio_queue( struct threadpool_object *object )
+/***********************************************************************
+ *           tp_queue_push    (internal)
+ *
+ * Links an object at the end of a queue. The queue holds a reference to
+ * the object, which is passed to whoever unlinks it. object->lock has to
+ * be held.
+ */
+static void tp_queue_push( struct threadpool_queue *queue, struct threadpool_object *object )
 {
-    ++object->pool->num_busy_workers;
-    list_add_tail( &object->pool->pools[object->priority], &object->pool_entry );
+    assert( !object->queue );
+
+    InterlockedIncrement( &object->refcount );
+    RtlAcquireSRWLockExclusive( &queue->lock );
+    list_add_tail( &queue->items[object->priority], &object->pool_entry );
+    object->queue = queue;
+    InterlockedIncrement( &queue->count );
+    RtlReleaseSRWLockExclusive( &queue->lock );
+    InterlockedIncrement( &object->pool->num_queued );
 }
 
 /***********************************************************************
- *           tp_object_submit    (internal)
+ *           tp_queue_pop    (internal)
  *
- * Submits a threadpool object to the associated threadpool. This
- * function has to be VOID because TpPostWork can never fail on Windows.
+ * Unlinks the first object with the given priority from a queue. The
+ * caller takes over the reference held by the queue.
  */
-static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
+static struct threadpool_object *tp_queue_pop( struct threadpool_queue *queue, unsigned int priority )
+{
+    struct threadpool_object *object = NULL;
+    struct list *ptr;
+
+    if (!queue->count) return NULL;
+
+    RtlAcquireSRWLockExclusive( &queue->lock );
+    if ((ptr = list_head( &queue->items[priority] )))
+    {
+        object = LIST_ENTRY( ptr, struct threadpool_object, pool_entry );
+        list_remove( &object->pool_entry );
+        object->queue = NULL;
+        InterlockedDecrement( &queue->count );
+        InterlockedDecrement( &object->pool->num_queued );
+    }
+    RtlReleaseSRWLockExclusive( &queue->lock );
+    return object;
+}
+
+/***********************************************************************
+ *           tp_queue_remove    (internal)
+ *
+ * Unlinks an object from the queue it is linked in, if any. Returns TRUE
+ * if the caller took over the reference held by the queue. object->lock
+ * has to be held, so that the object can't be queued again meanwhile.
+ */
+static BOOL tp_queue_remove( struct threadpool_object *object )
 {
     struct threadpool *pool = object->pool;
-    NTSTATUS status = STATUS_UNSUCCESSFUL;
+    struct threadpool_queue *queue;
+    BOOL ret = FALSE;
 
-    assert( !object->shutdown );
-    assert( !pool->shutdown );
+    /* the workers lock keeps the queue of a worker alive */
+    RtlAcquireSRWLockShared( &pool->workers_lock );
+    if ((queue = object->queue))
+    {
+        RtlAcquireSRWLockExclusive( &queue->lock );
+        if (object->queue == queue)
+        {
+            list_remove( &object->pool_entry );
+            object->queue = NULL;
+            InterlockedDecrement( &queue->count );
+            InterlockedDecrement( &pool->num_queued );
+            ret = TRUE;
+        }
+        RtlReleaseSRWLockExclusive( &queue->lock );
+    }
+    RtlReleaseSRWLockShared( &pool->workers_lock );
+    return ret;
+}
+
+/***********************************************************************
+ *           tp_threadpool_wake    (internal)
+ *
+ * Makes sure that queued objects are picked up, by waking an idle worker
+ * thread, or by starting a new one when all the workers are busy and more
+ * objects are queued than there are workers starting up.
+ */
+static void tp_threadpool_wake( struct threadpool *pool )
+{
+    struct threadpool_worker *worker;
+    struct list *ptr;
+
+    /* checked without the lock, workers going idle check the queues after
+     * incrementing num_idle_workers */
+    if (!pool->num_idle_workers && (pool->num_queued <= pool->num_starting_workers ||
+        pool->num_workers >= pool->max_workers))
+        return;
 
     RtlEnterCriticalSection( &pool->cs );
+    if ((ptr = list_head( &pool->idle_workers )))
+    {
+        worker = LIST_ENTRY( ptr, struct threadpool_worker, idle_entry );
+        list_remove( &worker->idle_entry );
+        worker->idle = FALSE;
+        InterlockedDecrement( &pool->num_idle_workers );
+        RtlWakeConditionVariable( &worker->wake_event );
+    }
+    else if (pool->num_queued > pool->num_starting_workers &&
+             pool->num_workers < pool->max_workers)
+    {
+        tp_new_worker_thread( pool );
+    }
+    RtlLeaveCriticalSection( &pool->cs );
+}
 
-    /* Start new worker threads if required. */
-    if (pool->num_busy_workers >= pool->num_workers &&
-        pool->num_workers < pool->max_workers)
-        status = tp_new_worker_thread( pool );
+/***********************************************************************
+ *           tp_object_prio_queue    (internal)
+ *
+ * Adds a pending callback to a threadpool object, and queues the object
+ * if it isn't already. Objects submitted from a worker thread go to the
+ * queue of that worker, where it will find them first; other workers
+ * steal them when they run out of work. object->lock has to be held,
+ * the caller has to call tp_threadpool_wake after releasing it.
+ */
+static void tp_object_prio_queue( struct threadpool_object *object, BOOL signaled )
+{
+    struct threadpool_worker *worker = NtCurrentTeb()->ThreadPoolData;
+    struct threadpool *pool = object->pool;
+
+    assert( !object->shutdown );
+    assert( !pool->shutdown );
 
     /* Queue work item and increment refcount. */
     InterlockedIncrement( &object->refcount );
-    if (!object->num_pending_callbacks++)
-        tp_object_prio_queue( object );
+    object->num_pending_callbacks++;
+    if (!object->queue)
+        tp_queue_push( worker && worker->pool == pool ? &worker->queue : &pool->queue, object );
 
     /* Count how often the object was signaled. */
     if (object->type == TP_OBJECT_TYPE_WAIT && signaled)
         object->u.wait.signaled++;
+}
 
-    /* No new thread started - wake up one existing thread. */
-    if (status != STATUS_SUCCESS)
-    {
-        assert( pool->num_workers > 0 );
-        RtlWakeConditionVariable( &pool->update_event );
-    }
+/***********************************************************************
+ *           tp_object_submit    (internal)
+ *
+ * Submits a threadpool object to the associated threadpool. This
+ * function has to be VOID because TpPostWork can never fail on Windows.
+ */
+static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
+{
+    RtlAcquireSRWLockExclusive( &object->lock );
+    tp_object_prio_queue( object, signaled );
+    RtlReleaseSRWLockExclusive( &object->lock );
 
-    RtlLeaveCriticalSection( &pool->cs );
+    tp_threadpool_wake( object->pool );
 }
 
 /***********************************************************************
@@ -2008,25 +2385,26 @@ static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
  */
 static void tp_object_cancel( struct threadpool_object *object )
 {
-    struct threadpool *pool = object->pool;
     LONG pending_callbacks = 0;
 
-    RtlEnterCriticalSection( &pool->cs );
+    RtlAcquireSRWLockExclusive( &object->lock );
     if (object->num_pending_callbacks)
     {
         pending_callbacks = object->num_pending_callbacks;
         object->num_pending_callbacks = 0;
-        list_remove( &object->pool_entry );
 
         if (object->type == TP_OBJECT_TYPE_WAIT)
             object->u.wait.signaled = 0;
     }
+    /* a worker may be about to run the object, it will notice that nothing is pending */
+    if (tp_queue_remove( object ))
+        pending_callbacks++;
     if (object->type == TP_OBJECT_TYPE_IO)
     {
         object->u.io.skipped_count += object->u.io.pending_count;
         object->u.io.pending_count = 0;
     }
-    RtlLeaveCriticalSection( &pool->cs );
+    RtlReleaseSRWLockExclusive( &object->lock );
 
     while (pending_callbacks--)
         tp_object_release( object );
@@ -2053,17 +2431,15 @@ static BOOL object_is_finished( struct threadpool_object *object, BOOL group )
  */
 static void tp_object_wait( struct threadpool_object *object, BOOL group_wait )
 {
-    struct threadpool *pool = object->pool;
-
-    RtlEnterCriticalSection( &pool->cs );
+    RtlAcquireSRWLockExclusive( &object->lock );
     while (!object_is_finished( object, group_wait ))
     {
         if (group_wait)
-            RtlSleepConditionVariableCS( &object->group_finished_event, &pool->cs, NULL );
+            RtlSleepConditionVariableSRW( &object->group_finished_event, &object->lock, NULL, 0 );
         else
-            RtlSleepConditionVariableCS( &object->finished_event, &pool->cs, NULL );
+            RtlSleepConditionVariableSRW( &object->finished_event, &object->lock, NULL, 0 );
     }
-    RtlLeaveCriticalSection( &pool->cs );
+    RtlReleaseSRWLockExclusive( &object->lock );
 }
 
 static void tp_ioqueue_unlock( struct threadpool_object *io )
@@ -2108,6 +2484,7 @@ static BOOL tp_object_release( struct threadpool_object *object )
     TRACE( "destroying object %p of type %u\n", object, object->type );
 
     assert( object->shutdown );
+    assert( !object->queue );
     assert( !object->num_pending_callbacks );
     assert( !object->num_running_callbacks );
     assert( !object->num_associated_callbacks );
@@ -2140,32 +2517,78 @@ static BOOL tp_object_release( struct threadpool_object *object )
     return TRUE;
 }
 
-static struct list *threadpool_get_next_item( const struct threadpool *pool )
+/* maximum number of objects a worker takes from its own queue before looking at the pool queue */
+#define THREADPOOL_MAX_LOCAL_ITEMS 32
+
+/***********************************************************************
+ *           threadpool_get_next_item    (internal)
+ *
+ * Takes the next object to run for a worker, by decreasing priority. The
+ * worker looks at its own queue first, then at the pool queue, and
+ * finally steals from the queues of the other workers. Returns the queue
+ * where the object has to go if it has more pending callbacks.
+ */
+static struct threadpool_object *threadpool_get_next_item( struct threadpool_worker *worker,
+                                                           struct threadpool_queue **queue )
 {
-    struct list *ptr;
+    struct threadpool *pool = worker->pool;
+    struct threadpool_object *object = NULL;
+    struct threadpool_worker *other;
     unsigned int i;
 
-    for (i = 0; i < ARRAY_SIZE(pool->pools); ++i)
+    for (i = 0; i < ARRAY_SIZE(pool->queue.items); ++i)
     {
-        if ((ptr = list_head( &pool->pools[i] )))
-            break;
+        /* don't starve the objects submitted from other threads */
+        if (worker->local_count < THREADPOOL_MAX_LOCAL_ITEMS &&
+            (object = tp_queue_pop( &worker->queue, i )))
+        {
+            worker->local_count++;
+            *queue = &worker->queue;
+            return object;
+        }
+        if ((object = tp_queue_pop( &pool->queue, i )))
+        {
+            worker->local_count = 0;
+            *queue = &pool->queue;
+            return object;
+        }
+        if ((object = tp_queue_pop( &worker->queue, i )))
+        {
+            worker->local_count = 0;
+            *queue = &worker->queue;
+            return object;
+        }
+
+        if (pool->num_queued <= pool->queue.count + worker->queue.count) continue;
+
+        RtlAcquireSRWLockShared( &pool->workers_lock );
+        LIST_FOR_EACH_ENTRY( other, &pool->workers, struct threadpool_worker, entry )
+        {
+            if (other == worker) continue;
+            if ((object = tp_queue_pop( &other->queue, i ))) break;
+        }
+        RtlReleaseSRWLockShared( &pool->workers_lock );
+
+        if (object)
+        {
+            *queue = &worker->queue;
+            return object;
+        }
     }
 
-    return ptr;
+    return NULL;
 }
 
 /***********************************************************************
  *           tp_object_execute    (internal)
  *
- * Executes a threadpool object callback, object->pool->cs has to be
- * held.
+ * Executes a threadpool object callback, object->lock has to be held.
  */
 static void tp_object_execute( struct threadpool_object *object, BOOL wait_thread )
 {
     TP_CALLBACK_INSTANCE *callback_instance;
     struct threadpool_instance instance;
     struct io_completion completion;
-    struct threadpool *pool = object->pool;
     TP_WAIT_RESULT wait_result = 0;
     NTSTATUS status;
 
@@ -2183,10 +2606,10 @@ static void tp_object_execute( struct threadpool_object *object, BOOL wait_threa
         completion = object->u.io.completions[--object->u.io.completion_count];
     }
 
-    /* Leave critical section and do the actual callback. */
+    /* Release the lock and do the actual callback. */
     object->num_associated_callbacks++;
     object->num_running_callbacks++;
-    RtlLeaveCriticalSection( &pool->cs );
+    RtlReleaseSRWLockExclusive( &object->lock );
     if (wait_thread) RtlLeaveCriticalSection( &waitqueue.cs );
 
     /* Initialize threadpool instance struct. */
@@ -2292,7 +2715,7 @@ static void tp_object_execute( struct threadpool_object *object, BOOL wait_threa
 
 skip_cleanup:
     if (wait_thread) RtlEnterCriticalSection( &waitqueue.cs );
-    RtlEnterCriticalSection( &pool->cs );
+    RtlAcquireSRWLockExclusive( &object->lock );
 
     /* Simple callbacks are automatically shutdown after execution. */
     if (object->type == TP_OBJECT_TYPE_SIMPLE)
@@ -2313,59 +2736,114 @@ skip_cleanup:
     }
 }
 
+/***********************************************************************
+ *           threadpool_worker_run    (internal)
+ *
+ * Runs a pending callback of an object taken from a queue, and releases
+ * the queue reference.
+ */
+static void threadpool_worker_run( struct threadpool_worker *worker, struct threadpool_object *object,
+                                   struct threadpool_queue *queue )
+{
+    struct threadpool *pool = worker->pool;
+    BOOL executed = FALSE;
+
+    RtlAcquireSRWLockExclusive( &object->lock );
+
+    /* The callbacks may have been canceled since the object was unlinked. */
+    if (object->num_pending_callbacks)
+    {
+        /* If further pending callbacks are queued, move the work item to
+         * the end of the queue, so that other workers can pick it up. */
+        if (object->num_pending_callbacks > 1 && !object->queue)
+        {
+            tp_queue_push( queue, object );
+            tp_threadpool_wake( pool );
+        }
+
+        InterlockedIncrement( &pool->num_busy_workers );
+        tp_object_execute( object, FALSE );
+        InterlockedDecrement( &pool->num_busy_workers );
+        executed = TRUE;
+    }
+
+    RtlReleaseSRWLockExclusive( &object->lock );
+
+    if (executed) tp_object_release( object );
+    tp_object_release( object );
+}
+
 /***********************************************************************
  *           threadpool_worker_proc    (internal)
  */
 static void CALLBACK threadpool_worker_proc( void *param )
 {
-    struct threadpool *pool = param;
+    struct threadpool_worker *worker = param;
+    struct threadpool *pool = worker->pool;
+    struct threadpool_object *object;
+    struct threadpool_queue *queue;
     LARGE_INTEGER timeout;
-    struct list *ptr;
+    NTSTATUS status;
 
     TRACE( "starting worker thread for pool %p\n", pool );
 
-    RtlEnterCriticalSection( &pool->cs );
+    NtCurrentTeb()->ThreadPoolData = worker;
+    InterlockedDecrement( &pool->num_starting_workers );
+
     for (;;)
     {
-        while ((ptr = threadpool_get_next_item( pool )))
-        {
-            struct threadpool_object *object = LIST_ENTRY( ptr, struct threadpool_object, pool_entry );
-            assert( object->num_pending_callbacks > 0 );
-
-            /* If further pending callbacks are queued, move the work item to
-             * the end of the pool list. Otherwise remove it from the pool. */
-            list_remove( &object->pool_entry );
-            if (object->num_pending_callbacks > 1)
-                tp_object_prio_queue( object );
+        while ((object = threadpool_get_next_item( worker, &queue )))
+            threadpool_worker_run( worker, object, queue );
 
-            tp_object_execute( object, FALSE );
-
-            assert(pool->num_busy_workers);
-            pool->num_busy_workers--;
-
-            tp_object_release( object );
-        }
+        RtlEnterCriticalSection( &pool->cs );
 
         /* Shutdown worker thread if requested. */
         if (pool->shutdown)
             break;
 
-        /* Wait for new tasks or until the timeout expires. A thread only terminates
-         * when no new tasks are available, and the number of threads can be
-         * decreased without violating the min_workers limit. An exception is when
-         * min_workers == 0, then objcount is used to detect if the last thread
-         * can be terminated. */
-        timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
-        if (RtlSleepConditionVariableCS( &pool->update_event, &pool->cs, &timeout ) == STATUS_TIMEOUT &&
-            !threadpool_get_next_item( pool ) && (pool->num_workers > max( pool->min_workers, 1 ) ||
+        /* Wait for new tasks or until the timeout expires. The queues are
+         * checked again after marking the worker idle, submitters check
+         * for idle workers after queuing. */
+        list_add_tail( &pool->idle_workers, &worker->idle_entry );
+        worker->idle = TRUE;
+        InterlockedIncrement( &pool->num_idle_workers );
+
+        status = STATUS_SUCCESS;
+        if (!pool->num_queued)
+        {
+            timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
+            status = RtlSleepConditionVariableCS( &worker->wake_event, &pool->cs, &timeout );
+        }
+        if (worker->idle)
+        {
+            list_remove( &worker->idle_entry );
+            worker->idle = FALSE;
+            InterlockedDecrement( &pool->num_idle_workers );
+        }
+
+        /* A thread only terminates when no new tasks are available, and the
+         * number of threads can be decreased without violating the min_workers
+         * limit. An exception is when min_workers == 0, then objcount is used
+         * to detect if the last thread can be terminated. */
+        if (status == STATUS_TIMEOUT && !pool->num_queued &&
+            (pool->num_workers > max( pool->min_workers, 1 ) ||
             (!pool->min_workers && !pool->objcount)))
         {
             break;
         }
+        RtlLeaveCriticalSection( &pool->cs );
     }
     pool->num_workers--;
     RtlLeaveCriticalSection( &pool->cs );
 
+    /* Nothing can be queued to a worker outside of its callbacks. */
+    RtlAcquireSRWLockExclusive( &pool->workers_lock );
+    list_remove( &worker->entry );
+    RtlReleaseSRWLockExclusive( &pool->workers_lock );
+    assert( !worker->queue.count );
+    NtCurrentTeb()->ThreadPoolData = NULL;
+    RtlFreeHeap( GetProcessHeap(), 0, worker );
+
     TRACE( "terminating worker thread for pool %p\n", pool );
     tp_threadpool_release( pool );
     RtlExitUserThread( 0 );
@@ -2564,7 +3042,7 @@ void WINAPI TpCancelAsyncIoOperation( TP_IO *io )
 
     TRACE( "%p\n", io );
 
-    RtlEnterCriticalSection( &this->pool->cs );
+    RtlAcquireSRWLockExclusive( &this->lock );
 
     TRACE("pending_count %u.\n", this->u.io.pending_count);
 
@@ -2574,7 +3052,7 @@ void WINAPI TpCancelAsyncIoOperation( TP_IO *io )
     if (object_is_finished( this, FALSE ))
         RtlWakeAllConditionVariable( &this->finished_event );
 
-    RtlLeaveCriticalSection( &this->pool->cs );
+    RtlReleaseSRWLockExclusive( &this->lock );
 }
 
 /***********************************************************************
@@ -2615,7 +3093,7 @@ NTSTATUS WINAPI TpCallbackMayRunLong( TP_CALLBACK_INSTANCE *instance )
     RtlEnterCriticalSection( &pool->cs );
 
     /* Start new worker threads if required. */
-    if (pool->num_busy_workers >= pool->num_workers)
+    if (pool->num_busy_workers + pool->num_queued >= pool->num_workers)
     {
         if (pool->num_workers < pool->max_workers)
         {
@@ -2694,7 +3172,6 @@ VOID WINAPI TpDisassociateCallback( TP_CALLBACK_INSTANCE *instance )
 {
     struct threadpool_instance *this = impl_from_TP_CALLBACK_INSTANCE( instance );
     struct threadpool_object *object = this->object;
-    struct threadpool *pool;
 
     TRACE( "%p\n", instance );
 
@@ -2707,14 +3184,13 @@ VOID WINAPI TpDisassociateCallback( TP_CALLBACK_INSTANCE *instance )
     if (!this->associated)
         return;
 
-    pool = object->pool;
-    RtlEnterCriticalSection( &pool->cs );
+    RtlAcquireSRWLockExclusive( &object->lock );
 
     object->num_associated_callbacks--;
     if (object_is_finished( object, FALSE ))
         RtlWakeAllConditionVariable( &object->finished_event );
 
-    RtlLeaveCriticalSection( &pool->cs );
+    RtlReleaseSRWLockExclusive( &object->lock );
     this->associated = FALSE;
 }
 
@@ -2838,10 +3314,10 @@ void WINAPI TpReleaseIoCompletion( TP_IO *io )
 
     TRACE( "%p\n", io );
 
-    RtlEnterCriticalSection( &this->pool->cs );
+    RtlAcquireSRWLockExclusive( &this->lock );
     this->u.io.shutting_down = TRUE;
     can_destroy = !this->u.io.pending_count && !this->u.io.skipped_count;
-    RtlLeaveCriticalSection( &this->pool->cs );
+    RtlReleaseSRWLockExclusive( &this->lock );
 
     if (can_destroy)
     {
@@ -2956,7 +3432,6 @@ BOOL WINAPI TpSetPoolMinThreads( TP_POOL *pool, DWORD minimum )
 VOID WINAPI TpSetTimer( TP_TIMER *timer, LARGE_INTEGER *timeout, LONG period, LONG window_length )
 {
     struct threadpool_object *this = impl_from_TP_TIMER( timer );
-    struct threadpool_object *other_timer;
     BOOL submit_timer = FALSE;
     ULONGLONG timestamp;
 
@@ -2995,7 +3470,7 @@ VOID WINAPI TpSetTimer( TP_TIMER *timer, LARGE_INTEGER *timeout, LONG period, LO
     /* First remove existing timeout. */
     if (this->u.timer.timer_pending)
     {
-        list_remove( &this->u.timer.timer_entry );
+        timer_heap_remove( &timerqueue.pending_timers, &this->u.timer.timer_entry );
         this->u.timer.timer_pending = FALSE;
     }
 
@@ -3006,17 +3481,10 @@ VOID WINAPI TpSetTimer( TP_TIMER *timer, LARGE_INTEGER *timeout, LONG period, LO
         this->u.timer.period        = period;
         this->u.timer.window_length = window_length;
 
-        LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
-                             struct threadpool_object, u.timer.timer_entry )
-        {
-            assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
-            if (this->u.timer.timeout < other_timer->u.timer.timeout)
-                break;
-        }
-        list_add_before( &other_timer->u.timer.timer_entry, &this->u.timer.timer_entry );
+        timer_heap_insert( &timerqueue.pending_timers, &this->u.timer.timer_entry, timestamp );
 
         /* Wake up the timer thread when the timeout has to be updated. */
-        if (list_head( &timerqueue.pending_timers ) == &this->u.timer.timer_entry )
+        if (timer_heap_head( &timerqueue.pending_timers ) == &this->u.timer.timer_entry)
             RtlWakeAllConditionVariable( &timerqueue.update_event );
 
         this->u.timer.timer_pending = TRUE;
@@ -3119,11 +3587,11 @@ void WINAPI TpStartAsyncIoOperation( TP_IO *io )
 
     TRACE( "%p\n", io );
 
-    RtlEnterCriticalSection( &this->pool->cs );
+    RtlAcquireSRWLockExclusive( &this->lock );
 
     this->u.io.pending_count++;
 
-    RtlLeaveCriticalSection( &this->pool->cs );
+    RtlReleaseSRWLockExclusive( &this->lock );
 }
 
 /***********************************************************************
@@ -3315,11 +3783,11 @@ NTSTATUS WINAPI RtlDeregisterWaitEx( HANDLE handle, HANDLE event )
         object->completed_event = event;
     }
 
-    RtlEnterCriticalSection( &object->pool->cs );
+    RtlAcquireSRWLockExclusive( &object->lock );
     if (object->num_pending_callbacks + object->num_running_callbacks
         + object->num_associated_callbacks) status = STATUS_PENDING;
     else status = STATUS_SUCCESS;
-    RtlLeaveCriticalSection( &object->pool->cs );
+    RtlReleaseSRWLockExclusive( &object->lock );
 
     TpReleaseWait( (TP_WAIT *)object );
     return status;
@@ -229,6 +229,39 @@ static const BOOL is_case_sensitive = FALSE;
 static pthread_mutex_t dir_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t mnt_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+/* cache of directory contents for case-insensitive lookups */
+
+struct dir_cache_name
+{
+    unsigned int           next;        /* next name in the hash chain, plus one */
+    unsigned int           name;        /* offset of the Unicode name */
+    unsigned int           unix_name;   /* offset of the Unix name */
+    unsigned short         len;         /* length of the Unicode name */
+    unsigned short         is_short;    /* is this a generated short name? */
+};
+
+struct dir_cache
+{
+    struct list            entry;       /* entry in the cache list, most recently used first */
+    struct file_identity   id;          /* directory file identity */
+    time_t                 mtime;       /* directory modification time */
+    long                   mtime_nsec;
+    unsigned int           count;       /* count of names */
+    unsigned int           hash_mask;   /* size of the hash table minus one */
+    unsigned int          *hash;        /* hash table, index of the first name in the chain plus one */
+    struct dir_cache_name *names;       /* file names */
+    WCHAR                 *wnames;      /* buffer of Unicode names */
+    char                  *unix_names;  /* buffer of Unix names */
+};
+
+static const unsigned int dir_cache_max_dirs = 64;
+
+static struct list dir_cache_list = LIST_INIT( dir_cache_list );
+static unsigned int dir_cache_count;
+static unsigned int dir_cache_hits;
+static unsigned int dir_cache_misses;
+static pthread_mutex_t dir_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 /* check if a given Unicode char is OK in a DOS short name */
 static inline BOOL is_invalid_dos_char( WCHAR ch )
 {
@@ -2473,6 +2506,200 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event, PIO_APC_ROUTI
 }
 
 
+/***********************************************************************
+ *           dir_cache_hash
+ */
+static unsigned int dir_cache_hash( const WCHAR *name, int length )
+{
+    unsigned int hash = 0;
+    while (length--) hash = hash * 31 + ntdll_towupper( *name++ );
+    return hash;
+}
+
+
+static void free_dir_cache( struct dir_cache *cache )
+{
+    free( cache->hash );
+    free( cache->names );
+    free( cache->wnames );
+    free( cache->unix_names );
+    free( cache );
+}
+
+
+/***********************************************************************
+ *           load_dir_cache
+ *
+ * Read the contents of a directory into a new cache entry.
+ */
+static struct dir_cache *load_dir_cache( const char *unix_name, const struct stat *st )
+{
+    unsigned int i, size = 0, wsize = 0, usize = 0, wpos = 0, upos = 0;
+    struct dir_cache_name *name;
+    struct dir_cache *cache;
+    struct dirent *de;
+    WCHAR buffer[MAX_DIR_ENTRY_LEN], short_nameW[12];
+    DIR *dir;
+    int len, short_len, unix_len;
+
+    if (!(dir = opendir( unix_name ))) return NULL;
+    if (!(cache = calloc( 1, sizeof(*cache) ))) goto failed;
+    cache->id.dev = st->st_dev;
+    cache->id.ino = st->st_ino;
+    cache->mtime = st->st_mtime;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    cache->mtime_nsec = st->st_mtim.tv_nsec;
+#endif
+
+    while ((de = readdir( dir )))
+    {
+        unix_len = strlen( de->d_name ) + 1;
+        len = ntdll_umbstowcs( de->d_name, unix_len - 1, buffer, MAX_DIR_ENTRY_LEN );
+        short_len = is_legal_8dot3_name( buffer, len ) ? 0 : hash_short_file_name( buffer, len, short_nameW );
+
+        if (cache->count + 2 > size)
+        {
+            size = max( 64, size * 2 );
+            if (!(name = realloc( cache->names, size * sizeof(*name) ))) goto failed;
+            cache->names = name;
+        }
+        if (wpos + len + short_len > wsize)
+        {
+            WCHAR *wnames;
+            wsize = max( wpos + len + short_len, max( 1024, wsize * 2 ));
+            if (!(wnames = realloc( cache->wnames, wsize * sizeof(WCHAR) ))) goto failed;
+            cache->wnames = wnames;
+        }
+        if (upos + unix_len > usize)
+        {
+            char *unix_names;
+            usize = max( upos + unix_len, max( 4096, usize * 2 ));
+            if (!(unix_names = realloc( cache->unix_names, usize ))) goto failed;
+            cache->unix_names = unix_names;
+        }
+
+        name = &cache->names[cache->count++];
+        name->name = wpos;
+        name->unix_name = upos;
+        name->len = len;
+        name->is_short = FALSE;
+        memcpy( cache->wnames + wpos, buffer, len * sizeof(WCHAR) );
+        wpos += len;
+        if (short_len)
+        {
+            name = &cache->names[cache->count++];
+            name->name = wpos;
+            name->unix_name = upos;
+            name->len = short_len;
+            name->is_short = TRUE;
+            memcpy( cache->wnames + wpos, short_nameW, short_len * sizeof(WCHAR) );
+            wpos += short_len;
+        }
+        memcpy( cache->unix_names + upos, de->d_name, unix_len );
+        upos += unix_len;
+    }
+    closedir( dir );
+
+    for (size = 16; size < cache->count; size *= 2) /* nothing */;
+    if (!(cache->hash = calloc( size, sizeof(*cache->hash) )))
+    {
+        free_dir_cache( cache );
+        return NULL;
+    }
+    cache->hash_mask = size - 1;
+    /* insert in reverse order so that the chains preserve the directory order */
+    for (i = cache->count; i > 0; i--)
+    {
+        unsigned int hash;
+
+        name = &cache->names[i - 1];
+        hash = dir_cache_hash( cache->wnames + name->name, name->len ) & cache->hash_mask;
+        name->next = cache->hash[hash];
+        cache->hash[hash] = i;
+    }
+    return cache;
+
+failed:
+    closedir( dir );
+    if (cache) free_dir_cache( cache );
+    return NULL;
+}
+
+
+/***********************************************************************
+ *           get_dir_cache
+ *
+ * Retrieve the up to date cache entry for a directory, loading it if needed.
+ * Must be called with dir_cache_mutex held.
+ */
+static struct dir_cache *get_dir_cache( const char *unix_name )
+{
+    struct dir_cache *cache;
+    struct stat st;
+    long mtime_nsec = 0;
+
+    if (stat( unix_name, &st ) == -1 || !S_ISDIR( st.st_mode )) return NULL;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    mtime_nsec = st.st_mtim.tv_nsec;
+#endif
+
+    LIST_FOR_EACH_ENTRY( cache, &dir_cache_list, struct dir_cache, entry )
+    {
+        if (cache->id.dev != st.st_dev || cache->id.ino != st.st_ino) continue;
+        list_remove( &cache->entry );
+        if (cache->mtime == st.st_mtime && cache->mtime_nsec == mtime_nsec)
+        {
+            list_add_head( &dir_cache_list, &cache->entry );
+            dir_cache_hits++;
+            return cache;
+        }
+        dir_cache_count--;
+        free_dir_cache( cache );
+        break;
+    }
+
+    dir_cache_misses++;
+    TRACE( "%s: %u hits, %u misses\n", debugstr_a(unix_name), dir_cache_hits, dir_cache_misses );
+
+    /* a directory modified in the last second may still change without its mtime being updated */
+    if (st.st_mtime >= time( NULL ) - 1) return NULL;
+
+    if (!(cache = load_dir_cache( unix_name, &st ))) return NULL;
+    list_add_head( &dir_cache_list, &cache->entry );
+    if (++dir_cache_count > dir_cache_max_dirs)
+    {
+        struct dir_cache *oldest = LIST_ENTRY( list_tail( &dir_cache_list ), struct dir_cache, entry );
+        list_remove( &oldest->entry );
+        free_dir_cache( oldest );
+        dir_cache_count--;
+    }
+    return cache;
+}
+
+
+/***********************************************************************
+ *           find_dir_cache_name
+ *
+ * Look for a name in a directory cache entry; long names take precedence over short names.
+ */
+static const char *find_dir_cache_name( const struct dir_cache *cache, const WCHAR *name, int length,
+                                        BOOLEAN check_short )
+{
+    const struct dir_cache_name *entry;
+    const char *short_match = NULL;
+    unsigned int index = cache->hash[dir_cache_hash( name, length ) & cache->hash_mask];
+
+    for ( ; index; index = entry->next)
+    {
+        entry = &cache->names[index - 1];
+        if (entry->len != length || wcsnicmp( cache->wnames + entry->name, name, length )) continue;
+        if (!entry->is_short) return cache->unix_names + entry->unix_name;
+        if (check_short && !short_match) short_match = cache->unix_names + entry->unix_name;
+    }
+    return short_match;
+}
+
+
 /***********************************************************************
  *           find_file_in_dir
  *
@@ -2485,6 +2712,8 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
 {
     WCHAR buffer[MAX_DIR_ENTRY_LEN];
     BOOLEAN is_name_8_dot_3;
+    struct dir_cache *cache;
+    const char *found;
     DIR *dir;
     struct dirent *de;
     struct stat st;
@@ -2563,6 +2792,20 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
     }
 #endif /* VFAT_IOCTL_READDIR_BOTH */
 
+    mutex_lock( &dir_cache_mutex );
+    if ((cache = get_dir_cache( unix_name )))
+    {
+        if ((found = find_dir_cache_name( cache, name, length, is_name_8_dot_3 )))
+        {
+            unix_name[pos - 1] = '/';
+            strcpy( unix_name + pos, found );
+        }
+        mutex_unlock( &dir_cache_mutex );
+        if (found) return STATUS_SUCCESS;
+        goto not_found;
+    }
+    mutex_unlock( &dir_cache_mutex );
+
     if (!(dir = opendir( unix_name ))) return errno_to_status( errno );
 
     unix_name[pos - 1] = '/';
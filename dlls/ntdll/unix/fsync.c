@@ -0,0 +1,480 @@
+/*
+ * Fast synchronization objects in shared memory
+ *
+ * Copyright 2026 The Wine Project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#if 0
+#pragma makedep unix
+#endif
+
+#include "config.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#ifdef HAVE_SYS_SYSCALL_H
+#include <sys/syscall.h>
+#endif
+#include <unistd.h>
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winternl.h"
+#include "wine/server.h"
+#include "wine/debug.h"
+#include "unix_private.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(sync);
+
+/* The functions below return STATUS_NOT_IMPLEMENTED when the handle isn't a
+ * fast synchronization object, in which case the caller uses the server. */
+
+#ifdef __linux__
+
+#define FUTEX_WAIT 0
+#define FUTEX_WAKE 1
+
+#ifndef __NR_futex_waitv
+#define __NR_futex_waitv 449
+#endif
+#define FUTEX2_SIZE_U32 0x02
+
+struct futex_waitv
+{
+    UINT64 val;
+    UINT64 uaddr;
+    UINT32 flags;
+    UINT32 __reserved;
+};
+
+static int have_futex_waitv = -1;
+
+/* the objects live in a shared mapping, so we can't use private futexes */
+static inline int futex_wait( int *addr, int val, struct timespec *timeout )
+{
+    return syscall( __NR_futex, addr, FUTEX_WAIT, val, timeout, 0, 0 );
+}
+
+static inline int futex_wake( int *addr, int count )
+{
+    return syscall( __NR_futex, addr, FUTEX_WAKE, count, NULL, 0, 0 );
+}
+
+static inline int futex_waitv( struct futex_waitv *waiters, unsigned int count, struct timespec *end )
+{
+    return syscall( __NR_futex_waitv, waiters, count, 0, end, CLOCK_MONOTONIC );
+}
+
+static inline int get_tid(void)
+{
+    return HandleToULong( NtCurrentTeb()->ClientId.UniqueThread );
+}
+
+/* The server abandons the mutexes of a dying thread from its owned list, so a
+ * mutex is added to the list before being acquired, and removed after being
+ * released. Entries may thus be stale, which the server checks for. */
+static void add_owned_mutex( struct fsync_thread *owned, unsigned int index )
+{
+    owned->owned[owned->count] = index;
+    __atomic_store_n( &owned->count, owned->count + 1, __ATOMIC_SEQ_CST );
+}
+
+static void remove_owned_mutex( struct fsync_thread *owned, unsigned int index )
+{
+    int i;
+
+    for (i = owned->count - 1; i >= 0; i--)
+    {
+        if (owned->owned[i] != index) continue;
+        owned->owned[i] = owned->owned[owned->count - 1];
+        __atomic_store_n( &owned->count, owned->count - 1, __ATOMIC_SEQ_CST );
+        break;
+    }
+}
+
+static struct fsync_object *get_object( HANDLE handle, enum fsync_type wanted_type,
+                                        unsigned int wanted_access, NTSTATUS *status )
+{
+    struct fsync_object *obj;
+    enum fsync_type type;
+    unsigned int access;
+
+    *status = STATUS_NOT_IMPLEMENTED;
+    if (!(obj = server_get_fsync_object( handle, &type, &access, NULL ))) return NULL;
+    if (type != wanted_type)
+    {
+        *status = STATUS_OBJECT_TYPE_MISMATCH;
+        return NULL;
+    }
+    if ((access & wanted_access) != wanted_access)
+    {
+        *status = STATUS_ACCESS_DENIED;
+        return NULL;
+    }
+    *status = STATUS_SUCCESS;
+    return obj;
+}
+
+/* let the server wake up its own waiters after we changed the object state */
+static void wake_server_waiters( HANDLE handle, struct fsync_object *obj )
+{
+    if (!__atomic_load_n( &obj->waiters, __ATOMIC_SEQ_CST )) return;
+
+    SERVER_START_REQ( fsync_wake )
+    {
+        req->handle = wine_server_obj_handle( handle );
+        wine_server_call( req );
+    }
+    SERVER_END_REQ;
+}
+
+
+NTSTATUS fsync_set_event( HANDLE handle, LONG *prev_state )
+{
+    struct fsync_object *obj;
+    NTSTATUS status;
+    int state;
+
+    if (!(obj = get_object( handle, FSYNC_EVENT, EVENT_MODIFY_STATE, &status ))) return status;
+
+    /* bump the set count, so that waiters notice even if the event gets reset right away */
+    state = __atomic_load_n( &obj->state, __ATOMIC_SEQ_CST );
+    while (!(state & FSYNC_EVENT_SIGNALED) &&
+           !__atomic_compare_exchange_n( &obj->state, &state,
+                                         (state + FSYNC_EVENT_SET_COUNT) | FSYNC_EVENT_SIGNALED,
+                                         0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ));
+
+    if (!(state & FSYNC_EVENT_SIGNALED))
+    {
+        futex_wake( &obj->state, obj->extra ? INT_MAX : 1 );
+        wake_server_waiters( handle, obj );
+    }
+    if (prev_state) *prev_state = state & FSYNC_EVENT_SIGNALED;
+    return STATUS_SUCCESS;
+}
+
+
+NTSTATUS fsync_reset_event( HANDLE handle, LONG *prev_state )
+{
+    struct fsync_object *obj;
+    NTSTATUS status;
+    int prev;
+
+    if (!(obj = get_object( handle, FSYNC_EVENT, EVENT_MODIFY_STATE, &status ))) return status;
+
+    prev = __atomic_fetch_and( &obj->state, ~FSYNC_EVENT_SIGNALED, __ATOMIC_SEQ_CST );
+    if (prev_state) *prev_state = prev & FSYNC_EVENT_SIGNALED;
+    return STATUS_SUCCESS;
+}
+
+
+NTSTATUS fsync_query_event( HANDLE handle, EVENT_BASIC_INFORMATION *info )
+{
+    struct fsync_object *obj;
+    NTSTATUS status;
+
+    if (!(obj = get_object( handle, FSYNC_EVENT, EVENT_QUERY_STATE, &status ))) return status;
+
+    info->EventType  = obj->extra ? NotificationEvent : SynchronizationEvent;
+    info->EventState = __atomic_load_n( &obj->state, __ATOMIC_SEQ_CST ) & FSYNC_EVENT_SIGNALED;
+    return STATUS_SUCCESS;
+}
+
+
+NTSTATUS fsync_release_semaphore( HANDLE handle, ULONG count, ULONG *previous )
+{
+    struct fsync_object *obj;
+    NTSTATUS status;
+    ULONG current;
+
+    if (!(obj = get_object( handle, FSYNC_SEMAPHORE, SEMAPHORE_MODIFY_STATE, &status ))) return status;
+
+    current = __atomic_load_n( &obj->state, __ATOMIC_SEQ_CST );
+    do
+    {
+        if (current + count < current || current + count > (ULONG)obj->extra)
+            return STATUS_SEMAPHORE_LIMIT_EXCEEDED;
+    } while (!__atomic_compare_exchange_n( &obj->state, (int *)&current, current + count, 0,
+                                           __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ));
+
+    if (!current)
+    {
+        futex_wake( &obj->state, count );
+        wake_server_waiters( handle, obj );
+    }
+    if (previous) *previous = current;
+    return STATUS_SUCCESS;
+}
+
+
+NTSTATUS fsync_query_semaphore( HANDLE handle, SEMAPHORE_BASIC_INFORMATION *info )
+{
+    struct fsync_object *obj;
+    NTSTATUS status;
+
+    if (!(obj = get_object( handle, FSYNC_SEMAPHORE, SEMAPHORE_QUERY_STATE, &status ))) return status;
+
+    info->CurrentCount = __atomic_load_n( &obj->state, __ATOMIC_SEQ_CST );
+    info->MaximumCount = obj->extra;
+    return STATUS_SUCCESS;
+}
+
+
+NTSTATUS fsync_release_mutex( HANDLE handle, LONG *prev_count )
+{
+    struct fsync_thread *owned = ntdll_get_thread_data()->fsync_thread;
+    struct fsync_object *obj;
+    unsigned int index;
+    enum fsync_type type;
+    unsigned int access;
+
+    if (!(obj = server_get_fsync_object( handle, &type, &access, &index ))) return STATUS_NOT_IMPLEMENTED;
+    if (type != FSYNC_MUTEX) return STATUS_OBJECT_TYPE_MISMATCH;
+
+    if (__atomic_load_n( &obj->state, __ATOMIC_SEQ_CST ) != get_tid()) return STATUS_MUTANT_NOT_OWNED;
+
+    if (prev_count) *prev_count = 1 - obj->extra;
+    if (!--obj->extra)
+    {
+        __atomic_store_n( &obj->state, 0, __ATOMIC_SEQ_CST );
+        if (owned) remove_owned_mutex( owned, index );
+        futex_wake( &obj->state, 1 );
+        wake_server_waiters( handle, obj );
+    }
+    return STATUS_SUCCESS;
+}
+
+
+NTSTATUS fsync_query_mutex( HANDLE handle, MUTANT_BASIC_INFORMATION *info )
+{
+    struct fsync_object *obj;
+    NTSTATUS status;
+    int owner;
+
+    if (!(obj = get_object( handle, FSYNC_MUTEX, MUTANT_QUERY_STATE, &status ))) return status;
+
+    owner = __atomic_load_n( &obj->state, __ATOMIC_SEQ_CST );
+    info->CurrentCount   = 1 - ((owner && owner != FSYNC_MUTEX_ABANDONED) ? obj->extra : 0);
+    info->OwnedByCaller  = (owner == get_tid());
+    info->AbandonedState = (owner == FSYNC_MUTEX_ABANDONED);
+    return STATUS_SUCCESS;
+}
+
+
+/* try to acquire the object; return 1 on success, 2 for an abandoned mutex, 0 if not signaled */
+/* the observed state is returned in *state, for use as the futex value */
+static int try_acquire( struct fsync_object *obj, unsigned int index, struct fsync_thread *owned,
+                        int tid, int *state )
+{
+    int cur = __atomic_load_n( &obj->state, __ATOMIC_SEQ_CST );
+
+    for (;;)
+    {
+        *state = cur;
+        switch (obj->type)
+        {
+        case FSYNC_EVENT:
+            if (!(cur & FSYNC_EVENT_SIGNALED)) return 0;
+            if (obj->extra) return 1;
+            if (__atomic_compare_exchange_n( &obj->state, &cur, cur & ~FSYNC_EVENT_SIGNALED, 0,
+                                             __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ))
+                return 1;
+            break;
+        case FSYNC_SEMAPHORE:
+            if (!cur) return 0;
+            if (__atomic_compare_exchange_n( &obj->state, &cur, cur - 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ))
+                return 1;
+            break;
+        case FSYNC_MUTEX:
+            if (cur == tid)
+            {
+                obj->extra++;
+                return 1;
+            }
+            if (cur && cur != FSYNC_MUTEX_ABANDONED) return 0;
+            add_owned_mutex( owned, index );
+            if (__atomic_compare_exchange_n( &obj->state, &cur, tid, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ))
+            {
+                obj->extra = 1;
+                return *state ? 2 : 1;
+            }
+            remove_owned_mutex( owned, index );
+            break;
+        default:
+            return 0;
+        }
+    }
+}
+
+
+/* check whether an event has been set or pulsed since the wait started, and
+ * whether that satisfies the wait even though the event isn't signaled anymore */
+static BOOL event_was_set( struct fsync_object *obj, int start_state )
+{
+    int state = __atomic_load_n( &obj->state, __ATOMIC_SEQ_CST ), pulse;
+
+    if (obj->type != FSYNC_EVENT) return FALSE;
+    if ((state & ~FSYNC_EVENT_SIGNALED) == (start_state & ~FSYNC_EVENT_SIGNALED)) return FALSE;
+
+    /* all the waiters of a manual-reset event are released when it gets set */
+    if (obj->extra) return TRUE;
+
+    /* a pulse of an auto-reset event releases a single waiter, the one claiming it */
+    pulse = __atomic_load_n( &obj->pulse, __ATOMIC_SEQ_CST );
+    if (!pulse || (int)((pulse & ~FSYNC_EVENT_SIGNALED) - (start_state & ~FSYNC_EVENT_SIGNALED)) <= 0)
+        return FALSE;
+    return __atomic_compare_exchange_n( &obj->pulse, &pulse, 0, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST );
+}
+
+
+/* wait for any of the objects to be signaled; only non-alertable waits are handled here
+ *
+ * The futex waits are not interruptible by server calls, but system APCs and
+ * thread suspension are delivered with SIGUSR1, whose handler processes them
+ * through the server (see wait_suspend()) before the wait is resumed. */
+NTSTATUS fsync_wait_objects( DWORD count, const HANDLE *handles, BOOLEAN wait_any,
+                             BOOLEAN alertable, const LARGE_INTEGER *timeout )
+{
+    struct fsync_object *objs[MAXIMUM_WAIT_OBJECTS];
+    struct futex_waitv waiters[MAXIMUM_WAIT_OBJECTS];
+    unsigned int indices[MAXIMUM_WAIT_OBJECTS];
+    int start_states[MAXIMUM_WAIT_OBJECTS];
+    int states[MAXIMUM_WAIT_OBJECTS];
+    struct fsync_thread *owned = NULL;
+    LONGLONG end = 0;
+    enum fsync_type type;
+    unsigned int access;
+    DWORD i;
+    int tid, ret;
+
+    if (alertable || (!wait_any && count > 1)) return STATUS_NOT_IMPLEMENTED;
+    if (count > 1 && !have_futex_waitv) return STATUS_NOT_IMPLEMENTED;
+
+    tid = get_tid();
+    for (i = 0; i < count; i++)
+    {
+        if (!(objs[i] = server_get_fsync_object( handles[i], &type, &access, &indices[i] )))
+            return STATUS_NOT_IMPLEMENTED;
+        if (!(access & SYNCHRONIZE)) return STATUS_ACCESS_DENIED;
+        if (type != FSYNC_MUTEX || owned) continue;
+        /* we need room to record the mutex before acquiring it, otherwise let the server do it */
+        if (!(owned = server_get_fsync_thread()) || owned->count >= FSYNC_MAX_OWNED)
+            return STATUS_NOT_IMPLEMENTED;
+    }
+
+    if (timeout && timeout->QuadPart != TIMEOUT_INFINITE)
+    {
+        LARGE_INTEGER now;
+
+        NtQueryPerformanceCounter( &now, NULL );
+        if (timeout->QuadPart < 0) end = now.QuadPart - timeout->QuadPart;
+        else
+        {
+            LARGE_INTEGER systime;
+            NtQuerySystemTime( &systime );
+            end = now.QuadPart + max( timeout->QuadPart - systime.QuadPart, 0 );
+        }
+    }
+    else timeout = NULL;
+
+    for (i = 0; i < count; i++) start_states[i] = __atomic_load_n( &objs[i]->state, __ATOMIC_SEQ_CST );
+
+    for (;;)
+    {
+        struct timespec ts, *tsp = NULL;
+
+        for (i = 0; i < count; i++)
+        {
+            if (!(ret = try_acquire( objs[i], indices[i], owned, tid, &states[i] )) &&
+                !event_was_set( objs[i], start_states[i] ))
+                continue;
+            TRACE( "acquired %p\n", handles[i] );
+            return ret == 2 ? STATUS_ABANDONED_WAIT_0 + i : STATUS_WAIT_0 + i;
+        }
+
+        if (timeout)
+        {
+            LARGE_INTEGER now;
+            LONGLONG diff;
+
+            NtQueryPerformanceCounter( &now, NULL );
+            if ((diff = end - now.QuadPart) <= 0)
+            {
+                NtYieldExecution();
+                return STATUS_TIMEOUT;
+            }
+            ts.tv_sec  = diff / TICKSPERSEC;
+            ts.tv_nsec = (diff % TICKSPERSEC) * 100;
+            tsp = &ts;
+        }
+
+        if (count == 1)
+        {
+            futex_wait( &objs[0]->state, states[0], tsp );
+            continue;
+        }
+
+        for (i = 0; i < count; i++)
+        {
+            waiters[i].val = states[i];
+            waiters[i].uaddr = (ULONG_PTR)&objs[i]->state;
+            waiters[i].flags = FUTEX2_SIZE_U32;
+            waiters[i].__reserved = 0;
+        }
+        if (tsp)
+        {
+            struct timespec now;
+
+            clock_gettime( CLOCK_MONOTONIC, &now );
+            ts.tv_sec += now.tv_sec;
+            ts.tv_nsec += now.tv_nsec;
+            if (ts.tv_nsec >= 1000000000)
+            {
+                ts.tv_nsec -= 1000000000;
+                ts.tv_sec++;
+            }
+        }
+        if (futex_waitv( waiters, count, tsp ) == -1 && errno == ENOSYS)
+        {
+            /* nothing has been acquired yet, let the server handle it */
+            have_futex_waitv = 0;
+            return STATUS_NOT_IMPLEMENTED;
+        }
+    }
+}
+
+#else  /* __linux__ */
+
+NTSTATUS fsync_set_event( HANDLE handle, LONG *prev_state ) { return STATUS_NOT_IMPLEMENTED; }
+NTSTATUS fsync_reset_event( HANDLE handle, LONG *prev_state ) { return STATUS_NOT_IMPLEMENTED; }
+NTSTATUS fsync_query_event( HANDLE handle, EVENT_BASIC_INFORMATION *info ) { return STATUS_NOT_IMPLEMENTED; }
+NTSTATUS fsync_release_semaphore( HANDLE handle, ULONG count, ULONG *previous ) { return STATUS_NOT_IMPLEMENTED; }
+NTSTATUS fsync_query_semaphore( HANDLE handle, SEMAPHORE_BASIC_INFORMATION *info ) { return STATUS_NOT_IMPLEMENTED; }
+NTSTATUS fsync_release_mutex( HANDLE handle, LONG *prev_count ) { return STATUS_NOT_IMPLEMENTED; }
+NTSTATUS fsync_query_mutex( HANDLE handle, MUTANT_BASIC_INFORMATION *info ) { return STATUS_NOT_IMPLEMENTED; }
+
+NTSTATUS fsync_wait_objects( DWORD count, const HANDLE *handles, BOOLEAN wait_any,
+                             BOOLEAN alertable, const LARGE_INTEGER *timeout )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+#endif  /* __linux__ */
@@ -549,8 +549,75 @@ NTSTATUS WINAPI NtQueryValueKey( HANDLE handle, const UNICODE_STRING *name,
 NTSTATUS WINAPI NtQueryMultipleValueKey( HANDLE key, KEY_MULTIPLE_VALUE_INFORMATION *info,
                                          ULONG count, void *buffer, ULONG length, ULONG *retlen )
 {
-    FIXME( "(%p,%p,0x%08x,%p,0x%08x,%p) stub!\n", key, info, count, buffer, length, retlen );
-    return STATUS_SUCCESS;
+    struct __server_request_info *reqs;
+    NTSTATUS ret;
+    ULONG i, total;
+
+    TRACE( "(%p,%p,%u,%p,%u,%p)\n", key, info, count, buffer, length, retlen );
+
+    if (!count)
+    {
+        if (retlen) *retlen = 0;
+        return STATUS_SUCCESS;
+    }
+
+    for (i = 0; i < count; i++)
+        if (info[i].ValueName->Length > MAX_VALUE_LENGTH) return STATUS_OBJECT_NAME_NOT_FOUND;
+
+    if (!(reqs = malloc( count * sizeof(*reqs) ))) return STATUS_NO_MEMORY;
+
+    for (;;)
+    {
+        /* first retrieve the sizes and types of all the values */
+        for (i = 0; i < count; i++)
+        {
+            memset( &reqs[i].u.req, 0, sizeof(reqs[i].u.req) );
+            reqs[i].u.req.request_header.req = REQ_get_key_value;
+            reqs[i].u.req.get_key_value_request.hkey = wine_server_obj_handle( key );
+            reqs[i].data_count = 0;
+            wine_server_add_data( &reqs[i], info[i].ValueName->Buffer, info[i].ValueName->Length );
+        }
+        if ((ret = server_call_batch( reqs, count ))) break;
+
+        for (i = total = 0; i < count; i++)
+        {
+            if ((ret = reqs[i].u.reply.reply_header.error)) break;
+            total = (total + sizeof(ULONG) - 1) & ~(sizeof(ULONG) - 1);
+            info[i].Type       = reqs[i].u.reply.get_key_value_reply.type;
+            info[i].DataLength = reqs[i].u.reply.get_key_value_reply.total;
+            info[i].DataOffset = total;
+            total += info[i].DataLength;
+        }
+        if (ret) break;
+        if (retlen) *retlen = total;
+        if (total > length)
+        {
+            ret = STATUS_BUFFER_OVERFLOW;
+            break;
+        }
+
+        /* then fetch the data straight into the caller buffer */
+        for (i = 0; i < count; i++)
+        {
+            memset( &reqs[i].u.req, 0, sizeof(reqs[i].u.req) );
+            reqs[i].u.req.request_header.req = REQ_get_key_value;
+            reqs[i].u.req.get_key_value_request.hkey = wine_server_obj_handle( key );
+            reqs[i].data_count = 0;
+            wine_server_add_data( &reqs[i], info[i].ValueName->Buffer, info[i].ValueName->Length );
+            wine_server_set_reply( &reqs[i], (char *)buffer + info[i].DataOffset, info[i].DataLength );
+        }
+        if ((ret = server_call_batch( reqs, count ))) break;
+
+        for (i = 0; i < count; i++)
+        {
+            if ((ret = reqs[i].u.reply.reply_header.error)) break;
+            if (reqs[i].u.reply.get_key_value_reply.total != info[i].DataLength) break;
+        }
+        if (ret || i == count) break;
+        /* a value changed size in the meantime, start over */
+    }
+    free( reqs );
+    return ret;
 }
 
 
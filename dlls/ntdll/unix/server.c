@@ -286,6 +286,78 @@ unsigned int CDECL wine_server_call( void *req_ptr )
 }
 
 
+/* size of a request or reply in a batch, including its data */
+static inline data_size_t batch_entry_size( data_size_t data_size )
+{
+    return (sizeof(union generic_request) + data_size + 7) & ~7;
+}
+
+
+/***********************************************************************
+ *           server_call_batch
+ *
+ * Perform several independent server calls in a single round-trip.
+ * The requests are set up as for wine_server_call() and each one gets its
+ * own reply; only requests marked as batchable in the protocol are allowed.
+ */
+unsigned int server_call_batch( struct __server_request_info *reqs, unsigned int count )
+{
+    data_size_t req_size = 0, reply_size = 0, pos, entry_size;
+    unsigned int i, j, ret, done = 0;
+    char *req_buf, *reply_buf;
+
+    for (i = 0; i < count; i++)
+    {
+        req_size += batch_entry_size( reqs[i].u.req.request_header.request_size );
+        reply_size += batch_entry_size( reqs[i].u.req.request_header.reply_size );
+    }
+    if (!(req_buf = calloc( 1, req_size + reply_size ))) return STATUS_NO_MEMORY;
+    reply_buf = req_buf + req_size;
+
+    for (i = pos = 0; i < count; i++)
+    {
+        entry_size = batch_entry_size( reqs[i].u.req.request_header.request_size );
+        memcpy( req_buf + pos, &reqs[i].u.req, sizeof(reqs[i].u.req) );
+        pos += sizeof(reqs[i].u.req);
+        for (j = 0; j < reqs[i].data_count; j++)
+        {
+            memcpy( req_buf + pos, reqs[i].data[j].ptr, reqs[i].data[j].size );
+            pos += reqs[i].data[j].size;
+        }
+        pos = (pos + 7) & ~7;
+    }
+
+    SERVER_START_REQ( batch_requests )
+    {
+        wine_server_add_data( req, req_buf, req_size );
+        wine_server_set_reply( req, reply_buf, reply_size );
+        ret = wine_server_call( req );
+        done = reply->count;
+    }
+    SERVER_END_REQ;
+
+    for (i = pos = 0; i < count; i++)
+    {
+        entry_size = batch_entry_size( reqs[i].u.req.request_header.reply_size );
+        if (i < done)
+        {
+            memcpy( &reqs[i].u.reply, reply_buf + pos, sizeof(reqs[i].u.reply) );
+            if (reqs[i].u.reply.reply_header.reply_size)
+                memcpy( reqs[i].reply_data, reply_buf + pos + sizeof(reqs[i].u.reply),
+                        reqs[i].u.reply.reply_header.reply_size );
+        }
+        else
+        {
+            memset( &reqs[i].u.reply, 0, sizeof(reqs[i].u.reply) );
+            reqs[i].u.reply.reply_header.error = ret ? ret : STATUS_INTERNAL_ERROR;
+        }
+        pos += entry_size;
+    }
+    free( req_buf );
+    return ret;
+}
+
+
 /***********************************************************************
  *           server_enter_uninterrupted_section
  */
@@ -906,7 +978,8 @@ static BOOL add_fd_to_cache( HANDLE handle, int fd, enum server_fd_type type,
 
     if (entry >= FD_CACHE_ENTRIES)
     {
-        FIXME( "too many allocated handles, not caching %p\n", handle );
+        /* pseudo and global handles end up here too, don't complain about failures for them */
+        if (type != FD_TYPE_INVALID) FIXME( "too many allocated handles, not caching %p\n", handle );
         return FALSE;
     }
 
@@ -977,6 +1050,175 @@ static int remove_fd_from_cache( HANDLE handle )
 }
 
 
+/***********************************************************************/
+/* fast synchronization objects cache support */
+
+union fsync_cache_entry
+{
+    LONG64 data;
+    struct
+    {
+        unsigned int  index;
+        unsigned int  type : 2;
+        unsigned int  cached : 1;
+        unsigned int  access : 29;
+    } s;
+};
+
+C_ASSERT( sizeof(union fsync_cache_entry) == sizeof(LONG64) );
+
+static union fsync_cache_entry *fsync_cache[FD_CACHE_ENTRIES];
+static struct fsync_object *fsync_shm;
+static int fsync_enabled = -1;
+
+
+/***********************************************************************
+ *           map_fsync_shm
+ *
+ * Caller must hold fd_cache_mutex.
+ */
+static BOOL map_fsync_shm(void)
+{
+    obj_handle_t fd_handle;
+    data_size_t size = 0;
+    void *ptr;
+    int fd = -1;
+
+    if (fsync_enabled != -1) return fsync_enabled;
+
+    SERVER_START_REQ( get_fsync_shm )
+    {
+        if (!wine_server_call( req ))
+        {
+            size = reply->size;
+            fd = receive_fd( &fd_handle );
+        }
+    }
+    SERVER_END_REQ;
+
+    fsync_enabled = FALSE;
+    if (fd == -1) return FALSE;
+    ptr = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    close( fd );
+    if (ptr == MAP_FAILED) return FALSE;
+    fsync_shm = ptr;
+    return (fsync_enabled = TRUE);
+}
+
+
+/***********************************************************************
+ *           add_fsync_to_cache
+ *
+ * Caller must hold fd_cache_mutex.
+ */
+static void add_fsync_to_cache( HANDLE handle, unsigned int index, enum fsync_type type, unsigned int access )
+{
+    unsigned int entry, idx = handle_to_index( handle, &entry );
+    union fsync_cache_entry cache;
+
+    if (entry >= FD_CACHE_ENTRIES) return;
+
+    if (!fsync_cache[entry])  /* do we need to allocate a new block of entries? */
+    {
+        void *ptr = anon_mmap_alloc( FD_CACHE_BLOCK_SIZE * sizeof(union fsync_cache_entry),
+                                     PROT_READ | PROT_WRITE );
+        if (ptr == MAP_FAILED) return;
+        fsync_cache[entry] = ptr;
+    }
+
+    cache.s.index = index;
+    cache.s.type = type;
+    cache.s.cached = 1;
+    cache.s.access = access;
+    interlocked_xchg64( &fsync_cache[entry][idx].data, cache.data );
+}
+
+
+/***********************************************************************
+ *           remove_fsync_from_cache
+ */
+static void remove_fsync_from_cache( HANDLE handle )
+{
+    unsigned int entry, idx = handle_to_index( handle, &entry );
+
+    if (entry < FD_CACHE_ENTRIES && fsync_cache[entry])
+        interlocked_xchg64( &fsync_cache[entry][idx].data, 0 );
+}
+
+
+/***********************************************************************
+ *           server_get_fsync_object
+ *
+ * Return the shared state of a fast synchronization object, or NULL if
+ * the handle doesn't refer to one and the server has to be used instead.
+ */
+struct fsync_object *server_get_fsync_object( HANDLE handle, enum fsync_type *type, unsigned int *access,
+                                              unsigned int *index )
+{
+    unsigned int entry, idx = handle_to_index( handle, &entry );
+    union fsync_cache_entry cache;
+    sigset_t sigset;
+
+    if (!fsync_enabled || !handle || ((ULONG_PTR)handle & 3)) return NULL;
+
+    if (entry < FD_CACHE_ENTRIES && fsync_cache[entry])
+        cache.data = InterlockedCompareExchange64( &fsync_cache[entry][idx].data, 0, 0 );
+    else
+        cache.data = 0;
+
+    if (!cache.s.cached)
+    {
+        server_enter_uninterrupted_section( &fd_cache_mutex, &sigset );
+        if (map_fsync_shm())
+        {
+            SERVER_START_REQ( get_fsync_idx )
+            {
+                req->handle = wine_server_obj_handle( handle );
+                if (!wine_server_call( req ))
+                {
+                    cache.s.index  = reply->index;
+                    cache.s.type   = reply->type;
+                    cache.s.cached = 1;
+                    cache.s.access = reply->access;
+                    add_fsync_to_cache( handle, reply->index, reply->type, reply->access );
+                }
+            }
+            SERVER_END_REQ;
+        }
+        server_leave_uninterrupted_section( &fd_cache_mutex, &sigset );
+    }
+
+    if (cache.s.type == FSYNC_NONE) return NULL;
+    *type = cache.s.type;
+    *access = cache.s.access;
+    if (index) *index = cache.s.index;
+    return &fsync_shm[cache.s.index];
+}
+
+
+/***********************************************************************
+ *           server_get_fsync_thread
+ *
+ * Return the list of the mutexes owned by the current thread without
+ * the server, allocating it on first use.
+ */
+struct fsync_thread *server_get_fsync_thread(void)
+{
+    struct ntdll_thread_data *thread_data = ntdll_get_thread_data();
+
+    if (!thread_data->fsync_thread && fsync_enabled == TRUE)
+    {
+        SERVER_START_REQ( get_fsync_thread )
+        {
+            if (!wine_server_call( req ))
+                thread_data->fsync_thread = (struct fsync_thread *)((char *)fsync_shm + reply->offset);
+        }
+        SERVER_END_REQ;
+    }
+    return thread_data->fsync_thread;
+}
+
+
 /***********************************************************************
  *           server_get_unix_fd
  *
@@ -1651,7 +1893,10 @@ NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source, HANDLE
     /* always remove the cached fd; if the server request fails we'll just
      * retrieve it again */
     if (options & DUPLICATE_CLOSE_SOURCE)
+    {
         fd = remove_fd_from_cache( source );
+        remove_fsync_from_cache( source );
+    }
 
     SERVER_START_REQ( dup_handle )
     {
@@ -1671,6 +1916,7 @@ NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source, HANDLE
     server_leave_uninterrupted_section( &fd_cache_mutex, &sigset );
 
     if (fd != -1) close( fd );
+    if (options & DUPLICATE_CLOSE_SOURCE) sock_invalidate_poll_state( source );
     return ret;
 }
 
@@ -1712,6 +1958,7 @@ NTSTATUS WINAPI NtClose( HANDLE handle )
     /* always remove the cached fd; if the server request fails we'll just
      * retrieve it again */
     fd = remove_fd_from_cache( handle );
+    remove_fsync_from_cache( handle );
 
     SERVER_START_REQ( close_handle )
     {
@@ -1723,6 +1970,7 @@ NTSTATUS WINAPI NtClose( HANDLE handle )
     server_leave_uninterrupted_section( &fd_cache_mutex, &sigset );
 
     if (fd != -1) close( fd );
+    sock_invalidate_poll_state( handle );
 
     if (ret != STATUS_INVALID_HANDLE || !handle) return ret;
     if (!peb->BeingDebugged) return ret;
@@ -27,7 +27,11 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/ioctl.h>
+#include <poll.h>
 #include <unistd.h>
+#ifdef HAVE_SYS_SENDFILE_H
+# include <sys/sendfile.h>
+#endif
 #ifdef HAVE_IFADDRS_H
 # include <ifaddrs.h>
 #endif
@@ -143,6 +147,7 @@ struct async_transmit_ioctl
     unsigned int buffer_cursor; /* amount of data currently in the buffer already sent */
     unsigned int tail_cursor;   /* amount of tail data already sent */
     unsigned int file_len;      /* total file length to send */
+    BOOL use_sendfile;          /* send file data directly from the file with sendfile() */
     DWORD flags;
     const char *head;
     const char *tail;
@@ -887,6 +892,9 @@ static NTSTATUS sock_recv( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, voi
             status = STATUS_PENDING;
     }
 
+    /* the server keeps the async queued, so polls must go through it */
+    if (status == STATUS_PENDING) sock_invalidate_poll_state( handle );
+
     if (status != STATUS_PENDING)
     {
         if (!NT_ERROR(status) || (wait_handle && !alerted))
@@ -1132,6 +1140,8 @@ static NTSTATUS sock_send( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, voi
             status = STATUS_SUCCESS;
     }
 
+    if (status == STATUS_PENDING) sock_invalidate_poll_state( handle );
+
     if (status != STATUS_PENDING)
     {
         information = async->sent_len;
@@ -1215,6 +1225,84 @@ NTSTATUS sock_write( HANDLE handle, int fd, HANDLE event, PIO_APC_ROUTINE apc,
 }
 
 
+/* perform a batch of registered I/O requests directly on the socket, with a
+ * single server call for the whole batch; requests that would block, or that
+ * have to wait behind asyncs already queued, are left to the caller */
+static NTSTATUS sock_rio_submit( HANDLE handle, int fd, const struct afd_rio_request *requests,
+                                 struct afd_rio_result *results, unsigned int count )
+{
+    BOOL send_blocked = TRUE, recv_blocked = TRUE;
+    BOOL has_send = FALSE, has_recv = FALSE;
+    struct msghdr hdr;
+    struct iovec iov;
+    unsigned int i;
+    NTSTATUS status;
+    ssize_t ret;
+
+    for (i = 0; i < count; ++i)
+    {
+        if (requests[i].send) has_send = TRUE;
+        else has_recv = TRUE;
+    }
+
+    SERVER_START_REQ( rio_socket )
+    {
+        req->handle = wine_server_obj_handle( handle );
+        req->recv   = has_recv;
+        req->send   = has_send;
+        if (!(status = wine_server_call( req )))
+        {
+            recv_blocked = !reply->recv_direct;
+            send_blocked = !reply->send_direct;
+        }
+    }
+    SERVER_END_REQ;
+    if (status) return status;
+
+    for (i = 0; i < count; ++i)
+    {
+        const struct afd_rio_request *req = &requests[i];
+        struct afd_rio_result *result = &results[i];
+        BOOL *blocked = req->send ? &send_blocked : &recv_blocked;
+
+        result->size = 0;
+        if (*blocked)
+        {
+            /* keep the order of earlier requests which are still pending */
+            result->status = STATUS_DEVICE_NOT_READY;
+            continue;
+        }
+
+        iov.iov_base = u64_to_user_ptr( req->buffer_ptr );
+        iov.iov_len = req->len;
+        memset( &hdr, 0, sizeof(hdr) );
+        hdr.msg_iov = &iov;
+        hdr.msg_iovlen = 1;
+        if (req->send)
+            while ((ret = sendmsg( fd, &hdr, 0 )) < 0 && errno == EINTR);
+        else
+            while ((ret = virtual_locked_recvmsg( fd, &hdr, 0 )) < 0 && errno == EINTR);
+
+        if (ret < 0)
+        {
+            if (errno != EWOULDBLOCK) WARN( "%s: %s\n", req->send ? "sendmsg" : "recvmsg", strerror( errno ) );
+            result->status = sock_errno_to_status( errno );
+        }
+        else
+        {
+            result->size = ret;
+            if (req->send && ret < req->len) result->status = STATUS_DEVICE_NOT_READY;
+            else if (hdr.msg_flags & MSG_TRUNC) result->status = STATUS_BUFFER_OVERFLOW;
+            else result->status = STATUS_SUCCESS;
+        }
+        if (result->status == STATUS_DEVICE_NOT_READY) *blocked = TRUE;
+        TRACE( "%s %u bytes at %p: status %#x, size %u\n", req->send ? "send" : "recv",
+               req->len, iov.iov_base, result->status, result->size );
+    }
+    return STATUS_SUCCESS;
+}
+
+
 static ssize_t do_send( int fd, const void *buffer, size_t len, int flags )
 {
     ssize_t ret;
@@ -1248,6 +1336,45 @@ static NTSTATUS try_transmit( int sock_fd, int file_fd, struct async_transmit_io
         async->file_cursor += ret;
     }
 
+#ifdef HAVE_SYS_SENDFILE_H
+    while (async->file && async->use_sendfile)
+    {
+        size_t count = 0x7ffff000;  /* maximum size of a single sendfile() call */
+        off_t offset = async->offset.QuadPart;
+
+        if (async->file_len)
+            count = min( count, async->file_len - async->file_cursor );
+
+        TRACE( "sending %zu bytes of file data with sendfile\n", count );
+        do
+        {
+            if (async->offset.QuadPart == FILE_USE_FILE_POINTER_POSITION)
+                ret = sendfile( sock_fd, file_fd, NULL, count );
+            else
+                ret = sendfile( sock_fd, file_fd, &offset, count );
+        } while (ret < 0 && errno == EINTR);
+
+        if (ret < 0)
+        {
+            /* the file or socket doesn't support it, copy the data through the buffer instead */
+            if (errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP)
+            {
+                TRACE( "sendfile failed: %s\n", strerror( errno ));
+                async->use_sendfile = FALSE;
+                break;
+            }
+            return sock_errno_to_status( errno );
+        }
+        TRACE( "sendfile returned %zd\n", ret );
+
+        async->file_cursor += ret;
+        if (async->offset.QuadPart != FILE_USE_FILE_POINTER_POSITION)
+            async->offset.QuadPart += ret;
+        if (!ret || (async->file_len && async->file_cursor == async->file_len))
+            async->file = NULL;
+    }
+#endif
+
     if (async->file && async->buffer_cursor == async->read_len)
     {
         unsigned int read_size = async->buffer_size;
@@ -1368,6 +1495,7 @@ static NTSTATUS sock_transmit( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc,
     async->buffer_cursor = 0;
     async->tail_cursor = 0;
     async->file_len = params->file_len;
+    async->use_sendfile = TRUE;
     async->flags = params->flags;
     async->head = u64_to_user_ptr(params->head_ptr);
     async->head_len = params->head_len;
@@ -1393,6 +1521,8 @@ static NTSTATUS sock_transmit( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc,
             status = STATUS_PENDING;
     }
 
+    if (status == STATUS_PENDING) sock_invalidate_poll_state( handle );
+
     if (status != STATUS_PENDING)
     {
         information = async->head_cursor + async->file_cursor + async->tail_cursor;
@@ -1433,6 +1563,222 @@ static void complete_async( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, vo
 }
 
 
+/* Cache of the sockets that the server reported as safe to poll on the client
+ * side. Only positive results are cached; any operation that may leave
+ * server-side state behind removes the entry, and bumps the sequence number so
+ * that a concurrent lookup does not put a stale entry back. */
+static struct
+{
+    HANDLE               handle;
+    enum sock_poll_state state;
+} poll_state_cache[1024];
+static unsigned int poll_state_seq;
+static pthread_mutex_t poll_state_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned int poll_state_index( HANDLE handle )
+{
+    return (HandleToULong( handle ) >> 2) % ARRAY_SIZE(poll_state_cache);
+}
+
+void sock_invalidate_poll_state( HANDLE handle )
+{
+    unsigned int idx = poll_state_index( handle );
+
+    mutex_lock( &poll_state_mutex );
+    if (poll_state_cache[idx].handle == handle) poll_state_cache[idx].handle = 0;
+    poll_state_seq++;
+    mutex_unlock( &poll_state_mutex );
+}
+
+static enum sock_poll_state get_poll_state( HANDLE handle )
+{
+    unsigned int idx = poll_state_index( handle ), seq;
+    enum sock_poll_state state = SOCK_POLL_SERVER;
+
+    mutex_lock( &poll_state_mutex );
+    if (poll_state_cache[idx].handle == handle) state = poll_state_cache[idx].state;
+    seq = poll_state_seq;
+    mutex_unlock( &poll_state_mutex );
+
+    if (state != SOCK_POLL_SERVER) return state;
+
+    SERVER_START_REQ( get_socket_poll_state )
+    {
+        req->handle = wine_server_obj_handle( handle );
+        if (!wine_server_call( req )) state = reply->state;
+    }
+    SERVER_END_REQ;
+
+    if (state == SOCK_POLL_SERVER) return state;
+
+    mutex_lock( &poll_state_mutex );
+    if (seq == poll_state_seq)
+    {
+        poll_state_cache[idx].handle = handle;
+        poll_state_cache[idx].state = state;
+    }
+    mutex_unlock( &poll_state_mutex );
+    return state;
+}
+
+struct fast_poll_socket
+{
+    HANDLE               handle;
+    int                  mask;
+    int                  flags;
+    enum sock_poll_state state;
+};
+
+/* Try to satisfy a poll request with a direct poll() of the unix fds,
+ * returning STATUS_BAD_DEVICE_TYPE if it needs to go through the server. */
+static NTSTATUS sock_poll( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, void *apc_user, IO_STATUS_BLOCK *io,
+                           const void *in_buffer, ULONG in_size, void *out_buffer, ULONG out_size )
+{
+    NTSTATUS status = STATUS_BAD_DEVICE_TYPE;
+    struct fast_poll_socket *sockets;
+    unsigned int i, count, signaled = 0;
+    struct pollfd *fds;
+    LONGLONG timeout;
+    ULONG_PTR size;
+
+    if (in_wow64_call())
+    {
+        const struct afd_poll_params_32 *params = in_buffer;
+
+        if (in_size < sizeof(*params) || in_size < offsetof( struct afd_poll_params_32, sockets[params->count] ))
+            return STATUS_BAD_DEVICE_TYPE;
+        if (!params->count || params->exclusive) return STATUS_BAD_DEVICE_TYPE;
+        count = params->count;
+        timeout = params->timeout;
+        if (!(sockets = malloc( count * (sizeof(*sockets) + sizeof(*fds)) ))) return STATUS_BAD_DEVICE_TYPE;
+        for (i = 0; i < count; ++i)
+        {
+            sockets[i].handle = LongToHandle( params->sockets[i].socket );
+            sockets[i].mask = params->sockets[i].flags;
+        }
+        size = offsetof( struct afd_poll_params_32, sockets[count] );
+    }
+    else
+    {
+        const struct afd_poll_params *params = in_buffer;
+
+        if (in_size < sizeof(*params) || in_size < offsetof( struct afd_poll_params, sockets[params->count] ))
+            return STATUS_BAD_DEVICE_TYPE;
+        if (!params->count || params->exclusive) return STATUS_BAD_DEVICE_TYPE;
+        count = params->count;
+        timeout = params->timeout;
+        if (!(sockets = malloc( count * (sizeof(*sockets) + sizeof(*fds)) ))) return STATUS_BAD_DEVICE_TYPE;
+        for (i = 0; i < count; ++i)
+        {
+            sockets[i].handle = (HANDLE)params->sockets[i].socket;
+            sockets[i].mask = params->sockets[i].flags;
+        }
+        size = offsetof( struct afd_poll_params, sockets[count] );
+    }
+    if (out_size < size) goto done;
+    fds = (struct pollfd *)(sockets + count);
+
+    for (i = 0; i < count; ++i)
+    {
+        int needs_close, mask = sockets[i].mask;
+
+        if ((sockets[i].state = get_poll_state( sockets[i].handle )) == SOCK_POLL_SERVER) goto done;
+        if (server_get_unix_fd( sockets[i].handle, 0, &fds[i].fd, &needs_close, NULL, NULL )) goto done;
+        if (needs_close)
+        {
+            /* the fd is not cacheable, so the socket state is not stable */
+            close( fds[i].fd );
+            goto done;
+        }
+
+        fds[i].events = 0;
+        if (mask & (AFD_POLL_READ | AFD_POLL_ACCEPT)) fds[i].events |= POLLIN;
+        if ((mask & AFD_POLL_HUP) && sockets[i].state == SOCK_POLL_CONNECTED) fds[i].events |= POLLIN;
+        if (mask & AFD_POLL_OOB) fds[i].events |= POLLPRI;
+        if (mask & AFD_POLL_WRITE) fds[i].events |= POLLOUT;
+    }
+
+    if (poll( fds, count, 0 ) < 0) goto done;
+
+    for (i = 0; i < count; ++i)
+    {
+        int flags = 0;
+
+        /* errors, hangups and out-of-band data update the server-side state */
+        if (fds[i].revents & (POLLPRI | POLLERR | POLLHUP | POLLNVAL))
+        {
+            sock_invalidate_poll_state( sockets[i].handle );
+            goto done;
+        }
+
+        if (fds[i].revents & POLLIN)
+        {
+            if (sockets[i].state == SOCK_POLL_LISTENING)
+                flags |= AFD_POLL_ACCEPT;
+            else if (sockets[i].state == SOCK_POLL_CONNECTED)
+            {
+                char dummy;
+                int ret = recv( fds[i].fd, &dummy, 1, MSG_PEEK | MSG_DONTWAIT );
+
+                /* let the server notice the hangup or the reset */
+                if (!ret || (ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+                {
+                    sock_invalidate_poll_state( sockets[i].handle );
+                    goto done;
+                }
+                if (ret > 0) flags |= AFD_POLL_READ;
+            }
+            else flags |= AFD_POLL_READ;
+        }
+        if (fds[i].revents & POLLOUT) flags |= AFD_POLL_WRITE;
+        if (sockets[i].state == SOCK_POLL_CONNECTED) flags |= AFD_POLL_CONNECT;
+
+        if ((sockets[i].flags = flags & sockets[i].mask)) ++signaled;
+    }
+
+    /* nothing to report yet; let the server wait for us */
+    if (!signaled && timeout) goto done;
+
+    if (in_wow64_call())
+    {
+        struct afd_poll_params_32 *output = out_buffer;
+
+        size = offsetof( struct afd_poll_params_32, sockets[signaled] );
+        memset( output, 0, size );
+        output->timeout = timeout;
+        for (i = 0; i < count; ++i)
+        {
+            if (!sockets[i].flags) continue;
+            output->sockets[output->count].socket = HandleToULong( sockets[i].handle );
+            output->sockets[output->count].flags = sockets[i].flags;
+            ++output->count;
+        }
+    }
+    else
+    {
+        struct afd_poll_params *output = out_buffer;
+
+        size = offsetof( struct afd_poll_params, sockets[signaled] );
+        memset( output, 0, size );
+        output->timeout = timeout;
+        for (i = 0; i < count; ++i)
+        {
+            if (!sockets[i].flags) continue;
+            output->sockets[output->count].socket = (SOCKET)sockets[i].handle;
+            output->sockets[output->count].flags = sockets[i].flags;
+            ++output->count;
+        }
+    }
+
+    complete_async( handle, event, apc, apc_user, io, STATUS_SUCCESS, size );
+    status = STATUS_SUCCESS;
+
+done:
+    free( sockets );
+    return status;
+}
+
+
 static NTSTATUS do_getsockopt( HANDLE handle, IO_STATUS_BLOCK *io, int level,
                                int option, void *out_buffer, ULONG out_size )
 {
@@ -1541,6 +1887,10 @@ NTSTATUS sock_ioctl( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, void *apc
             break;
 
         case IOCTL_AFD_POLL:
+            return sock_poll( handle, event, apc, apc_user, io, in_buffer, in_size, out_buffer, out_size );
+
+        case IOCTL_AFD_WINE_ACCEPT_INTO:
+            sock_invalidate_poll_state( handle );
             status = STATUS_BAD_DEVICE_TYPE;
             break;
 
@@ -1677,6 +2027,21 @@ NTSTATUS sock_ioctl( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, void *apc
             return status;
         }
 
+        case IOCTL_AFD_WINE_RIO_SUBMIT:
+        {
+            unsigned int count = in_size / sizeof(struct afd_rio_request);
+
+            if (in_size % sizeof(struct afd_rio_request) || out_size < count * sizeof(struct afd_rio_result))
+                return STATUS_INVALID_PARAMETER;
+
+            if ((status = server_get_unix_fd( handle, 0, &fd, &needs_close, NULL, NULL )))
+                return status;
+
+            if (!(status = sock_rio_submit( handle, fd, in_buffer, out_buffer, count )))
+                io->Information = count * sizeof(struct afd_rio_result);
+            break;
+        }
+
         case IOCTL_AFD_WINE_COMPLETE_ASYNC:
         {
             if (in_size != sizeof(NTSTATUS))
@@ -18948,11 +18948,16 @@ static void test_invalid_window(void)
     MSG msg;
     BOOL ret;
 
+    /* the queue has just been checked and is empty */
+    flush_events();
+    while (PeekMessageA(&msg, 0, 0, 0, PM_REMOVE)) DispatchMessageA(&msg);
+
     SetLastError(0xdeadbeef);
     ret = GetMessageA(&msg, (HWND)0xdeadbeef, 0, 0);
     ok(ret == -1, "wrong ret %d\n", ret);
     ok(GetLastError() == ERROR_INVALID_WINDOW_HANDLE, "wrong error %lu\n", GetLastError());
 
+    while (PeekMessageA(&msg, 0, 0, 0, PM_REMOVE)) DispatchMessageA(&msg);
     SetLastError(0xdeadbeef);
     ret = PeekMessageA(&msg, (HWND)0xdeadbeef, 0, 0, PM_REMOVE);
     ok(!ret, "wrong ret %d\n", ret);
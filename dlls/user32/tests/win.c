@@ -12810,6 +12810,181 @@ static void test_other_process_window(const char *argv0)
     DestroyWindow(hwnd);
 }
 
+/* window information published by the parent process, checked by the child */
+struct other_process_info
+{
+    HWND     hwnd;
+    HWND     parent;
+    BOOL     valid;
+    DWORD    tid;
+    DWORD    pid;
+    LONG     style;
+    LONG     ex_style;
+    LONG_PTR id;
+    LONG_PTR instance;
+    LONG_PTR user_data;
+    RECT     window_rect;
+    RECT     client_rect;
+};
+
+static void other_process_info_proc(void)
+{
+    HANDLE window_ready_event, test_done_event, mapping;
+    const struct other_process_info *info;
+    RECT rect;
+    DWORD ret, tid, pid;
+    int i;
+
+    window_ready_event = OpenEventA(EVENT_ALL_ACCESS, FALSE, "test_opi_window");
+    ok(!!window_ready_event, "OpenEvent failed.\n");
+    test_done_event = OpenEventA(EVENT_ALL_ACCESS, FALSE, "test_opi_test");
+    ok(!!test_done_event, "OpenEvent failed.\n");
+    mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, "test_opi_info");
+    ok(!!mapping, "OpenFileMapping failed.\n");
+    info = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, sizeof(*info));
+    ok(!!info, "MapViewOfFile failed.\n");
+
+    for (i = 0; i < 3; i++)
+    {
+        winetest_push_context("%d", i);
+        ret = WaitForSingleObject(window_ready_event, 5000);
+        ok(ret == WAIT_OBJECT_0, "Unexpected ret %lx.\n", ret);
+
+        if (info->valid)
+        {
+            ok(IsWindow(info->hwnd), "IsWindow failed.\n");
+            tid = GetWindowThreadProcessId(info->hwnd, &pid);
+            ok(tid == info->tid, "Unexpected tid %#lx, expected %#lx.\n", tid, info->tid);
+            ok(pid == info->pid, "Unexpected pid %#lx, expected %#lx.\n", pid, info->pid);
+            ok(GetParent(info->hwnd) == info->parent, "Unexpected parent %p.\n", GetParent(info->hwnd));
+            ok(GetAncestor(info->hwnd, GA_PARENT) == info->parent, "Unexpected ancestor %p.\n",
+               GetAncestor(info->hwnd, GA_PARENT));
+            ok(GetAncestor(info->hwnd, GA_ROOT) == info->parent, "Unexpected root %p.\n",
+               GetAncestor(info->hwnd, GA_ROOT));
+            ok(IsChild(info->parent, info->hwnd), "IsChild failed.\n");
+            ok(GetWindowLongA(info->hwnd, GWL_STYLE) == info->style, "Unexpected style %#lx, expected %#lx.\n",
+               GetWindowLongA(info->hwnd, GWL_STYLE), info->style);
+            ok(GetWindowLongA(info->hwnd, GWL_EXSTYLE) == info->ex_style, "Unexpected ex style %#lx, expected %#lx.\n",
+               GetWindowLongA(info->hwnd, GWL_EXSTYLE), info->ex_style);
+            ok(GetWindowLongPtrA(info->hwnd, GWLP_ID) == info->id, "Unexpected id %#Ix.\n",
+               GetWindowLongPtrA(info->hwnd, GWLP_ID));
+            ok(GetWindowLongPtrA(info->hwnd, GWLP_HINSTANCE) == info->instance, "Unexpected instance %#Ix.\n",
+               GetWindowLongPtrA(info->hwnd, GWLP_HINSTANCE));
+            ok(GetWindowLongPtrA(info->hwnd, GWLP_USERDATA) == info->user_data, "Unexpected user data %#Ix.\n",
+               GetWindowLongPtrA(info->hwnd, GWLP_USERDATA));
+            ok(GetWindowRect(info->hwnd, &rect), "GetWindowRect failed.\n");
+            ok(EqualRect(&rect, &info->window_rect), "Unexpected window rect %s, expected %s.\n",
+               wine_dbgstr_rect(&rect), wine_dbgstr_rect(&info->window_rect));
+            ok(GetClientRect(info->hwnd, &rect), "GetClientRect failed.\n");
+            ok(EqualRect(&rect, &info->client_rect), "Unexpected client rect %s, expected %s.\n",
+               wine_dbgstr_rect(&rect), wine_dbgstr_rect(&info->client_rect));
+        }
+        else
+        {
+            ok(!IsWindow(info->hwnd), "IsWindow succeeded.\n");
+            SetLastError(0xdeadbeef);
+            tid = GetWindowThreadProcessId(info->hwnd, &pid);
+            ok(!tid, "Unexpected tid %#lx.\n", tid);
+            ok(GetLastError() == ERROR_INVALID_WINDOW_HANDLE, "Unexpected error %lu.\n", GetLastError());
+            SetLastError(0xdeadbeef);
+            ok(!GetWindowLongA(info->hwnd, GWL_STYLE), "GetWindowLong succeeded.\n");
+            ok(GetLastError() == ERROR_INVALID_WINDOW_HANDLE, "Unexpected error %lu.\n", GetLastError());
+            ok(!GetWindowRect(info->hwnd, &rect), "GetWindowRect succeeded.\n");
+        }
+        winetest_pop_context();
+        SetEvent(test_done_event);
+    }
+
+    UnmapViewOfFile(info);
+    CloseHandle(mapping);
+    CloseHandle(window_ready_event);
+    CloseHandle(test_done_event);
+}
+
+static void get_other_process_info(HWND hwnd, struct other_process_info *info)
+{
+    info->hwnd = hwnd;
+    info->parent = GetParent(hwnd);
+    info->valid = TRUE;
+    info->tid = GetWindowThreadProcessId(hwnd, &info->pid);
+    info->style = GetWindowLongA(hwnd, GWL_STYLE);
+    info->ex_style = GetWindowLongA(hwnd, GWL_EXSTYLE);
+    info->id = GetWindowLongPtrA(hwnd, GWLP_ID);
+    info->instance = GetWindowLongPtrA(hwnd, GWLP_HINSTANCE);
+    info->user_data = GetWindowLongPtrA(hwnd, GWLP_USERDATA);
+    GetWindowRect(hwnd, &info->window_rect);
+    GetClientRect(hwnd, &info->client_rect);
+}
+
+static void test_other_process_window_info(const char *argv0)
+{
+    HANDLE window_ready_event, test_done_event, mapping;
+    struct other_process_info *info;
+    PROCESS_INFORMATION pi;
+    STARTUPINFOA startup;
+    char cmd[MAX_PATH];
+    HWND parent, hwnd;
+    DWORD ret;
+    int i;
+
+    parent = CreateWindowExA(0, "static", NULL, WS_POPUP, 100, 100, 300, 200, 0, 0, NULL, NULL);
+    ok(!!parent, "CreateWindowEx failed.\n");
+    hwnd = CreateWindowExA(WS_EX_CLIENTEDGE, "static", NULL, WS_CHILD | WS_BORDER, 10, 20, 100, 50,
+                           parent, (HMENU)0x1234, GetModuleHandleA(NULL), NULL);
+    ok(!!hwnd, "CreateWindowEx failed.\n");
+    SetWindowLongPtrA(hwnd, GWLP_USERDATA, 0xdeadbeef);
+
+    window_ready_event = CreateEventA(NULL, FALSE, FALSE, "test_opi_window");
+    ok(!!window_ready_event, "CreateEvent failed.\n");
+    test_done_event = CreateEventA(NULL, FALSE, FALSE, "test_opi_test");
+    ok(!!test_done_event, "CreateEvent failed.\n");
+    mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(*info), "test_opi_info");
+    ok(!!mapping, "CreateFileMapping failed.\n");
+    info = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, sizeof(*info));
+    ok(!!info, "MapViewOfFile failed.\n");
+
+    sprintf(cmd, "%s win test_other_process_window_info", argv0);
+    memset(&startup, 0, sizeof(startup));
+    startup.cb = sizeof(startup);
+    ok(CreateProcessA(NULL, cmd, NULL, NULL, FALSE, 0, NULL, NULL,
+            &startup, &pi), "CreateProcess failed.\n");
+
+    for (i = 0; i < 3; i++)
+    {
+        switch (i)
+        {
+        case 0:
+            get_other_process_info(hwnd, info);
+            break;
+        case 1:
+            /* the child has the record of the window cached by now */
+            SetWindowLongA(hwnd, GWL_STYLE, GetWindowLongA(hwnd, GWL_STYLE) | WS_DISABLED);
+            SetWindowLongA(hwnd, GWL_EXSTYLE, GetWindowLongA(hwnd, GWL_EXSTYLE) | WS_EX_TRANSPARENT);
+            SetWindowLongPtrA(hwnd, GWLP_USERDATA, 0xcafe);
+            SetWindowLongPtrA(hwnd, GWLP_ID, 0x4321);
+            MoveWindow(hwnd, 30, 40, 120, 60, FALSE);
+            get_other_process_info(hwnd, info);
+            break;
+        case 2:
+            DestroyWindow(hwnd);
+            info->valid = FALSE;
+            break;
+        }
+        SetEvent(window_ready_event);
+        ret = WaitForSingleObject(test_done_event, 5000);
+        ok(ret == WAIT_OBJECT_0, "Unexpected ret %lx.\n", ret);
+    }
+
+    wait_child_process(pi.hProcess);
+    UnmapViewOfFile(info);
+    CloseHandle(mapping);
+    CloseHandle(window_ready_event);
+    CloseHandle(test_done_event);
+    CloseHandle(pi.hProcess);
+    CloseHandle(pi.hThread);
+    DestroyWindow(parent);
+}
+
 static void test_cancel_mode(void)
 {
     HWND hwnd1, hwnd2, child;
@@ -13031,6 +13206,12 @@ START_TEST(win)
         }
     }
 
+    if (argc == 3 && !strcmp(argv[2], "test_other_process_window_info"))
+    {
+        other_process_info_proc();
+        return;
+    }
+
     if (argc == 3 && !strcmp(argv[2], "winproc_limit"))
     {
         test_winproc_limit();
@@ -13167,6 +13348,7 @@ START_TEST(win)
     test_window_placement();
     test_arrange_iconic_windows();
     test_other_process_window(argv[0]);
+    test_other_process_window_info(argv[0]);
     test_SC_SIZE();
     test_cancel_mode();
     test_DragDetect();
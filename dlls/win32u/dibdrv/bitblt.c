@@ -23,6 +23,10 @@
 #endif
 
 #include <assert.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
 
 #include "ntgdi_private.h"
 #include "dibdrv.h"
@@ -470,6 +474,180 @@ static int get_overlap( const dib_info *dst, const RECT *dst_rect,
     return ret;
 }
 
+/* Large operations are split in horizontal bands that are processed in parallel by
+ * a few host threads. The bands don't overlap and each of them is processed exactly
+ * like in the serial case, so the results are identical. This can be disabled with
+ * the ParallelBands value of HKCU\Software\Wine\Gdi. */
+
+#define MAX_BAND_THREADS 8
+#define MIN_BAND_PIXELS  (256 * 1024)  /* not worth waking up the threads below that */
+#define MIN_BAND_ROWS    16
+
+struct band_job
+{
+    void (*func)( void *ctx, int band );
+    void  *ctx;
+    int    count;  /* number of bands */
+    int    next;   /* next band to process */
+    int    done;   /* number of processed bands */
+};
+
+static pthread_mutex_t band_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t band_start_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t band_done_cond = PTHREAD_COND_INITIALIZER;
+static pthread_once_t band_once = PTHREAD_ONCE_INIT;
+static struct band_job *band_job;
+static int band_threads;
+
+static void *band_thread( void *arg )
+{
+    struct band_job *job;
+    int band;
+
+    pthread_mutex_lock( &band_mutex );
+    for (;;)
+    {
+        while (!(job = band_job) || job->next >= job->count)
+            pthread_cond_wait( &band_start_cond, &band_mutex );
+        band = job->next++;
+        pthread_mutex_unlock( &band_mutex );
+        job->func( job->ctx, band );
+        pthread_mutex_lock( &band_mutex );
+        if (++job->done == job->count) pthread_cond_signal( &band_done_cond );
+    }
+    return NULL;
+}
+
+/* check whether the parallel path has been disabled in the registry */
+static BOOL use_band_threads(void)
+{
+    static const WCHAR valsW[] = {'n','N','f','F','0',0};
+    char buffer[offsetof(KEY_VALUE_PARTIAL_INFORMATION, Data[8 * sizeof(WCHAR)])];
+    KEY_VALUE_PARTIAL_INFORMATION *info = (void *)buffer;
+    BOOL ret = TRUE;
+    HKEY hkey;
+
+    /* @@ Wine registry key: HKCU\Software\Wine\Gdi */
+    if ((hkey = reg_open_hkcu_key( "Software\\Wine\\Gdi" )))
+    {
+        if (query_reg_ascii_value( hkey, "ParallelBands", info, sizeof(buffer) ) && info->Type == REG_SZ)
+            ret = !wcschr( valsW, *(const WCHAR *)info->Data );
+        NtClose( hkey );
+    }
+    return ret;
+}
+
+static void init_band_threads(void)
+{
+    long cpus = sysconf( _SC_NPROCESSORS_ONLN );
+    sigset_t sigset, old_sigset;
+    pthread_attr_t attr;
+    pthread_t thread;
+    int i, count = min( cpus, MAX_BAND_THREADS ) - 1;
+
+    if (!use_band_threads())
+    {
+        TRACE( "parallel bands disabled\n" );
+        return;
+    }
+
+    /* these threads only crunch pixels, leave the signals to the Wine threads */
+    sigfillset( &sigset );
+    pthread_sigmask( SIG_BLOCK, &sigset, &old_sigset );
+    pthread_attr_init( &attr );
+    pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+    for (i = 0; i < count; i++)
+        if (!pthread_create( &thread, &attr, band_thread, NULL )) band_threads++;
+    pthread_attr_destroy( &attr );
+    pthread_sigmask( SIG_SETMASK, &old_sigset, NULL );
+    TRACE( "using %d band threads\n", band_threads );
+}
+
+/* return the number of bands to use for an operation covering the given rows and pixels */
+static int get_band_count( int rows, LONGLONG pixels )
+{
+    if (pixels < MIN_BAND_PIXELS || rows < 2 * MIN_BAND_ROWS) return 1;
+    pthread_once( &band_once, init_band_threads );
+    return max( 1, min( band_threads + 1, rows / MIN_BAND_ROWS ));
+}
+
+/* process all the bands, in parallel if the band threads aren't busy with another job */
+static void run_bands( void (*func)( void *ctx, int band ), void *ctx, int count )
+{
+    struct band_job job = { func, ctx, count, 0, 0 };
+    int band;
+
+    if (count > 1)
+    {
+        pthread_mutex_lock( &band_mutex );
+        if (!band_job)
+        {
+            band_job = &job;
+            pthread_cond_broadcast( &band_start_cond );
+            while (job.next < job.count)
+            {
+                band = job.next++;
+                pthread_mutex_unlock( &band_mutex );
+                func( ctx, band );
+                pthread_mutex_lock( &band_mutex );
+                job.done++;
+            }
+            while (job.done < job.count) pthread_cond_wait( &band_done_cond, &band_mutex );
+            band_job = NULL;
+            pthread_mutex_unlock( &band_mutex );
+            return;
+        }
+        pthread_mutex_unlock( &band_mutex );
+    }
+    for (band = 0; band < count; band++) func( ctx, band );
+}
+
+/* the bands can only be processed in any order if the source isn't modified */
+static BOOL dib_bits_overlap( const dib_info *a, const dib_info *b )
+{
+    const char *a_start = a->bits.ptr, *b_start = b->bits.ptr;
+
+    if (a->stride < 0) a_start += (a->height - 1) * a->stride;
+    if (b->stride < 0) b_start += (b->height - 1) * b->stride;
+    return (a_start < b_start + abs( b->stride ) * b->height &&
+            b_start < a_start + abs( a->stride ) * a->height);
+}
+
+struct band_rects
+{
+    const struct clipped_rects *clipped_rects;
+    int top, bottom, count;
+};
+
+static int init_band_rects( struct band_rects *bands, const struct clipped_rects *clipped_rects )
+{
+    LONGLONG pixels = 0;
+    const RECT *rect;
+    int i;
+
+    bands->clipped_rects = clipped_rects;
+    bands->top = INT_MAX;
+    bands->bottom = INT_MIN;
+    for (i = 0, rect = clipped_rects->rects; i < clipped_rects->count; i++, rect++)
+    {
+        pixels += (LONGLONG)(rect->right - rect->left) * (rect->bottom - rect->top);
+        bands->top = min( bands->top, rect->top );
+        bands->bottom = max( bands->bottom, rect->bottom );
+    }
+    return bands->count = get_band_count( bands->bottom - bands->top, pixels );
+}
+
+/* retrieve the part of a clipped rectangle that falls into a band */
+static BOOL get_band_rect( const struct band_rects *bands, int band, int index, RECT *rect )
+{
+    int height = bands->bottom - bands->top;
+
+    *rect = bands->clipped_rects->rects[index];
+    rect->top = max( rect->top, bands->top + height * band / bands->count );
+    rect->bottom = min( rect->bottom, bands->top + height * (band + 1) / bands->count );
+    return rect->top < rect->bottom;
+}
+
 static void copy_rect( dib_info *dst, const RECT *dst_rect, const dib_info *src, const RECT *src_rect,
                         const struct clipped_rects *clipped_rects, INT rop2 )
 {
@@ -585,17 +763,46 @@ static void mask_rect( dib_info *dst, const RECT *dst_rect, const dib_info *src,
     }
 }
 
+struct blend_bands
+{
+    struct band_rects rects;
+    dib_info         *dst;
+    const dib_info   *src;
+    POINT             offset;
+    BLENDFUNCTION     blend;
+};
+
+static void blend_band( void *ctx, int band )
+{
+    struct blend_bands *params = ctx;
+    RECT rect;
+    int i;
+
+    for (i = 0; i < params->rects.clipped_rects->count; i++)
+        if (get_band_rect( &params->rects, band, i, &rect ))
+            params->dst->funcs->blend_rects( params->dst, 1, &rect, params->src, &params->offset, params->blend );
+}
+
 static DWORD blend_rect( dib_info *dst, const RECT *dst_rect, const dib_info *src, const RECT *src_rect,
                          HRGN clip, BLENDFUNCTION blend )
 {
     POINT offset;
     struct clipped_rects clipped_rects;
+    struct blend_bands params;
 
     if (!get_clipped_rects( dst, dst_rect, clip, &clipped_rects )) return ERROR_SUCCESS;
 
     offset.x = src_rect->left - dst_rect->left;
     offset.y = src_rect->top  - dst_rect->top;
-    dst->funcs->blend_rects( dst, clipped_rects.count, clipped_rects.rects, src, &offset, blend );
+    if (init_band_rects( &params.rects, &clipped_rects ) > 1 && !dib_bits_overlap( dst, src ))
+    {
+        params.dst = dst;
+        params.src = src;
+        params.offset = offset;
+        params.blend = blend;
+        run_bands( blend_band, &params, params.rects.count );
+    }
+    else dst->funcs->blend_rects( dst, clipped_rects.count, clipped_rects.rects, src, &offset, blend );
 
     free_clipped_rects( &clipped_rects );
     return ERROR_SUCCESS;
@@ -680,14 +887,47 @@ static void get_gradient_triangle_vertices( const GRADIENT_TRIANGLE *tri, const
     bounds->bottom = v[2].y;
 }
 
+struct gradient_bands
+{
+    struct band_rects rects;
+    dib_info         *dib;
+    const TRIVERTEX  *v;
+    int               mode;
+    BOOL              ret[MAX_BAND_THREADS];
+};
+
+static void gradient_band( void *ctx, int band )
+{
+    struct gradient_bands *params = ctx;
+    RECT rect;
+    int i;
+
+    params->ret[band] = TRUE;
+    for (i = 0; i < params->rects.clipped_rects->count; i++)
+    {
+        if (!get_band_rect( &params->rects, band, i, &rect )) continue;
+        if (!(params->ret[band] = params->dib->funcs->gradient_rect( params->dib, &rect, params->v, params->mode )))
+            break;
+    }
+}
+
 static BOOL gradient_rect( dib_info *dib, TRIVERTEX *v, int mode, HRGN clip, const RECT *bounds )
 {
     int i;
     struct clipped_rects clipped_rects;
+    struct gradient_bands params;
     BOOL ret = TRUE;
 
     if (!get_clipped_rects( dib, bounds, clip, &clipped_rects )) return TRUE;
-    for (i = 0; i < clipped_rects.count; i++)
+    if (init_band_rects( &params.rects, &clipped_rects ) > 1)
+    {
+        params.dib = dib;
+        params.v = v;
+        params.mode = mode;
+        run_bands( gradient_band, &params, params.rects.count );
+        for (i = 0; i < params.rects.count; i++) ret = ret && params.ret[i];
+    }
+    else for (i = 0; i < clipped_rects.count; i++)
     {
         if (!(ret = dib->funcs->gradient_rect( dib, &clipped_rects.rects[i], v, mode ))) break;
     }
@@ -1198,6 +1438,126 @@ static DWORD calc_1d_stretch_params( INT dst_start, INT dst_length, INT dst_vis_
 }
 
 
+struct stretch_rows
+{
+    POINT dst_start;
+    POINT src_start;
+    int   err;
+    int   length;
+};
+
+struct stretch_bands
+{
+    dib_info              *dst_dib;
+    const dib_info        *src_dib;
+    struct stretch_params  v_params;
+    struct stretch_params  h_params;
+    BOOL                   vstretch;
+    int                    mode;
+    int                    dst_width;
+    void                 (*row_fn)( const dib_info *dst_dib, const POINT *dst_start,
+                                    const dib_info *src_dib, const POINT *src_start,
+                                    const struct stretch_params *params, int mode, BOOL keep_dst );
+    struct stretch_rows    rows[MAX_BAND_THREADS];
+};
+
+static void stretch_band( void *ctx, int band )
+{
+    struct stretch_bands *params = ctx;
+    const struct stretch_params *v_params = &params->v_params;
+    struct stretch_rows rows = params->rows[band];
+
+    if (params->vstretch)
+    {
+        BOOL need_row = TRUE;
+        RECT last_row, this_row;
+        last_row.left = 0;
+        last_row.right = params->dst_width;
+
+        while (rows.length--)
+        {
+            if (need_row)
+            {
+                params->row_fn( params->dst_dib, &rows.dst_start, params->src_dib, &rows.src_start,
+                                &params->h_params, params->mode, FALSE );
+                need_row = FALSE;
+            }
+            else
+            {
+                last_row.top = rows.dst_start.y - v_params->dst_inc;
+                last_row.bottom = last_row.top + 1;
+                this_row = last_row;
+                OffsetRect( &this_row, 0, v_params->dst_inc );
+                copy_rect( params->dst_dib, &this_row, params->dst_dib, &last_row, NULL, R2_COPYPEN );
+            }
+
+            if (rows.err > 0)
+            {
+                rows.src_start.y += v_params->src_inc;
+                need_row = TRUE;
+                rows.err += v_params->err_add_1;
+            }
+            else rows.err += v_params->err_add_2;
+            rows.dst_start.y += v_params->dst_inc;
+        }
+    }
+    else
+    {
+        int merged_rows = 0;
+
+        while (rows.length--)
+        {
+            if (params->mode != STRETCH_DELETESCANS || !merged_rows)
+                params->row_fn( params->dst_dib, &rows.dst_start, params->src_dib, &rows.src_start,
+                                &params->h_params, params->mode, merged_rows != 0 );
+            merged_rows++;
+
+            if (rows.err > 0)
+            {
+                rows.dst_start.y += v_params->dst_inc;
+                merged_rows = 0;
+                rows.err += v_params->err_add_1;
+            }
+            else rows.err += v_params->err_add_2;
+            rows.src_start.y += v_params->src_inc;
+        }
+    }
+}
+
+/* split the rows where a new destination row is generated from a new source row,
+ * so that the bands don't depend on each other */
+static int split_stretch_rows( struct stretch_bands *params, int count )
+{
+    const struct stretch_params *v_params = &params->v_params;
+    struct stretch_rows rows = params->rows[0];
+    int i, done = 0, per_band = rows.length / count, bands = 1;
+    BOOL new_row;
+
+    while (rows.length && bands < count)
+    {
+        new_row = rows.err > 0;
+        if (params->vstretch)
+        {
+            if (new_row) rows.src_start.y += v_params->src_inc;
+            rows.dst_start.y += v_params->dst_inc;
+        }
+        else
+        {
+            if (new_row) rows.dst_start.y += v_params->dst_inc;
+            rows.src_start.y += v_params->src_inc;
+        }
+        rows.err += new_row ? v_params->err_add_1 : v_params->err_add_2;
+        rows.length--;
+        if (++done >= per_band && new_row && rows.length)
+        {
+            params->rows[bands++] = rows;
+            done = 0;
+        }
+    }
+    for (i = 0; i < bands - 1; i++) params->rows[i].length -= params->rows[i + 1].length;
+    return bands;
+}
+
 DWORD stretch_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bitblt_coords *src,
                           const BITMAPINFO *dst_info, void *dst_bits, struct bitblt_coords *dst,
                           INT mode )
@@ -1207,11 +1567,9 @@ DWORD stretch_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bit
     RECT rect;
     BOOL hstretch, vstretch;
     struct stretch_params v_params, h_params;
-    int err;
+    struct stretch_bands params;
+    int count;
     DWORD ret;
-    void (* row_fn)(const dib_info *dst_dib, const POINT *dst_start,
-                    const dib_info *src_dib, const POINT *src_start,
-                    const struct stretch_params *params, int mode, BOOL keep_dst);
 
     TRACE("dst %d, %d - %d x %d visrect %s src %d, %d - %d x %d visrect %s\n",
           dst->x, dst->y, dst->width, dst->height, wine_dbgstr_rect(&dst->visrect),
@@ -1251,64 +1609,23 @@ DWORD stretch_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bit
     dst_start.x -= dst->visrect.left;
     dst_start.y -= dst->visrect.top;
 
-    err = v_params.err_start;
-
-    row_fn = hstretch ? dst_dib.funcs->stretch_row : dst_dib.funcs->shrink_row;
-
-    if (vstretch)
-    {
-        BOOL need_row = TRUE;
-        RECT last_row, this_row;
-        if (hstretch) mode = STRETCH_DELETESCANS;
-        last_row.left = 0;
-        last_row.right = dst->visrect.right - dst->visrect.left;
-
-        while (v_params.length--)
-        {
-            if (need_row)
-            {
-                row_fn( &dst_dib, &dst_start, &src_dib, &src_start, &h_params, mode, FALSE );
-                need_row = FALSE;
-            }
-            else
-            {
-                last_row.top = dst_start.y - v_params.dst_inc;
-                last_row.bottom = last_row.top + 1;
-                this_row = last_row;
-                OffsetRect( &this_row, 0, v_params.dst_inc );
-                copy_rect( &dst_dib, &this_row, &dst_dib, &last_row, NULL, R2_COPYPEN );
-            }
-
-            if (err > 0)
-            {
-                src_start.y += v_params.src_inc;
-                need_row = TRUE;
-                err += v_params.err_add_1;
-            }
-            else err += v_params.err_add_2;
-            dst_start.y += v_params.dst_inc;
-        }
-    }
-    else
-    {
-        int merged_rows = 0;
-
-        while (v_params.length--)
-        {
-            if (mode != STRETCH_DELETESCANS || !merged_rows)
-                row_fn( &dst_dib, &dst_start, &src_dib, &src_start, &h_params, mode, merged_rows != 0 );
-            merged_rows++;
-
-            if (err > 0)
-            {
-                dst_start.y += v_params.dst_inc;
-                merged_rows = 0;
-                err += v_params.err_add_1;
-            }
-            else err += v_params.err_add_2;
-            src_start.y += v_params.src_inc;
-        }
-    }
+    params.dst_dib  = &dst_dib;
+    params.src_dib  = &src_dib;
+    params.v_params = v_params;
+    params.h_params = h_params;
+    params.vstretch = vstretch;
+    params.dst_width = dst->visrect.right - dst->visrect.left;
+    params.mode     = (vstretch && hstretch) ? STRETCH_DELETESCANS : mode;
+    params.row_fn   = hstretch ? dst_dib.funcs->stretch_row : dst_dib.funcs->shrink_row;
+    params.rows[0].dst_start = dst_start;
+    params.rows[0].src_start = src_start;
+    params.rows[0].err       = v_params.err_start;
+    params.rows[0].length    = v_params.length;
+
+    count = get_band_count( v_params.length, (LONGLONG)v_params.length * h_params.length );
+    if (count > 1 && !dib_bits_overlap( &dst_dib, &src_dib )) count = split_stretch_rows( &params, count );
+    else count = 1;
+    run_bands( stretch_band, &params, count );
 
 done:
     /* update coordinates, the destination rectangle is always stored at 0,0 */
@@ -33,8 +33,14 @@ WINE_DEFAULT_DEBUG_CHANNEL(dib);
 
 struct cached_glyph
 {
-    GLYPHMETRICS metrics;
-    BYTE         bits[1];
+    struct list           entry;    /* entry in the glyph LRU or evicted list */
+    struct cached_font   *font;     /* font the glyph belongs to */
+    struct cached_glyph **slot;     /* slot of the glyph in its font page */
+    LONG                  ref;
+    LONG                  used;     /* used since it was last moved in the LRU list */
+    SIZE_T                size;     /* size of the allocation */
+    GLYPHMETRICS          metrics;
+    BYTE                  bits[1];
 };
 
 enum glyph_type
@@ -47,18 +53,36 @@ enum glyph_type
 #define GLYPH_CACHE_PAGE_SIZE  0x100
 #define GLYPH_CACHE_PAGES      (0x10000 / GLYPH_CACHE_PAGE_SIZE)
 
+#define FONT_CACHE_HASH_SIZE   64
+
 struct cached_font
 {
-    struct list           entry;
+    struct list           entry;       /* entry in the most-recently used list */
+    struct list           hash_entry;  /* entry in the hash table */
     LONG                  ref;
     DWORD                 hash;
     LOGFONTW              lf;
     XFORM                 xform;
     UINT                  aa_flags;
+    BOOL                  ascii_cached;
+    LONG                  lookups;     /* number of lock-free lookups in progress */
+    LONG                  hits;
+    LONG                  misses;
     struct cached_glyph **glyphs[GLYPH_NBTYPES][GLYPH_CACHE_PAGES];
 };
 
 static struct list font_cache = LIST_INIT( font_cache );
+static struct list font_cache_hash_table[FONT_CACHE_HASH_SIZE];
+
+/* All the cached glyphs, most recently added or used first. Lookups don't take the
+ * lock, they only flag the glyph as used; the flagged glyphs are moved back to the
+ * head of the list when they reach the tail during eviction. */
+static struct list glyph_lru = LIST_INIT( glyph_lru );
+/* evicted glyphs that a lookup in progress may still be about to reference */
+static struct list glyph_evicted = LIST_INIT( glyph_evicted );
+static SIZE_T glyph_cache_size;
+static SIZE_T glyph_cache_max = 16 * 1024 * 1024;
+static LONG glyph_cache_hits, glyph_cache_misses, glyph_cache_evictions;
 
 static pthread_mutex_t font_cache_lock = PTHREAD_MUTEX_INITIALIZER;
 
@@ -551,10 +575,96 @@ static int font_cache_cmp( const struct cached_font *p1, const struct cached_fon
     return ret;
 }
 
+static void release_cached_glyph( struct cached_glyph *glyph )
+{
+    if (!InterlockedDecrement( &glyph->ref )) free( glyph );
+}
+
+/* release the evicted glyphs that can no longer be found by a lookup, font_cache_lock must be held */
+static void free_evicted_glyphs(void)
+{
+    struct cached_glyph *glyph, *next;
+
+    LIST_FOR_EACH_ENTRY_SAFE( glyph, next, &glyph_evicted, struct cached_glyph, entry )
+    {
+        if (glyph->font->lookups) continue;
+        list_remove( &glyph->entry );
+        release_cached_glyph( glyph );
+    }
+}
+
+/* remove a glyph from the cache, font_cache_lock must be held */
+static void remove_cached_glyph( struct cached_glyph *glyph )
+{
+    InterlockedExchangePointer( (void **)glyph->slot, NULL );
+    list_remove( &glyph->entry );
+    glyph_cache_size -= glyph->size;
+    /* a lookup may have read the slot before we cleared it, and not have taken its reference yet */
+    if (glyph->font->lookups) list_add_tail( &glyph_evicted, &glyph->entry );
+    else release_cached_glyph( glyph );
+}
+
+/* evict the least recently used glyphs until we fit in the budget, font_cache_lock must be held */
+static void trim_glyph_cache(void)
+{
+    struct cached_glyph *glyph;
+    struct list *ptr;
+    LONG count = 0;
+
+    free_evicted_glyphs();
+    while (glyph_cache_size > glyph_cache_max && (ptr = list_tail( &glyph_lru )))
+    {
+        glyph = LIST_ENTRY( ptr, struct cached_glyph, entry );
+        if (glyph->used)  /* give it another chance */
+        {
+            glyph->used = FALSE;
+            list_remove( &glyph->entry );
+            list_add_head( &glyph_lru, &glyph->entry );
+            continue;
+        }
+        remove_cached_glyph( glyph );
+        count++;
+    }
+    if (!count) return;
+    glyph_cache_evictions += count;
+    TRACE( "evicted %d glyphs, %s bytes used, %d hits %d misses %d evictions\n", count,
+           wine_dbgstr_longlong( glyph_cache_size ), glyph_cache_hits, glyph_cache_misses,
+           glyph_cache_evictions );
+}
+
+void set_glyph_cache_size( SIZE_T size )
+{
+    pthread_mutex_lock( &font_cache_lock );
+    glyph_cache_max = size;
+    trim_glyph_cache();
+    pthread_mutex_unlock( &font_cache_lock );
+}
+
+/* font_cache_lock must be held */
+static void free_font_glyphs( struct cached_font *font )
+{
+    UINT i, j, k;
+
+    TRACE( "%p: %d hits %d misses\n", font, font->hits, font->misses );
+    for (i = 0; i < GLYPH_NBTYPES; i++)
+    {
+        for (j = 0; j < GLYPH_CACHE_PAGES; j++)
+        {
+            if (!font->glyphs[i][j]) continue;
+            for (k = 0; k < GLYPH_CACHE_PAGE_SIZE; k++)
+                if (font->glyphs[i][j][k]) remove_cached_glyph( font->glyphs[i][j][k] );
+            free( font->glyphs[i][j] );
+        }
+    }
+    /* the font is unused, so none of its evicted glyphs can still be looked up */
+    free_evicted_glyphs();
+}
+
 static struct cached_font *add_cached_font( DC *dc, HFONT hfont, UINT aa_flags )
 {
     struct cached_font font, *ptr, *last_unused = NULL;
-    UINT i = 0, j, k;
+    struct list *bucket;
+    UINT i;
 
     NtGdiExtGetObjectW( hfont, sizeof(font.lf), &font.lf );
     font.xform = dc->xformWorld2Vport;
@@ -570,7 +680,11 @@ static struct cached_font *add_cached_font( DC *dc, HFONT hfont, UINT aa_flags )
     font.hash = font_cache_hash( &font );
 
     pthread_mutex_lock( &font_cache_lock );
-    LIST_FOR_EACH_ENTRY( ptr, &font_cache, struct cached_font, entry )
+    if (!font_cache_hash_table[0].next)
+        for (i = 0; i < FONT_CACHE_HASH_SIZE; i++) list_init( &font_cache_hash_table[i] );
+
+    bucket = &font_cache_hash_table[font.hash % FONT_CACHE_HASH_SIZE];
+    LIST_FOR_EACH_ENTRY( ptr, bucket, struct cached_font, hash_entry )
     {
         if (!font_cache_cmp( &font, ptr ))
         {
@@ -578,27 +692,22 @@ static struct cached_font *add_cached_font( DC *dc, HFONT hfont, UINT aa_flags )
             list_remove( &ptr->entry );
             goto done;
         }
-        if (!ptr->ref)
-        {
-            i++;
-            last_unused = ptr;
-        }
+    }
+
+    i = 0;
+    LIST_FOR_EACH_ENTRY( ptr, &font_cache, struct cached_font, entry )
+    {
+        if (ptr->ref) continue;
+        i++;
+        last_unused = ptr;
     }
 
     if (i > 5)  /* keep at least 5 of the most-recently used fonts around */
     {
         ptr = last_unused;
-        for (i = 0; i < GLYPH_NBTYPES; i++)
-        {
-            for (j = 0; j < GLYPH_CACHE_PAGES; j++)
-            {
-                if (!ptr->glyphs[i][j]) continue;
-                for (k = 0; k < GLYPH_CACHE_PAGE_SIZE; k++)
-                    free( ptr->glyphs[i][j][k] );
-                free( ptr->glyphs[i][j] );
-            }
-        }
+        free_font_glyphs( ptr );
         list_remove( &ptr->entry );
+        list_remove( &ptr->hash_entry );
     }
     else if (!(ptr = malloc( sizeof(*ptr) )))
     {
@@ -608,7 +717,10 @@ static struct cached_font *add_cached_font( DC *dc, HFONT hfont, UINT aa_flags )
 
     *ptr = font;
     ptr->ref = 1;
+    ptr->ascii_cached = FALSE;
+    ptr->lookups = ptr->hits = ptr->misses = 0;
     memset( ptr->glyphs, 0, sizeof(ptr->glyphs) );
+    list_add_tail( bucket, &ptr->hash_entry );
 done:
     list_add_head( &font_cache, &ptr->entry );
     pthread_mutex_unlock( &font_cache_lock );
@@ -621,40 +733,63 @@ void release_cached_font( struct cached_font *font )
     if (font) InterlockedDecrement( &font->ref );
 }
 
+/* add a glyph to the cache, the returned glyph must be released by the caller */
 static struct cached_glyph *add_cached_glyph( struct cached_font *font, UINT index, UINT flags,
                                               struct cached_glyph *glyph )
 {
-    struct cached_glyph *ret;
+    struct cached_glyph *ret, **glyphs;
     enum glyph_type type = (flags & ETO_GLYPH_INDEX) ? GLYPH_INDEX : GLYPH_WCHAR;
     UINT page = index / GLYPH_CACHE_PAGE_SIZE;
     UINT entry = index % GLYPH_CACHE_PAGE_SIZE;
 
+    pthread_mutex_lock( &font_cache_lock );
     if (!font->glyphs[type][page])
     {
-        struct cached_glyph **ptr;
-
-        ptr = calloc( 1, GLYPH_CACHE_PAGE_SIZE * sizeof(*ptr) );
-        if (!ptr)
+        if (!(glyphs = calloc( 1, GLYPH_CACHE_PAGE_SIZE * sizeof(struct cached_glyph *) )))
         {
+            pthread_mutex_unlock( &font_cache_lock );
             free( glyph );
             return NULL;
         }
-        if (InterlockedCompareExchangePointer( (void **)&font->glyphs[type][page], ptr, NULL ))
-            free( ptr );
+        InterlockedExchangePointer( (void **)&font->glyphs[type][page], glyphs );
     }
-    ret = InterlockedCompareExchangePointer( (void **)&font->glyphs[type][page][entry], glyph, NULL );
-    if (!ret) ret = glyph;
-    else free( glyph );
-    return ret;
+    if ((ret = font->glyphs[type][page][entry]))  /* another thread got there first */
+    {
+        InterlockedIncrement( &ret->ref );
+        pthread_mutex_unlock( &font_cache_lock );
+        free( glyph );
+        return ret;
+    }
+    glyph->ref = 2;  /* one for the cache and one for the caller */
+    glyph->used = FALSE;
+    glyph->font = font;
+    glyph->slot = &font->glyphs[type][page][entry];
+    InterlockedExchangePointer( (void **)glyph->slot, glyph );
+    list_add_head( &glyph_lru, &glyph->entry );
+    glyph_cache_size += glyph->size;
+    trim_glyph_cache();
+    pthread_mutex_unlock( &font_cache_lock );
+    return glyph;
 }
 
+/* look up a glyph in the cache, the returned glyph must be released by the caller
+ *
+ * This doesn't take the cache lock. The lookups count of the font keeps an evicted
+ * glyph alive until we had a chance to take a reference to it. */
 static struct cached_glyph *get_cached_glyph( struct cached_font *font, UINT index, UINT flags )
 {
     enum glyph_type type = (flags & ETO_GLYPH_INDEX) ? GLYPH_INDEX : GLYPH_WCHAR;
     UINT page = index / GLYPH_CACHE_PAGE_SIZE;
+    struct cached_glyph **glyphs, *glyph = NULL;
 
-    if (!font->glyphs[type][page]) return NULL;
-    return font->glyphs[type][page][index % GLYPH_CACHE_PAGE_SIZE];
+    InterlockedIncrement( &font->lookups );
+    if ((glyphs = font->glyphs[type][page]) && (glyph = glyphs[index % GLYPH_CACHE_PAGE_SIZE]))
+    {
+        InterlockedIncrement( &glyph->ref );
+        if (!glyph->used) glyph->used = TRUE;
+    }
+    InterlockedDecrement( &font->lookups );
+    return glyph;
 }
 
 /**********************************************************************
@@ -771,6 +906,7 @@ static struct cached_glyph *cache_glyph_bitmap( DC *dc, struct cached_font *font
     size = metrics.gmBlackBoxY * stride;
     glyph = malloc( FIELD_OFFSET( struct cached_glyph, bits[size] ));
     if (!glyph) return NULL;
+    glyph->size = FIELD_OFFSET( struct cached_glyph, bits[size] );
     if (!size) goto done;  /* empty glyph */
 
     if (bit_count == 8) pad = padding[ metrics.gmBlackBoxX % 4 ];
@@ -807,6 +943,44 @@ done:
     return add_cached_glyph( font, index, flags, glyph );
 }
 
+/* rasterize the printable ASCII glyphs in one go, most text needs a good part of them anyway */
+static void cache_ascii_glyphs( DC *dc, struct cached_font *font )
+{
+    struct cached_glyph *glyph;
+    WCHAR ch;
+
+    font->ascii_cached = TRUE;
+    for (ch = 0x20; ch < 0x7f; ch++)
+    {
+        if ((glyph = get_cached_glyph( font, ch, 0 )) || (glyph = cache_glyph_bitmap( dc, font, ch, 0 )))
+            release_cached_glyph( glyph );
+    }
+}
+
+static struct cached_glyph *get_glyph( DC *dc, struct cached_font *font, UINT index, UINT flags )
+{
+    struct cached_glyph *glyph;
+
+    if ((glyph = get_cached_glyph( font, index, flags )))
+    {
+        /* only count hits when tracing, to keep the lookups off shared counters */
+        if (TRACE_ON(dib))
+        {
+            InterlockedIncrement( &font->hits );
+            InterlockedIncrement( &glyph_cache_hits );
+        }
+        return glyph;
+    }
+    InterlockedIncrement( &font->misses );
+    InterlockedIncrement( &glyph_cache_misses );
+    if (!(flags & ETO_GLYPH_INDEX) && index >= 0x20 && index < 0x7f && !font->ascii_cached)
+    {
+        cache_ascii_glyphs( dc, font );
+        if ((glyph = get_cached_glyph( font, index, flags ))) return glyph;
+    }
+    return cache_glyph_bitmap( dc, font, index, flags );
+}
+
 static void render_string( DC *dc, dib_info *dib, struct cached_font *font, INT x, INT y,
                            UINT flags, const WCHAR *str, UINT count, const INT *dx,
                            const struct clipped_rects *clipped_rects, RECT *bounds )
@@ -832,8 +1006,7 @@ static void render_string( DC *dc, dib_info *dib, struct cached_font *font, INT
 
     for (i = 0; i < count; i++)
     {
-        if (!(glyph = get_cached_glyph( font, str[i], flags )) &&
-            !(glyph = cache_glyph_bitmap( dc, font, str[i], flags ))) continue;
+        if (!(glyph = get_glyph( dc, font, str[i], flags ))) continue;
 
         glyph_dib.width       = glyph->metrics.gmBlackBoxX;
         glyph_dib.height      = glyph->metrics.gmBlackBoxY;
@@ -859,6 +1032,7 @@ static void render_string( DC *dc, dib_info *dib, struct cached_font *font, INT
             x += glyph->metrics.gmCellIncX;
             y += glyph->metrics.gmCellIncY;
         }
+        release_cached_glyph( glyph );
     }
 }
 
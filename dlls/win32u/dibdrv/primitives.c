@@ -23,6 +23,9 @@
 #endif
 
 #include <assert.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <emmintrin.h>
+#endif
 
 #include "ntgdi_private.h"
 #include "dibdrv.h"
@@ -136,6 +139,18 @@ case R2_WHITE:        LOOP( (_d) = ~0 ) break;
 case R2_COPYPEN:      LOOP( (_d) = (_s) ) break;                        \
 ROPS_WITHOUT_COPY( (_d), (_s) )
 
+/* inner loops of the most used primitives, vectorized versions are selected at init time */
+struct row_funcs
+{
+    void (*solid_rop_32)( DWORD *ptr, int len, DWORD and, DWORD xor );
+    void (*solid_rop_24)( DWORD *ptr, int count, const DWORD *and_masks, const DWORD *xor_masks );
+    void (*blend_argb)( DWORD *dst, const DWORD *src, int len, DWORD alpha );
+    void (*blend_constant_alpha)( DWORD *dst, const DWORD *src, int len, DWORD alpha, BOOL src_alpha );
+};
+
+static const struct row_funcs scalar_row_funcs;
+static const struct row_funcs *row_funcs = &scalar_row_funcs;
+
 static inline void do_rop_32(DWORD *ptr, DWORD and, DWORD xor)
 {
     *ptr = (*ptr & and) ^ xor;
@@ -268,10 +283,26 @@ static inline void memset_16( WORD *start, WORD val, DWORD size )
 #endif
 }
 
+static void solid_row_rop_32( DWORD *ptr, int len, DWORD and, DWORD xor )
+{
+    while (len--) do_rop_32( ptr++, and, xor );
+}
+
+/* count is the number of DWORD triplets, i.e. groups of 4 pixels */
+static void solid_row_rop_24( DWORD *ptr, int count, const DWORD *and_masks, const DWORD *xor_masks )
+{
+    while (count--)
+    {
+        do_rop_32( ptr++, and_masks[0], xor_masks[0] );
+        do_rop_32( ptr++, and_masks[1], xor_masks[1] );
+        do_rop_32( ptr++, and_masks[2], xor_masks[2] );
+    }
+}
+
 static void solid_rects_32(const dib_info *dib, int num, const RECT *rc, DWORD and, DWORD xor)
 {
-    DWORD *ptr, *start;
-    int x, y, i;
+    DWORD *start;
+    int y, i;
 
     for(i = 0; i < num; i++, rc++)
     {
@@ -280,8 +311,7 @@ static void solid_rects_32(const dib_info *dib, int num, const RECT *rc, DWORD a
         start = get_pixel_ptr_32(dib, rc->left, rc->top);
         if (and)
             for(y = rc->top; y < rc->bottom; y++, start += dib->stride / 4)
-                for(x = rc->left, ptr = start; x < rc->right; x++)
-                    do_rop_32(ptr++, and, xor);
+                row_funcs->solid_rop_32( start, rc->right - rc->left, and, xor );
         else
             for(y = rc->top; y < rc->bottom; y++, start += dib->stride / 4)
                 memset_32( start, xor, rc->right - rc->left );
@@ -345,12 +375,9 @@ static void solid_rects_24(const dib_info *dib, int num, const RECT *rc, DWORD a
                     break;
                 }
 
-                for(x = (left + 3) & ~3; x < (right & ~3); x += 4)
-                {
-                    do_rop_32(ptr++, and_masks[0], xor_masks[0]);
-                    do_rop_32(ptr++, and_masks[1], xor_masks[1]);
-                    do_rop_32(ptr++, and_masks[2], xor_masks[2]);
-                }
+                x = ((right & ~3) - ((left + 3) & ~3)) / 4;
+                row_funcs->solid_rop_24( ptr, x, and_masks, xor_masks );
+                ptr += x * 3;
 
                 switch(right & 3)
                 {
@@ -4682,10 +4709,30 @@ static inline DWORD blend_rgb( BYTE dst_r, BYTE dst_g, BYTE dst_b, DWORD src, BL
             blend_color( dst_r, src >> 16, blend.SourceConstantAlpha ) << 16);
 }
 
+static void blend_row_argb( DWORD *dst, const DWORD *src, int len, DWORD alpha )
+{
+    int x;
+
+    if (alpha == 255)
+        for (x = 0; x < len; x++) dst[x] = blend_argb( dst[x], src[x] );
+    else
+        for (x = 0; x < len; x++) dst[x] = blend_argb_alpha( dst[x], src[x], alpha );
+}
+
+static void blend_row_constant_alpha( DWORD *dst, const DWORD *src, int len, DWORD alpha, BOOL src_alpha )
+{
+    int x;
+
+    if (src_alpha)
+        for (x = 0; x < len; x++) dst[x] = blend_argb_constant_alpha( dst[x], src[x], alpha );
+    else
+        for (x = 0; x < len; x++) dst[x] = blend_argb_no_src_alpha( dst[x], src[x], alpha );
+}
+
 static void blend_rects_8888(const dib_info *dst, int num, const RECT *rc,
                              const dib_info *src, const POINT *offset, BLENDFUNCTION blend)
 {
-    int i, x, y;
+    int i, y;
 
     for (i = 0; i < num; i++, rc++)
     {
@@ -4693,24 +4740,12 @@ static void blend_rects_8888(const dib_info *dst, int num, const RECT *rc,
         DWORD *dst_ptr = get_pixel_ptr_32( dst, rc->left, rc->top );
 
         if (blend.AlphaFormat & AC_SRC_ALPHA)
-        {
-            if (blend.SourceConstantAlpha == 255)
-                for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
-                    for (x = 0; x < rc->right - rc->left; x++)
-                        dst_ptr[x] = blend_argb( dst_ptr[x], src_ptr[x] );
-            else
-                for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
-                    for (x = 0; x < rc->right - rc->left; x++)
-                        dst_ptr[x] = blend_argb_alpha( dst_ptr[x], src_ptr[x], blend.SourceConstantAlpha );
-        }
-        else if (src->compression == BI_RGB)
             for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
-                for (x = 0; x < rc->right - rc->left; x++)
-                    dst_ptr[x] = blend_argb_constant_alpha( dst_ptr[x], src_ptr[x], blend.SourceConstantAlpha );
+                row_funcs->blend_argb( dst_ptr, src_ptr, rc->right - rc->left, blend.SourceConstantAlpha );
         else
             for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
-                for (x = 0; x < rc->right - rc->left; x++)
-                    dst_ptr[x] = blend_argb_no_src_alpha( dst_ptr[x], src_ptr[x], blend.SourceConstantAlpha );
+                row_funcs->blend_constant_alpha( dst_ptr, src_ptr, rc->right - rc->left,
+                                                 blend.SourceConstantAlpha, src->compression == BI_RGB );
     }
 }
 
@@ -4760,7 +4795,8 @@ static void blend_rects_32(const dib_info *dst, int num, const RECT *rc,
 static void blend_rects_24(const dib_info *dst, int num, const RECT *rc,
                            const dib_info *src, const POINT *offset, BLENDFUNCTION blend)
 {
-    int i, x, y;
+    DWORD buffer[64];
+    int i, j, x, y, len;
 
     for (i = 0; i < num; i++, rc++)
     {
@@ -4769,13 +4805,24 @@ static void blend_rects_24(const dib_info *dst, int num, const RECT *rc,
 
         for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride, src_ptr += src->stride / 4)
         {
-            for (x = 0; x < rc->right - rc->left; x++)
+            /* expand to 32-bpp with a zero alpha, the 8888 row functions then give
+             * the same color channels as blend_rgb() */
+            for (x = 0; x < rc->right - rc->left; x += len)
             {
-                DWORD val = blend_rgb( dst_ptr[x * 3 + 2], dst_ptr[x * 3 + 1], dst_ptr[x * 3],
-                                       src_ptr[x], blend );
-                dst_ptr[x * 3]     = val;
-                dst_ptr[x * 3 + 1] = val >> 8;
-                dst_ptr[x * 3 + 2] = val >> 16;
+                BYTE *ptr = dst_ptr + x * 3;
+
+                len = min( rc->right - rc->left - x, ARRAY_SIZE(buffer) );
+                for (j = 0; j < len; j++, ptr += 3) buffer[j] = ptr[0] | ptr[1] << 8 | ptr[2] << 16;
+                if (blend.AlphaFormat & AC_SRC_ALPHA)
+                    row_funcs->blend_argb( buffer, src_ptr + x, len, blend.SourceConstantAlpha );
+                else
+                    row_funcs->blend_constant_alpha( buffer, src_ptr + x, len, blend.SourceConstantAlpha, TRUE );
+                for (j = 0, ptr = dst_ptr + x * 3; j < len; j++, ptr += 3)
+                {
+                    ptr[0] = buffer[j];
+                    ptr[1] = buffer[j] >> 8;
+                    ptr[2] = buffer[j] >> 16;
+                }
             }
         }
     }
@@ -8036,6 +8083,154 @@ static void halftone_null( const dib_info *dst_dib, const struct bitblt_coords *
                            const dib_info *src_dib, const struct bitblt_coords *src )
 {}
 
+static const struct row_funcs scalar_row_funcs =
+{
+    solid_row_rop_32,
+    solid_row_rop_24,
+    blend_row_argb,
+    blend_row_constant_alpha
+};
+
+#if defined(__i386__) || defined(__x86_64__)
+
+#define SSE2_TARGET __attribute__((target("sse2")))
+
+static void SSE2_TARGET solid_row_rop_32_sse2( DWORD *ptr, int len, DWORD and, DWORD xor )
+{
+    __m128i and_mask = _mm_set1_epi32( and ), xor_mask = _mm_set1_epi32( xor );
+    __m128i val;
+
+    for (; len >= 4; len -= 4, ptr += 4)
+    {
+        val = _mm_loadu_si128( (__m128i *)ptr );
+        val = _mm_xor_si128( _mm_and_si128( val, and_mask ), xor_mask );
+        _mm_storeu_si128( (__m128i *)ptr, val );
+    }
+    solid_row_rop_32( ptr, len, and, xor );
+}
+
+static void SSE2_TARGET solid_row_rop_24_sse2( DWORD *ptr, int count, const DWORD *and_masks,
+                                               const DWORD *xor_masks )
+{
+    /* four triplets fill three vectors, each one starting at a different mask */
+    __m128i and0 = _mm_set_epi32( and_masks[0], and_masks[2], and_masks[1], and_masks[0] );
+    __m128i and1 = _mm_set_epi32( and_masks[1], and_masks[0], and_masks[2], and_masks[1] );
+    __m128i and2 = _mm_set_epi32( and_masks[2], and_masks[1], and_masks[0], and_masks[2] );
+    __m128i xor0 = _mm_set_epi32( xor_masks[0], xor_masks[2], xor_masks[1], xor_masks[0] );
+    __m128i xor1 = _mm_set_epi32( xor_masks[1], xor_masks[0], xor_masks[2], xor_masks[1] );
+    __m128i xor2 = _mm_set_epi32( xor_masks[2], xor_masks[1], xor_masks[0], xor_masks[2] );
+    __m128i *vec;
+
+    for (; count >= 4; count -= 4, ptr += 12)
+    {
+        vec = (__m128i *)ptr;
+        _mm_storeu_si128( vec, _mm_xor_si128( _mm_and_si128( _mm_loadu_si128( vec ), and0 ), xor0 ));
+        vec++;
+        _mm_storeu_si128( vec, _mm_xor_si128( _mm_and_si128( _mm_loadu_si128( vec ), and1 ), xor1 ));
+        vec++;
+        _mm_storeu_si128( vec, _mm_xor_si128( _mm_and_si128( _mm_loadu_si128( vec ), and2 ), xor2 ));
+    }
+    solid_row_rop_24( ptr, count, and_masks, xor_masks );
+}
+
+/* (x + 127) / 255 on 16-bit channels, exact for x <= 255 * 255 */
+static inline __m128i SSE2_TARGET div255_sse2( __m128i x )
+{
+    x = _mm_add_epi16( x, _mm_set1_epi16( 127 ));
+    x = _mm_add_epi16( _mm_add_epi16( x, _mm_set1_epi16( 1 )), _mm_srli_epi16( x, 8 ));
+    return _mm_srli_epi16( x, 8 );
+}
+
+/* pack channel sums of up to 9 bits back into pixels; like in blend_argb(),
+ * an overflowing channel spills into the low bit of the next one */
+static inline __m128i SSE2_TARGET pack_channel_sums_sse2( __m128i lo, __m128i hi )
+{
+    __m128i mask = _mm_set1_epi16( 0xff );
+    __m128i val = _mm_packus_epi16( _mm_and_si128( lo, mask ), _mm_and_si128( hi, mask ));
+    __m128i carry = _mm_packus_epi16( _mm_srli_epi16( lo, 8 ), _mm_srli_epi16( hi, 8 ));
+
+    return _mm_or_si128( val, _mm_slli_epi32( carry, 8 ));
+}
+
+/* blend two premultiplied pixels expanded to 16-bit channels, see blend_argb_alpha() */
+static inline __m128i SSE2_TARGET blend_argb_sse2( __m128i dst, __m128i src, __m128i alpha, BOOL scale )
+{
+    __m128i src_alpha;
+
+    if (scale) src = div255_sse2( _mm_mullo_epi16( src, alpha ));
+    src_alpha = _mm_shufflehi_epi16( _mm_shufflelo_epi16( src, 0xff ), 0xff );
+    dst = _mm_mullo_epi16( dst, _mm_sub_epi16( _mm_set1_epi16( 255 ), src_alpha ));
+    return _mm_add_epi16( src, div255_sse2( dst ));
+}
+
+static void SSE2_TARGET blend_row_argb_sse2( DWORD *dst, const DWORD *src, int len, DWORD alpha )
+{
+    __m128i zero = _mm_setzero_si128(), const_alpha = _mm_set1_epi16( alpha );
+    __m128i s, d, lo, hi;
+    int x;
+
+    for (x = 0; x + 4 <= len; x += 4)
+    {
+        s = _mm_loadu_si128( (const __m128i *)(src + x) );
+        d = _mm_loadu_si128( (const __m128i *)(dst + x) );
+        lo = blend_argb_sse2( _mm_unpacklo_epi8( d, zero ), _mm_unpacklo_epi8( s, zero ),
+                              const_alpha, alpha != 255 );
+        hi = blend_argb_sse2( _mm_unpackhi_epi8( d, zero ), _mm_unpackhi_epi8( s, zero ),
+                              const_alpha, alpha != 255 );
+        _mm_storeu_si128( (__m128i *)(dst + x), pack_channel_sums_sse2( lo, hi ));
+    }
+    blend_row_argb( dst + x, src + x, len - x, alpha );
+}
+
+/* see blend_color() */
+static inline __m128i SSE2_TARGET blend_color_sse2( __m128i dst, __m128i src, __m128i alpha, __m128i inv_alpha )
+{
+    return div255_sse2( _mm_add_epi16( _mm_mullo_epi16( src, alpha ), _mm_mullo_epi16( dst, inv_alpha )));
+}
+
+static void SSE2_TARGET blend_row_constant_alpha_sse2( DWORD *dst, const DWORD *src, int len,
+                                                       DWORD alpha, BOOL src_alpha )
+{
+    __m128i zero = _mm_setzero_si128(), const_alpha = _mm_set1_epi16( alpha );
+    __m128i inv_alpha = _mm_set1_epi16( 255 - alpha );
+    __m128i src_mask = _mm_set1_epi32( src_alpha ? 0 : 0xff000000 );
+    __m128i s, d, lo, hi;
+    int x;
+
+    for (x = 0; x + 4 <= len; x += 4)
+    {
+        s = _mm_or_si128( _mm_loadu_si128( (const __m128i *)(src + x) ), src_mask );
+        d = _mm_loadu_si128( (const __m128i *)(dst + x) );
+        lo = blend_color_sse2( _mm_unpacklo_epi8( d, zero ), _mm_unpacklo_epi8( s, zero ),
+                               const_alpha, inv_alpha );
+        hi = blend_color_sse2( _mm_unpackhi_epi8( d, zero ), _mm_unpackhi_epi8( s, zero ),
+                               const_alpha, inv_alpha );
+        _mm_storeu_si128( (__m128i *)(dst + x), _mm_packus_epi16( lo, hi ));
+    }
+    blend_row_constant_alpha( dst + x, src + x, len - x, alpha, src_alpha );
+}
+
+static const struct row_funcs sse2_row_funcs =
+{
+    solid_row_rop_32_sse2,
+    solid_row_rop_24_sse2,
+    blend_row_argb_sse2,
+    blend_row_constant_alpha_sse2
+};
+
+#endif  /* __i386__ || __x86_64__ */
+
+void init_dib_primitives(void)
+{
+#ifdef __x86_64__
+    row_funcs = &sse2_row_funcs;  /* always available */
+#elif defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports( "sse2" )) row_funcs = &sse2_row_funcs;
+#endif
+    TRACE( "using %s row functions\n", row_funcs == &scalar_row_funcs ? "scalar" : "sse2" );
+}
+
 const primitive_funcs funcs_8888 =
 {
     solid_rects_32,
@@ -48,7 +48,6 @@
 WINE_DEFAULT_DEBUG_CHANNEL(font);
 
 static HKEY wine_fonts_key;
-static HKEY wine_fonts_cache_key;
 HKEY hkcu_key;
 
 struct font_physdev
@@ -1245,170 +1244,380 @@ int add_gdi_face( const WCHAR *family_name, const WCHAR *second_name,
     return ret;
 }
 
-/* font cache */
+/* font cache
+ *
+ * Faces added with ADDFONT_ADD_TO_CACHE are stored in a section shared by all the
+ * processes of the session, so that new processes can rebuild the font list without
+ * going through the registry. Records are appended under the font mutex, removed
+ * faces are flagged as deleted, and the deleted records are compacted away when the
+ * section is full. Adding a face that is already cached with identical data keeps
+ * the existing record. When the write time of a font directory changes, the records
+ * of the files that have disappeared from it are discarded.
+ */
+
+#define FACE_DB_MAGIC     0x42444657  /* "WFDB" */
+#define FACE_DB_VERSION   1
+#define FACE_DB_SIZE      (4 * 1024 * 1024)
+#define FACE_DB_MAX_DIRS  64
+
+struct face_db_dir
+{
+    LARGE_INTEGER           write_time;
+    WCHAR                   path[MAX_PATH];
+};
+
+struct face_db
+{
+    DWORD                   magic;
+    DWORD                   version;
+    DWORD                   size;       /* used size, including the header */
+    DWORD                   dir_count;
+    struct face_db_dir      dirs[FACE_DB_MAX_DIRS];
+    /* struct cached_face   faces[]; */
+};
 
 struct cached_face
 {
+    DWORD                   record_size;
+    DWORD                   deleted;
+    DWORD                   dir;        /* index in face_db->dirs, ~0u if not tracked */
+    DWORD                   scalable;
     DWORD                   index;
     DWORD                   flags;
     DWORD                   ntmflags;
     DWORD                   version;
     struct bitmap_font_size size;
     FONTSIGNATURE           fs;
-    WCHAR                   full_name[1];
-    /* WCHAR                file_name[]; */
+    WCHAR                   names[1];
+    /* family, second, style, full and file names, null-terminated */
 };
 
-static void load_face_from_cache( HKEY hkey_family, struct gdi_font_family *family,
-                                  void *buffer, DWORD buffer_size, BOOL scalable )
+#define CACHED_FACE_NAMES 5
+
+static HANDLE font_mutex;
+static struct face_db *face_db;
+
+static void lock_face_db(void)
 {
-    KEY_VALUE_FULL_INFORMATION *info = (KEY_VALUE_FULL_INFORMATION *)buffer;
-    KEY_NODE_INFORMATION *node_info = (KEY_NODE_INFORMATION *)buffer;
-    DWORD index = 0, total_size;
-    struct gdi_font_face *face;
-    HKEY hkey_strike;
-    WCHAR name[256];
+    if (font_mutex) NtWaitForSingleObject( font_mutex, FALSE, NULL );
+}
+
+static void unlock_face_db(void)
+{
+    if (font_mutex) NtReleaseMutant( font_mutex, NULL );
+}
+
+/* return the record at pos, or NULL past the last record or if it is invalid */
+static struct cached_face *get_cached_face( DWORD pos )
+{
+    struct cached_face *cached = (struct cached_face *)((char *)face_db + pos);
+    DWORD i, len, count = 0;
+
+    if (pos >= face_db->size) return NULL;
+    if (face_db->size - pos <= offsetof( struct cached_face, names ) ||
+        cached->record_size <= offsetof( struct cached_face, names ) ||
+        cached->record_size > face_db->size - pos || cached->record_size % sizeof(DWORD))
+    {
+        WARN( "invalid font cache record at %#x\n", pos );
+        return NULL;
+    }
+    len = (cached->record_size - offsetof( struct cached_face, names )) / sizeof(WCHAR);
+    for (i = 0; i < len && count < CACHED_FACE_NAMES; i++) if (!cached->names[i]) count++;
+    if (count < CACHED_FACE_NAMES)
+    {
+        WARN( "invalid font cache record names at %#x\n", pos );
+        return NULL;
+    }
+    return cached;
+}
+
+static inline const WCHAR *next_cached_name( const WCHAR *name )
+{
+    return name + lstrlenW( name ) + 1;
+}
+
+static const WCHAR *get_cached_file_name( const struct cached_face *cached )
+{
+    const WCHAR *name = cached->names;
+    int i;
+
+    for (i = 0; i < CACHED_FACE_NAMES - 1; i++) name = next_cached_name( name );
+    return name;
+}
+
+static BOOL get_file_write_time( const WCHAR *path, LARGE_INTEGER *time )
+{
+    FILE_NETWORK_OPEN_INFORMATION info;
+    UNICODE_STRING nt_name;
+    OBJECT_ATTRIBUTES attr;
+
+    nt_name.Buffer = (WCHAR *)path;
+    nt_name.Length = nt_name.MaximumLength = lstrlenW( path ) * sizeof(WCHAR);
+    InitializeObjectAttributes( &attr, &nt_name, OBJ_CASE_INSENSITIVE, 0, NULL );
+    if (NtQueryFullAttributesFile( &attr, &info )) return FALSE;
+    *time = info.LastWriteTime;
+    return TRUE;
+}
+
+/* returns TRUE if the database has just been created, in which case it needs to be filled */
+static BOOL open_face_db(void)
+{
+    static WCHAR face_dbW[] =
+        {'\\','B','a','s','e','N','a','m','e','d','O','b','j','e','c','t','s',
+         '\\','_','_','W','I','N','E','_','F','O','N','T','_','C','A','C','H','E','_','_'};
+    OBJECT_ATTRIBUTES attr = { sizeof(attr) };
+    UNICODE_STRING name;
+    LARGE_INTEGER size;
+    SIZE_T view_size = 0;
+    HANDLE section;
+    void *ptr = NULL;
+    NTSTATUS status;
+
+    attr.Attributes = OBJ_OPENIF;
+    attr.ObjectName = &name;
+    name.Buffer = face_dbW;
+    name.Length = name.MaximumLength = sizeof(face_dbW);
+    size.QuadPart = FACE_DB_SIZE;
+
+    status = NtCreateSection( &section, SECTION_ALL_ACCESS, &attr, &size, PAGE_READWRITE, SEC_COMMIT, 0 );
+    if (NT_ERROR( status ))
+    {
+        WARN( "failed to create the font cache section: %#x\n", status );
+        return TRUE;
+    }
+    if (NtMapViewOfSection( section, GetCurrentProcess(), &ptr, zero_bits(), 0, NULL, &view_size,
+                            ViewShare, 0, PAGE_READWRITE ))
+    {
+        WARN( "failed to map the font cache section\n" );
+        NtClose( section );
+        return TRUE;
+    }
+    /* the section handle is kept open, the cache lives as long as a process uses it */
+    face_db = ptr;
+
+    if (status == STATUS_OBJECT_NAME_EXISTS && face_db->magic == FACE_DB_MAGIC &&
+        face_db->version == FACE_DB_VERSION && face_db->size >= sizeof(*face_db) &&
+        face_db->size <= FACE_DB_SIZE && face_db->dir_count <= FACE_DB_MAX_DIRS)
+        return FALSE;
+
+    face_db->magic = FACE_DB_MAGIC;
+    face_db->version = FACE_DB_VERSION;
+    face_db->size = sizeof(*face_db);
+    face_db->dir_count = 0;
+    return TRUE;
+}
+
+/* discard the faces whose file disappeared if the directory has been modified */
+static void update_face_db_dir( DWORD index )
+{
+    struct face_db_dir *dir = &face_db->dirs[index];
     struct cached_face *cached;
+    LARGE_INTEGER time;
+    DWORD pos;
 
-    while (reg_enum_value( hkey_family, index++, info,
-                           buffer_size - sizeof(DWORD), name, sizeof(name) ))
+    if (!get_file_write_time( dir->path, &time )) time.QuadPart = 0;
+    if (time.QuadPart == dir->write_time.QuadPart) return;
+
+    TRACE( "%s has changed, checking cached faces\n", debugstr_w(dir->path) );
+    for (pos = sizeof(*face_db); (cached = get_cached_face( pos )); pos += cached->record_size)
     {
-        cached = (struct cached_face *)((char *)info + info->DataOffset);
-        if (info->Type == REG_BINARY && info->DataLength > sizeof(*cached))
-        {
-            ((DWORD *)cached)[info->DataLength / sizeof(DWORD)] = 0;
-            if ((face = create_face( family, name, cached->full_name,
-                                     cached->full_name + lstrlenW(cached->full_name) + 1,
-                                     NULL, 0, cached->index, cached->fs, cached->ntmflags, cached->version,
-                                     cached->flags, scalable ? NULL : &cached->size )))
-            {
-                if (!scalable)
-                    TRACE("Adding bitmap size h %d w %d size %d x_ppem %d y_ppem %d\n",
-                          face->size.height, face->size.width, face->size.size >> 6,
-                          face->size.x_ppem >> 6, face->size.y_ppem >> 6);
+        LARGE_INTEGER file_time;
 
-                TRACE("fsCsb = %08x %08x/%08x %08x %08x %08x\n",
-                      face->fs.fsCsb[0], face->fs.fsCsb[1],
-                      face->fs.fsUsb[0], face->fs.fsUsb[1],
-                      face->fs.fsUsb[2], face->fs.fsUsb[3]);
+        if (cached->deleted || cached->dir != index) continue;
+        if (get_file_write_time( get_cached_file_name( cached ), &file_time )) continue;
+        TRACE( "removing %s\n", debugstr_w(get_cached_file_name( cached )) );
+        cached->deleted = TRUE;
+    }
+    dir->write_time = time;
+}
 
-                release_face( face );
-            }
-        }
+static DWORD get_face_db_dir( const WCHAR *file )
+{
+    const WCHAR *p = wcsrchr( file, '\\' );
+    struct face_db_dir *dir;
+    DWORD i, len;
+
+    if (!p || (len = p - file) >= MAX_PATH) return ~0u;
+
+    for (i = 0; i < face_db->dir_count; i++)
+    {
+        if (wcsnicmp( face_db->dirs[i].path, file, len ) || face_db->dirs[i].path[len]) continue;
+        update_face_db_dir( i );
+        return i;
     }
 
-    /* load bitmap strikes */
+    if (face_db->dir_count == FACE_DB_MAX_DIRS) return ~0u;
+    dir = &face_db->dirs[face_db->dir_count];
+    memcpy( dir->path, file, len * sizeof(WCHAR) );
+    dir->path[len] = 0;
+    if (!get_file_write_time( dir->path, &dir->write_time )) return ~0u;
+    return face_db->dir_count++;
+}
+
+/* flag the cached faces that would be replaced by face, or all its styles for a bitmap strike */
+static void delete_cached_faces( const struct gdi_font_face *face, BOOL all_styles )
+{
+    struct cached_face *cached;
+    DWORD pos;
 
-    index = 0;
-    while (!NtEnumerateKey( hkey_family, index++, KeyNodeInformation, node_info,
-                            buffer_size, &total_size ))
+    for (pos = sizeof(*face_db); (cached = get_cached_face( pos )); pos += cached->record_size)
     {
-        if ((hkey_strike = reg_open_key( hkey_family, node_info->Name, node_info->NameLength )))
-        {
-            load_face_from_cache( hkey_strike, family, buffer, buffer_size, FALSE );
-            NtClose( hkey_strike );
-        }
+        const WCHAR *style;
+
+        if (cached->deleted || cached->scalable != face->scalable) continue;
+        if (!face->scalable && cached->size.y_ppem != face->size.y_ppem) continue;
+        if (wcsicmp( cached->names, face->family->family_name )) continue;
+        style = next_cached_name( next_cached_name( cached->names ));
+        if (!all_styles && wcsicmp( style, face->style_name )) continue;
+        cached->deleted = TRUE;
     }
 }
 
 static void load_font_list_from_cache(void)
 {
-    WCHAR buffer[4096];
-    KEY_VALUE_PARTIAL_INFORMATION *info = (void *)buffer;
-    KEY_NODE_INFORMATION *enum_info = (KEY_NODE_INFORMATION *)buffer;
-    DWORD family_index = 0, total_size;
+    const WCHAR *second_name, *style, *full_name, *file;
     struct gdi_font_family *family;
-    HKEY hkey_family;
-    WCHAR *second_name = (WCHAR *)info->Data;
+    struct gdi_font_face *face;
+    struct cached_face *cached;
+    DWORD i, pos, count = 0;
+
+    if (!face_db) return;
+
+    lock_face_db();
+
+    for (i = 0; i < face_db->dir_count; i++) update_face_db_dir( i );
 
-    while (!NtEnumerateKey( wine_fonts_cache_key, family_index++, KeyNodeInformation, enum_info,
-                            sizeof(buffer), &total_size ))
+    for (pos = sizeof(*face_db); (cached = get_cached_face( pos )); pos += cached->record_size)
     {
-        if (!(hkey_family = reg_open_key( wine_fonts_cache_key, enum_info->Name,
-                                          enum_info->NameLength )))
-            continue;
-        TRACE( "opened family key %s\n", debugstr_wn(enum_info->Name, enum_info->NameLength / sizeof(WCHAR)) );
-        if (!query_reg_value( hkey_family, NULL, info, sizeof(buffer) ))
-            second_name[0] = 0;
+        if (cached->deleted) continue;
+
+        second_name = next_cached_name( cached->names );
+        style = next_cached_name( second_name );
+        full_name = next_cached_name( style );
+        file = next_cached_name( full_name );
 
-        family = create_family( buffer, second_name );
+        if ((family = find_family_from_name( cached->names ))) family->refcount++;
+        else if (!(family = create_family( cached->names, second_name ))) continue;
+
+        if ((face = create_face( family, style, full_name, file, NULL, 0, cached->index, cached->fs,
+                                 cached->ntmflags, cached->version, cached->flags,
+                                 cached->scalable ? NULL : &cached->size )))
+        {
+            if (!face->scalable)
+                TRACE("Adding bitmap size h %d w %d size %d x_ppem %d y_ppem %d\n",
+                      face->size.height, face->size.width, face->size.size >> 6,
+                      face->size.x_ppem >> 6, face->size.y_ppem >> 6);
 
-        load_face_from_cache( hkey_family, family, buffer, sizeof(buffer), TRUE );
+            TRACE("fsCsb = %08x %08x/%08x %08x %08x %08x\n",
+                  face->fs.fsCsb[0], face->fs.fsCsb[1],
+                  face->fs.fsUsb[0], face->fs.fsUsb[1],
+                  face->fs.fsUsb[2], face->fs.fsUsb[3]);
 
-        NtClose( hkey_family );
+            release_face( face );
+            count++;
+        }
         release_family( family );
     }
+
+    TRACE( "loaded %u faces, %u bytes used\n", count, face_db->size );
+    unlock_face_db();
 }
 
-static void add_face_to_cache( struct gdi_font_face *face )
+/* drop the deleted records to make room at the end of the database */
+static void compact_face_db(void)
 {
-    HKEY hkey_family, hkey_face;
-    DWORD len, buffer[1024];
-    struct cached_face *cached = (struct cached_face *)buffer;
+    struct cached_face *cached;
+    DWORD pos, size, end = sizeof(*face_db);
 
-    if (!(hkey_family = reg_create_key( wine_fonts_cache_key, face->family->family_name,
-                                        lstrlenW( face->family->family_name ) * sizeof(WCHAR),
-                                        REG_OPTION_VOLATILE, NULL )))
-        return;
+    for (pos = sizeof(*face_db); (cached = get_cached_face( pos )); pos += size)
+    {
+        size = cached->record_size;
+        if (cached->deleted) continue;
+        if (pos != end) memmove( (char *)face_db + end, cached, size );
+        end += size;
+    }
+    TRACE( "compacted font cache from %u to %u bytes\n", face_db->size, end );
+    face_db->size = end;
+}
 
-    if (face->family->second_name[0])
-        set_reg_value( hkey_family, NULL, REG_SZ, face->family->second_name,
-                       (lstrlenW( face->family->second_name ) + 1) * sizeof(WCHAR) );
+/* find a live record with the same contents, the directory index aside */
+static BOOL is_face_cached( const struct cached_face *record )
+{
+    const DWORD offset = offsetof( struct cached_face, scalable );
+    struct cached_face *cached;
+    DWORD pos;
 
-    if (!face->scalable)
+    for (pos = sizeof(*face_db); (cached = get_cached_face( pos )); pos += cached->record_size)
     {
-        WCHAR nameW[10];
-        char name[10];
-
-        sprintf( name, "%d", face->size.y_ppem );
-        hkey_face = reg_create_key( hkey_family, nameW,
-                                    asciiz_to_unicode( nameW, name ) - sizeof(WCHAR),
-                                    REG_OPTION_VOLATILE, NULL );
+        if (cached->deleted || cached->record_size != record->record_size) continue;
+        if (!memcmp( (char *)cached + offset, (char *)record + offset, record->record_size - offset ))
+            return TRUE;
     }
-    else hkey_face = hkey_family;
+    return FALSE;
+}
 
-    memset( cached, 0, sizeof(*cached) );
+static void add_face_to_cache( struct gdi_font_face *face )
+{
+    const WCHAR *names[CACHED_FACE_NAMES];
+    struct cached_face *cached;
+    DWORD i, len, size;
+    WCHAR *p;
+
+    if (!face_db || !face->file) return;
+
+    names[0] = face->family->family_name;
+    names[1] = face->family->second_name;
+    names[2] = face->style_name;
+    names[3] = face->full_name;
+    names[4] = face->file;
+    for (i = len = 0; i < ARRAY_SIZE(names); i++) len += lstrlenW( names[i] ) + 1;
+    size = (offsetof( struct cached_face, names[len] ) + sizeof(DWORD) - 1) & ~(sizeof(DWORD) - 1);
+
+    if (!(cached = calloc( 1, size ))) return;
+    cached->record_size = size;
+    cached->scalable = face->scalable;
     cached->index = face->face_index;
     cached->flags = face->flags;
     cached->ntmflags = face->ntmFlags;
     cached->version = face->version;
     cached->fs = face->fs;
     if (!face->scalable) cached->size = face->size;
-    lstrcpyW( cached->full_name, face->full_name );
-    len = lstrlenW( face->full_name ) + 1;
-    lstrcpyW( cached->full_name + len, face->file );
-    len += lstrlenW( face->file ) + 1;
+    for (i = 0, p = cached->names; i < ARRAY_SIZE(names); i++)
+    {
+        lstrcpyW( p, names[i] );
+        p += lstrlenW( p ) + 1;
+    }
+
+    lock_face_db();
+
+    /* other processes add the registry fonts again at startup */
+    if (is_face_cached( cached )) goto done;
+
+    if (face_db->size + size > FACE_DB_SIZE) compact_face_db();
+    if (face_db->size + size > FACE_DB_SIZE)
+    {
+        WARN( "font cache is full, not adding %s\n", debugstr_w(face->full_name) );
+        goto done;
+    }
 
-    set_reg_value( hkey_face, face->style_name, REG_BINARY, cached,
-                   offsetof( struct cached_face, full_name[len] ));
+    delete_cached_faces( face, FALSE );
+    cached->dir = get_face_db_dir( face->file );
+    memcpy( (char *)face_db + face_db->size, cached, size );
+    face_db->size += size;
 
-    if (hkey_face != hkey_family) NtClose( hkey_face );
-    NtClose( hkey_family );
+done:
+    unlock_face_db();
+    free( cached );
 }
 
 static void remove_face_from_cache( struct gdi_font_face *face )
 {
-    HKEY hkey_family, hkey;
-
-    if (!(hkey_family = reg_open_key( wine_fonts_cache_key, face->family->family_name,
-                                      lstrlenW( face->family->family_name ) * sizeof(WCHAR) )))
-        return;
+    if (!face_db) return;
 
-    if (!face->scalable)
-    {
-        WCHAR nameW[10];
-        char name[10];
-        sprintf( name, "%d", face->size.y_ppem );
-        if ((hkey = reg_open_key( hkey_family, nameW,
-                                  asciiz_to_unicode( nameW, name ) - sizeof(WCHAR) )))
-        {
-            NtDeleteKey( hkey );
-            NtClose( hkey );
-        }
-    }
-    else reg_delete_value( hkey_family, face->style_name );
-
-    NtClose( hkey_family );
+    lock_face_db();
+    /* removing a bitmap face drops the whole strike, as the registry cache used to */
+    delete_cached_faces( face, !face->scalable );
+    unlock_face_db();
 }
 
 /* font links */
@@ -4333,6 +4542,9 @@ static UINT init_font_options(void)
         antialias_fakes = (wcschr( valsW, *(const WCHAR *)info->Data ) != NULL);
     }
 
+    /* size of the DIB engine glyph cache, in kilobytes */
+    if (get_key_value( wine_fonts_key, "GlyphCacheSize", &val )) set_glyph_cache_size( (SIZE_T)val * 1024 );
+
     if ((key = reg_open_hkcu_key( "Control Panel\\Desktop" )))
     {
         /* FIXME: handle vertical orientations even though Windows doesn't */
@@ -6308,8 +6520,7 @@ UINT font_init(void)
 {
     OBJECT_ATTRIBUTES attr = { sizeof(attr) };
     UNICODE_STRING name;
-    HANDLE mutex;
-    DWORD disposition;
+    BOOL created;
     UINT dpi = 0;
 
     static WCHAR wine_font_mutexW[] =
@@ -6317,7 +6528,6 @@ UINT font_init(void)
          '\\','_','_','W','I','N','E','_','F','O','N','T','_','M','U','T','E','X','_','_'};
     static const WCHAR wine_fonts_keyW[] =
         {'S','o','f','t','w','a','r','e','\\','W','i','n','e','\\','F','o','n','t','s'};
-    static const WCHAR cacheW[] = {'C','a','c','h','e'};
 
     if (!(hkcu_key = open_hkcu())) return 0;
     wine_fonts_key = reg_create_key( hkcu_key, wine_fonts_keyW, sizeof(wine_fonts_keyW), 0, NULL );
@@ -6337,21 +6547,22 @@ UINT font_init(void)
     name.Buffer = wine_font_mutexW;
     name.Length = name.MaximumLength = sizeof(wine_font_mutexW);
 
-    if (NtCreateMutant( &mutex, MUTEX_ALL_ACCESS, &attr, FALSE ) < 0) return dpi;
-    NtWaitForSingleObject( mutex, FALSE, NULL );
-
-    wine_fonts_cache_key = reg_create_key( wine_fonts_key, cacheW, sizeof(cacheW),
-                                           REG_OPTION_VOLATILE, &disposition );
+    if (NtCreateMutant( &font_mutex, MUTEX_ALL_ACCESS, &attr, FALSE ) < 0)
+    {
+        font_mutex = 0;
+        return dpi;
+    }
+    NtWaitForSingleObject( font_mutex, FALSE, NULL );
 
-    if (disposition == REG_CREATED_NEW_KEY)
+    if ((created = open_face_db()))
     {
         load_registry_fonts();
         update_external_font_keys();
     }
 
-    NtReleaseMutant( mutex, NULL );
+    NtReleaseMutant( font_mutex, NULL );
 
-    if (disposition != REG_CREATED_NEW_KEY)
+    if (!created)
     {
         load_registry_fonts();
         load_font_list_from_cache();
@@ -216,13 +216,25 @@ BOOL WINAPI NtUserSetCursorPos( INT x, INT y )
  */
 BOOL get_cursor_pos( POINT *pt )
 {
+    const desktop_shm_t *shm;
     BOOL ret;
     DWORD last_change;
-    UINT dpi;
+    UINT dpi, seq;
 
     if (!pt) return FALSE;
 
-    SERVER_START_REQ( set_cursor )
+    if ((shm = get_desktop_shm()))
+    {
+        do
+        {
+            seq = shared_read_begin( &shm->seq );
+            pt->x = shm->cursor_x;
+            pt->y = shm->cursor_y;
+            last_change = shm->cursor_last_change;
+        } while (!shared_read_end( &shm->seq, seq ));
+        ret = TRUE;
+    }
+    else SERVER_START_REQ( set_cursor )
     {
         if ((ret = !wine_server_call( req )))
         {
@@ -280,13 +292,18 @@ SHORT WINAPI NtUserGetAsyncKeyState( INT key )
 {
     struct user_key_state_info *key_state_info = get_user_thread_info()->key_state;
     INT counter = global_key_state_counter;
-    BYTE prev_key_state;
+    const desktop_shm_t *shm;
+    BYTE prev_key_state, state;
     SHORT ret;
 
     if (key < 0 || key >= 256) return 0;
 
     check_for_events( QS_INPUT );
 
+    /* the server only needs to be called to clear the pressed since last call bit */
+    if ((shm = get_desktop_shm()) && !((state = shm->keystate[key]) & 0x40))
+        return (state & 0x80) ? 0x8000 : 0;
+
     if (key_state_info && !(key_state_info->state[key] & 0xc0) &&
         key_state_info->counter == counter && NtGetTickCount() - key_state_info->time < 50)
     {
@@ -336,7 +353,9 @@ SHORT WINAPI NtUserGetAsyncKeyState( INT key )
  */
 DWORD WINAPI NtUserGetQueueStatus( UINT flags )
 {
+    const queue_shm_t *shm;
     DWORD ret;
+    UINT seq;
 
     if (flags & ~(QS_ALLINPUT | QS_ALLPOSTMESSAGE | QS_SMRESULT))
     {
@@ -346,6 +365,17 @@ DWORD WINAPI NtUserGetQueueStatus( UINT flags )
 
     check_for_events( flags );
 
+    if ((shm = get_queue_shm()))
+    {
+        do
+        {
+            seq = shared_read_begin( &shm->seq );
+            ret = MAKELONG( shm->changed_bits & flags, shm->wake_bits & flags );
+        } while (!shared_read_end( &shm->seq, seq ));
+        /* we only need the server to clear the changed bits */
+        if (!LOWORD(ret)) return ret;
+    }
+
     SERVER_START_REQ( get_queue_status )
     {
         req->clear_bits = flags;
@@ -361,10 +391,13 @@ DWORD WINAPI NtUserGetQueueStatus( UINT flags )
  */
 DWORD get_input_state(void)
 {
+    const queue_shm_t *shm;
     DWORD ret;
 
     check_for_events( QS_INPUT );
 
+    if ((shm = get_queue_shm())) return shm->wake_bits & (QS_KEY | QS_MOUSEBUTTON);
+
     SERVER_START_REQ( get_queue_status )
     {
         req->clear_bits = 0;
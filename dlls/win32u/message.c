@@ -1777,6 +1777,47 @@ static BOOL process_hardware_message( MSG *msg, UINT hw_id, const struct hardwar
     return ret;
 }
 
+/***********************************************************************
+ *           is_queue_empty
+ *
+ * Check the shared queue state to find out if a get_message request would
+ * return nothing and leave the queue unchanged, so that we can skip it.
+ */
+static BOOL is_queue_empty( HWND hwnd, UINT first, UINT last, UINT flags, UINT changed_mask )
+{
+    struct user_thread_info *thread_info = get_user_thread_info();
+    UINT filter = flags >> 16, wake_mask = changed_mask & (QS_SENDMESSAGE | QS_SMRESULT);
+    UINT clear_bits = 0, seq;
+    const queue_shm_t *shm;
+    BOOL empty;
+
+    /* the idle event is only set by the server */
+    if (hwnd == HWND_TOPMOST) return FALSE;
+    /* invalid windows are only reported by the server */
+    if (hwnd && hwnd != (HWND)1 && !is_window( hwnd )) return FALSE;
+    /* the server considers the queue hung if we don't get messages from it regularly */
+    if (NtGetTickCount() - thread_info->last_getmsg_time > 1000) return FALSE;
+    if (!(shm = get_queue_shm())) return FALSE;
+
+    if (!filter) filter = QS_ALLINPUT;
+    if (filter & QS_POSTMESSAGE)
+    {
+        clear_bits |= QS_POSTMESSAGE | QS_HOTKEY | QS_TIMER;
+        if (first == 0 && last == ~0U) clear_bits |= QS_ALLPOSTMESSAGE;
+    }
+    if (filter & QS_INPUT) clear_bits |= QS_INPUT;
+    if (filter & QS_PAINT) clear_bits |= QS_PAINT;
+
+    do
+    {
+        seq = shared_read_begin( &shm->seq );
+        empty = !(shm->wake_bits & (filter | QS_SENDMESSAGE)) && !(shm->changed_bits & clear_bits) &&
+                shm->wake_mask == wake_mask && shm->changed_mask == changed_mask;
+    } while (!shared_read_end( &shm->seq, seq ));
+
+    return empty;
+}
+
 /***********************************************************************
  *           peek_message
  *
@@ -1808,7 +1849,8 @@ static int peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags,
 
         thread_info->client_info.msg_source = prev_source;
 
-        SERVER_START_REQ( get_message )
+        if (!hw_id && is_queue_empty( hwnd, first, last, flags, changed_mask )) res = STATUS_PENDING;
+        else SERVER_START_REQ( get_message )
         {
             req->flags     = flags;
             req->get_win   = wine_server_user_handle( hwnd );
@@ -1833,6 +1875,7 @@ static int peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags,
                 thread_info->active_hooks = reply->active_hooks;
             }
             else buffer_size = reply->total;
+            thread_info->last_getmsg_time = NtGetTickCount();
         }
         SERVER_END_REQ;
 
@@ -2070,6 +2113,7 @@ static HANDLE get_server_queue_handle(void)
         {
             wine_server_call( req );
             ret = wine_server_ptr_handle( reply->handle );
+            thread_info->queue_shm = get_session_shm( reply->shm_offset );
         }
         SERVER_END_REQ;
         thread_info->server_queue = ret;
@@ -2078,6 +2122,17 @@ static HANDLE get_server_queue_handle(void)
     return ret;
 }
 
+/***********************************************************************
+ *           get_queue_shm
+ *
+ * Get the shared state of the server message queue for the current thread.
+ */
+const queue_shm_t *get_queue_shm(void)
+{
+    get_server_queue_handle();
+    return get_user_thread_info()->queue_shm;
+}
+
 /* check for driver events if we detect that the app is not properly consuming messages */
 static inline void check_for_driver_events( UINT msg )
 {
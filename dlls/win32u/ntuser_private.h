@@ -134,6 +134,9 @@ struct user_thread_info
     DWORD                         kbd_layout_id;          /* Current keyboard layout ID */
     struct rawinput_thread_data  *rawinput;               /* RawInput thread local data / buffer */
     UINT                          spy_indent;             /* Current spy indent */
+    const queue_shm_t            *queue_shm;              /* Queue state in session shared memory */
+    const desktop_shm_t          *desktop_shm;            /* Desktop state in session shared memory */
+    DWORD                         last_getmsg_time;       /* Time of last get_message request */
 };
 
 C_ASSERT( sizeof(struct user_thread_info) <= sizeof(((TEB *)0)->Win32ClientInfo) );
@@ -4917,6 +4917,8 @@ static void thread_detach(void)
     destroy_thread_windows();
     cleanup_imm_thread();
     NtClose( thread_info->server_queue );
+    thread_info->queue_shm = NULL;
+    thread_info->desktop_shm = NULL;
 
     exiting_thread_id = 0;
 }
@@ -308,6 +308,7 @@ extern LRESULT send_internal_message_timeout( DWORD dest_pid, DWORD dest_tid, UI
                                               LPARAM lparam, UINT flags, UINT timeout,
                                               PDWORD_PTR res_ptr ) DECLSPEC_HIDDEN;
 extern LRESULT send_message( HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam ) DECLSPEC_HIDDEN;
+extern const queue_shm_t *get_queue_shm(void) DECLSPEC_HIDDEN;
 extern LRESULT send_message_timeout( HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam,
                                      UINT flags, UINT timeout, BOOL ansi );
 
@@ -410,6 +411,25 @@ static inline void release_win_ptr( struct tagWND *ptr )
     user_unlock();
 }
 
+/* winstation.c */
+extern const volatile void *get_session_shm( unsigned int offset ) DECLSPEC_HIDDEN;
+extern const desktop_shm_t *get_desktop_shm(void) DECLSPEC_HIDDEN;
+
+/* read objects from the session shared memory, retrying until the server isn't updating them */
+
+static inline unsigned int shared_read_begin( const volatile unsigned int *seq )
+{
+    unsigned int ret;
+    while ((ret = __atomic_load_n( seq, __ATOMIC_ACQUIRE )) & 1) YieldProcessor();
+    return ret;
+}
+
+static inline BOOL shared_read_end( const volatile unsigned int *seq, unsigned int prev )
+{
+    __atomic_thread_fence( __ATOMIC_ACQUIRE );
+    return __atomic_load_n( seq, __ATOMIC_RELAXED ) == prev;
+}
+
 extern void wrappers_init( unixlib_handle_t handle ) DECLSPEC_HIDDEN;
 extern void gdi_init(void) DECLSPEC_HIDDEN;
 extern NTSTATUS callbacks_init( void *args ) DECLSPEC_HIDDEN;
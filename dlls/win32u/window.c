@@ -39,6 +39,28 @@ WINE_DEFAULT_DEBUG_CHANNEL(win);
 
 static void *user_handles[NB_USER_HANDLES];
 
+/* offsets of the server shared records of windows we looked up, indexed by handle;
+ * each entry holds the full handle in the high part and the offset in the low part,
+ * so that it can be read and updated atomically by any thread */
+static LONG64 window_shm_cache[256];
+
+/* snapshot of a window shared record */
+struct window_shm_info
+{
+    HWND      parent;
+    HWND      owner;
+    DWORD     tid;
+    DWORD     pid;
+    DWORD     style;
+    DWORD     ex_style;
+    ULONG_PTR id;
+    HINSTANCE instance;
+    ULONG_PTR user_data;
+    UINT      dpi;
+    RECT      window_rect;
+    RECT      client_rect;
+};
+
 #define SWP_AGG_NOGEOMETRYCHANGE \
     (SWP_NOSIZE | SWP_NOCLIENTSIZE | SWP_NOZORDER)
 #define SWP_AGG_NOPOSCHANGE \
@@ -254,6 +276,71 @@ WND *get_win_ptr( HWND hwnd )
     return win;
 }
 
+/***********************************************************************
+ *           get_window_shm_info
+ *
+ * Read the window information published by the server, without a server
+ * round trip once the record of the window is known. Used for windows of
+ * other processes, for which we don't have a WND structure.
+ */
+static BOOL get_window_shm_info( HWND hwnd, struct window_shm_info *info )
+{
+    UINT index = USER_HANDLE_TO_INDEX( hwnd ) % ARRAY_SIZE(window_shm_cache);
+    LONG64 entry = __atomic_load_n( &window_shm_cache[index], __ATOMIC_RELAXED );
+    UINT handle = (ULONG64)entry >> 32, offset = (UINT)entry;
+    const window_shm_t *shm;
+    unsigned int seq;
+    BOOL valid;
+
+    if (!handle || LOWORD(handle) != LOWORD(hwnd) ||
+        (HIWORD(hwnd) && HIWORD(hwnd) != 0xffff && handle != HandleToUlong( hwnd )))
+    {
+        handle = offset = 0;
+        SERVER_START_REQ( get_window_info )
+        {
+            req->handle = wine_server_user_handle( hwnd );
+            if (!wine_server_call( req ))
+            {
+                handle = reply->full_handle;
+                offset = reply->shm_offset;
+            }
+        }
+        SERVER_END_REQ;
+        if (!offset) return FALSE;
+        entry = (ULONG64)handle << 32 | offset;
+        __atomic_store_n( &window_shm_cache[index], entry, __ATOMIC_RELAXED );
+    }
+    if (!(shm = get_session_shm( offset ))) return FALSE;
+
+    do
+    {
+        seq = shared_read_begin( &shm->seq );
+        /* the cache entry may be stale, the record is only valid if it still has the same handle */
+        valid = shm->handle == handle;
+        info->parent      = wine_server_ptr_handle( shm->parent );
+        info->owner       = wine_server_ptr_handle( shm->owner );
+        info->tid         = shm->tid;
+        info->pid         = shm->pid;
+        info->style       = shm->style;
+        info->ex_style    = shm->ex_style;
+        info->id          = shm->id;
+        info->instance    = wine_server_get_ptr( shm->instance );
+        info->user_data   = shm->user_data;
+        info->dpi         = shm->dpi;
+        info->window_rect.left   = shm->window_rect.left;
+        info->window_rect.top    = shm->window_rect.top;
+        info->window_rect.right  = shm->window_rect.right;
+        info->window_rect.bottom = shm->window_rect.bottom;
+        info->client_rect.left   = shm->client_rect.left;
+        info->client_rect.top    = shm->client_rect.top;
+        info->client_rect.right  = shm->client_rect.right;
+        info->client_rect.bottom = shm->client_rect.bottom;
+    } while (!shared_read_end( &shm->seq, seq ));
+
+    if (!valid) InterlockedCompareExchange64( &window_shm_cache[index], 0, entry );
+    return valid;
+}
+
 /***********************************************************************
  *           is_current_thread_window
  *
@@ -290,6 +377,7 @@ HWND is_current_process_window( HWND hwnd )
 /* see IsWindow */
 BOOL is_window( HWND hwnd )
 {
+    struct window_shm_info info;
     WND *win;
     BOOL ret;
 
@@ -301,6 +389,7 @@ BOOL is_window( HWND hwnd )
         release_win_ptr( win );
         return TRUE;
     }
+    if (get_window_shm_info( hwnd, &info )) return TRUE;
 
     /* check other processes */
     SERVER_START_REQ( get_window_info )
@@ -315,6 +404,7 @@ BOOL is_window( HWND hwnd )
 /* see GetWindowThreadProcessId */
 DWORD get_window_thread( HWND hwnd, DWORD *process )
 {
+    struct window_shm_info info;
     WND *ptr;
     DWORD tid = 0;
 
@@ -332,6 +422,11 @@ DWORD get_window_thread( HWND hwnd, DWORD *process )
         release_win_ptr( ptr );
         return tid;
     }
+    if (ptr == WND_OTHER_PROCESS && get_window_shm_info( hwnd, &info ))
+    {
+        if (process) *process = info.pid;
+        return info.tid;
+    }
 
     /* check other processes */
     SERVER_START_REQ( get_window_info )
@@ -350,6 +445,7 @@ DWORD get_window_thread( HWND hwnd, DWORD *process )
 /* see GetParent */
 HWND get_parent( HWND hwnd )
 {
+    struct window_shm_info info;
     HWND retval = 0;
     WND *win;
 
@@ -359,7 +455,12 @@ HWND get_parent( HWND hwnd )
         return 0;
     }
     if (win == WND_DESKTOP) return 0;
-    if (win == WND_OTHER_PROCESS)
+    if (win == WND_OTHER_PROCESS && get_window_shm_info( hwnd, &info ))
+    {
+        if (info.style & WS_POPUP) retval = info.owner;
+        else if (info.style & WS_CHILD) retval = info.parent;
+    }
+    else if (win == WND_OTHER_PROCESS)
     {
         LONG style = get_window_long( hwnd, GWL_STYLE );
         if (style & (WS_POPUP | WS_CHILD))
@@ -545,6 +646,7 @@ HWND get_window_relative( HWND hwnd, UINT rel )
  */
 static HWND *list_window_parents( HWND hwnd )
 {
+    struct window_shm_info info;
     WND *win;
     HWND current, *list;
     int i, pos = 0, size = 16, count;
@@ -555,15 +657,23 @@ static HWND *list_window_parents( HWND hwnd )
     for (;;)
     {
         if (!(win = get_win_ptr( current ))) goto empty;
-        if (win == WND_OTHER_PROCESS) break;  /* need to do it the hard way */
         if (win == WND_DESKTOP)
         {
             if (!pos) goto empty;
             list[pos] = 0;
             return list;
         }
-        list[pos] = current = win->parent;
-        release_win_ptr( win );
+        if (win == WND_OTHER_PROCESS)
+        {
+            if (!get_window_shm_info( current, &info )) break;  /* need to do it the hard way */
+            current = info.parent;
+        }
+        else
+        {
+            current = win->parent;
+            release_win_ptr( win );
+        }
+        list[pos] = current;
         if (!current) return list;
         if (++pos == size - 1)
         {
@@ -888,6 +998,7 @@ DPI_AWARENESS_CONTEXT get_window_dpi_awareness_context( HWND hwnd )
 /* see GetDpiForWindow */
 UINT get_dpi_for_window( HWND hwnd )
 {
+    struct window_shm_info info;
     WND *win;
     UINT ret = 0;
 
@@ -907,6 +1018,10 @@ UINT get_dpi_for_window( HWND hwnd )
         if (!ret) ret = get_win_monitor_dpi( hwnd );
         release_win_ptr( win );
     }
+    else if (get_window_shm_info( hwnd, &info ) && info.dpi)
+    {
+        ret = info.dpi;
+    }
     else
     {
         SERVER_START_REQ( get_window_info )
@@ -972,6 +1087,7 @@ BOOL is_zoomed( HWND hwnd )
 
 static LONG_PTR get_window_long_size( HWND hwnd, INT offset, UINT size, BOOL ansi )
 {
+    struct window_shm_info info;
     LONG_PTR retval = 0;
     WND *win;
 
@@ -1018,6 +1134,17 @@ static LONG_PTR get_window_long_size( HWND hwnd, INT offset, UINT size, BOOL ans
             RtlSetLastWin32Error( ERROR_ACCESS_DENIED );
             return 0;
         }
+        if (offset < 0 && get_window_shm_info( hwnd, &info ))
+        {
+            switch (offset)
+            {
+            case GWL_STYLE:      return info.style;
+            case GWL_EXSTYLE:    return info.ex_style;
+            case GWLP_ID:        return info.id;
+            case GWLP_HINSTANCE: return (ULONG_PTR)info.instance;
+            case GWLP_USERDATA:  return info.user_data;
+            }
+        }
         SERVER_START_REQ( set_window_info )
         {
             req->handle = wine_server_user_handle( hwnd );
@@ -1550,6 +1677,56 @@ static void mirror_rect( const RECT *window_rect, RECT *rect )
     rect->right = width - tmp;
 }
 
+/* get the window and client rectangles from the server shared records, see get_window_rects */
+static BOOL get_window_shm_rects( HWND hwnd, enum coords_relative relative, RECT *window_rect,
+                                  RECT *client_rect, UINT dpi )
+{
+    struct window_shm_info info, parent;
+    RECT window, client;
+
+    if (!get_window_shm_info( hwnd, &info )) return FALSE;
+    if (info.dpi != dpi) return FALSE;  /* let the server do the DPI mapping */
+
+    window = info.window_rect;
+    client = info.client_rect;
+
+    switch (relative)
+    {
+    case COORDS_CLIENT:
+        OffsetRect( &window, -info.client_rect.left, -info.client_rect.top );
+        OffsetRect( &client, -info.client_rect.left, -info.client_rect.top );
+        if (info.ex_style & WS_EX_LAYOUTRTL) mirror_rect( &info.client_rect, &window );
+        break;
+    case COORDS_WINDOW:
+        OffsetRect( &window, -info.window_rect.left, -info.window_rect.top );
+        OffsetRect( &client, -info.window_rect.left, -info.window_rect.top );
+        if (info.ex_style & WS_EX_LAYOUTRTL) mirror_rect( &info.window_rect, &client );
+        break;
+    case COORDS_PARENT:
+        if (!info.parent || is_desktop_window( info.parent )) break;
+        if (!get_window_shm_info( info.parent, &parent )) return FALSE;
+        if (parent.ex_style & WS_EX_LAYOUTRTL)
+        {
+            mirror_rect( &parent.client_rect, &window );
+            mirror_rect( &parent.client_rect, &client );
+        }
+        break;
+    case COORDS_SCREEN:
+        while (info.parent && !is_desktop_window( info.parent ))
+        {
+            if (!get_window_shm_info( info.parent, &info )) return FALSE;
+            OffsetRect( &window, info.client_rect.left, info.client_rect.top );
+            OffsetRect( &client, info.client_rect.left, info.client_rect.top );
+        }
+        break;
+    default:
+        return FALSE;
+    }
+    if (window_rect) *window_rect = window;
+    if (client_rect) *client_rect = client;
+    return TRUE;
+}
+
 /***********************************************************************
  *           get_window_rects
  *
@@ -1660,6 +1837,8 @@ BOOL get_window_rects( HWND hwnd, enum coords_relative relative, RECT *window_re
     }
 
 other_process:
+    if (get_window_shm_rects( hwnd, relative, window_rect, client_rect, dpi )) return TRUE;
+
     SERVER_START_REQ( get_window_rectangles )
     {
         req->handle = wine_server_user_handle( hwnd );
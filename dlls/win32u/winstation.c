@@ -205,6 +205,68 @@ BOOL WINAPI NtUserCloseDesktop( HDESK handle )
     return ret;
 }
 
+/***********************************************************************
+ *           get_session_shm
+ *
+ * Return a pointer to an object in the session shared memory, mapping it on first use.
+ */
+const volatile void *get_session_shm( unsigned int offset )
+{
+    static const WCHAR nameW[] =
+        {'\\','K','e','r','n','e','l','O','b','j','e','c','t','s','\\',
+         '_','_','w','i','n','e','_','s','e','s','s','i','o','n','_','s','h','a','r','e','d','_','d','a','t','a',0};
+    static void *session_shm;
+    static BOOL failed;
+    UNICODE_STRING name;
+    OBJECT_ATTRIBUTES attr;
+    SIZE_T size = 0;
+    HANDLE section;
+    void *ptr = NULL;
+    NTSTATUS status;
+
+    if (!offset || failed) return NULL;
+    if (session_shm) return (char *)session_shm + offset;
+
+    RtlInitUnicodeString( &name, nameW );
+    InitializeObjectAttributes( &attr, &name, 0, NULL, NULL );
+    if (!(status = NtOpenSection( &section, SECTION_MAP_READ, &attr )))
+    {
+        status = NtMapViewOfSection( section, GetCurrentProcess(), &ptr, 0, 0, NULL, &size,
+                                     ViewShare, 0, PAGE_READONLY );
+        NtClose( section );
+    }
+    if (status)
+    {
+        WARN( "failed to map the session shared memory: %#x\n", status );
+        failed = TRUE;
+        return NULL;
+    }
+    if (InterlockedCompareExchangePointer( &session_shm, ptr, NULL ))
+        NtUnmapViewOfSection( GetCurrentProcess(), ptr );
+    return (char *)session_shm + offset;
+}
+
+/***********************************************************************
+ *           get_desktop_shm
+ *
+ * Return the shared cursor and key state of the current thread desktop.
+ */
+const desktop_shm_t *get_desktop_shm(void)
+{
+    struct user_thread_info *thread_info = get_user_thread_info();
+    unsigned int offset = 0;
+
+    if (thread_info->desktop_shm) return thread_info->desktop_shm;
+
+    SERVER_START_REQ( get_thread_desktop )
+    {
+        req->tid = GetCurrentThreadId();
+        if (!wine_server_call( req )) offset = reply->shm_offset;
+    }
+    SERVER_END_REQ;
+    return (thread_info->desktop_shm = get_session_shm( offset ));
+}
+
 /***********************************************************************
  *           NtUserGetThreadDesktop   (win32u.@)
  */
@@ -241,6 +303,7 @@ BOOL WINAPI NtUserSetThreadDesktop( HDESK handle )
         struct user_key_state_info *key_state_info = thread_info->key_state;
         thread_info->client_info.top_window = 0;
         thread_info->client_info.msg_window = 0;
+        thread_info->desktop_shm = NULL;
         if (key_state_info) key_state_info->time = 0;
     }
     return ret;
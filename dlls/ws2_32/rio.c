@@ -0,0 +1,804 @@
+/*
+ * Registered I/O (RIO) extension functions
+ *
+ * Copyright 2026 The Wine Project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * Buffers are locked in memory once when they are registered, and requests
+ * only refer to them by id. Committing a request queue hands the whole batch
+ * of deferred requests to ntdll in a single IOCTL_AFD_WINE_RIO_SUBMIT call,
+ * which performs them directly on the socket with one server call for the
+ * whole batch, so that they are still ordered after asyncs already queued on
+ * the socket. Only the requests that would block are queued as regular asyncs,
+ * and those signal an event waited on by the thread pool; the socket is not
+ * bound to a completion port, so the application is still free to do so.
+ * Results of both kinds are appended to the completion queue ring, from which
+ * RIODequeueCompletion() copies them without making any system call.
+ */
+
+#include "ws2_32_private.h"
+#include "wine/list.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(winsock);
+
+#define RIO_BATCH_SIZE 64
+
+struct rio_buffer
+{
+    char *data;
+    DWORD len;
+};
+
+struct rio_cq
+{
+    CRITICAL_SECTION cs;
+    RIORESULT *results;     /* ring of completed requests */
+    ULONG size;             /* size of the ring */
+    ULONG head;             /* index of the oldest result */
+    ULONG count;            /* number of results in the ring */
+    ULONG reserved;         /* number of entries reserved by request queues */
+    RIO_NOTIFICATION_COMPLETION notify;
+    BOOL armed;             /* RIONotify() was called and no notification was sent yet */
+    LONG refcount;          /* the application handle plus one per request queue using it */
+};
+
+struct rio_rq
+{
+    struct list entry;              /* entry in rq_list */
+    CRITICAL_SECTION cs;
+    SOCKET socket;
+    void *context;
+    struct rio_cq *recv_cq;
+    struct rio_cq *send_cq;
+    ULONG max_recv, max_send;       /* maximum number of outstanding requests */
+    ULONG recv_count, send_count;   /* number of outstanding requests */
+    ULONG recv_async, send_async;   /* number of requests queued as asyncs */
+    struct list deferred;           /* requests waiting to be committed */
+    LONG refcount;
+};
+
+struct rio_request
+{
+    struct list entry;      /* entry in the deferred list */
+    struct rio_rq *rq;
+    IO_STATUS_BLOCK iosb;   /* I/O status of the async */
+    HANDLE event;           /* event signaled when the async completes */
+    TP_WAIT *wait;          /* thread pool wait on the event */
+    WSABUF buf;
+    DWORD ws_flags;         /* receive flags of the async */
+    ULONG done;             /* amount of data already sent directly */
+    DWORD flags;            /* RIO_MSG_* flags */
+    BOOL send;
+    void *context;
+};
+
+static struct list rq_list = LIST_INIT( rq_list );
+
+DECLARE_CRITICAL_SECTION( rq_list_cs );
+
+static struct rio_cq *impl_from_RIO_CQ( RIO_CQ cq )
+{
+    return (struct rio_cq *)cq;
+}
+
+static struct rio_rq *impl_from_RIO_RQ( RIO_RQ rq )
+{
+    return (struct rio_rq *)rq;
+}
+
+static struct rio_buffer *impl_from_RIO_BUFFERID( RIO_BUFFERID id )
+{
+    if (id == RIO_INVALID_BUFFERID) return NULL;
+    return (struct rio_buffer *)id;
+}
+
+static void cq_notify( struct rio_cq *cq )
+{
+    switch (cq->notify.Type)
+    {
+    case RIO_EVENT_COMPLETION:
+        SetEvent( cq->notify.u.Event.EventHandle );
+        break;
+    case RIO_IOCP_COMPLETION:
+        PostQueuedCompletionStatus( cq->notify.u.Iocp.IocpHandle, 0, (ULONG_PTR)cq->notify.u.Iocp.CompletionKey,
+                                    cq->notify.u.Iocp.Overlapped );
+        break;
+    }
+}
+
+static void cq_add_result( struct rio_cq *cq, LONG status, ULONG size, void *socket_context,
+                           void *request_context, BOOL notify )
+{
+    RIORESULT *result;
+
+    EnterCriticalSection( &cq->cs );
+    assert( cq->count < cq->size );
+    result = &cq->results[(cq->head + cq->count++) % cq->size];
+    result->Status = status;
+    result->BytesTransferred = size;
+    result->SocketContext = (ULONG_PTR)socket_context;
+    result->RequestContext = (ULONG_PTR)request_context;
+    if (notify && cq->armed)
+    {
+        cq->armed = FALSE;
+        cq_notify( cq );
+    }
+    LeaveCriticalSection( &cq->cs );
+}
+
+static BOOL reserve_cq_entries( struct rio_cq *recv_cq, LONG recv, struct rio_cq *send_cq, LONG send );
+
+static void cq_release( struct rio_cq *cq )
+{
+    if (InterlockedDecrement( &cq->refcount )) return;
+
+    TRACE( "destroying completion queue %p\n", cq );
+    cq->cs.DebugInfo->Spare[0] = 0;
+    DeleteCriticalSection( &cq->cs );
+    free( cq->results );
+    free( cq );
+}
+
+static void rq_release( struct rio_rq *rq )
+{
+    if (InterlockedDecrement( &rq->refcount )) return;
+
+    TRACE( "destroying request queue %p\n", rq );
+    /* no request can complete anymore, give the entries back to the completion queues */
+    reserve_cq_entries( rq->recv_cq, -(LONG)rq->max_recv, rq->send_cq, -(LONG)rq->max_send );
+    cq_release( rq->recv_cq );
+    cq_release( rq->send_cq );
+    rq->cs.DebugInfo->Spare[0] = 0;
+    DeleteCriticalSection( &rq->cs );
+    free( rq );
+}
+
+/* called with the request queue lock held */
+static void complete_request( struct rio_request *req, NTSTATUS status, ULONG size )
+{
+    struct rio_rq *rq = req->rq;
+
+    TRACE( "request %p, status %#lx, size %lu\n", req, status, size );
+
+    if (req->send)
+    {
+        rq->send_count--;
+        cq_add_result( rq->send_cq, status ? NtStatusToWSAError( status ) : 0, size, rq->context,
+                       req->context, !(req->flags & RIO_MSG_DONT_NOTIFY) );
+    }
+    else
+    {
+        rq->recv_count--;
+        cq_add_result( rq->recv_cq, status ? NtStatusToWSAError( status ) : 0, size, rq->context,
+                       req->context, !(req->flags & RIO_MSG_DONT_NOTIFY) );
+    }
+    free( req );
+}
+
+static void CALLBACK rio_wait_callback( TP_CALLBACK_INSTANCE *instance, void *context, TP_WAIT *wait,
+                                        TP_WAIT_RESULT result )
+{
+    struct rio_request *req = context;
+    struct rio_rq *rq = req->rq;
+    NTSTATUS status = req->iosb.u.Status;
+
+    /* requests pending when the socket is closed are aborted */
+    if (status == STATUS_HANDLES_CLOSED) status = STATUS_CANCELLED;
+
+    CloseThreadpoolWait( wait );
+    CloseHandle( req->event );
+
+    EnterCriticalSection( &rq->cs );
+    if (req->send) rq->send_async--;
+    else rq->recv_async--;
+    complete_request( req, status, req->done + req->iosb.Information );
+    LeaveCriticalSection( &rq->cs );
+    rq_release( rq );
+}
+
+/* queue a request which would block as an async; called with the request queue lock held */
+static void queue_async( struct rio_rq *rq, struct rio_request *req )
+{
+    NTSTATUS status;
+
+    req->buf.buf += req->done;
+    req->buf.len -= req->done;
+
+    if (!(req->event = CreateEventW( NULL, TRUE, FALSE, NULL )))
+    {
+        complete_request( req, STATUS_NO_MEMORY, req->done );
+        return;
+    }
+    if (!(req->wait = CreateThreadpoolWait( rio_wait_callback, req, NULL )))
+    {
+        CloseHandle( req->event );
+        complete_request( req, STATUS_NO_MEMORY, req->done );
+        return;
+    }
+
+    /* no completion context, so that nothing is posted to a port the socket may be bound to */
+    if (req->send)
+    {
+        struct afd_sendmsg_params params = {0};
+
+        params.force_async = 1;
+        params.count = 1;
+        params.buffers_ptr = u64_from_user_ptr( &req->buf );
+        status = NtDeviceIoControlFile( (HANDLE)rq->socket, req->event, NULL, NULL, &req->iosb,
+                                        IOCTL_AFD_WINE_SENDMSG, &params, sizeof(params), NULL, 0 );
+    }
+    else
+    {
+        struct afd_recvmsg_params params = {0};
+
+        req->ws_flags = 0;
+        params.ws_flags_ptr = u64_from_user_ptr( &req->ws_flags );
+        params.force_async = 1;
+        params.count = 1;
+        params.buffers_ptr = u64_from_user_ptr( &req->buf );
+        status = NtDeviceIoControlFile( (HANDLE)rq->socket, req->event, NULL, NULL, &req->iosb,
+                                        IOCTL_AFD_WINE_RECVMSG, &params, sizeof(params), NULL, 0 );
+    }
+    TRACE( "request %p queued, status %#lx\n", req, status );
+
+    if (NT_ERROR(status))
+    {
+        /* the event won't be signaled */
+        CloseThreadpoolWait( req->wait );
+        CloseHandle( req->event );
+        complete_request( req, status, req->done );
+        return;
+    }
+
+    InterlockedIncrement( &rq->refcount );
+    if (req->send) rq->send_async++;
+    else rq->recv_async++;
+    SetThreadpoolWait( req->wait, req->event, NULL );
+}
+
+/* submit the deferred requests of a queue; called with the request queue lock held */
+static void rq_commit( struct rio_rq *rq )
+{
+    struct afd_rio_request batch[RIO_BATCH_SIZE];
+    struct afd_rio_result results[RIO_BATCH_SIZE];
+    struct rio_request *reqs[RIO_BATCH_SIZE];
+    struct rio_request *req, *next;
+    unsigned int i, count;
+    IO_STATUS_BLOCK io;
+    NTSTATUS status;
+
+    while (!list_empty( &rq->deferred ))
+    {
+        count = 0;
+        LIST_FOR_EACH_ENTRY_SAFE( req, next, &rq->deferred, struct rio_request, entry )
+        {
+            if (count == RIO_BATCH_SIZE) break;
+            list_remove( &req->entry );
+
+            /* requests behind a pending async have to wait for it */
+            if (req->send ? rq->send_async : rq->recv_async)
+            {
+                queue_async( rq, req );
+                continue;
+            }
+
+            batch[count].buffer_ptr = u64_from_user_ptr( req->buf.buf );
+            batch[count].len = req->buf.len;
+            batch[count].send = req->send;
+            reqs[count++] = req;
+        }
+        if (!count) continue;
+
+        status = NtDeviceIoControlFile( (HANDLE)rq->socket, NULL, NULL, NULL, &io, IOCTL_AFD_WINE_RIO_SUBMIT,
+                                        batch, count * sizeof(*batch), results, count * sizeof(*results) );
+        TRACE( "submitted %u requests, status %#lx\n", count, status );
+
+        for (i = 0; i < count; ++i)
+        {
+            if (status) complete_request( reqs[i], status, 0 );
+            else if (results[i].status == STATUS_DEVICE_NOT_READY)
+            {
+                reqs[i]->done = results[i].size;
+                queue_async( rq, reqs[i] );
+            }
+            else complete_request( reqs[i], results[i].status, results[i].size );
+        }
+    }
+}
+
+static BOOL rio_queue_request( RIO_RQ queue, RIO_BUF *data, ULONG count, DWORD flags, void *context, BOOL send )
+{
+    struct rio_rq *rq = impl_from_RIO_RQ( queue );
+    struct rio_buffer *buffer = NULL;
+    struct rio_request *req;
+
+    TRACE( "queue %p, data %p, count %lu, flags %#lx, context %p\n", queue, data, count, flags, context );
+
+    if (!rq || count > 1 || (count && !data))
+    {
+        SetLastError( WSAEINVAL );
+        return FALSE;
+    }
+
+    if (flags & RIO_MSG_COMMIT_ONLY)
+    {
+        if (count || (flags & ~RIO_MSG_COMMIT_ONLY))
+        {
+            SetLastError( WSAEINVAL );
+            return FALSE;
+        }
+        EnterCriticalSection( &rq->cs );
+        rq_commit( rq );
+        LeaveCriticalSection( &rq->cs );
+        return TRUE;
+    }
+
+    if (flags & ~(RIO_MSG_DONT_NOTIFY | RIO_MSG_DEFER | RIO_MSG_WAITALL))
+    {
+        SetLastError( WSAEINVAL );
+        return FALSE;
+    }
+    if (flags & RIO_MSG_WAITALL) FIXME( "RIO_MSG_WAITALL is not supported\n" );
+
+    if (count && (!(buffer = impl_from_RIO_BUFFERID( data->BufferId )) || data->Offset > buffer->len
+                  || data->Length > buffer->len - data->Offset))
+    {
+        SetLastError( WSAEINVAL );
+        return FALSE;
+    }
+
+    if (!(req = malloc( sizeof(*req) )))
+    {
+        SetLastError( WSAENOBUFS );
+        return FALSE;
+    }
+    req->rq = rq;
+    req->buf.buf = buffer ? buffer->data + data->Offset : NULL;
+    req->buf.len = buffer ? data->Length : 0;
+    req->done = 0;
+    req->flags = flags;
+    req->send = send;
+    req->context = context;
+
+    EnterCriticalSection( &rq->cs );
+    if (send ? rq->send_count == rq->max_send : rq->recv_count == rq->max_recv)
+    {
+        LeaveCriticalSection( &rq->cs );
+        free( req );
+        SetLastError( WSAENOBUFS );
+        return FALSE;
+    }
+    if (send) rq->send_count++;
+    else rq->recv_count++;
+    list_add_tail( &rq->deferred, &req->entry );
+    if (!(flags & RIO_MSG_DEFER)) rq_commit( rq );
+    LeaveCriticalSection( &rq->cs );
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *     RIOReceive
+ */
+static BOOL WINAPI WS2_RIOReceive( RIO_RQ queue, RIO_BUF *data, ULONG count, DWORD flags, void *context )
+{
+    return rio_queue_request( queue, data, count, flags, context, FALSE );
+}
+
+
+/***********************************************************************
+ *     RIOReceiveEx
+ */
+static int WINAPI WS2_RIOReceiveEx( RIO_RQ queue, RIO_BUF *data, ULONG count, RIO_BUF *local_addr,
+                                    RIO_BUF *remote_addr, RIO_BUF *control, RIO_BUF *ret_flags,
+                                    DWORD flags, void *context )
+{
+    if (local_addr || remote_addr || control || ret_flags)
+    {
+        FIXME( "addresses, control data and flags are not supported\n" );
+        SetLastError( WSAEOPNOTSUPP );
+        return SOCKET_ERROR;
+    }
+    return rio_queue_request( queue, data, count, flags, context, FALSE ) ? 0 : SOCKET_ERROR;
+}
+
+
+/***********************************************************************
+ *     RIOSend
+ */
+static BOOL WINAPI WS2_RIOSend( RIO_RQ queue, RIO_BUF *data, ULONG count, DWORD flags, void *context )
+{
+    if (flags & RIO_MSG_WAITALL)
+    {
+        SetLastError( WSAEINVAL );
+        return FALSE;
+    }
+    return rio_queue_request( queue, data, count, flags, context, TRUE );
+}
+
+
+/***********************************************************************
+ *     RIOSendEx
+ */
+static BOOL WINAPI WS2_RIOSendEx( RIO_RQ queue, RIO_BUF *data, ULONG count, RIO_BUF *local_addr,
+                                  RIO_BUF *remote_addr, RIO_BUF *control, RIO_BUF *ret_flags,
+                                  DWORD flags, void *context )
+{
+    if (local_addr || remote_addr || control || ret_flags)
+    {
+        FIXME( "addresses, control data and flags are not supported\n" );
+        SetLastError( WSAEOPNOTSUPP );
+        return FALSE;
+    }
+    return WS2_RIOSend( queue, data, count, flags, context );
+}
+
+
+/***********************************************************************
+ *     RIOCreateCompletionQueue
+ */
+static RIO_CQ WINAPI WS2_RIOCreateCompletionQueue( DWORD size, RIO_NOTIFICATION_COMPLETION *notify )
+{
+    struct rio_cq *cq;
+
+    TRACE( "size %lu, notify %p\n", size, notify );
+
+    if (!size || size > RIO_MAX_CQ_SIZE)
+    {
+        SetLastError( WSAEINVAL );
+        return RIO_INVALID_CQ;
+    }
+    if (notify && ((notify->Type == RIO_EVENT_COMPLETION && !notify->u.Event.EventHandle)
+                   || (notify->Type == RIO_IOCP_COMPLETION && !notify->u.Iocp.IocpHandle)
+                   || (notify->Type != RIO_EVENT_COMPLETION && notify->Type != RIO_IOCP_COMPLETION)))
+    {
+        SetLastError( WSAEINVAL );
+        return RIO_INVALID_CQ;
+    }
+
+    if (!(cq = calloc( 1, sizeof(*cq) )) || !(cq->results = malloc( size * sizeof(*cq->results) )))
+    {
+        free( cq );
+        SetLastError( WSAENOBUFS );
+        return RIO_INVALID_CQ;
+    }
+    cq->size = size;
+    cq->refcount = 1;
+    if (notify) cq->notify = *notify;
+    InitializeCriticalSection( &cq->cs );
+    cq->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": rio_cq.cs");
+    return (RIO_CQ)cq;
+}
+
+
+/***********************************************************************
+ *     RIOCloseCompletionQueue
+ */
+static void WINAPI WS2_RIOCloseCompletionQueue( RIO_CQ queue )
+{
+    struct rio_cq *cq = impl_from_RIO_CQ( queue );
+
+    TRACE( "queue %p\n", queue );
+
+    /* the request queues still using it keep it alive until they are released */
+    if (cq) cq_release( cq );
+}
+
+
+/***********************************************************************
+ *     RIOResizeCompletionQueue
+ */
+static BOOL WINAPI WS2_RIOResizeCompletionQueue( RIO_CQ queue, DWORD size )
+{
+    struct rio_cq *cq = impl_from_RIO_CQ( queue );
+    RIORESULT *results;
+    ULONG i;
+
+    TRACE( "queue %p, size %lu\n", queue, size );
+
+    if (!cq || !size || size > RIO_MAX_CQ_SIZE)
+    {
+        SetLastError( WSAEINVAL );
+        return FALSE;
+    }
+
+    EnterCriticalSection( &cq->cs );
+    if (size < cq->reserved || size < cq->count)
+    {
+        LeaveCriticalSection( &cq->cs );
+        SetLastError( WSAEINVAL );
+        return FALSE;
+    }
+    if (!(results = malloc( size * sizeof(*results) )))
+    {
+        LeaveCriticalSection( &cq->cs );
+        SetLastError( WSAENOBUFS );
+        return FALSE;
+    }
+    for (i = 0; i < cq->count; ++i) results[i] = cq->results[(cq->head + i) % cq->size];
+    free( cq->results );
+    cq->results = results;
+    cq->size = size;
+    cq->head = 0;
+    LeaveCriticalSection( &cq->cs );
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *     RIODequeueCompletion
+ */
+static ULONG WINAPI WS2_RIODequeueCompletion( RIO_CQ queue, RIORESULT *results, ULONG size )
+{
+    struct rio_cq *cq = impl_from_RIO_CQ( queue );
+    ULONG i, count;
+
+    TRACE( "queue %p, results %p, size %lu\n", queue, results, size );
+
+    if (!cq || !results)
+    {
+        SetLastError( WSAEINVAL );
+        return RIO_CORRUPT_CQ;
+    }
+
+    EnterCriticalSection( &cq->cs );
+    count = min( size, cq->count );
+    for (i = 0; i < count; ++i)
+    {
+        results[i] = cq->results[cq->head];
+        cq->head = (cq->head + 1) % cq->size;
+    }
+    cq->count -= count;
+    LeaveCriticalSection( &cq->cs );
+    return count;
+}
+
+
+/***********************************************************************
+ *     RIONotify
+ */
+static INT WINAPI WS2_RIONotify( RIO_CQ queue )
+{
+    struct rio_cq *cq = impl_from_RIO_CQ( queue );
+    INT ret = 0;
+
+    TRACE( "queue %p\n", queue );
+
+    if (!cq || !cq->notify.Type) return WSAEINVAL;
+
+    EnterCriticalSection( &cq->cs );
+    if (cq->armed) ret = WSAEALREADY;
+    else
+    {
+        if (cq->notify.Type == RIO_EVENT_COMPLETION && cq->notify.u.Event.NotifyReset)
+            ResetEvent( cq->notify.u.Event.EventHandle );
+        if (cq->count) cq_notify( cq );
+        else cq->armed = TRUE;
+    }
+    LeaveCriticalSection( &cq->cs );
+    return ret;
+}
+
+
+static BOOL reserve_cq_entries( struct rio_cq *recv_cq, LONG recv, struct rio_cq *send_cq, LONG send )
+{
+    struct rio_cq *first, *second;
+    BOOL ret;
+
+    if (recv_cq == send_cq)
+    {
+        EnterCriticalSection( &recv_cq->cs );
+        if ((ret = recv_cq->reserved + recv + send <= recv_cq->size)) recv_cq->reserved += recv + send;
+        LeaveCriticalSection( &recv_cq->cs );
+        return ret;
+    }
+
+    /* lock them in a fixed order, other request queues may use them the other way around */
+    first = recv_cq < send_cq ? recv_cq : send_cq;
+    second = recv_cq < send_cq ? send_cq : recv_cq;
+    EnterCriticalSection( &first->cs );
+    EnterCriticalSection( &second->cs );
+    if ((ret = recv_cq->reserved + recv <= recv_cq->size && send_cq->reserved + send <= send_cq->size))
+    {
+        recv_cq->reserved += recv;
+        send_cq->reserved += send;
+    }
+    LeaveCriticalSection( &second->cs );
+    LeaveCriticalSection( &first->cs );
+    return ret;
+}
+
+
+/***********************************************************************
+ *     RIOCreateRequestQueue
+ */
+static RIO_RQ WINAPI WS2_RIOCreateRequestQueue( SOCKET s, ULONG max_recv, ULONG max_recv_bufs, ULONG max_send,
+                                                ULONG max_send_bufs, RIO_CQ recv_queue, RIO_CQ send_queue,
+                                                void *context )
+{
+    struct rio_cq *recv_cq = impl_from_RIO_CQ( recv_queue ), *send_cq = impl_from_RIO_CQ( send_queue );
+    struct rio_rq *rq;
+
+    TRACE( "socket %#Ix, max_recv %lu, max_recv_bufs %lu, max_send %lu, max_send_bufs %lu, "
+           "recv_cq %p, send_cq %p, context %p\n", s, max_recv, max_recv_bufs, max_send, max_send_bufs,
+           recv_queue, send_queue, context );
+
+    if (!recv_cq || !send_cq || max_recv_bufs > 1 || max_send_bufs > 1)
+    {
+        SetLastError( WSAEINVAL );
+        return RIO_INVALID_RQ;
+    }
+
+    if (!(rq = calloc( 1, sizeof(*rq) )))
+    {
+        SetLastError( WSAENOBUFS );
+        return RIO_INVALID_RQ;
+    }
+    if (!reserve_cq_entries( recv_cq, max_recv, send_cq, max_send ))
+    {
+        free( rq );
+        SetLastError( WSAENOBUFS );
+        return RIO_INVALID_RQ;
+    }
+
+    InterlockedIncrement( &recv_cq->refcount );
+    InterlockedIncrement( &send_cq->refcount );
+    rq->socket = s;
+    rq->context = context;
+    rq->recv_cq = recv_cq;
+    rq->send_cq = send_cq;
+    rq->max_recv = max_recv;
+    rq->max_send = max_send;
+    rq->refcount = 1;
+    list_init( &rq->deferred );
+    InitializeCriticalSection( &rq->cs );
+    rq->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": rio_rq.cs");
+
+    EnterCriticalSection( &rq_list_cs );
+    list_add_tail( &rq_list, &rq->entry );
+    LeaveCriticalSection( &rq_list_cs );
+    return (RIO_RQ)rq;
+}
+
+
+/***********************************************************************
+ *     RIOResizeRequestQueue
+ */
+static BOOL WINAPI WS2_RIOResizeRequestQueue( RIO_RQ queue, DWORD max_recv, DWORD max_send )
+{
+    struct rio_rq *rq = impl_from_RIO_RQ( queue );
+    BOOL ret;
+
+    TRACE( "queue %p, max_recv %lu, max_send %lu\n", queue, max_recv, max_send );
+
+    if (!rq)
+    {
+        SetLastError( WSAEINVAL );
+        return FALSE;
+    }
+
+    EnterCriticalSection( &rq->cs );
+    if (max_recv < rq->recv_count || max_send < rq->send_count)
+    {
+        LeaveCriticalSection( &rq->cs );
+        SetLastError( WSAEINVAL );
+        return FALSE;
+    }
+    if ((ret = reserve_cq_entries( rq->recv_cq, (LONG)(max_recv - rq->max_recv),
+                                   rq->send_cq, (LONG)(max_send - rq->max_send) )))
+    {
+        rq->max_recv = max_recv;
+        rq->max_send = max_send;
+    }
+    else SetLastError( WSAENOBUFS );
+    LeaveCriticalSection( &rq->cs );
+    return ret;
+}
+
+
+/***********************************************************************
+ *     RIORegisterBuffer
+ */
+static RIO_BUFFERID WINAPI WS2_RIORegisterBuffer( char *data, DWORD len )
+{
+    struct rio_buffer *buffer;
+
+    TRACE( "data %p, len %lu\n", data, len );
+
+    if (!data || !len)
+    {
+        SetLastError( WSAEINVAL );
+        return RIO_INVALID_BUFFERID;
+    }
+    if (!(buffer = malloc( sizeof(*buffer) )))
+    {
+        SetLastError( WSAENOBUFS );
+        return RIO_INVALID_BUFFERID;
+    }
+    /* keep the pages resident while they are registered */
+    if (!VirtualLock( data, len )) WARN( "failed to lock %p-%p, error %lu\n", data, data + len, GetLastError() );
+    buffer->data = data;
+    buffer->len = len;
+    return (RIO_BUFFERID)buffer;
+}
+
+
+/***********************************************************************
+ *     RIODeregisterBuffer
+ */
+static void WINAPI WS2_RIODeregisterBuffer( RIO_BUFFERID id )
+{
+    struct rio_buffer *buffer = impl_from_RIO_BUFFERID( id );
+
+    TRACE( "id %p\n", id );
+
+    if (!buffer) return;
+    VirtualUnlock( buffer->data, buffer->len );
+    free( buffer );
+}
+
+
+void rio_get_extension_functions( RIO_EXTENSION_FUNCTION_TABLE *table )
+{
+    table->cbSize = sizeof(*table);
+    table->RIOReceive = WS2_RIOReceive;
+    table->RIOReceiveEx = WS2_RIOReceiveEx;
+    table->RIOSend = WS2_RIOSend;
+    table->RIOSendEx = WS2_RIOSendEx;
+    table->RIOCloseCompletionQueue = WS2_RIOCloseCompletionQueue;
+    table->RIOCreateCompletionQueue = WS2_RIOCreateCompletionQueue;
+    table->RIOCreateRequestQueue = WS2_RIOCreateRequestQueue;
+    table->RIODequeueCompletion = WS2_RIODequeueCompletion;
+    table->RIODeregisterBuffer = WS2_RIODeregisterBuffer;
+    table->RIONotify = WS2_RIONotify;
+    table->RIORegisterBuffer = WS2_RIORegisterBuffer;
+    table->RIOResizeCompletionQueue = WS2_RIOResizeCompletionQueue;
+    table->RIOResizeRequestQueue = WS2_RIOResizeRequestQueue;
+}
+
+
+/* release the request queues of a socket that is being closed; asyncs still
+ * pending are canceled by the close and complete through the thread pool, and
+ * the completion queue entries are given back once the last one is done */
+void rio_socket_closed( SOCKET s )
+{
+    struct rio_rq *rq, *next;
+    struct rio_request *req, *next_req;
+    struct list closed = LIST_INIT( closed );
+
+    EnterCriticalSection( &rq_list_cs );
+    LIST_FOR_EACH_ENTRY_SAFE( rq, next, &rq_list, struct rio_rq, entry )
+    {
+        if (rq->socket != s) continue;
+        list_remove( &rq->entry );
+        list_add_tail( &closed, &rq->entry );
+    }
+    LeaveCriticalSection( &rq_list_cs );
+
+    LIST_FOR_EACH_ENTRY_SAFE( rq, next, &closed, struct rio_rq, entry )
+    {
+        EnterCriticalSection( &rq->cs );
+        LIST_FOR_EACH_ENTRY_SAFE( req, next_req, &rq->deferred, struct rio_request, entry )
+        {
+            list_remove( &req->entry );
+            complete_request( req, STATUS_CANCELLED, 0 );
+        }
+        LeaveCriticalSection( &rq->cs );
+        rq_release( rq );
+    }
+}
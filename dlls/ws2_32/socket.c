@@ -35,8 +35,6 @@ WINE_DECLARE_DEBUG_CHANNEL(winediag);
 
 #define TIMEOUT_INFINITE _I64_MAX
 
-#define u64_from_user_ptr(ptr) ((ULONGLONG)(uintptr_t)(ptr))
-
 static const WSAPROTOCOL_INFOW supported_protocols[] =
 {
     {
@@ -444,7 +442,7 @@ static FARPROC blocking_hook = (FARPROC)WSA_DefaultBlockingHook;
 /* function prototypes */
 static int ws_protocol_info(SOCKET s, int unicode, WSAPROTOCOL_INFOW *buffer, int *size);
 
-static DWORD NtStatusToWSAError( NTSTATUS status )
+DWORD NtStatusToWSAError( NTSTATUS status )
 {
     static const struct
     {
@@ -1208,6 +1206,7 @@ int WINAPI closesocket( SOCKET s )
         return -1;
     }
 
+    rio_socket_closed( s );
     CloseHandle( (HANDLE)s );
     return 0;
 }
@@ -2137,6 +2136,7 @@ static const char *debugstr_wsaioctl(DWORD code)
         IOCTL_NAME(SIO_GET_GROUP_QOS);
         IOCTL_NAME(SIO_GET_INTERFACE_LIST);
         /* IOCTL_NAME(SIO_GET_INTERFACE_LIST_EX); */
+        IOCTL_NAME(SIO_GET_MULTIPLE_EXTENSION_FUNCTION_POINTER);
         IOCTL_NAME(SIO_GET_QOS);
         IOCTL_NAME(SIO_IDEAL_SEND_BACKLOG_CHANGE);
         IOCTL_NAME(SIO_IDEAL_SEND_BACKLOG_QUERY);
@@ -2470,6 +2470,34 @@ INT WINAPI WSAIoctl(SOCKET s, DWORD code, LPVOID in_buff, DWORD in_size, LPVOID
         return -1;
     }
 
+    case SIO_GET_MULTIPLE_EXTENSION_FUNCTION_POINTER:
+    {
+        static const GUID rio_guid = WSAID_MULTIPLE_RIO;
+        NTSTATUS status = STATUS_SUCCESS;
+        DWORD ret;
+
+        if (in_size < sizeof(GUID) || !IsEqualGUID( &rio_guid, in_buff ))
+        {
+            FIXME( "SIO_GET_MULTIPLE_EXTENSION_FUNCTION_POINTER %s: stub\n", debugstr_guid(in_buff) );
+            SetLastError( WSAEINVAL );
+            return -1;
+        }
+        if (out_size < sizeof(RIO_EXTENSION_FUNCTION_TABLE))
+        {
+            SetLastError( WSAEFAULT );
+            return -1;
+        }
+
+        TRACE( "returning RIO function table\n" );
+        rio_get_extension_functions( out_buff );
+
+        ret = server_ioctl_sock( s, IOCTL_AFD_WINE_COMPLETE_ASYNC, &status, sizeof(status),
+                                 NULL, 0, ret_size, overlapped, completion );
+        *ret_size = sizeof(RIO_EXTENSION_FUNCTION_TABLE);
+        SetLastError( ret );
+        return ret ? -1 : 0;
+    }
+
     case SIO_KEEPALIVE_VALS:
     {
         DWORD ret;
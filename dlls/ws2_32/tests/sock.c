@@ -7709,6 +7709,99 @@ static void test_WSAPoll(void)
     closesocket(server);
 }
 
+static void test_WSAPoll_many(void)
+{
+    SOCKET clients[32], servers[32];
+    WSAPOLLFD fds[32];
+    OVERLAPPED overlapped = {0};
+    struct timeval timeout = {0};
+    char buffer[4];
+    fd_set writefds;
+    WSABUF wsabuf;
+    DWORD size, flags;
+    unsigned int i;
+    int ret;
+
+    if (!pWSAPoll) /* >= Vista */
+    {
+        win_skip("WSAPoll is unsupported, skipping tests.\n");
+        return;
+    }
+
+    for (i = 0; i < ARRAY_SIZE(servers); ++i)
+    {
+        tcp_socketpair(&clients[i], &servers[i]);
+        fds[i].fd = servers[i];
+        fds[i].events = POLLRDNORM;
+        fds[i].revents = 0xdead;
+    }
+
+    ret = pWSAPoll(fds, ARRAY_SIZE(fds), 0);
+    ok(!ret, "got %d\n", ret);
+    for (i = 0; i < ARRAY_SIZE(fds); ++i)
+        ok(!fds[i].revents, "%u: got events %#x\n", i, fds[i].revents);
+
+    for (i = 0; i < ARRAY_SIZE(clients); i += 4)
+    {
+        ret = send(clients[i], "data", 4, 0);
+        ok(ret == 4, "got %d\n", ret);
+    }
+
+    /* polling again without consuming the data reports the same sockets */
+    check_poll_mask(servers[0], POLLRDNORM, POLLRDNORM);
+    check_poll_mask(servers[28], POLLRDNORM, POLLRDNORM);
+    ret = pWSAPoll(fds, ARRAY_SIZE(fds), 0);
+    ok(ret == ARRAY_SIZE(fds) / 4, "got %d\n", ret);
+    for (i = 0; i < ARRAY_SIZE(fds); ++i)
+        ok(fds[i].revents == (i % 4 ? 0 : POLLRDNORM), "%u: got events %#x\n", i, fds[i].revents);
+
+    for (i = 0; i < ARRAY_SIZE(servers); i += 4)
+    {
+        ret = recv(servers[i], buffer, sizeof(buffer), 0);
+        ok(ret == 4, "got %d\n", ret);
+    }
+    ret = pWSAPoll(fds, ARRAY_SIZE(fds), 0);
+    ok(!ret, "got %d\n", ret);
+
+    FD_ZERO(&writefds);
+    for (i = 0; i < ARRAY_SIZE(servers); ++i)
+        FD_SET(servers[i], &writefds);
+    ret = select(0, NULL, &writefds, NULL, &timeout);
+    ok(ret == ARRAY_SIZE(servers), "got %d\n", ret);
+
+    /* data consumed by a pending overlapped receive is not reported */
+    overlapped.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    wsabuf.buf = buffer;
+    wsabuf.len = sizeof(buffer);
+    flags = 0;
+    ret = WSARecv(servers[1], &wsabuf, 1, NULL, &flags, &overlapped, NULL);
+    ok(ret == -1, "got %d\n", ret);
+    ok(WSAGetLastError() == ERROR_IO_PENDING, "got error %u\n", WSAGetLastError());
+    ret = send(clients[1], "data", 4, 0);
+    ok(ret == 4, "got %d\n", ret);
+    ret = WaitForSingleObject(overlapped.hEvent, 1000);
+    ok(!ret, "wait failed\n");
+    ret = WSAGetOverlappedResult(servers[1], &overlapped, &size, FALSE, &flags);
+    ok(ret, "got error %u\n", WSAGetLastError());
+    ok(size == 4, "got size %u\n", size);
+    ret = pWSAPoll(fds, ARRAY_SIZE(fds), 0);
+    ok(!ret, "got %d\n", ret);
+    CloseHandle(overlapped.hEvent);
+
+    /* a hangup is reported among sockets that are otherwise idle */
+    closesocket(clients[7]);
+    ret = pWSAPoll(fds, ARRAY_SIZE(fds), 1000);
+    ok(ret == 1, "got %d\n", ret);
+    ok(fds[7].revents == POLLHUP, "got events %#x\n", fds[7].revents);
+    check_poll_mask(servers[7], 0, POLLHUP);
+
+    for (i = 0; i < ARRAY_SIZE(servers); ++i)
+    {
+        if (i != 7) closesocket(clients[i]);
+        closesocket(servers[i]);
+    }
+}
+
 static void test_connect(void)
 {
     SOCKET listener = INVALID_SOCKET;
@@ -9157,6 +9250,323 @@ static void test_TransmitFile(void)
     closesocket(server);
 }
 
+static void test_TransmitFile_large(void)
+{
+    static const unsigned int file_size = 16 * 1024 * 1024, offset = 4097;
+    GUID transmitFileGuid = WSAID_TRANSMITFILE;
+    LPFN_TRANSMITFILE pTransmitFile = NULL;
+    char temp_path[MAX_PATH], path[MAX_PATH];
+    DWORD size, total, ticks, i;
+    unsigned char *data, *buffer;
+    SOCKET client, dest;
+    OVERLAPPED ov;
+    HANDLE file;
+    BOOL bret;
+    int ret;
+
+    tcp_socketpair(&client, &dest);
+    ret = WSAIoctl(client, SIO_GET_EXTENSION_FUNCTION_POINTER, &transmitFileGuid, sizeof(transmitFileGuid),
+                   &pTransmitFile, sizeof(pTransmitFile), &size, NULL, NULL);
+    ok(!ret, "failed to get TransmitFile, error %u\n", WSAGetLastError());
+
+    data = malloc(file_size);
+    buffer = malloc(file_size);
+    for (i = 0; i < file_size / sizeof(DWORD); i++) ((DWORD *)data)[i] = i * 0x9e3779b1;
+
+    GetTempPathA(MAX_PATH, temp_path);
+    GetTempFileNameA(temp_path, "tf", 0, path);
+    file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                       FILE_FLAG_DELETE_ON_CLOSE, NULL);
+    ok(file != INVALID_HANDLE_VALUE, "failed to create file, error %lu\n", GetLastError());
+    bret = WriteFile(file, data, file_size, &size, NULL);
+    ok(bret && size == file_size, "failed to write file, error %lu\n", GetLastError());
+
+    /* the whole file from the current file position, larger than the transmit buffer */
+    SetFilePointer(file, 0, NULL, FILE_BEGIN);
+    memset(&ov, 0, sizeof(ov));
+    ov.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    ticks = GetTickCount();
+    bret = pTransmitFile(client, file, 0, 0, &ov, NULL, 0);
+    ok(!bret, "TransmitFile succeeded unexpectedly.\n");
+    ok(WSAGetLastError() == ERROR_IO_PENDING, "got error %u\n", WSAGetLastError());
+    for (total = 0; total < file_size; total += ret)
+    {
+        ret = recv(dest, (char *)buffer + total, file_size - total, 0);
+        ok(ret > 0, "recv returned %d, error %u\n", ret, WSAGetLastError());
+        if (ret <= 0) break;
+    }
+    ret = WaitForSingleObject(ov.hEvent, 10000);
+    ok(!ret, "wait timed out\n");
+    ticks = GetTickCount() - ticks;
+    bret = WSAGetOverlappedResult(client, &ov, &size, FALSE, NULL);
+    ok(bret, "TransmitFile failed, error %u\n", WSAGetLastError());
+    ok(size == file_size, "got size %lu\n", size);
+    ok(total == file_size, "received %lu bytes\n", total);
+    ok(!memcmp(buffer, data, file_size), "data didn't match\n");
+    trace("transmitted %u MiB in %lu ms\n", file_size >> 20, ticks);
+
+    /* a limited amount of data from an explicit offset, with a small transmit buffer */
+    ResetEvent(ov.hEvent);
+    ov.Offset = offset;
+    bret = pTransmitFile(client, file, file_size / 2, 1000, &ov, NULL, 0);
+    ok(!bret, "TransmitFile succeeded unexpectedly.\n");
+    ok(WSAGetLastError() == ERROR_IO_PENDING, "got error %u\n", WSAGetLastError());
+    for (total = 0; total < file_size / 2; total += ret)
+    {
+        ret = recv(dest, (char *)buffer + total, file_size / 2 - total, 0);
+        ok(ret > 0, "recv returned %d, error %u\n", ret, WSAGetLastError());
+        if (ret <= 0) break;
+    }
+    ret = WaitForSingleObject(ov.hEvent, 10000);
+    ok(!ret, "wait timed out\n");
+    bret = WSAGetOverlappedResult(client, &ov, &size, FALSE, NULL);
+    ok(bret, "TransmitFile failed, error %u\n", WSAGetLastError());
+    ok(size == file_size / 2, "got size %lu\n", size);
+    ok(total == file_size / 2, "received %lu bytes\n", total);
+    ok(!memcmp(buffer, data + offset, file_size / 2), "data didn't match\n");
+
+    CloseHandle(ov.hEvent);
+    CloseHandle(file);
+    free(buffer);
+    free(data);
+    closesocket(client);
+    closesocket(dest);
+}
+
+static ULONG dequeue_rio_results(const RIO_EXTENSION_FUNCTION_TABLE *rio, RIO_CQ cq, RIORESULT *results,
+                                 ULONG count)
+{
+    DWORD start = GetTickCount();
+    ULONG ret, total = 0;
+
+    while (total < count && GetTickCount() - start < 5000)
+    {
+        ret = rio->RIODequeueCompletion(cq, results + total, count - total);
+        ok(ret != RIO_CORRUPT_CQ, "got corrupt completion queue\n");
+        if (ret == RIO_CORRUPT_CQ) break;
+        if (!(total += ret)) Sleep(1);
+    }
+    return total;
+}
+
+static void test_rio(void)
+{
+    static const GUID rio_guid = WSAID_MULTIPLE_RIO;
+    char send_data[4096], recv_data[4096];
+    RIO_NOTIFICATION_COMPLETION notify;
+    RIO_EXTENSION_FUNCTION_TABLE rio;
+    RIO_BUFFERID send_id, recv_id;
+    RIO_BUF send_buf, recv_buf;
+    RIORESULT results[8];
+    RIO_CQ cq, event_cq;
+    RIO_RQ src_rq, dst_rq;
+    SOCKET src, dst;
+    unsigned int i;
+    HANDLE event;
+    DWORD size;
+    ULONG count;
+    BOOL bret;
+    int ret;
+
+    tcp_socketpair_flags(&src, &dst, WSA_FLAG_OVERLAPPED | WSA_FLAG_REGISTERED_IO);
+
+    memset(&rio, 0, sizeof(rio));
+    size = 0xdeadbeef;
+    ret = WSAIoctl(src, SIO_GET_MULTIPLE_EXTENSION_FUNCTION_POINTER, (void *)&rio_guid, sizeof(rio_guid),
+                   &rio, sizeof(rio), &size, NULL, NULL);
+    if (ret && WSAGetLastError() == WSAEOPNOTSUPP)
+    {
+        win_skip("Registered I/O is not supported.\n");
+        closesocket(src);
+        closesocket(dst);
+        return;
+    }
+    ok(!ret, "got error %u\n", WSAGetLastError());
+    ok(size == sizeof(rio), "got size %lu\n", size);
+    ok(rio.cbSize == sizeof(rio), "got table size %lu\n", rio.cbSize);
+
+    for (i = 0; i < sizeof(send_data); ++i) send_data[i] = i * 13;
+
+    cq = rio.RIOCreateCompletionQueue(0, NULL);
+    ok(cq == RIO_INVALID_CQ, "expected failure\n");
+    ok(WSAGetLastError() == WSAEINVAL, "got error %u\n", WSAGetLastError());
+
+    cq = rio.RIOCreateCompletionQueue(16, NULL);
+    ok(cq != RIO_INVALID_CQ, "got error %u\n", WSAGetLastError());
+
+    event = CreateEventW(NULL, TRUE, FALSE, NULL);
+    memset(&notify, 0, sizeof(notify));
+    notify.Type = RIO_EVENT_COMPLETION;
+    notify.Event.EventHandle = event;
+    notify.Event.NotifyReset = TRUE;
+    event_cq = rio.RIOCreateCompletionQueue(16, &notify);
+    ok(event_cq != RIO_INVALID_CQ, "got error %u\n", WSAGetLastError());
+
+    ret = rio.RIONotify(cq);
+    ok(ret == WSAEINVAL, "got %d\n", ret);
+
+    send_id = rio.RIORegisterBuffer(send_data, sizeof(send_data));
+    ok(send_id != RIO_INVALID_BUFFERID, "got error %u\n", WSAGetLastError());
+    recv_id = rio.RIORegisterBuffer(recv_data, sizeof(recv_data));
+    ok(recv_id != RIO_INVALID_BUFFERID, "got error %u\n", WSAGetLastError());
+
+    /* the request queues may not use more entries than the completion queues have */
+    src_rq = rio.RIOCreateRequestQueue(src, 16, 1, 16, 1, cq, cq, (void *)0xdead);
+    ok(src_rq == RIO_INVALID_RQ, "expected failure\n");
+    ok(WSAGetLastError() == WSAENOBUFS, "got error %u\n", WSAGetLastError());
+
+    src_rq = rio.RIOCreateRequestQueue(src, 4, 1, 4, 1, cq, cq, (void *)0xdead);
+    ok(src_rq != RIO_INVALID_RQ, "got error %u\n", WSAGetLastError());
+    dst_rq = rio.RIOCreateRequestQueue(dst, 4, 1, 4, 1, event_cq, event_cq, (void *)0xbeef);
+    ok(dst_rq != RIO_INVALID_RQ, "got error %u\n", WSAGetLastError());
+
+    /* a receive is pending before any data is sent */
+    memset(recv_data, 0xcc, sizeof(recv_data));
+    recv_buf.BufferId = recv_id;
+    recv_buf.Offset = 0;
+    recv_buf.Length = 1024;
+    bret = rio.RIOReceive(dst_rq, &recv_buf, 1, 0, (void *)1);
+    ok(bret, "got error %u\n", WSAGetLastError());
+
+    ret = rio.RIONotify(event_cq);
+    ok(!ret, "got %d\n", ret);
+    ret = rio.RIONotify(event_cq);
+    ok(ret == WSAEALREADY, "got %d\n", ret);
+    count = rio.RIODequeueCompletion(event_cq, results, ARRAY_SIZE(results));
+    ok(!count, "got %lu results\n", count);
+
+    send_buf.BufferId = send_id;
+    send_buf.Offset = 0;
+    send_buf.Length = 1024;
+    bret = rio.RIOSend(src_rq, &send_buf, 1, 0, (void *)2);
+    ok(bret, "got error %u\n", WSAGetLastError());
+
+    count = dequeue_rio_results(&rio, cq, results, 1);
+    ok(count == 1, "got %lu results\n", count);
+    ok(!results[0].Status, "got status %ld\n", results[0].Status);
+    ok(results[0].BytesTransferred == 1024, "got size %lu\n", results[0].BytesTransferred);
+    ok(results[0].SocketContext == 0xdead, "got socket context %#I64x\n", results[0].SocketContext);
+    ok(results[0].RequestContext == 2, "got request context %#I64x\n", results[0].RequestContext);
+
+    ret = WaitForSingleObject(event, 5000);
+    ok(!ret, "got %d\n", ret);
+    count = dequeue_rio_results(&rio, event_cq, results, 1);
+    ok(count == 1, "got %lu results\n", count);
+    ok(!results[0].Status, "got status %ld\n", results[0].Status);
+    ok(results[0].BytesTransferred == 1024, "got size %lu\n", results[0].BytesTransferred);
+    ok(results[0].SocketContext == 0xbeef, "got socket context %#I64x\n", results[0].SocketContext);
+    ok(results[0].RequestContext == 1, "got request context %#I64x\n", results[0].RequestContext);
+    ok(!memcmp(recv_data, send_data, 1024), "data didn't match\n");
+
+    /* deferred requests are only sent once committed, and count as outstanding */
+    for (i = 0; i < 4; ++i)
+    {
+        send_buf.Offset = 1024 * i;
+        bret = rio.RIOSend(src_rq, &send_buf, 1, RIO_MSG_DEFER, (void *)(ULONG_PTR)(10 + i));
+        ok(bret, "got error %u\n", WSAGetLastError());
+    }
+    bret = rio.RIOSend(src_rq, &send_buf, 1, RIO_MSG_DEFER, (void *)14);
+    ok(!bret, "expected failure\n");
+    ok(WSAGetLastError() == WSAENOBUFS, "got error %u\n", WSAGetLastError());
+    count = rio.RIODequeueCompletion(cq, results, ARRAY_SIZE(results));
+    ok(!count, "got %lu results\n", count);
+    bret = rio.RIOSend(src_rq, NULL, 0, RIO_MSG_COMMIT_ONLY, NULL);
+    ok(bret, "got error %u\n", WSAGetLastError());
+
+    count = dequeue_rio_results(&rio, cq, results, 4);
+    ok(count == 4, "got %lu results\n", count);
+    for (i = 0; i < count; ++i)
+    {
+        ok(!results[i].Status, "got status %ld\n", results[i].Status);
+        ok(results[i].BytesTransferred == 1024, "got size %lu\n", results[i].BytesTransferred);
+        ok(results[i].RequestContext == 10 + i, "got request context %#I64x\n", results[i].RequestContext);
+    }
+
+    memset(recv_data, 0xcc, sizeof(recv_data));
+    for (i = 0; i < 4; ++i)
+    {
+        recv_buf.Offset = 1024 * i;
+        recv_buf.Length = 1024;
+        bret = rio.RIOReceive(dst_rq, &recv_buf, 1, RIO_MSG_WAITALL, (void *)(ULONG_PTR)(20 + i));
+        ok(bret, "got error %u\n", WSAGetLastError());
+    }
+    count = dequeue_rio_results(&rio, event_cq, results, 4);
+    ok(count == 4, "got %lu results\n", count);
+    for (i = 0; i < count; ++i)
+    {
+        ok(!results[i].Status, "got status %ld\n", results[i].Status);
+        ok(results[i].BytesTransferred == 1024, "got size %lu\n", results[i].BytesTransferred);
+        ok(results[i].RequestContext == 20 + i, "got request context %#I64x\n", results[i].RequestContext);
+    }
+    ok(!memcmp(recv_data, send_data, sizeof(send_data)), "data didn't match\n");
+
+    /* invalid buffers */
+    recv_buf.Offset = sizeof(recv_data) - 10;
+    recv_buf.Length = 20;
+    bret = rio.RIOReceive(dst_rq, &recv_buf, 1, 0, NULL);
+    ok(!bret, "expected failure\n");
+    ok(WSAGetLastError() == WSAEINVAL, "got error %u\n", WSAGetLastError());
+
+    /* pending requests are aborted when the socket is closed */
+    recv_buf.Offset = 0;
+    recv_buf.Length = 16;
+    bret = rio.RIOReceive(src_rq, &recv_buf, 1, 0, (void *)30);
+    ok(bret, "got error %u\n", WSAGetLastError());
+    closesocket(src);
+    count = dequeue_rio_results(&rio, cq, results, 1);
+    ok(count == 1, "got %lu results\n", count);
+    ok(results[0].Status == WSA_OPERATION_ABORTED, "got status %ld\n", results[0].Status);
+    ok(results[0].RequestContext == 30, "got request context %#I64x\n", results[0].RequestContext);
+
+    /* closing the socket gives the entries of its request queue back to the completion queue,
+     * and the socket can still be bound to a completion port */
+    for (i = 0; i < 8; ++i)
+    {
+        SOCKET sock = WSASocketA(AF_INET, SOCK_STREAM, IPPROTO_TCP, NULL, 0,
+                                 WSA_FLAG_OVERLAPPED | WSA_FLAG_REGISTERED_IO);
+        HANDLE port;
+
+        ok(sock != INVALID_SOCKET, "got error %u\n", WSAGetLastError());
+        src_rq = rio.RIOCreateRequestQueue(sock, 4, 1, 4, 1, cq, cq, NULL);
+        ok(src_rq != RIO_INVALID_RQ, "%u: got error %u\n", i, WSAGetLastError());
+        port = CreateIoCompletionPort((HANDLE)sock, NULL, 0, 0);
+        ok(!!port, "%u: got error %lu\n", i, GetLastError());
+        closesocket(sock);
+        CloseHandle(port);
+    }
+
+    closesocket(dst);
+
+    /* request queues may use the same completion queues the other way around */
+    tcp_socketpair_flags(&src, &dst, WSA_FLAG_OVERLAPPED | WSA_FLAG_REGISTERED_IO);
+    src_rq = rio.RIOCreateRequestQueue(src, 2, 1, 2, 1, cq, event_cq, NULL);
+    ok(src_rq != RIO_INVALID_RQ, "got error %u\n", WSAGetLastError());
+    dst_rq = rio.RIOCreateRequestQueue(dst, 2, 1, 2, 1, event_cq, cq, NULL);
+    ok(dst_rq != RIO_INVALID_RQ, "got error %u\n", WSAGetLastError());
+    closesocket(src);
+    closesocket(dst);
+
+    /* a completion queue can be closed before the request queues using it */
+    {
+        RIO_CQ tmp_cq = rio.RIOCreateCompletionQueue(8, NULL);
+        SOCKET sock = WSASocketA(AF_INET, SOCK_STREAM, IPPROTO_TCP, NULL, 0,
+                                 WSA_FLAG_OVERLAPPED | WSA_FLAG_REGISTERED_IO);
+
+        ok(tmp_cq != RIO_INVALID_CQ, "got error %u\n", WSAGetLastError());
+        ok(sock != INVALID_SOCKET, "got error %u\n", WSAGetLastError());
+        src_rq = rio.RIOCreateRequestQueue(sock, 4, 1, 4, 1, tmp_cq, tmp_cq, NULL);
+        ok(src_rq != RIO_INVALID_RQ, "got error %u\n", WSAGetLastError());
+        rio.RIOCloseCompletionQueue(tmp_cq);
+        closesocket(sock);
+    }
+
+    rio.RIODeregisterBuffer(send_id);
+    rio.RIODeregisterBuffer(recv_id);
+    rio.RIOCloseCompletionQueue(cq);
+    rio.RIOCloseCompletionQueue(event_cq);
+    CloseHandle(event);
+}
+
 static void test_getpeername(void)
 {
     SOCKET sock;
@@ -13254,6 +13664,7 @@ START_TEST( sock )
     test_WSASendTo();
     test_WSARecv();
     test_WSAPoll();
+    test_WSAPoll_many();
     test_write_watch();
     test_iocp();
 
@@ -13261,6 +13672,8 @@ START_TEST( sock )
 
     test_ipv6only();
     test_TransmitFile();
+    test_TransmitFile_large();
+    test_rio();
     test_AcceptEx();
     test_connect();
     test_shutdown();
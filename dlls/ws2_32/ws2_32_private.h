@@ -73,9 +73,15 @@ static inline char *strdupWtoA( const WCHAR *str )
     return ret;
 }
 
+#define u64_from_user_ptr(ptr) ((ULONGLONG)(uintptr_t)(ptr))
+
 static const char magic_loopback_addr[] = {127, 12, 34, 56};
 
 const char *debugstr_sockaddr( const struct sockaddr *addr ) DECLSPEC_HIDDEN;
+DWORD NtStatusToWSAError( NTSTATUS status ) DECLSPEC_HIDDEN;
+
+void rio_get_extension_functions( RIO_EXTENSION_FUNCTION_TABLE *table ) DECLSPEC_HIDDEN;
+void rio_socket_closed( SOCKET s ) DECLSPEC_HIDDEN;
 
 struct per_thread_data
 {
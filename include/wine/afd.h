@@ -283,6 +283,7 @@ C_ASSERT( sizeof(struct afd_get_events_params) == 56 );
 #define IOCTL_AFD_WINE_SET_IP_RECVTTL                   WINE_AFD_IOC(294)
 #define IOCTL_AFD_WINE_GET_IP_RECVTOS                   WINE_AFD_IOC(295)
 #define IOCTL_AFD_WINE_SET_IP_RECVTOS                   WINE_AFD_IOC(296)
+#define IOCTL_AFD_WINE_RIO_SUBMIT                       WINE_AFD_IOC(297)
 
 struct afd_iovec
 {
@@ -365,4 +366,20 @@ struct afd_get_info_params
 };
 C_ASSERT( sizeof(struct afd_get_info_params) == 12 );
 
+/* one registered I/O request; sends and receives are each performed in array order */
+struct afd_rio_request
+{
+    ULONGLONG buffer_ptr;
+    unsigned int len;
+    int send;
+};
+C_ASSERT( sizeof(struct afd_rio_request) == 16 );
+
+struct afd_rio_result
+{
+    unsigned int status;
+    unsigned int size;
+};
+C_ASSERT( sizeof(struct afd_rio_result) == 8 );
+
 #endif
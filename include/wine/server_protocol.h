@@ -471,6 +471,75 @@ typedef union
     } keyed_event;
 } select_op_t;
 
+
+enum fsync_type
+{
+    FSYNC_NONE,
+    FSYNC_EVENT,
+    FSYNC_SEMAPHORE,
+    FSYNC_MUTEX
+};
+
+struct fsync_object
+{
+    int          state;
+    int          extra;
+    int          waiters;
+    int          type;
+    int          pulse;
+};
+
+#define FSYNC_MUTEX_ABANDONED (~0)
+#define FSYNC_EVENT_SIGNALED  1
+#define FSYNC_EVENT_SET_COUNT 2
+
+
+#define FSYNC_MAX_OWNED 31
+struct fsync_thread
+{
+    int          count;
+    unsigned int owned[FSYNC_MAX_OWNED];
+};
+
+
+
+
+typedef volatile struct
+{
+    unsigned int  seq;
+    unsigned int  wake_bits;
+    unsigned int  changed_bits;
+    unsigned int  wake_mask;
+    unsigned int  changed_mask;
+} queue_shm_t;
+
+typedef volatile struct
+{
+    unsigned int  seq;
+    int           cursor_x;
+    int           cursor_y;
+    unsigned int  cursor_last_change;
+    unsigned char keystate[256];
+} desktop_shm_t;
+
+typedef volatile struct
+{
+    unsigned int  seq;
+    user_handle_t handle;
+    user_handle_t parent;
+    user_handle_t owner;
+    thread_id_t   tid;
+    process_id_t  pid;
+    unsigned int  style;
+    unsigned int  ex_style;
+    lparam_t      id;
+    mod_handle_t  instance;
+    lparam_t      user_data;
+    unsigned int  dpi;
+    rectangle_t   window_rect;
+    rectangle_t   client_rect;
+} window_shm_t;
+
 enum apc_type
 {
     APC_NONE,
@@ -1568,6 +1637,79 @@ struct open_semaphore_reply
 
 
 
+struct get_fsync_shm_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_fsync_shm_reply
+{
+    struct reply_header __header;
+    data_size_t  size;
+    char __pad_12[4];
+};
+
+
+
+struct get_fsync_idx_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct get_fsync_idx_reply
+{
+    struct reply_header __header;
+    int          type;
+    unsigned int index;
+    unsigned int access;
+    char __pad_20[4];
+};
+
+
+
+struct get_fsync_thread_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_fsync_thread_reply
+{
+    struct reply_header __header;
+    data_size_t  offset;
+    char __pad_12[4];
+};
+
+
+
+struct fsync_wake_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct fsync_wake_reply
+{
+    struct reply_header __header;
+};
+
+
+
+
+struct batch_requests_request
+{
+    struct request_header __header;
+    /* VARARG(data,bytes); */
+    char __pad_12[4];
+};
+struct batch_requests_reply
+{
+    struct reply_header __header;
+    unsigned int count;
+    /* VARARG(data,bytes); */
+    char __pad_12[4];
+};
+
+
+
 struct create_file_request
 {
     struct request_header __header;
@@ -1797,6 +1939,22 @@ struct send_socket_reply
 
 
 
+struct rio_socket_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+    int          recv;
+    int          send;
+};
+struct rio_socket_reply
+{
+    struct reply_header __header;
+    int          recv_direct;
+    int          send_direct;
+};
+
+
+
 struct socket_send_icmp_id_request
 {
     struct request_header __header;
@@ -1828,6 +1986,27 @@ struct socket_get_icmp_id_reply
 
 
 
+struct get_socket_poll_state_request
+{
+    struct request_header __header;
+    obj_handle_t   handle;
+};
+struct get_socket_poll_state_reply
+{
+    struct reply_header __header;
+    int            state;
+    char __pad_12[4];
+};
+enum sock_poll_state
+{
+    SOCK_POLL_SERVER,
+    SOCK_POLL_LISTENING,
+    SOCK_POLL_CONNECTED,
+    SOCK_POLL_CONNECTIONLESS
+};
+
+
+
 struct get_next_console_request_request
 {
     struct request_header __header;
@@ -2627,7 +2806,7 @@ struct get_msg_queue_reply
 {
     struct reply_header __header;
     obj_handle_t handle;
-    char __pad_12[4];
+    unsigned int shm_offset;
 };
 
 
@@ -3165,6 +3344,8 @@ struct get_window_info_reply
     int            is_unicode;
     int            dpi;
     int            awareness;
+    unsigned int   shm_offset;
+    char __pad_44[4];
 };
 
 
@@ -3735,7 +3916,7 @@ struct get_thread_desktop_reply
 {
     struct reply_header __header;
     obj_handle_t handle;
-    char __pad_12[4];
+    unsigned int shm_offset;
 };
 
 
@@ -5520,6 +5701,11 @@ enum request
     REQ_release_semaphore,
     REQ_query_semaphore,
     REQ_open_semaphore,
+    REQ_get_fsync_shm,
+    REQ_get_fsync_idx,
+    REQ_get_fsync_thread,
+    REQ_fsync_wake,
+    REQ_batch_requests,
     REQ_create_file,
     REQ_open_file_object,
     REQ_alloc_file_handle,
@@ -5533,8 +5719,10 @@ enum request
     REQ_unlock_file,
     REQ_recv_socket,
     REQ_send_socket,
+    REQ_rio_socket,
     REQ_socket_send_icmp_id,
     REQ_socket_get_icmp_id,
+    REQ_get_socket_poll_state,
     REQ_get_next_console_request,
     REQ_read_directory_changes,
     REQ_read_change,
@@ -5804,6 +5992,11 @@ union generic_request
     struct release_semaphore_request release_semaphore_request;
     struct query_semaphore_request query_semaphore_request;
     struct open_semaphore_request open_semaphore_request;
+    struct get_fsync_shm_request get_fsync_shm_request;
+    struct get_fsync_idx_request get_fsync_idx_request;
+    struct get_fsync_thread_request get_fsync_thread_request;
+    struct fsync_wake_request fsync_wake_request;
+    struct batch_requests_request batch_requests_request;
     struct create_file_request create_file_request;
     struct open_file_object_request open_file_object_request;
     struct alloc_file_handle_request alloc_file_handle_request;
@@ -5817,8 +6010,10 @@ union generic_request
     struct unlock_file_request unlock_file_request;
     struct recv_socket_request recv_socket_request;
     struct send_socket_request send_socket_request;
+    struct rio_socket_request rio_socket_request;
     struct socket_send_icmp_id_request socket_send_icmp_id_request;
     struct socket_get_icmp_id_request socket_get_icmp_id_request;
+    struct get_socket_poll_state_request get_socket_poll_state_request;
     struct get_next_console_request_request get_next_console_request_request;
     struct read_directory_changes_request read_directory_changes_request;
     struct read_change_request read_change_request;
@@ -6086,6 +6281,11 @@ union generic_reply
     struct release_semaphore_reply release_semaphore_reply;
     struct query_semaphore_reply query_semaphore_reply;
     struct open_semaphore_reply open_semaphore_reply;
+    struct get_fsync_shm_reply get_fsync_shm_reply;
+    struct get_fsync_idx_reply get_fsync_idx_reply;
+    struct get_fsync_thread_reply get_fsync_thread_reply;
+    struct fsync_wake_reply fsync_wake_reply;
+    struct batch_requests_reply batch_requests_reply;
     struct create_file_reply create_file_reply;
     struct open_file_object_reply open_file_object_reply;
     struct alloc_file_handle_reply alloc_file_handle_reply;
@@ -6099,8 +6299,10 @@ union generic_reply
     struct unlock_file_reply unlock_file_reply;
     struct recv_socket_reply recv_socket_reply;
     struct send_socket_reply send_socket_reply;
+    struct rio_socket_reply rio_socket_reply;
     struct socket_send_icmp_id_reply socket_send_icmp_id_reply;
     struct socket_get_icmp_id_reply socket_get_icmp_id_reply;
+    struct get_socket_poll_state_reply get_socket_poll_state_reply;
     struct get_next_console_request_reply get_next_console_request_reply;
     struct read_directory_changes_reply read_directory_changes_reply;
     struct read_change_reply read_change_reply;
@@ -6324,7 +6526,7 @@ union generic_reply
 
 /* ### protocol_version begin ### */
 
-#define SERVER_PROTOCOL_VERSION 755
+#define SERVER_PROTOCOL_VERSION 762
 
 /* ### protocol_version end ### */
 
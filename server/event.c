@@ -21,6 +21,7 @@
 #include "config.h"
 
 #include <assert.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
@@ -56,21 +57,25 @@ struct event
     struct list    kernel_object;   /* list of kernel object pointers */
     int            manual_reset;    /* is it a manual reset event? */
     int            signaled;        /* event has been signaled */
+    unsigned int   fsync_idx;       /* fast synchronization object index */
 };
 
 static void event_dump( struct object *obj, int verbose );
+static int event_add_queue( struct object *obj, struct wait_queue_entry *entry );
+static void event_remove_queue( struct object *obj, struct wait_queue_entry *entry );
 static int event_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void event_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static int event_signal( struct object *obj, unsigned int access);
 static struct list *event_get_kernel_obj_list( struct object *obj );
+static void event_destroy( struct object *obj );
 
 static const struct object_ops event_ops =
 {
     sizeof(struct event),      /* size */
     &event_type,               /* type */
     event_dump,                /* dump */
-    add_queue,                 /* add_queue */
-    remove_queue,              /* remove_queue */
+    event_add_queue,           /* add_queue */
+    event_remove_queue,        /* remove_queue */
     event_signaled,            /* signaled */
     event_satisfied,           /* satisfied */
     event_signal,              /* signal */
@@ -85,7 +90,7 @@ static const struct object_ops event_ops =
     no_open_file,              /* open_file */
     event_get_kernel_obj_list, /* get_kernel_obj_list */
     no_close_handle,           /* close_handle */
-    no_destroy                 /* destroy */
+    event_destroy              /* destroy */
 };
 
 
@@ -150,6 +155,9 @@ struct event *create_event( struct object *root, const struct unicode_str *name,
             list_init( &event->kernel_object );
             event->manual_reset = manual_reset;
             event->signaled     = initial_state;
+            event->fsync_idx    = alloc_fsync_object( &event->obj, FSYNC_EVENT,
+                                                       initial_state ? FSYNC_EVENT_SIGNALED : 0,
+                                                       manual_reset );
         }
     }
     return event;
@@ -160,24 +168,95 @@ struct event *get_event_obj( struct process *process, obj_handle_t handle, unsig
     return (struct event *)get_handle_obj( process, handle, access, &event_ops );
 }
 
+static int get_event_state( struct event *event )
+{
+    if (event->fsync_idx)
+        return __atomic_load_n( &get_fsync_object( event->fsync_idx )->state, __ATOMIC_SEQ_CST ) &
+               FSYNC_EVENT_SIGNALED;
+    return event->signaled;
+}
+
+/* set the signaled bit of a fast synchronization event, bumping its set count */
+static int set_fsync_event( struct fsync_object *obj )
+{
+    int state = __atomic_load_n( &obj->state, __ATOMIC_SEQ_CST );
+
+    while (!__atomic_compare_exchange_n( &obj->state, &state,
+                                         (state + FSYNC_EVENT_SET_COUNT) | FSYNC_EVENT_SIGNALED,
+                                         0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ));
+    return state;
+}
+
+static int set_event_state( struct event *event, int state )
+{
+    if (event->fsync_idx)
+    {
+        struct fsync_object *obj = get_fsync_object( event->fsync_idx );
+        int prev;
+
+        if (!state)
+            return __atomic_fetch_and( &obj->state, ~FSYNC_EVENT_SIGNALED, __ATOMIC_SEQ_CST ) &
+                   FSYNC_EVENT_SIGNALED;
+        if ((prev = __atomic_load_n( &obj->state, __ATOMIC_SEQ_CST ) & FSYNC_EVENT_SIGNALED)) return prev;
+        if (!(set_fsync_event( obj ) & FSYNC_EVENT_SIGNALED))
+            fsync_wake_futex( event->fsync_idx, event->manual_reset ? INT_MAX : 1 );
+        return 0;
+    }
+    return event->signaled = state;
+}
+
 static void pulse_event( struct event *event )
 {
-    event->signaled = 1;
-    /* wake up all waiters if manual reset, a single one otherwise */
+    struct fsync_object *obj;
+    int state;
+
+    if (!event->fsync_idx)
+    {
+        event->signaled = 1;
+        /* wake up all waiters if manual reset, a single one otherwise */
+        wake_up( &event->obj, !event->manual_reset );
+        event->signaled = 0;
+        return;
+    }
+
+    /* client waiters may only get to look at the state once the event has been
+     * reset again, the set count is what tells them that a pulse happened */
+    obj = get_fsync_object( event->fsync_idx );
+    state = (set_fsync_event( obj ) + FSYNC_EVENT_SET_COUNT) | FSYNC_EVENT_SIGNALED;
     wake_up( &event->obj, !event->manual_reset );
-    event->signaled = 0;
+
+    if (event->manual_reset)
+    {
+        fsync_wake_futex( event->fsync_idx, INT_MAX );
+        __atomic_fetch_and( &obj->state, ~FSYNC_EVENT_SIGNALED, __ATOMIC_SEQ_CST );
+        return;
+    }
+
+    /* if no waiter took it yet, leave the pulse to the first client waiter that claims it */
+    if (__atomic_compare_exchange_n( &obj->state, &state, state & ~FSYNC_EVENT_SIGNALED,
+                                     0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ))
+    {
+        __atomic_store_n( &obj->pulse, state, __ATOMIC_SEQ_CST );
+        fsync_wake_futex( event->fsync_idx, INT_MAX );
+    }
 }
 
 void set_event( struct event *event )
 {
-    event->signaled = 1;
+    set_event_state( event, 1 );
     /* wake up all waiters if manual reset, a single one otherwise */
     wake_up( &event->obj, !event->manual_reset );
 }
 
 void reset_event( struct event *event )
 {
-    event->signaled = 0;
+    set_event_state( event, 0 );
+}
+
+unsigned int get_event_fsync_idx( struct object *obj )
+{
+    if (obj->ops != &event_ops) return 0;
+    return ((struct event *)obj)->fsync_idx;
 }
 
 static void event_dump( struct object *obj, int verbose )
@@ -185,13 +264,28 @@ static void event_dump( struct object *obj, int verbose )
     struct event *event = (struct event *)obj;
     assert( obj->ops == &event_ops );
     fprintf( stderr, "Event manual=%d signaled=%d\n",
-             event->manual_reset, event->signaled );
+             event->manual_reset, get_event_state( event ) );
+}
+
+static int event_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+    return fsync_add_queue( obj, entry, event->fsync_idx );
+}
+
+static void event_remove_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+    fsync_remove_queue( obj, entry, event->fsync_idx );
 }
 
 static int event_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct event *event = (struct event *)obj;
     assert( obj->ops == &event_ops );
+    if (event->fsync_idx) return fsync_signaled( event->fsync_idx, entry );
     return event->signaled;
 }
 
@@ -199,6 +293,8 @@ static void event_satisfied( struct object *obj, struct wait_queue_entry *entry
 {
     struct event *event = (struct event *)obj;
     assert( obj->ops == &event_ops );
+    /* fast synchronization objects are acquired when checking the wait */
+    if (event->fsync_idx) return;
     /* Reset if it's an auto-reset event */
     if (!event->manual_reset) event->signaled = 0;
 }
@@ -223,6 +319,13 @@ static struct list *event_get_kernel_obj_list( struct object *obj )
     return &event->kernel_object;
 }
 
+static void event_destroy( struct object *obj )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+    free_fsync_object( event->fsync_idx );
+}
+
 struct keyed_event *create_keyed_event( struct object *root, const struct unicode_str *name,
                                         unsigned int attr, const struct security_descriptor *sd )
 {
@@ -316,7 +419,7 @@ DECL_HANDLER(event_op)
     struct event *event;
 
     if (!(event = get_event_obj( current->process, req->handle, EVENT_MODIFY_STATE ))) return;
-    reply->state = event->signaled;
+    reply->state = get_event_state( event );
     switch(req->op)
     {
     case PULSE_EVENT:
@@ -343,7 +446,7 @@ DECL_HANDLER(query_event)
     if (!(event = get_event_obj( current->process, req->handle, EVENT_QUERY_STATE ))) return;
 
     reply->manual_reset = event->manual_reset;
-    reply->state = event->signaled;
+    reply->state = get_event_state( event );
 
     release_object( event );
 }
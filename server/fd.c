@@ -186,6 +186,7 @@ struct fd
     unsigned int         cacheable :1;/* can the fd be cached on the client side? */
     unsigned int         signaled :1; /* is the fd signaled? */
     unsigned int         fs_locks :1; /* can we use filesystem locks for this fd? */
+    unsigned int         may_linger :1; /* is it a socket whose close may block? */
     int                  poll_index;  /* index of fd in poll array */
     struct async_queue   read_q;      /* async readers of this fd */
     struct async_queue   write_q;     /* async writers of this fd */
@@ -363,16 +364,40 @@ static file_pos_t max_unix_offset = OFF_T_MAX;
 /****************************************************************/
 /* timeouts support */
 
+struct timeout_heap;
+
 struct timeout_user
 {
-    struct list           entry;      /* entry in sorted timeout list */
+    struct timeout_heap  *heap;       /* heap containing the timeout, NULL once expired */
+    unsigned int          index;      /* index in the heap array */
+    struct list           entry;      /* entry in expired list */
     abstime_t             when;       /* timeout expiry */
     timeout_callback      callback;   /* callback function */
     void                 *private;    /* callback private data */
 };
 
-static struct list abs_timeout_list = LIST_INIT(abs_timeout_list); /* sorted absolute timeouts list */
-static struct list rel_timeout_list = LIST_INIT(rel_timeout_list); /* sorted relative timeouts list */
+/* binary min-heap of timeouts, ordered by expiry time */
+struct timeout_heap
+{
+    struct timeout_user **users;      /* heap array */
+    unsigned int          count;      /* number of timeouts in the heap */
+    unsigned int          size;       /* allocated size of the array */
+};
+
+static struct timeout_heap abs_timeouts;  /* absolute timeouts, by system time */
+static struct timeout_heap rel_timeouts;  /* relative timeouts, by monotonic time */
+
+/* timeout statistics, dumped on SIGHUP */
+static struct
+{
+    unsigned int     max_count;       /* highest number of pending timeouts */
+    unsigned __int64 added;           /* total timeouts added */
+    unsigned __int64 removed;         /* total timeouts removed before expiry */
+    unsigned __int64 expired;         /* total timeouts expired */
+    timeout_t        total_lateness;  /* sum of expiry lateness */
+    timeout_t        max_lateness;    /* highest expiry lateness */
+} timeout_stats;
+
 timeout_t current_time;
 timeout_t monotonic_time;
 
@@ -449,46 +474,163 @@ void set_current_time(void)
     if (user_shared_data) set_user_shared_data_time();
 }
 
+/* return the expiry of a timeout in the time base of its heap */
+static inline timeout_t get_timeout_expiry( const struct timeout_user *user )
+{
+    return user->when > 0 ? user->when : -user->when;
+}
+
+static inline void set_heap_entry( struct timeout_heap *heap, unsigned int index, struct timeout_user *user )
+{
+    heap->users[index] = user;
+    user->index = index;
+}
+
+static void timeout_heap_sift_up( struct timeout_heap *heap, unsigned int index )
+{
+    struct timeout_user *user = heap->users[index];
+
+    while (index)
+    {
+        unsigned int parent = (index - 1) / 2;
+        if (get_timeout_expiry( heap->users[parent] ) <= get_timeout_expiry( user )) break;
+        set_heap_entry( heap, index, heap->users[parent] );
+        index = parent;
+    }
+    set_heap_entry( heap, index, user );
+}
+
+static void timeout_heap_sift_down( struct timeout_heap *heap, unsigned int index )
+{
+    struct timeout_user *user = heap->users[index];
+
+    for (;;)
+    {
+        unsigned int child = 2 * index + 1;
+
+        if (child >= heap->count) break;
+        if (child + 1 < heap->count &&
+            get_timeout_expiry( heap->users[child + 1] ) < get_timeout_expiry( heap->users[child] ))
+            child++;
+        if (get_timeout_expiry( user ) <= get_timeout_expiry( heap->users[child] )) break;
+        set_heap_entry( heap, index, heap->users[child] );
+        index = child;
+    }
+    set_heap_entry( heap, index, user );
+}
+
+static int timeout_heap_insert( struct timeout_heap *heap, struct timeout_user *user )
+{
+    if (heap->count == heap->size)
+    {
+        unsigned int new_size = max( 64, heap->size * 2 );
+        struct timeout_user **new_users = realloc( heap->users, new_size * sizeof(*new_users) );
+
+        if (!new_users)
+        {
+            set_error( STATUS_NO_MEMORY );
+            return 0;
+        }
+        heap->users = new_users;
+        heap->size  = new_size;
+    }
+    user->heap = heap;
+    heap->users[heap->count] = user;
+    timeout_heap_sift_up( heap, heap->count++ );
+    return 1;
+}
+
+static void timeout_heap_remove( struct timeout_heap *heap, struct timeout_user *user )
+{
+    unsigned int index = user->index;
+
+    assert( heap->users[index] == user );
+    user->heap = NULL;
+    if (index == --heap->count) return;
+
+    set_heap_entry( heap, index, heap->users[heap->count] );
+    if (index && get_timeout_expiry( heap->users[index] ) < get_timeout_expiry( heap->users[(index - 1) / 2] ))
+        timeout_heap_sift_up( heap, index );
+    else
+        timeout_heap_sift_down( heap, index );
+}
+
+/* move the expired timeouts of a heap to the expired list */
+static void timeout_heap_expire( struct timeout_heap *heap, timeout_t now, struct list *expired )
+{
+    while (heap->count && get_timeout_expiry( heap->users[0] ) <= now)
+    {
+        struct timeout_user *timeout = heap->users[0];
+        timeout_t lateness = now - get_timeout_expiry( timeout );
+
+        timeout_heap_remove( heap, timeout );
+        list_add_tail( expired, &timeout->entry );
+
+        timeout_stats.expired++;
+        timeout_stats.total_lateness += lateness;
+        if (lateness > timeout_stats.max_lateness) timeout_stats.max_lateness = lateness;
+    }
+}
+
+/* return the time until the next timeout of a heap, in milliseconds */
+static int timeout_heap_next( struct timeout_heap *heap, timeout_t now, int ret )
+{
+    timeout_t diff;
+
+    if (!heap->count) return ret;
+    diff = (get_timeout_expiry( heap->users[0] ) - now + 9999) / 10000;
+    if (diff > INT_MAX) diff = INT_MAX;
+    else if (diff < 0) diff = 0;
+    if (ret == -1 || diff < ret) ret = diff;
+    return ret;
+}
+
 /* add a timeout user */
 struct timeout_user *add_timeout_user( timeout_t when, timeout_callback func, void *private )
 {
     struct timeout_user *user;
-    struct list *ptr;
 
     if (!(user = mem_alloc( sizeof(*user) ))) return NULL;
     user->when     = timeout_to_abstime( when );
     user->callback = func;
     user->private  = private;
 
-    /* Now insert it in the linked list */
-
-    if (user->when > 0)
+    if (!timeout_heap_insert( user->when > 0 ? &abs_timeouts : &rel_timeouts, user ))
     {
-        LIST_FOR_EACH( ptr, &abs_timeout_list )
-        {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-            if (timeout->when >= user->when) break;
-        }
-    }
-    else
-    {
-        LIST_FOR_EACH( ptr, &rel_timeout_list )
-        {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-            if (timeout->when <= user->when) break;
-        }
+        free( user );
+        return NULL;
     }
-    list_add_before( ptr, &user->entry );
+
+    timeout_stats.added++;
+    timeout_stats.max_count = max( timeout_stats.max_count, abs_timeouts.count + rel_timeouts.count );
     return user;
 }
 
 /* remove a timeout user */
 void remove_timeout_user( struct timeout_user *user )
 {
-    list_remove( &user->entry );
+    if (user->heap)
+    {
+        timeout_heap_remove( user->heap, user );
+        timeout_stats.removed++;
+    }
+    else list_remove( &user->entry );  /* expired but callback not called yet */
     free( user );
 }
 
+/* dump the timeout statistics */
+void dump_timeout_stats(void)
+{
+    timeout_t avg = timeout_stats.expired ? timeout_stats.total_lateness / timeout_stats.expired : 0;
+
+    fprintf( stderr, "Timeouts: pending=%u (abs=%u rel=%u) max=%u added=%lu removed=%lu expired=%lu\n",
+             abs_timeouts.count + rel_timeouts.count, abs_timeouts.count, rel_timeouts.count,
+             timeout_stats.max_count, (unsigned long)timeout_stats.added,
+             (unsigned long)timeout_stats.removed, (unsigned long)timeout_stats.expired );
+    fprintf( stderr, "Timeouts: expiry lateness avg=%luus max=%luus\n",
+             (unsigned long)(avg / 10), (unsigned long)(timeout_stats.max_lateness / 10) );
+}
+
 /* return a text description of a timeout for debugging purposes */
 const char *get_timeout_str( timeout_t timeout )
 {
@@ -920,35 +1062,15 @@ static int get_next_timeout(void)
 {
     int ret = user_shared_data ? user_shared_data_timeout : -1;
 
-    if (!list_empty( &abs_timeout_list ) || !list_empty( &rel_timeout_list ))
+    if (abs_timeouts.count || rel_timeouts.count)
     {
         struct list expired_list, *ptr;
 
-        /* first remove all expired timers from the list */
+        /* first remove all expired timers from the heaps */
 
         list_init( &expired_list );
-        while ((ptr = list_head( &abs_timeout_list )) != NULL)
-        {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-
-            if (timeout->when <= current_time)
-            {
-                list_remove( &timeout->entry );
-                list_add_tail( &expired_list, &timeout->entry );
-            }
-            else break;
-        }
-        while ((ptr = list_head( &rel_timeout_list )) != NULL)
-        {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-
-            if (-timeout->when <= monotonic_time)
-            {
-                list_remove( &timeout->entry );
-                list_add_tail( &expired_list, &timeout->entry );
-            }
-            else break;
-        }
+        timeout_heap_expire( &abs_timeouts, current_time, &expired_list );
+        timeout_heap_expire( &rel_timeouts, monotonic_time, &expired_list );
 
         /* now call the callback for all the removed timers */
 
@@ -960,23 +1082,8 @@ static int get_next_timeout(void)
             free( timeout );
         }
 
-        if ((ptr = list_head( &abs_timeout_list )) != NULL)
-        {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-            timeout_t diff = (timeout->when - current_time + 9999) / 10000;
-            if (diff > INT_MAX) diff = INT_MAX;
-            else if (diff < 0) diff = 0;
-            if (ret == -1 || diff < ret) ret = diff;
-        }
-
-        if ((ptr = list_head( &rel_timeout_list )) != NULL)
-        {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-            timeout_t diff = (-timeout->when - monotonic_time + 9999) / 10000;
-            if (diff > INT_MAX) diff = INT_MAX;
-            else if (diff < 0) diff = 0;
-            if (ret == -1 || diff < ret) ret = diff;
-        }
+        ret = timeout_heap_next( &abs_timeouts, current_time, ret );
+        ret = timeout_heap_next( &rel_timeouts, monotonic_time, ret );
     }
     return ret;
 }
@@ -1584,7 +1691,11 @@ static void fd_destroy( struct object *obj )
     }
     else  /* no inode, close it right away */
     {
-        if (fd->unix_fd != -1) close( fd->unix_fd );
+        if (fd->unix_fd != -1)
+        {
+            if (fd->may_linger) close_lingering_fd( fd->unix_fd );
+            else close( fd->unix_fd );
+        }
         free( fd->unix_name );
     }
 }
@@ -1700,6 +1811,7 @@ static struct fd *alloc_fd_object(void)
     fd->cacheable  = 0;
     fd->signaled   = 1;
     fd->fs_locks   = 1;
+    fd->may_linger = 0;
     fd->poll_index = -1;
     fd->completion = NULL;
     fd->comp_flags = 0;
@@ -1738,6 +1850,7 @@ struct fd *alloc_pseudo_fd( const struct fd_ops *fd_user_ops, struct object *use
     fd->cacheable  = 0;
     fd->signaled   = 1;
     fd->fs_locks   = 0;
+    fd->may_linger = 0;
     fd->poll_index = -1;
     fd->completion = NULL;
     fd->comp_flags = 0;
@@ -2131,6 +2244,12 @@ void allow_fd_caching( struct fd *fd )
     fd->cacheable = 1;
 }
 
+/* mark the fd as a connection-oriented socket, that may linger on close */
+void set_fd_may_linger( struct fd *fd )
+{
+    fd->may_linger = 1;
+}
+
 /* check if fd is on a removable device */
 int is_fd_removable( struct fd *fd )
 {
@@ -2796,9 +2915,12 @@ DECL_HANDLER(get_handle_unix_name)
 /* get a Unix fd to access a file */
 DECL_HANDLER(get_handle_fd)
 {
+    struct object *obj;
     struct fd *fd;
 
-    if ((fd = get_handle_fd_obj( current->process, req->handle, 0 )))
+    if (!(obj = get_handle_obj( current->process, req->handle, 0, NULL ))) return;
+
+    if ((fd = get_obj_fd( obj )))
     {
         int unix_fd = get_unix_fd( fd );
         reply->cacheable = fd->cacheable;
@@ -2811,6 +2933,9 @@ DECL_HANDLER(get_handle_fd)
         }
         release_object( fd );
     }
+    /* objects without an fd will never get one, let the client remember the failure */
+    else if (obj->ops->get_fd == no_get_fd) reply->cacheable = 1;
+    release_object( obj );
 }
 
 /* perform a read on a file object */
@@ -101,6 +101,7 @@ extern void set_fd_events( struct fd *fd, int events );
 extern obj_handle_t lock_fd( struct fd *fd, file_pos_t offset, file_pos_t count, int shared, int wait );
 extern void unlock_fd( struct fd *fd, file_pos_t offset, file_pos_t count );
 extern void allow_fd_caching( struct fd *fd );
+extern void set_fd_may_linger( struct fd *fd );
 extern void set_fd_signaled( struct fd *fd, int signaled );
 extern char *dup_fd_name( struct fd *root, const char *name );
 extern void get_nt_name( struct fd *fd, struct unicode_str *name );
@@ -155,6 +156,17 @@ extern void set_current_time( void );
 extern struct timeout_user *add_timeout_user( timeout_t when, timeout_callback func, void *private );
 extern void remove_timeout_user( struct timeout_user *user );
 extern const char *get_timeout_str( timeout_t timeout );
+extern void dump_timeout_stats(void);
+
+/* server worker threads */
+
+typedef void (*worker_callback)( void *arg );
+
+extern int worker_threads;
+extern void queue_worker_job( worker_callback work, worker_callback done, void *arg );
+extern void close_lingering_fd( int unix_fd );
+extern void suspend_worker_threads(void);
+extern void resume_worker_threads(void);
 
 /* file functions */
 
@@ -173,6 +185,7 @@ extern int is_file_executable( const char *name );
 struct memory_view;
 
 extern int grow_file( int unix_fd, file_pos_t new_size );
+extern int create_temp_file( file_pos_t size );
 extern struct memory_view *find_mapped_view( struct process *process, client_ptr_t base );
 extern struct memory_view *get_exe_view( struct process *process );
 extern struct file *get_view_file( const struct memory_view *view, unsigned int access, unsigned int sharing );
@@ -184,6 +197,23 @@ extern struct mapping *create_fd_mapping( struct object *root, const struct unic
                                           unsigned int attr, const struct security_descriptor *sd );
 extern struct object *create_user_data_mapping( struct object *root, const struct unicode_str *name,
                                                 unsigned int attr, const struct security_descriptor *sd );
+extern struct object *create_session_mapping( struct object *root, const struct unicode_str *name,
+                                              unsigned int attr, const struct security_descriptor *sd );
+extern volatile void *alloc_session_shm( data_size_t size, unsigned int *offset );
+extern void free_session_shm( volatile void *ptr, data_size_t size );
+
+/* update an object in the session shared memory, see the *_shm_t types */
+
+static inline void shared_write_begin( volatile unsigned int *seq )
+{
+    __atomic_store_n( seq, *seq + 1, __ATOMIC_RELAXED );
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+}
+
+static inline void shared_write_end( volatile unsigned int *seq )
+{
+    __atomic_store_n( seq, *seq + 1, __ATOMIC_RELEASE );
+}
 
 /* device functions */
 
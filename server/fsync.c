@@ -0,0 +1,443 @@
+/*
+ * Fast synchronization objects in shared memory
+ *
+ * Copyright 2026 The Wine Project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * When enabled with WINEFSYNC=1, the state of events, semaphores and mutexes
+ * lives in a shared memory section mapped into every client. Clients operate
+ * on it directly with atomic instructions and wait on it with futexes; the
+ * server keeps using the same state for waits that it has to handle itself
+ * (mixed, alertable or wait-all waits). Objects with server-side waiters
+ * advertise it through the waiters count, so that clients know when they
+ * need to send a fsync_wake request after changing the state.
+ *
+ * Every set or pulse of an event increments its state, so that waiters
+ * can tell that the event has been set even if it got reset before they
+ * had a chance to run. Mutexes acquired by a client are recorded in a
+ * per-thread list at the end of the section before they are owned, so
+ * that they can be abandoned when the thread dies.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#ifdef HAVE_SYS_SYSCALL_H
+# include <sys/syscall.h>
+#endif
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winternl.h"
+
+#include "file.h"
+#include "handle.h"
+#include "request.h"
+#include "thread.h"
+
+#define FSYNC_SHM_SIZE     (16 * 1024 * 1024)
+#define FSYNC_MAX_THREADS  8192
+#define FSYNC_THREADS_SIZE (FSYNC_MAX_THREADS * sizeof(struct fsync_thread))
+#define FSYNC_MAX_OBJECTS  ((FSYNC_SHM_SIZE - FSYNC_THREADS_SIZE) / sizeof(struct fsync_object))
+
+struct index_stack
+{
+    unsigned int *indices;
+    unsigned int  count;
+    unsigned int  size;
+};
+
+static struct fsync_object *fsync_shm;     /* shared memory section */
+static struct fsync_thread *fsync_threads; /* per-thread lists of owned mutexes, at the end of the section */
+static int fsync_fd = -1;                  /* unix fd of the shared memory section */
+static unsigned int fsync_next = 1;        /* next never used index, 0 is invalid */
+static struct index_stack fsync_free;      /* freed object indices */
+static struct object **fsync_owners;       /* server object of each index */
+static unsigned int fsync_owners_size;
+static unsigned int fsync_thread_next;     /* next never used thread list */
+static struct index_stack fsync_thread_free; /* freed thread lists */
+
+/* push an index on a stack of free indices; return 0 if it had to be leaked */
+static int push_index( struct index_stack *stack, unsigned int index )
+{
+    if (stack->count == stack->size)
+    {
+        unsigned int new_size = max( 64, stack->size * 2 );
+        unsigned int *new_indices = realloc( stack->indices, new_size * sizeof(*new_indices) );
+        if (!new_indices) return 0;
+        stack->indices = new_indices;
+        stack->size = new_size;
+    }
+    stack->indices[stack->count++] = index;
+    return 1;
+}
+
+#ifdef __linux__
+static void futex_wake( int *addr, int count )
+{
+    syscall( __NR_futex, addr, 1 /* FUTEX_WAKE */, count, NULL, 0, 0 );
+}
+#else
+static void futex_wake( int *addr, int count ) { }
+#endif
+
+/* check if fast synchronization objects are enabled, mapping the section on first use */
+int do_fsync(void)
+{
+#ifdef __linux__
+    static int enabled = -1;
+    const char *env;
+    void *ptr;
+
+    if (enabled != -1) return enabled;
+
+    enabled = 0;
+    if (!(env = getenv( "WINEFSYNC" )) || !atoi( env )) return 0;
+    if ((fsync_fd = create_temp_file( FSYNC_SHM_SIZE )) == -1) return 0;
+    ptr = mmap( NULL, FSYNC_SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fsync_fd, 0 );
+    if (ptr == MAP_FAILED)
+    {
+        fprintf( stderr, "wineserver: cannot map fsync section: %s\n", strerror( errno ));
+        close( fsync_fd );
+        fsync_fd = -1;
+        return 0;
+    }
+    fsync_shm = ptr;
+    fsync_threads = (struct fsync_thread *)((char *)ptr + FSYNC_SHM_SIZE - FSYNC_THREADS_SIZE);
+    enabled = 1;
+    return enabled;
+#else
+    return 0;
+#endif
+}
+
+struct fsync_object *get_fsync_object( unsigned int index )
+{
+    assert( index && index < fsync_next );
+    return &fsync_shm[index];
+}
+
+/* allocate a shared object slot for a server object; return 0 if fsync is disabled or the section is full */
+unsigned int alloc_fsync_object( struct object *owner, enum fsync_type type, int state, int extra )
+{
+    struct fsync_object *obj;
+    unsigned int index;
+
+    if (!do_fsync()) return 0;
+
+    if (fsync_free.count) index = fsync_free.indices[--fsync_free.count];
+    else if (fsync_next < FSYNC_MAX_OBJECTS) index = fsync_next++;
+    else return 0;
+
+    if (index >= fsync_owners_size)
+    {
+        unsigned int new_size = max( 256, fsync_owners_size * 2 );
+        struct object **new_owners = realloc( fsync_owners, new_size * sizeof(*new_owners) );
+
+        if (!new_owners)
+        {
+            push_index( &fsync_free, index );
+            return 0;
+        }
+        memset( new_owners + fsync_owners_size, 0, (new_size - fsync_owners_size) * sizeof(*new_owners) );
+        fsync_owners = new_owners;
+        fsync_owners_size = new_size;
+    }
+    fsync_owners[index] = owner;
+
+    obj = &fsync_shm[index];
+    obj->extra   = extra;
+    obj->waiters = 0;
+    obj->type    = type;
+    obj->pulse   = 0;
+    __atomic_store_n( &obj->state, state, __ATOMIC_SEQ_CST );
+    return index;
+}
+
+void free_fsync_object( unsigned int index )
+{
+    if (!index) return;
+    memset( &fsync_shm[index], 0, sizeof(fsync_shm[index]) );
+    fsync_owners[index] = NULL;
+    push_index( &fsync_free, index );  /* the slot is leaked on failure */
+}
+
+/* retrieve the server object using a shared object slot; the index may come from a client */
+struct object *get_fsync_object_owner( unsigned int index )
+{
+    if (!index || index >= fsync_next || index >= fsync_owners_size) return NULL;
+    return fsync_owners[index];
+}
+
+/* retrieve the list of mutexes a thread acquired without the server, if it has one */
+struct fsync_thread *get_fsync_thread( struct thread *thread )
+{
+    if (!thread->fsync_thread) return NULL;
+    return &fsync_threads[thread->fsync_thread - 1];
+}
+
+/* remove a mutex from the list of a thread, after it has been released through the server */
+void remove_fsync_thread_mutex( struct thread *thread, unsigned int index )
+{
+    struct fsync_thread *list = get_fsync_thread( thread );
+    int i;
+
+    if (!list) return;
+    for (i = min( list->count, FSYNC_MAX_OWNED ) - 1; i >= 0; i--)
+    {
+        if (list->owned[i] != index) continue;
+        list->owned[i] = list->owned[list->count - 1];
+        list->count--;
+        break;
+    }
+}
+
+void free_fsync_thread( struct thread *thread )
+{
+    if (!thread->fsync_thread) return;
+    push_index( &fsync_thread_free, thread->fsync_thread - 1 );
+    thread->fsync_thread = 0;
+}
+
+/* wake up client threads waiting on the object futex */
+void fsync_wake_futex( unsigned int index, int count )
+{
+    futex_wake( &get_fsync_object( index )->state, count );
+}
+
+int fsync_add_queue( struct object *obj, struct wait_queue_entry *entry, unsigned int index )
+{
+    if (index)
+    {
+        entry->fsync_idx = index;
+        __atomic_add_fetch( &get_fsync_object( index )->waiters, 1, __ATOMIC_SEQ_CST );
+    }
+    return add_queue( obj, entry );
+}
+
+void fsync_remove_queue( struct object *obj, struct wait_queue_entry *entry, unsigned int index )
+{
+    if (index) __atomic_sub_fetch( &get_fsync_object( index )->waiters, 1, __ATOMIC_SEQ_CST );
+    remove_queue( obj, entry );
+}
+
+/* check whether the object could be acquired by the thread, without changing its state */
+static int fsync_is_signaled( struct fsync_object *obj, thread_id_t tid )
+{
+    int state = __atomic_load_n( &obj->state, __ATOMIC_SEQ_CST );
+
+    switch (obj->type)
+    {
+    case FSYNC_EVENT:
+        return state & FSYNC_EVENT_SIGNALED;
+    case FSYNC_SEMAPHORE:
+        return state != 0;
+    case FSYNC_MUTEX:
+        return !state || state == FSYNC_MUTEX_ABANDONED || state == (int)tid;
+    }
+    return 0;
+}
+
+/* try to acquire the object for the thread; return 1 on success, 2 if the mutex was abandoned */
+static int fsync_try_acquire( struct fsync_object *obj, thread_id_t tid, int *prev )
+{
+    int state = __atomic_load_n( &obj->state, __ATOMIC_SEQ_CST );
+
+    *prev = state;
+    switch (obj->type)
+    {
+    case FSYNC_EVENT:
+        if (!(state & FSYNC_EVENT_SIGNALED)) return 0;
+        if (obj->extra) return 1;
+        return __atomic_compare_exchange_n( &obj->state, prev, state & ~FSYNC_EVENT_SIGNALED, 0,
+                                            __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST );
+    case FSYNC_SEMAPHORE:
+        while (state)
+        {
+            if (__atomic_compare_exchange_n( &obj->state, &state, state - 1, 0,
+                                             __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ))
+                return 1;
+        }
+        return 0;
+    case FSYNC_MUTEX:
+        if (state == (int)tid)
+        {
+            obj->extra++;
+            return 1;
+        }
+        if (state && state != FSYNC_MUTEX_ABANDONED) return 0;
+        if (!__atomic_compare_exchange_n( &obj->state, prev, tid, 0,
+                                          __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ))
+            return 0;
+        obj->extra = 1;
+        return state ? 2 : 1;
+    }
+    return 0;
+}
+
+/* undo a successful fsync_try_acquire */
+static void fsync_undo_acquire( struct fsync_object *obj, thread_id_t tid, int prev )
+{
+    switch (obj->type)
+    {
+    case FSYNC_EVENT:
+        if (obj->extra) return;
+        __atomic_or_fetch( &obj->state, FSYNC_EVENT_SIGNALED, __ATOMIC_SEQ_CST );
+        futex_wake( &obj->state, 1 );
+        break;
+    case FSYNC_SEMAPHORE:
+        __atomic_add_fetch( &obj->state, 1, __ATOMIC_SEQ_CST );
+        futex_wake( &obj->state, 1 );
+        break;
+    case FSYNC_MUTEX:
+        if (prev == (int)tid)
+        {
+            obj->extra--;
+            break;
+        }
+        obj->extra = 0;
+        __atomic_store_n( &obj->state, prev, __ATOMIC_SEQ_CST );
+        futex_wake( &obj->state, 1 );
+        break;
+    }
+}
+
+/* signaled() implementation for fast synchronization objects */
+/* for single waits the object is acquired right away, since end_wait() follows immediately */
+int fsync_signaled( unsigned int index, struct wait_queue_entry *entry )
+{
+    struct fsync_object *obj = get_fsync_object( index );
+    thread_id_t tid = get_wait_queue_thread( entry )->id;
+    int prev, ret;
+
+    if (get_wait_queue_select_op( entry ) == SELECT_WAIT_ALL) return fsync_is_signaled( obj, tid );
+
+    if (!(ret = fsync_try_acquire( obj, tid, &prev ))) return 0;
+    if (ret == 2) make_wait_abandoned( entry );
+    return 1;
+}
+
+/* atomically acquire all the fast synchronization objects of a wait-all */
+/* return 0 if a client took one of them in the meantime */
+int fsync_satisfy_all( struct wait_queue_entry *entries, unsigned int count )
+{
+    int prev[MAXIMUM_WAIT_OBJECTS];
+    unsigned int i;
+    thread_id_t tid;
+    int ret;
+
+    if (!count) return 1;
+    tid = get_wait_queue_thread( entries )->id;
+
+    for (i = 0; i < count; i++)
+    {
+        if (!entries[i].fsync_idx) continue;
+        if (!(ret = fsync_try_acquire( get_fsync_object( entries[i].fsync_idx ), tid, &prev[i] ))) break;
+        if (ret == 2) make_wait_abandoned( &entries[i] );
+    }
+    if (i == count) return 1;
+
+    while (i--)
+    {
+        if (!entries[i].fsync_idx) continue;
+        fsync_undo_acquire( get_fsync_object( entries[i].fsync_idx ), tid, prev[i] );
+    }
+    return 0;
+}
+
+/* retrieve the fast synchronization object of a server object */
+static unsigned int get_object_fsync_idx( struct object *obj, enum fsync_type *type )
+{
+    unsigned int index;
+
+    if ((index = get_event_fsync_idx( obj ))) *type = FSYNC_EVENT;
+    else if ((index = get_semaphore_fsync_idx( obj ))) *type = FSYNC_SEMAPHORE;
+    else if ((index = get_mutex_fsync_idx( obj ))) *type = FSYNC_MUTEX;
+    else *type = FSYNC_NONE;
+    return index;
+}
+
+DECL_HANDLER(get_fsync_shm)
+{
+    if (!do_fsync())
+    {
+        set_error( STATUS_NOT_IMPLEMENTED );
+        return;
+    }
+    reply->size = FSYNC_SHM_SIZE;
+    send_client_fd( current->process, fsync_fd, 0 );
+}
+
+DECL_HANDLER(get_fsync_idx)
+{
+    enum fsync_type type;
+    struct object *obj;
+
+    if (!do_fsync())
+    {
+        set_error( STATUS_NOT_IMPLEMENTED );
+        return;
+    }
+    if (!(obj = get_handle_obj( current->process, req->handle, 0, NULL ))) return;
+
+    reply->index  = get_object_fsync_idx( obj, &type );
+    reply->type   = type;
+    reply->access = get_handle_access( current->process, req->handle );
+    release_object( obj );
+}
+
+DECL_HANDLER(get_fsync_thread)
+{
+    if (!do_fsync())
+    {
+        set_error( STATUS_NOT_IMPLEMENTED );
+        return;
+    }
+    if (!current->fsync_thread)
+    {
+        unsigned int index;
+
+        if (fsync_thread_free.count) index = fsync_thread_free.indices[--fsync_thread_free.count];
+        else if (fsync_thread_next < FSYNC_MAX_THREADS) index = fsync_thread_next++;
+        else
+        {
+            set_error( STATUS_NO_MEMORY );
+            return;
+        }
+        memset( &fsync_threads[index], 0, sizeof(fsync_threads[index]) );
+        current->fsync_thread = index + 1;
+    }
+    reply->offset = (char *)get_fsync_thread( current ) - (char *)fsync_shm;
+}
+
+DECL_HANDLER(fsync_wake)
+{
+    struct object *obj;
+
+    if (!(obj = get_handle_obj( current->process, req->handle, 0, NULL ))) return;
+    wake_up( obj, 0 );
+    release_object( obj );
+}
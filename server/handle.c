@@ -42,7 +42,7 @@
 struct handle_entry
 {
     struct object *ptr;       /* object */
-    unsigned int   access;    /* access rights */
+    unsigned int   access;    /* access rights, or next free entry if ptr is NULL */
 };
 
 struct handle_table
@@ -51,7 +51,11 @@ struct handle_table
     struct process      *process;     /* process owning this table */
     int                  count;       /* number of allocated entries */
     int                  last;        /* last used entry */
-    int                  free;        /* first entry that may be free */
+    int                  free;        /* head of the list of free entries, or -1 */
+    int                  used;        /* number of entries in use */
+    int                  peak;        /* highest number of entries in use */
+    unsigned int         grow_count;  /* number of times the table was grown */
+    unsigned int         shrink_count;/* number of times the table was shrunk */
     struct handle_entry *entries;     /* handle entries */
 };
 
@@ -151,8 +155,9 @@ static void handle_table_dump( struct object *obj, int verbose )
 
     assert( obj->ops == &handle_table_ops );
 
-    fprintf( stderr, "Handle table last=%d count=%d process=%p\n",
-             table->last, table->count, table->process );
+    fprintf( stderr, "Handle table last=%d count=%d used=%d peak=%d grown=%u shrunk=%u process=%p\n",
+             table->last, table->count, table->used, table->peak, table->grow_count,
+             table->shrink_count, table->process );
     if (!verbose) return;
     entry = table->entries;
     for (i = 0; i <= table->last; i++, entry++)
@@ -208,7 +213,11 @@ struct handle_table *alloc_handle_table( struct process *process, int count )
     table->process = process;
     table->count   = count;
     table->last    = -1;
-    table->free    = 0;
+    table->free    = -1;
+    table->used    = 0;
+    table->peak    = 0;
+    table->grow_count   = 0;
+    table->shrink_count = 0;
     if ((table->entries = mem_alloc( count * sizeof(*table->entries) ))) return table;
     release_object( table );
     return NULL;
@@ -228,26 +237,48 @@ static int grow_handle_table( struct handle_table *table )
     }
     table->entries = new_entries;
     table->count   = count;
+    table->grow_count++;
     return 1;
 }
 
-/* allocate the first free entry in the handle table */
+/* rebuild the list of free entries, with the lowest entries first */
+static void rebuild_free_list( struct handle_table *table )
+{
+    int i;
+
+    table->free = -1;
+    for (i = table->last; i >= 0; i--)
+    {
+        if (table->entries[i].ptr) continue;
+        table->entries[i].access = table->free;
+        table->free = i;
+    }
+}
+
+/* allocate a free entry in the handle table */
 static obj_handle_t alloc_entry( struct handle_table *table, void *obj, unsigned int access )
 {
-    struct handle_entry *entry = table->entries + table->free;
+    struct handle_entry *entry;
     int i;
 
-    for (i = table->free; i <= table->last; i++, entry++) if (!entry->ptr) goto found;
-    if (i >= table->count)
+    if ((i = table->free) != -1)
+    {
+        /* entries above last can be on the list if the table has been trimmed */
+        entry = table->entries + i;
+        table->free = entry->access;
+        if (i > table->last) table->last = i;
+    }
+    else
     {
-        if (!grow_handle_table( table )) return 0;
-        entry = table->entries + i;  /* the entries may have moved */
+        i = table->last + 1;
+        if (i >= table->count && !grow_handle_table( table )) return 0;
+        entry = table->entries + i;
+        table->last = i;
     }
-    table->last = i;
- found:
-    table->free = i + 1;
     entry->ptr    = grab_object_for_handle( obj );
     entry->access = access;
+    table->used++;
+    table->peak = max( table->peak, table->used );
     return index_to_handle(i);
 }
 
@@ -350,6 +381,9 @@ static void shrink_handle_table( struct handle_table *table )
     if (!(new_entries = realloc( table->entries, count * sizeof(*new_entries) ))) return;
     table->count   = count;
     table->entries = new_entries;
+    table->shrink_count++;
+    /* drop the entries that are now out of the table from the free list */
+    rebuild_free_list( table );
 }
 
 static void inherit_handle( struct process *parent, const obj_handle_t handle, struct handle_table *table )
@@ -366,6 +400,7 @@ static void inherit_handle( struct process *parent, const obj_handle_t handle, s
     grab_object_for_handle( src->ptr );
     dst[index] = *src;
     table->last = max( table->last, index );
+    table->used++;
 }
 
 /* copy the handle table of the parent process */
@@ -407,13 +442,19 @@ struct handle_table *copy_handle_table( struct process *process, struct process
             for (i = 0; i <= table->last; i++, ptr++)
             {
                 if (!ptr->ptr) continue;
-                if (ptr->access & RESERVED_INHERIT) grab_object_for_handle( ptr->ptr );
+                if (ptr->access & RESERVED_INHERIT)
+                {
+                    grab_object_for_handle( ptr->ptr );
+                    table->used++;
+                }
                 else ptr->ptr = NULL; /* don't inherit this entry */
             }
         }
     }
     /* attempt to shrink the table */
     shrink_handle_table( table );
+    rebuild_free_list( table );
+    table->peak = table->used;
     return table;
 }
 
@@ -430,7 +471,9 @@ unsigned int close_handle( struct process *process, obj_handle_t handle )
     if (!obj->ops->close_handle( obj, process, handle )) return STATUS_HANDLE_NOT_CLOSABLE;
     entry->ptr = NULL;
     table = handle_is_global(handle) ? global_table : process->handles;
-    if (entry < table->entries + table->free) table->free = entry - table->entries;
+    entry->access = table->free;
+    table->free = entry - table->entries;
+    table->used--;
     if (entry == table->entries + table->last) shrink_handle_table( table );
     release_object_from_handle( obj );
     return STATUS_SUCCESS;
@@ -632,11 +675,11 @@ obj_handle_t open_object( struct process *process, obj_handle_t parent, unsigned
     return handle;
 }
 
-/* return the size of the handle table of a given process */
+/* return the number of handles open in a given process */
 unsigned int get_handle_table_count( struct process *process )
 {
     if (!process->handles) return 0;
-    return process->handles->count;
+    return process->handles->used;
 }
 
 /* close a handle */
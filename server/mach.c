@@ -27,6 +27,7 @@
 #include <signal.h>
 #include <stdarg.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
 #ifdef HAVE_SYS_SYSCALL_H
 #include <sys/syscall.h>
@@ -53,7 +54,8 @@ static mach_port_t server_mach_port;
 
 void sigchld_callback(void)
 {
-    assert(0);  /* should never be called on MacOS */
+    /* client processes are not our children, only the registry save process is */
+    while (waitpid( -1, NULL, WNOHANG ) > 0) /* nothing */;
 }
 
 static void mach_set_error(kern_return_t mach_error)
@@ -52,6 +52,7 @@ static void usage( FILE *fh )
     fprintf(fh, "   -h,    --help            display this help message\n");
     fprintf(fh, "   -k[n], --kill[=n]        kill the current wineserver, optionally with signal n\n");
     fprintf(fh, "   -p[n], --persistent[=n]  make server persistent, optionally for n seconds\n");
+    fprintf(fh, "   -t n,  --threads=n       use n threads to close lingering sockets, 0 for none\n");
     fprintf(fh, "   -v,    --version         display version information and exit\n");
     fprintf(fh, "   -w,    --wait            wait until the current wineserver terminates\n");
     fprintf(fh, "\n");
@@ -88,6 +89,14 @@ static void option_callback( int optc, char *optarg )
         else
             master_socket_timeout = TIMEOUT_INFINITE;
         break;
+    case 't':
+        if (!isdigit(*optarg))
+        {
+            usage(stderr);
+            exit(1);
+        }
+        worker_threads = atoi( optarg );
+        break;
     case 'v':
         fprintf( stderr, "%s\n", PACKAGE_STRING );
         exit(0);
@@ -112,6 +121,7 @@ static struct long_option
     {"help",        0, 'h'},
     {"kill",        2, 'k'},
     {"persistent",  2, 'p'},
+    {"threads",     1, 't'},
     {"version",     0, 'v'},
     {"wait",        0, 'w'},
     { NULL }
@@ -216,7 +226,7 @@ int main( int argc, char *argv[] )
 {
     setvbuf( stderr, NULL, _IOLBF, 0 );
     server_argv0 = argv[0];
-    parse_options( argc, argv, "d::fhk::p::vw", long_options, option_callback );
+    parse_options( argc, argv, "d::fhk::p::t:vw", long_options, option_callback );
 
     /* setup temporary handlers before the real signal initialization is done */
     signal( SIGPIPE, SIG_IGN );
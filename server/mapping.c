@@ -297,7 +297,7 @@ static int check_current_dir_for_exec(void)
 }
 
 /* create a temp file for anonymous mappings */
-static int create_temp_file( file_pos_t size )
+int create_temp_file( file_pos_t size )
 {
     static int temp_dir_fd = -1;
     char tmpfn[16];
@@ -1097,6 +1097,61 @@ int get_page_size(void)
     return page_mask + 1;
 }
 
+/* session shared memory, allocated in blocks of SESSION_SHM_BLOCK bytes */
+#define SESSION_SHM_SIZE   (4 * 1024 * 1024)
+#define SESSION_SHM_BLOCK  64
+
+static char *session_shm;
+static unsigned int session_shm_next = SESSION_SHM_BLOCK;  /* offset 0 is reserved as invalid */
+static unsigned int session_shm_free[16];                  /* free lists indexed by block count */
+
+struct object *create_session_mapping( struct object *root, const struct unicode_str *name,
+                                       unsigned int attr, const struct security_descriptor *sd )
+{
+    void *ptr;
+    struct mapping *mapping;
+
+    if (!(mapping = create_mapping( root, name, attr, SESSION_SHM_SIZE,
+                                    SEC_COMMIT, 0, FILE_READ_DATA | FILE_WRITE_DATA, sd ))) return NULL;
+    ptr = mmap( NULL, mapping->size, PROT_READ | PROT_WRITE, MAP_SHARED, get_unix_fd( mapping->fd ), 0 );
+    if (ptr != MAP_FAILED) session_shm = ptr;
+    return &mapping->obj;
+}
+
+/* allocate a zeroed object in the session shared memory; return NULL if it isn't available */
+volatile void *alloc_session_shm( data_size_t size, unsigned int *offset )
+{
+    unsigned int count = (size + SESSION_SHM_BLOCK - 1) / SESSION_SHM_BLOCK;
+    unsigned int pos;
+
+    *offset = 0;
+    if (!session_shm || !count || count >= ARRAY_SIZE(session_shm_free)) return NULL;
+
+    if ((pos = session_shm_free[count]))
+        session_shm_free[count] = *(unsigned int *)(session_shm + pos);
+    else if (session_shm_next <= SESSION_SHM_SIZE - count * SESSION_SHM_BLOCK)
+    {
+        pos = session_shm_next;
+        session_shm_next += count * SESSION_SHM_BLOCK;
+    }
+    else return NULL;
+
+    memset( session_shm + pos, 0, count * SESSION_SHM_BLOCK );
+    *offset = pos;
+    return session_shm + pos;
+}
+
+void free_session_shm( volatile void *ptr, data_size_t size )
+{
+    unsigned int count = (size + SESSION_SHM_BLOCK - 1) / SESSION_SHM_BLOCK;
+    unsigned int pos;
+
+    if (!ptr) return;
+    pos = (char *)ptr - session_shm;
+    *(unsigned int *)(session_shm + pos) = session_shm_free[count];
+    session_shm_free[count] = pos;
+}
+
 struct object *create_user_data_mapping( struct object *root, const struct unicode_str *name,
                                         unsigned int attr, const struct security_descriptor *sd )
 {
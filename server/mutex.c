@@ -57,9 +57,12 @@ struct mutex
     unsigned int   count;           /* recursion count */
     int            abandoned;       /* has it been abandoned? */
     struct list    entry;           /* entry in owner thread mutex list */
+    unsigned int   fsync_idx;       /* fast synchronization object index */
 };
 
 static void mutex_dump( struct object *obj, int verbose );
+static int mutex_add_queue( struct object *obj, struct wait_queue_entry *entry );
+static void mutex_remove_queue( struct object *obj, struct wait_queue_entry *entry );
 static int mutex_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void mutex_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static void mutex_destroy( struct object *obj );
@@ -70,8 +73,8 @@ static const struct object_ops mutex_ops =
     sizeof(struct mutex),      /* size */
     &mutex_type,               /* type */
     mutex_dump,                /* dump */
-    add_queue,                 /* add_queue */
-    remove_queue,              /* remove_queue */
+    mutex_add_queue,           /* add_queue */
+    mutex_remove_queue,        /* remove_queue */
     mutex_signaled,            /* signaled */
     mutex_satisfied,           /* satisfied */
     mutex_signal,              /* signal */
@@ -126,24 +129,92 @@ static struct mutex *create_mutex( struct object *root, const struct unicode_str
             mutex->count = 0;
             mutex->owner = NULL;
             mutex->abandoned = 0;
-            if (owned) do_grab( mutex, current );
+            list_init( &mutex->entry );
+            if ((mutex->fsync_idx = alloc_fsync_object( &mutex->obj, FSYNC_MUTEX,
+                                                        owned ? current->id : 0, !!owned )))
+            {
+                if (owned) list_add_head( &current->mutex_list, &mutex->entry );
+            }
+            else if (owned) do_grab( mutex, current );
         }
     }
     return mutex;
 }
 
+/* abandon a shared memory mutex if it is still owned by the thread */
+static void abandon_fsync_mutex( struct mutex *mutex, struct thread *thread )
+{
+    struct fsync_object *obj = get_fsync_object( mutex->fsync_idx );
+
+    if (__atomic_load_n( &obj->state, __ATOMIC_SEQ_CST ) != (int)thread->id) return;
+    obj->extra = 0;
+    __atomic_store_n( &obj->state, FSYNC_MUTEX_ABANDONED, __ATOMIC_SEQ_CST );
+    fsync_wake_futex( mutex->fsync_idx, 1 );
+    wake_up( &mutex->obj, 0 );
+}
+
 void abandon_mutexes( struct thread *thread )
 {
+    struct fsync_thread *owned;
     struct list *ptr;
+    int i;
 
     while ((ptr = list_head( &thread->mutex_list )) != NULL)
     {
         struct mutex *mutex = LIST_ENTRY( ptr, struct mutex, entry );
+
+        if (mutex->fsync_idx)
+        {
+            /* the thread may have released it without telling us */
+            list_remove( &mutex->entry );
+            list_init( &mutex->entry );
+            abandon_fsync_mutex( mutex, thread );
+            continue;
+        }
         assert( mutex->owner == thread );
         mutex->count = 0;
         mutex->abandoned = 1;
         do_release( mutex );
     }
+
+    /* mutexes acquired by the client itself; entries are added before the mutex
+     * gets owned and may be stale, so they are checked against the object state */
+    if (!(owned = get_fsync_thread( thread ))) return;
+    for (i = 0; i < owned->count && i < FSYNC_MAX_OWNED; i++)
+    {
+        struct object *obj = get_fsync_object_owner( owned->owned[i] );
+        if (obj && obj->ops == &mutex_ops) abandon_fsync_mutex( (struct mutex *)obj, thread );
+    }
+    owned->count = 0;
+}
+
+/* release a shared memory mutex owned by the current thread */
+static int release_fsync_mutex( struct mutex *mutex, unsigned int *prev_count )
+{
+    struct fsync_object *obj = get_fsync_object( mutex->fsync_idx );
+
+    if (obj->state != (int)current->id)
+    {
+        set_error( STATUS_MUTANT_NOT_OWNED );
+        return 0;
+    }
+    if (prev_count) *prev_count = obj->extra;
+    if (!--obj->extra)
+    {
+        __atomic_store_n( &obj->state, 0, __ATOMIC_SEQ_CST );
+        list_remove( &mutex->entry );
+        list_init( &mutex->entry );
+        remove_fsync_thread_mutex( current, mutex->fsync_idx );
+        fsync_wake_futex( mutex->fsync_idx, 1 );
+        wake_up( &mutex->obj, 0 );
+    }
+    return 1;
+}
+
+unsigned int get_mutex_fsync_idx( struct object *obj )
+{
+    if (obj->ops != &mutex_ops) return 0;
+    return ((struct mutex *)obj)->fsync_idx;
 }
 
 static void mutex_dump( struct object *obj, int verbose )
@@ -153,10 +224,25 @@ static void mutex_dump( struct object *obj, int verbose )
     fprintf( stderr, "Mutex count=%u owner=%p\n", mutex->count, mutex->owner );
 }
 
+static int mutex_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct mutex *mutex = (struct mutex *)obj;
+    assert( obj->ops == &mutex_ops );
+    return fsync_add_queue( obj, entry, mutex->fsync_idx );
+}
+
+static void mutex_remove_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct mutex *mutex = (struct mutex *)obj;
+    assert( obj->ops == &mutex_ops );
+    fsync_remove_queue( obj, entry, mutex->fsync_idx );
+}
+
 static int mutex_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct mutex *mutex = (struct mutex *)obj;
     assert( obj->ops == &mutex_ops );
+    if (mutex->fsync_idx) return fsync_signaled( mutex->fsync_idx, entry );
     return (!mutex->count || (mutex->owner == get_wait_queue_thread( entry )));
 }
 
@@ -165,6 +251,19 @@ static void mutex_satisfied( struct object *obj, struct wait_queue_entry *entry
     struct mutex *mutex = (struct mutex *)obj;
     assert( obj->ops == &mutex_ops );
 
+    if (mutex->fsync_idx)
+    {
+        /* fast synchronization objects are acquired when checking the wait,
+         * we only need to remember the owner to abandon it on thread exit */
+        struct thread *thread = get_wait_queue_thread( entry );
+
+        if (__atomic_load_n( &get_fsync_object( mutex->fsync_idx )->state, __ATOMIC_SEQ_CST ) == (int)thread->id)
+        {
+            list_remove( &mutex->entry );
+            list_add_head( &thread->mutex_list, &mutex->entry );
+        }
+        return;
+    }
     do_grab( mutex, get_wait_queue_thread( entry ));
     if (mutex->abandoned) make_wait_abandoned( entry );
     mutex->abandoned = 0;
@@ -180,6 +279,7 @@ static int mutex_signal( struct object *obj, unsigned int access )
         set_error( STATUS_ACCESS_DENIED );
         return 0;
     }
+    if (mutex->fsync_idx) return release_fsync_mutex( mutex, NULL );
     if (!mutex->count || (mutex->owner != current))
     {
         set_error( STATUS_MUTANT_NOT_OWNED );
@@ -194,6 +294,12 @@ static void mutex_destroy( struct object *obj )
     struct mutex *mutex = (struct mutex *)obj;
     assert( obj->ops == &mutex_ops );
 
+    if (mutex->fsync_idx)
+    {
+        list_remove( &mutex->entry );
+        free_fsync_object( mutex->fsync_idx );
+        return;
+    }
     if (!mutex->count) return;
     mutex->count = 0;
     do_release( mutex );
@@ -240,7 +346,8 @@ DECL_HANDLER(release_mutex)
     if ((mutex = (struct mutex *)get_handle_obj( current->process, req->handle,
                                                  0, &mutex_ops )))
     {
-        if (!mutex->count || (mutex->owner != current)) set_error( STATUS_MUTANT_NOT_OWNED );
+        if (mutex->fsync_idx) release_fsync_mutex( mutex, &reply->prev_count );
+        else if (!mutex->count || (mutex->owner != current)) set_error( STATUS_MUTANT_NOT_OWNED );
         else
         {
             reply->prev_count = mutex->count;
@@ -258,10 +365,21 @@ DECL_HANDLER(query_mutex)
     if ((mutex = (struct mutex *)get_handle_obj( current->process, req->handle,
                                                  MUTANT_QUERY_STATE, &mutex_ops )))
     {
-        reply->count = mutex->count;
-        reply->owned = (mutex->owner == current);
-        reply->abandoned = mutex->abandoned;
+        if (mutex->fsync_idx)
+        {
+            struct fsync_object *obj = get_fsync_object( mutex->fsync_idx );
+            int owner = __atomic_load_n( &obj->state, __ATOMIC_SEQ_CST );
 
+            reply->count = (owner && owner != FSYNC_MUTEX_ABANDONED) ? obj->extra : 0;
+            reply->owned = (owner == (int)current->id);
+            reply->abandoned = (owner == FSYNC_MUTEX_ABANDONED);
+        }
+        else
+        {
+            reply->count = mutex->count;
+            reply->owned = (mutex->owner == current);
+            reply->abandoned = mutex->abandoned;
+        }
         release_object( mutex );
     }
 }
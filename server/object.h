@@ -137,6 +137,7 @@ struct wait_queue_entry
     struct list         entry;
     struct object      *obj;
     struct thread_wait *wait;
+    unsigned int        fsync_idx;  /* fast synchronization object index, if any */
 };
 
 extern void *mem_alloc( size_t size );  /* malloc wrapper */
@@ -214,10 +215,32 @@ extern struct event *get_event_obj( struct process *process, obj_handle_t handle
 extern struct keyed_event *get_keyed_event_obj( struct process *process, obj_handle_t handle, unsigned int access );
 extern void set_event( struct event *event );
 extern void reset_event( struct event *event );
+extern unsigned int get_event_fsync_idx( struct object *obj );
+
+/* semaphore functions */
+
+extern unsigned int get_semaphore_fsync_idx( struct object *obj );
 
 /* mutex functions */
 
 extern void abandon_mutexes( struct thread *thread );
+extern unsigned int get_mutex_fsync_idx( struct object *obj );
+
+/* fast synchronization functions */
+
+extern int do_fsync(void);
+extern struct fsync_object *get_fsync_object( unsigned int index );
+extern unsigned int alloc_fsync_object( struct object *owner, enum fsync_type type, int state, int extra );
+extern void free_fsync_object( unsigned int index );
+extern struct object *get_fsync_object_owner( unsigned int index );
+extern struct fsync_thread *get_fsync_thread( struct thread *thread );
+extern void remove_fsync_thread_mutex( struct thread *thread, unsigned int index );
+extern void free_fsync_thread( struct thread *thread );
+extern void fsync_wake_futex( unsigned int index, int count );
+extern int fsync_add_queue( struct object *obj, struct wait_queue_entry *entry, unsigned int index );
+extern void fsync_remove_queue( struct object *obj, struct wait_queue_entry *entry, unsigned int index );
+extern int fsync_signaled( unsigned int index, struct wait_queue_entry *entry );
+extern int fsync_satisfy_all( struct wait_queue_entry *entries, unsigned int count );
 
 /* serial functions */
 
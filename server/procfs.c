@@ -27,6 +27,7 @@
 #include <signal.h>
 #include <stdarg.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #include "ntstatus.h"
@@ -90,7 +91,8 @@ static int open_proc_lwpctl( struct thread *thread )
 /* handle a SIGCHLD signal */
 void sigchld_callback(void)
 {
-    assert( 0 );  /* should only be called when using ptrace */
+    /* client processes are not our children, only the registry save process is */
+    while (waitpid( -1, NULL, WNOHANG ) > 0) /* nothing */;
 }
 
 /* initialize the process tracing mechanism */
@@ -141,6 +141,8 @@ struct msg_queue
     struct hook_table     *hooks;           /* hook table */
     timeout_t              last_get_msg;    /* time of last get message call */
     int                    keystate_lock;   /* owns an input keystate lock */
+    queue_shm_t           *shared;          /* wakeup bits and masks in the session shared memory */
+    unsigned int           shared_offset;   /* offset of the shared state in the session memory */
 };
 
 struct hotkey
@@ -309,6 +311,7 @@ static struct msg_queue *create_msg_queue( struct thread *thread, struct thread_
         queue->hooks           = NULL;
         queue->last_get_msg    = current_time;
         queue->keystate_lock   = 0;
+        queue->shared          = alloc_session_shm( sizeof(*queue->shared), &queue->shared_offset );
         list_init( &queue->send_result );
         list_init( &queue->callback_result );
         list_init( &queue->pending_timers );
@@ -403,6 +406,20 @@ static struct message *alloc_hardware_message( lparam_t info, struct hw_msg_sour
     return msg;
 }
 
+/* update the desktop state visible to the clients */
+static void update_desktop_shm( struct desktop *desktop )
+{
+    desktop_shm_t *shared = desktop->shared;
+
+    if (!shared) return;
+    shared_write_begin( &shared->seq );
+    shared->cursor_x = desktop->cursor.x;
+    shared->cursor_y = desktop->cursor.y;
+    shared->cursor_last_change = desktop->cursor.last_change;
+    memcpy( (void *)shared->keystate, desktop->keystate, sizeof(desktop->keystate) );
+    shared_write_end( &shared->seq );
+}
+
 static int update_desktop_cursor_pos( struct desktop *desktop, int x, int y )
 {
     int updated;
@@ -413,6 +430,7 @@ static int update_desktop_cursor_pos( struct desktop *desktop, int x, int y )
     desktop->cursor.x = x;
     desktop->cursor.y = y;
     desktop->cursor.last_change = get_tick_count();
+    update_desktop_shm( desktop );
 
     return updated;
 }
@@ -500,6 +518,20 @@ void set_queue_hooks( struct thread *thread, struct hook_table *hooks )
     queue->hooks = hooks;
 }
 
+/* update the queue state visible to the clients */
+static void update_queue_shm( struct msg_queue *queue )
+{
+    queue_shm_t *shared = queue->shared;
+
+    if (!shared) return;
+    shared_write_begin( &shared->seq );
+    shared->wake_bits    = queue->wake_bits;
+    shared->changed_bits = queue->changed_bits;
+    shared->wake_mask    = queue->wake_mask;
+    shared->changed_mask = queue->changed_mask;
+    shared_write_end( &shared->seq );
+}
+
 /* check the queue status */
 static inline int is_signaled( struct msg_queue *queue )
 {
@@ -516,6 +548,7 @@ static inline void set_queue_bits( struct msg_queue *queue, unsigned int bits )
     }
     queue->wake_bits |= bits;
     queue->changed_bits |= bits;
+    update_queue_shm( queue );
     if (is_signaled( queue )) wake_up( &queue->obj, 0 );
 }
 
@@ -524,6 +557,7 @@ static inline void clear_queue_bits( struct msg_queue *queue, unsigned int bits
 {
     queue->wake_bits &= ~bits;
     queue->changed_bits &= ~bits;
+    update_queue_shm( queue );
     if (!(queue->wake_bits & (QS_KEY | QS_MOUSEBUTTON)))
     {
         if (queue->keystate_lock) unlock_input_keystate( queue->input );
@@ -1038,6 +1072,7 @@ static void msg_queue_satisfied( struct object *obj, struct wait_queue_entry *en
     struct msg_queue *queue = (struct msg_queue *)obj;
     queue->wake_mask = 0;
     queue->changed_mask = 0;
+    update_queue_shm( queue );
 }
 
 static void msg_queue_destroy( struct object *obj )
@@ -1077,6 +1112,7 @@ static void msg_queue_destroy( struct object *obj )
     release_object( queue->input );
     if (queue->hooks) release_object( queue->hooks );
     if (queue->fd) release_object( queue->fd );
+    free_session_shm( queue->shared, sizeof(*queue->shared) );
 }
 
 static void msg_queue_poll_event( struct fd *fd, int event )
@@ -1405,6 +1441,7 @@ static void update_input_key_state( struct desktop *desktop, unsigned char *keys
         }
         break;
     }
+    if (keystate == desktop->keystate) update_desktop_shm( desktop );
 }
 
 /* update the desktop key state according to a mouse message flags */
@@ -1785,6 +1822,7 @@ static int queue_mouse_message( struct desktop *desktop, user_handle_t win, cons
     };
 
     desktop->cursor.last_change = get_tick_count();
+    update_desktop_shm( desktop );
     flags = input->mouse.flags;
     time  = input->mouse.time;
     if (!time) time = desktop->cursor.last_change;
@@ -2402,7 +2440,11 @@ DECL_HANDLER(get_msg_queue)
     struct msg_queue *queue = get_current_queue();
 
     reply->handle = 0;
-    if (queue) reply->handle = alloc_handle( current->process, queue, SYNCHRONIZE, 0 );
+    if (queue)
+    {
+        reply->handle = alloc_handle( current->process, queue, SYNCHRONIZE, 0 );
+        reply->shm_offset = queue->shared_offset;
+    }
 }
 
 
@@ -2448,6 +2490,7 @@ DECL_HANDLER(set_queue_mask)
             if (req->skip_wait) queue->wake_mask = queue->changed_mask = 0;
             else wake_up( &queue->obj, 0 );
         }
+        update_queue_shm( queue );
     }
 }
 
@@ -2461,6 +2504,7 @@ DECL_HANDLER(get_queue_status)
         reply->wake_bits    = queue->wake_bits;
         reply->changed_bits = queue->changed_bits;
         queue->changed_bits &= ~req->clear_bits;
+        update_queue_shm( queue );
     }
     else reply->wake_bits = reply->changed_bits = 0;
 }
@@ -2643,6 +2687,7 @@ DECL_HANDLER(get_message)
     }
     if (filter & QS_INPUT) queue->changed_bits &= ~QS_INPUT;
     if (filter & QS_PAINT) queue->changed_bits &= ~QS_PAINT;
+    update_queue_shm( queue );
 
     /* then check for posted messages */
     if ((filter & QS_POSTMESSAGE) &&
@@ -2697,6 +2742,7 @@ DECL_HANDLER(get_message)
     if (get_win == -1 && current->process->idle_event) set_event( current->process->idle_event );
     queue->wake_mask = req->wake_mask;
     queue->changed_mask = req->changed_mask;
+    update_queue_shm( queue );
     set_error( STATUS_PENDING );  /* FIXME */
 }
 
@@ -3072,6 +3118,7 @@ DECL_HANDLER(get_key_state)
         {
             reply->state = desktop->keystate[req->key & 0xff];
             desktop->keystate[req->key & 0xff] &= ~0x40;
+            update_desktop_shm( desktop );
         }
         set_reply_data( desktop->keystate, size );
         release_object( desktop );
@@ -3102,6 +3149,7 @@ DECL_HANDLER(set_key_state)
     if (req->async && (desktop = get_thread_desktop( current, 0 )))
     {
         memcpy( desktop->keystate, get_req_data(), size );
+        update_desktop_shm( desktop );
         release_object( desktop );
     }
 }
@@ -29,12 +29,16 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <poll.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #include "ntstatus.h"
@@ -74,6 +78,21 @@ struct type_descr key_type =
     },
 };
 
+/* hash index entry for a subkey or value name */
+struct name_index_entry
+{
+    int               pos;         /* index in the subkeys or values array, -1 if free */
+    unsigned int      hash;        /* hash of the name */
+};
+
+/* hash index for the subkeys or values of a large key */
+/* entries are then appended to the array, and only sorted when needed */
+struct name_index
+{
+    unsigned int             size;     /* size of the hash table, 0 if not indexed */
+    struct name_index_entry *entries;  /* hash table, with linear probing */
+};
+
 /* a registry key */
 struct key
 {
@@ -82,11 +101,16 @@ struct key
     data_size_t       classlen;    /* length of class name */
     int               last_subkey; /* last in use subkey */
     int               nb_subkeys;  /* count of allocated subkeys */
+    int               sorted_subkeys; /* count of sorted subkeys at the start of the array */
     struct key      **subkeys;     /* subkeys array */
+    struct name_index subkey_index; /* hash index of the subkeys */
     struct key       *wow6432node; /* Wow6432Node subkey */
     int               last_value;  /* last in use value */
     int               nb_values;   /* count of allocated values in array */
+    int               sorted_values; /* count of sorted values at the start of the array */
     struct key_value *values;      /* values array */
+    struct name_index value_index; /* hash index of the values */
+    unsigned int      hash;        /* hash of the key name */
     unsigned int      flags;       /* flags */
     timeout_t         modif;       /* last modification time */
     struct list       notify_list; /* list of notifications */
@@ -107,6 +131,7 @@ struct key_value
 {
     WCHAR            *name;    /* value name */
     unsigned short    namelen; /* length of value name */
+    unsigned int      hash;    /* hash of value name */
     unsigned int      type;    /* value type */
     data_size_t       len;     /* value data length in bytes */
     void             *data;    /* pointer to value data */
@@ -114,6 +139,7 @@ struct key_value
 
 #define MIN_SUBKEYS  8   /* min. number of allocated subkeys per key */
 #define MIN_VALUES   8   /* min. number of allocated values per key */
+#define MIN_INDEXED  32  /* min. number of subkeys or values to use a hash index */
 
 #define MAX_NAME_LEN  256    /* max. length of a key name */
 #define MAX_VALUE_LEN 16383  /* max. length of a value name */
@@ -132,6 +158,8 @@ static const struct unicode_str symlink_str = { symlink_value, sizeof(symlink_va
 
 static void set_periodic_save_timer(void);
 static struct key_value *find_value( const struct key *key, const struct unicode_str *name, int *index );
+static void sort_subkeys( struct key *key );
+static void sort_values( struct key *key );
 
 /* information about where to save a registry branch */
 struct save_branch_info
@@ -285,12 +313,158 @@ static void dump_value( const struct key_value *value, FILE *f )
     fputc( '\n', f );
 }
 
+/* compute the case-insensitive hash of a subkey or value name */
+static inline unsigned int hash_name( const WCHAR *name, data_size_t len )
+{
+    return hash_strW( name, len, ~0u );
+}
+
+/* compare a subkey or value name with a string, using the sort order of the arrays */
+static inline int compare_name( const WCHAR *name, data_size_t namelen, const struct unicode_str *str )
+{
+    int res = memicmp_strW( name, str->str, min( namelen, str->len ));
+    if (!res) res = namelen - str->len;
+    return res;
+}
+
+/* resize and clear a hash index for the given number of entries */
+static int init_name_index( struct name_index *index, int count )
+{
+    struct name_index_entry *entries = index->entries;
+    unsigned int i, size = 2 * MIN_INDEXED;
+
+    while (size < 2 * count) size *= 2;
+    if (size != index->size)
+    {
+        if (!(entries = realloc( index->entries, size * sizeof(*entries) ))) return 0;
+        index->entries = entries;
+        index->size = size;
+    }
+    for (i = 0; i < size; i++) entries[i].pos = -1;
+    return 1;
+}
+
+static void free_name_index( struct name_index *index )
+{
+    free( index->entries );
+    index->entries = NULL;
+    index->size = 0;
+}
+
+/* add an entry to a hash index; the table must not be full */
+static void add_name_index( struct name_index *index, unsigned int hash, int pos )
+{
+    unsigned int i, mask = index->size - 1;
+
+    for (i = hash & mask; index->entries[i].pos != -1; i = (i + 1) & mask) ;
+    index->entries[i].pos  = pos;
+    index->entries[i].hash = hash;
+}
+
+/* remove an entry from a hash index, and renumber the entries following it in the array */
+static void remove_name_index( struct name_index *index, unsigned int hash, int pos, int last )
+{
+    unsigned int i, j, home, mask = index->size - 1;
+
+    for (i = hash & mask; index->entries[i].pos != pos; i = (i + 1) & mask) ;
+
+    /* shift back the following entries of the probe sequence, so that we don't need tombstones */
+    for (j = (i + 1) & mask; index->entries[j].pos != -1; j = (j + 1) & mask)
+    {
+        home = index->entries[j].hash & mask;
+        if (i <= j ? (i < home && home <= j) : (i < home || home <= j)) continue;
+        index->entries[i] = index->entries[j];
+        i = j;
+    }
+    index->entries[i].pos = -1;
+
+    if (pos < last)
+        for (i = 0; i < index->size; i++) if (index->entries[i].pos > pos) index->entries[i].pos--;
+}
+
+/* sort the unsorted entries at the end of an array and merge them with the sorted ones */
+static void sort_array( void *array, int sorted, int count, size_t size,
+                        int (*compare)( const void *, const void * ) )
+{
+    char *base = array, *tail;
+    int i, j, k;
+
+    if (sorted >= count) return;
+    qsort( base + sorted * size, count - sorted, size, compare );
+    if (!sorted || compare( base + (sorted - 1) * size, base + sorted * size ) < 0) return;
+    if (!(tail = malloc( (count - sorted) * size )))
+    {
+        qsort( base, count, size, compare );
+        return;
+    }
+    memcpy( tail, base + sorted * size, (count - sorted) * size );
+    for (i = sorted - 1, j = count - sorted - 1, k = count - 1; j >= 0; k--)
+    {
+        if (i >= 0 && compare( base + i * size, tail + j * size ) > 0)
+            memcpy( base + k * size, base + i-- * size, size );
+        else
+            memcpy( base + k * size, tail + j-- * size, size );
+    }
+    free( tail );
+}
+
+static int compare_subkeys( const void *p1, const void *p2 )
+{
+    const struct key *key1 = *(const struct key * const *)p1;
+    const struct key *key2 = *(const struct key * const *)p2;
+    struct unicode_str str = { key2->obj.name->name, key2->obj.name->len };
+
+    return compare_name( key1->obj.name->name, key1->obj.name->len, &str );
+}
+
+/* build the hash index of the subkeys; fall back to a sorted array on failure */
+static void build_subkey_index( struct key *key )
+{
+    int i;
+
+    if (!init_name_index( &key->subkey_index, key->last_subkey + 1 ))
+    {
+        free_name_index( &key->subkey_index );
+        sort_subkeys( key );
+        return;
+    }
+    for (i = 0; i <= key->last_subkey; i++)
+        add_name_index( &key->subkey_index, key->subkeys[i]->hash, i );
+}
+
+/* make sure the subkeys array is sorted, for operations that depend on the order */
+static void sort_subkeys( struct key *key )
+{
+    if (key->sorted_subkeys > key->last_subkey) return;
+    sort_array( key->subkeys, key->sorted_subkeys, key->last_subkey + 1,
+                sizeof(*key->subkeys), compare_subkeys );
+    key->sorted_subkeys = key->last_subkey + 1;
+    if (key->subkey_index.size) build_subkey_index( key );
+}
+
 /* find the named child of a given key and return its index */
 static struct key *find_subkey( const struct key *key, const struct unicode_str *name, int *index )
 {
     int i, min, max, res;
     data_size_t len;
 
+    if (key->subkey_index.size)
+    {
+        const struct name_index_entry *entry;
+        unsigned int hash = hash_name( name->str, name->len ), mask = key->subkey_index.size - 1;
+
+        for (i = hash & mask; (entry = &key->subkey_index.entries[i])->pos != -1; i = (i + 1) & mask)
+        {
+            if (entry->hash != hash) continue;
+            if (compare_name( key->subkeys[entry->pos]->obj.name->name,
+                              key->subkeys[entry->pos]->obj.name->len, name )) continue;
+            *index = entry->pos;
+            return key->subkeys[entry->pos];
+        }
+        *index = key->last_subkey + 1;  /* new subkeys are appended to indexed keys */
+        return NULL;
+    }
+
     min = 0;
     max = key->last_subkey;
     while (min <= max)
@@ -336,12 +510,44 @@ static int grow_subkeys( struct key *key )
     return 1;
 }
 
+/* insert a subkey at the index returned by find_subkey; the array must be large enough */
+static void insert_subkey( struct key *parent, struct key *key, int index )
+{
+    int i, count;
+
+    for (i = ++parent->last_subkey; i > index; i--) parent->subkeys[i] = parent->subkeys[i - 1];
+    parent->subkeys[index] = key;
+    count = parent->last_subkey + 1;
+
+    if (!parent->subkey_index.size)
+    {
+        parent->sorted_subkeys = count;
+        if (count >= MIN_INDEXED) build_subkey_index( parent );
+    }
+    else if (2 * count > parent->subkey_index.size) build_subkey_index( parent );
+    else add_name_index( &parent->subkey_index, key->hash, index );
+}
+
+/* remove the subkey at the given index from the array */
+static void remove_subkey( struct key *parent, int index )
+{
+    int i;
+
+    if (parent->subkey_index.size)
+        remove_name_index( &parent->subkey_index, parent->subkeys[index]->hash, index, parent->last_subkey );
+    if (index < parent->sorted_subkeys) parent->sorted_subkeys--;
+    for (i = index; i < parent->last_subkey; i++) parent->subkeys[i] = parent->subkeys[i + 1];
+    parent->last_subkey--;
+}
+
 /* save a registry and all its subkeys to a text file */
-static void save_subkeys( const struct key *key, const struct key *base, FILE *f )
+static void save_subkeys( struct key *key, const struct key *base, FILE *f )
 {
     int i;
 
     if (key->flags & KEY_VOLATILE) return;
+    sort_subkeys( key );
+    sort_values( key );
     /* save key if it has either some values or no subkeys, or needs special options */
     /* keys with no values but subkeys are saved implicitly by saving the subkeys */
     if ((key->last_value >= 0) || (key->last_subkey == -1) || key->class || (key->flags & KEY_SYMLINK))
@@ -573,7 +779,7 @@ static int key_link_name( struct object *obj, struct object_name *name, struct o
     struct key *key = (struct key *)obj;
     struct key *parent_key = (struct key *)parent;
     struct unicode_str tmp;
-    int i, index;
+    int index;
 
     if (parent->ops != &key_ops)
     {
@@ -592,9 +798,8 @@ static int key_link_name( struct object *obj, struct object_name *name, struct o
     tmp.len = name->len;
     find_subkey( parent_key, &tmp, &index );
 
-    for (i = ++parent_key->last_subkey; i > index; i--)
-        parent_key->subkeys[i] = parent_key->subkeys[i - 1];
-    parent_key->subkeys[index] = (struct key *)grab_object( key );
+    key->hash = hash_name( name->name, name->len );
+    insert_subkey( parent_key, (struct key *)grab_object( key ), index );
     if (is_wow6432node( name->name, name->len ) &&
         !is_wow6432node( parent_key->obj.name->name, parent_key->obj.name->len ))
         parent_key->wow6432node = key;
@@ -606,7 +811,8 @@ static void key_unlink_name( struct object *obj, struct object_name *name )
 {
     struct key *key = (struct key *)obj;
     struct key *parent = (struct key *)name->parent;
-    int i, nb_subkeys;
+    struct unicode_str tmp;
+    int index, nb_subkeys;
 
     if (!parent) return;
 
@@ -616,10 +822,11 @@ static void key_unlink_name( struct object *obj, struct object_name *name )
         return;
     }
 
-    for (i = 0; i <= parent->last_subkey; i++) if (parent->subkeys[i] == key) break;
-    assert( i <= parent->last_subkey );
-    for ( ; i < parent->last_subkey; i++) parent->subkeys[i] = parent->subkeys[i + 1];
-    parent->last_subkey--;
+    tmp.str = name->name;
+    tmp.len = name->len;
+    find_subkey( parent, &tmp, &index );
+    assert( index <= parent->last_subkey && parent->subkeys[index] == key );
+    remove_subkey( parent, index );
     name->parent = NULL;
     if (parent->wow6432node == key) parent->wow6432node = NULL;
     release_object( key );
@@ -660,12 +867,14 @@ static void key_destroy( struct object *obj )
         free( key->values[i].data );
     }
     free( key->values );
+    free_name_index( &key->value_index );
     for (i = 0; i <= key->last_subkey; i++)
     {
         key->subkeys[i]->obj.name->parent = NULL;
         release_object( key->subkeys[i] );
     }
     free( key->subkeys );
+    free_name_index( &key->subkey_index );
     /* unconditionally notify everything waiting on this key */
     while ((ptr = list_head( &key->notify_list )))
     {
@@ -693,11 +902,17 @@ static struct key *create_key_object( struct object *parent, const struct unicod
             key->flags       = 0;
             key->last_subkey = -1;
             key->nb_subkeys  = 0;
+            key->sorted_subkeys = 0;
             key->subkeys     = NULL;
+            key->subkey_index.size = 0;
+            key->subkey_index.entries = NULL;
             key->wow6432node = NULL;
             key->nb_values   = 0;
             key->last_value  = -1;
+            key->sorted_values = 0;
             key->values      = NULL;
+            key->value_index.size = 0;
+            key->value_index.entries = NULL;
             key->modif       = modif;
             list_init( &key->notify_list );
 
@@ -885,6 +1100,7 @@ static void enum_key( struct key *key, int index, int info_class, struct enum_ke
             set_error( STATUS_NO_MORE_ENTRIES );
             return;
         }
+        sort_subkeys( key );
         key = key->subkeys[index];
     }
 
@@ -964,8 +1180,9 @@ static void rename_key( struct key *key, const struct unicode_str *new_name )
 {
     struct object_name *new_name_ptr;
     struct key *subkey, *parent = get_parent( key );
+    struct unicode_str cur_name;
     data_size_t len;
-    int i, index, cur_index;
+    int index, cur_index;
 
     /* changing to a path is not allowed */
     len = get_path_element( new_name->str, new_name->len );
@@ -996,22 +1213,18 @@ static void rename_key( struct key *key, const struct unicode_str *new_name )
     new_name_ptr->parent = &parent->obj;
     memcpy( new_name_ptr->name, new_name->str, new_name->len );
 
-    for (cur_index = 0; cur_index <= parent->last_subkey; cur_index++)
-        if (parent->subkeys[cur_index] == key) break;
-
-    if (cur_index < index && (index - cur_index) > 1)
-    {
-        --index;
-        for (i = cur_index; i < index; ++i) parent->subkeys[i] = parent->subkeys[i+1];
-    }
-    else if (cur_index > index)
-    {
-        for (i = cur_index; i > index; --i) parent->subkeys[i] = parent->subkeys[i-1];
-    }
-    parent->subkeys[index] = key;
+    cur_name.str = key->obj.name->name;
+    cur_name.len = key->obj.name->len;
+    find_subkey( parent, &cur_name, &cur_index );
+    assert( cur_index <= parent->last_subkey && parent->subkeys[cur_index] == key );
+    remove_subkey( parent, cur_index );
 
     free( key->obj.name );
     key->obj.name = new_name_ptr;
+    key->hash = hash_name( new_name->str, new_name->len );
+
+    find_subkey( parent, new_name, &index );
+    insert_subkey( parent, key, index );
 
     if (debug_level > 1) dump_operation( key, NULL, "Rename" );
     touch_key( key, REG_NOTIFY_CHANGE_NAME );
@@ -1078,12 +1291,61 @@ static int grow_values( struct key *key )
     return 1;
 }
 
+static int compare_values( const void *p1, const void *p2 )
+{
+    const struct key_value *value1 = p1, *value2 = p2;
+    struct unicode_str str = { value2->name, value2->namelen };
+
+    return compare_name( value1->name, value1->namelen, &str );
+}
+
+/* build the hash index of the values; fall back to a sorted array on failure */
+static void build_value_index( struct key *key )
+{
+    int i;
+
+    if (!init_name_index( &key->value_index, key->last_value + 1 ))
+    {
+        free_name_index( &key->value_index );
+        sort_values( key );
+        return;
+    }
+    for (i = 0; i <= key->last_value; i++)
+        add_name_index( &key->value_index, key->values[i].hash, i );
+}
+
+/* make sure the values array is sorted, for operations that depend on the order */
+static void sort_values( struct key *key )
+{
+    if (key->sorted_values > key->last_value) return;
+    sort_array( key->values, key->sorted_values, key->last_value + 1,
+                sizeof(*key->values), compare_values );
+    key->sorted_values = key->last_value + 1;
+    if (key->value_index.size) build_value_index( key );
+}
+
 /* find the named value of a given key and return its index in the array */
 static struct key_value *find_value( const struct key *key, const struct unicode_str *name, int *index )
 {
     int i, min, max, res;
     data_size_t len;
 
+    if (key->value_index.size)
+    {
+        const struct name_index_entry *entry;
+        unsigned int hash = hash_name( name->str, name->len ), mask = key->value_index.size - 1;
+
+        for (i = hash & mask; (entry = &key->value_index.entries[i])->pos != -1; i = (i + 1) & mask)
+        {
+            if (entry->hash != hash) continue;
+            if (compare_name( key->values[entry->pos].name, key->values[entry->pos].namelen, name )) continue;
+            *index = entry->pos;
+            return &key->values[entry->pos];
+        }
+        *index = key->last_value + 1;  /* new values are appended to indexed keys */
+        return NULL;
+    }
+
     min = 0;
     max = key->last_value;
     while (min <= max)
@@ -1109,7 +1371,7 @@ static struct key_value *insert_value( struct key *key, const struct unicode_str
 {
     struct key_value *value;
     WCHAR *new_name = NULL;
-    int i;
+    int i, count;
 
     if (name->len > MAX_VALUE_LEN * sizeof(WCHAR))
     {
@@ -1125,9 +1387,23 @@ static struct key_value *insert_value( struct key *key, const struct unicode_str
     value = &key->values[index];
     value->name    = new_name;
     value->namelen = name->len;
+    value->hash    = hash_name( name->str, name->len );
     value->len     = 0;
     value->data    = NULL;
-    return value;
+
+    count = key->last_value + 1;
+    if (!key->value_index.size)
+    {
+        key->sorted_values = count;
+        if (count >= MIN_INDEXED) build_value_index( key );
+    }
+    else if (2 * count > key->value_index.size)
+    {
+        build_value_index( key );
+        if (!key->value_index.size) find_value( key, name, &index );  /* array got sorted */
+    }
+    else add_name_index( &key->value_index, value->hash, index );
+    return &key->values[index];
 }
 
 /* set a key value */
@@ -1227,6 +1503,7 @@ static void enum_value( struct key *key, int i, int info_class, struct enum_key_
         void *data;
         data_size_t namelen, maxlen;
 
+        sort_values( key );
         value = &key->values[i];
         reply->type = value->type;
         namelen = value->namelen;
@@ -1287,6 +1564,9 @@ static void delete_value( struct key *key, const struct unicode_str *name )
     if (debug_level > 1) dump_operation( key, value, "Delete" );
     free( value->name );
     free( value->data );
+    if (key->value_index.size)
+        remove_name_index( &key->value_index, value->hash, index, key->last_value );
+    if (index < key->sorted_values) key->sorted_values--;
     for (i = index; i < key->last_value; i++) key->values[i] = key->values[i + 1];
     key->last_value--;
     touch_key( key, REG_NOTIFY_CHANGE_LAST_SET );
@@ -1767,20 +2047,311 @@ static void load_registry( struct key *key, obj_handle_t handle )
     }
 }
 
+/* The registry files are also saved in a binary format that can be loaded without any parsing.
+ * The cache is only used if the size and modification time of the text file still match,
+ * so that the text file remains the reference and can be edited by hand. It is written
+ * along with the text file when a modified branch is saved, loading never writes it. */
+
+#define REG_CACHE_MAGIC   0x43474552  /* "REGC" */
+#define REG_CACHE_VERSION 1
+
+struct reg_cache_header
+{
+    unsigned int magic;        /* REG_CACHE_MAGIC */
+    unsigned int version;      /* REG_CACHE_VERSION */
+    unsigned int prefix_type;  /* prefix architecture */
+    unsigned int mtime_nsec;   /* nanoseconds part of the registry file modification time */
+    ULONGLONG    mtime;        /* registry file modification time */
+    ULONGLONG    file_size;    /* registry file size */
+    ULONGLONG    size;         /* total size of the cache file */
+};
+
+/* all records are aligned to 8 bytes */
+struct reg_cache_key
+{
+    timeout_t    modif;        /* last modification time */
+    unsigned int flags;        /* key flags (only KEY_SYMLINK is saved) */
+    unsigned int namelen;      /* length of key name in bytes */
+    unsigned int classlen;     /* length of class name in bytes */
+    unsigned int values;       /* number of values */
+    unsigned int subkeys;      /* number of subkeys */
+    unsigned int pad;
+    /* followed by the name, the class, the values and the subkeys */
+};
+
+struct reg_cache_value
+{
+    unsigned int namelen;      /* length of value name in bytes */
+    unsigned int type;         /* value type */
+    data_size_t  len;          /* value data length in bytes */
+    unsigned int pad;
+    /* followed by the name and the data */
+};
+
+/* return the name of the cache file for a given registry file */
+static char *get_registry_cache_path( const char *path )
+{
+    char *ret;
+
+    if ((ret = malloc( strlen(path) + sizeof(".cache") ))) sprintf( ret, "%s.cache", path );
+    return ret;
+}
+
+static unsigned int get_mtime_nsec( const struct stat *st )
+{
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    return st->st_mtim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    return st->st_mtimespec.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+/* write some data to the cache file, padded to 8 bytes */
+static void write_cache_data( FILE *f, const void *data, data_size_t len )
+{
+    static const char zero[8];
+
+    if (len) fwrite( data, len, 1, f );
+    if (len % 8) fwrite( zero, 8 - len % 8, 1, f );
+}
+
+/* save a key and all its subkeys to the cache file */
+static void save_cache_key( struct key *key, FILE *f )
+{
+    struct reg_cache_key rec;
+    struct reg_cache_value val;
+    int i;
+
+    sort_subkeys( key );
+    sort_values( key );
+    rec.modif    = key->modif;
+    rec.flags    = key->flags & KEY_SYMLINK;
+    rec.namelen  = key->obj.name ? key->obj.name->len : 0;
+    rec.classlen = key->class ? key->classlen : 0;
+    rec.values   = key->last_value + 1;
+    rec.subkeys  = 0;
+    rec.pad      = 0;
+    for (i = 0; i <= key->last_subkey; i++)
+        if (!(key->subkeys[i]->flags & KEY_VOLATILE)) rec.subkeys++;
+
+    write_cache_data( f, &rec, sizeof(rec) );
+    if (rec.namelen) write_cache_data( f, key->obj.name->name, rec.namelen );
+    write_cache_data( f, key->class, rec.classlen );
+    for (i = 0; i <= key->last_value; i++)
+    {
+        val.namelen = key->values[i].namelen;
+        val.type    = key->values[i].type;
+        val.len     = key->values[i].len;
+        val.pad     = 0;
+        write_cache_data( f, &val, sizeof(val) );
+        write_cache_data( f, key->values[i].name, val.namelen );
+        write_cache_data( f, key->values[i].data, val.len );
+    }
+    for (i = 0; i <= key->last_subkey; i++)
+        if (!(key->subkeys[i]->flags & KEY_VOLATILE)) save_cache_key( key->subkeys[i], f );
+}
+
+/* save the binary cache of a registry branch that has just been saved to path */
+static void save_registry_cache( struct key *key, const char *path )
+{
+    struct reg_cache_header header;
+    struct stat st;
+    char *cache, *tmp = NULL;
+    int fd, ret = 0;
+    FILE *f;
+
+    if (stat( path, &st ) == -1 || !S_ISREG(st.st_mode)) return;
+    if (!(cache = get_registry_cache_path( path ))) return;
+    if (!(tmp = malloc( strlen(cache) + 20 ))) goto done;
+    sprintf( tmp, "%s.%lx.tmp", cache, (long)getpid() );
+    if ((fd = open( tmp, O_CREAT | O_TRUNC | O_WRONLY, 0666 )) == -1) goto done;
+    if (!(f = fdopen( fd, "w" )))
+    {
+        close( fd );
+        goto done;
+    }
+
+    memset( &header, 0, sizeof(header) );
+    header.magic       = REG_CACHE_MAGIC;
+    header.version     = REG_CACHE_VERSION;
+    header.prefix_type = prefix_type;
+    header.mtime       = st.st_mtime;
+    header.mtime_nsec  = get_mtime_nsec( &st );
+    header.file_size   = st.st_size;
+    write_cache_data( f, &header, sizeof(header) );
+    save_cache_key( key, f );
+
+    /* now that the size is known, write the final header */
+    header.size = ftell( f );
+    ret = !fseek( f, 0, SEEK_SET ) && fwrite( &header, sizeof(header), 1, f ) == 1;
+    if (fclose( f )) ret = 0;
+    if (ret) ret = !rename( tmp, cache );
+    if (!ret) unlink( tmp );
+
+done:
+    if (!ret) unlink( cache );  /* make sure a stale cache is never used */
+    free( tmp );
+    free( cache );
+}
+
+/* get a pointer to the next record of the cache and skip over it */
+static const void *get_cache_data( const char **pos, const char *end, data_size_t len )
+{
+    const char *ret = *pos;
+
+    /* the cache size is a multiple of 8, so the padding is always present */
+    if (len > (size_t)(end - ret)) return NULL;
+    *pos += ((size_t)len + 7) & ~(size_t)7;
+    return ret;
+}
+
+/* load a key and its subkeys from the cache; if key is NULL, only check that the data is valid */
+static int load_cache_key( struct key *key, const char **pos, const char *end )
+{
+    const struct reg_cache_key *rec;
+    const struct reg_cache_value *val;
+    const void *class, *data;
+    struct key_value *value;
+    struct unicode_str name;
+    struct key *subkey;
+    unsigned int i;
+    int index, ret;
+
+    if (!(rec = get_cache_data( pos, end, sizeof(*rec) ))) return 0;
+    if (!get_cache_data( pos, end, rec->namelen )) return 0;
+    if (!(class = get_cache_data( pos, end, rec->classlen ))) return 0;
+    if (rec->classlen % sizeof(WCHAR)) return 0;
+
+    if (key)
+    {
+        key->modif = rec->modif;
+        key->flags |= rec->flags & KEY_SYMLINK;
+        if (rec->classlen)
+        {
+            free( key->class );
+            if (!(key->class = memdup( class, rec->classlen ))) return 0;
+            key->classlen = rec->classlen;
+        }
+    }
+
+    for (i = 0; i < rec->values; i++)
+    {
+        if (!(val = get_cache_data( pos, end, sizeof(*val) ))) return 0;
+        if (!(name.str = get_cache_data( pos, end, val->namelen ))) return 0;
+        if (!(data = get_cache_data( pos, end, val->len ))) return 0;
+        if (val->namelen > MAX_VALUE_LEN * sizeof(WCHAR) || val->namelen % sizeof(WCHAR)) return 0;
+        if (!key) continue;
+
+        name.len = val->namelen;
+        if (!(value = find_value( key, &name, &index )) && !(value = insert_value( key, &name, index )))
+            return 0;
+        free( value->data );
+        value->data = NULL;
+        value->len  = 0;
+        value->type = val->type;
+        if (val->len && !(value->data = memdup( data, val->len ))) return 0;
+        value->len = val->len;
+    }
+
+    for (i = 0; i < rec->subkeys; i++)
+    {
+        const struct reg_cache_key *sub = (const struct reg_cache_key *)*pos;
+
+        if (!get_cache_data( pos, end, sizeof(*sub) )) return 0;
+        if (sub->namelen > MAX_NAME_LEN * sizeof(WCHAR) || sub->namelen % sizeof(WCHAR) ||
+            sub->namelen > (size_t)(end - *pos))
+            return 0;
+        name.str = (const WCHAR *)*pos;
+        name.len = sub->namelen;
+        *pos = (const char *)sub;
+        if (!key)
+        {
+            unsigned int j;
+
+            if (!name.len) return 0;
+            for (j = 0; j < name.len / sizeof(WCHAR); j++) if (name.str[j] == '\\') return 0;
+            if (!load_cache_key( NULL, pos, end )) return 0;
+            continue;
+        }
+        if (!(subkey = create_key_object( &key->obj, &name, OBJ_OPENIF, 0, sub->modif, NULL ))) return 0;
+        ret = load_cache_key( subkey, pos, end );
+        release_object( subkey );
+        if (!ret) return 0;
+    }
+    return 1;
+}
+
+/* load a registry branch from its binary cache; return 0 if the cache is missing or out of date */
+static int load_registry_cache( struct key *key, const char *path )
+{
+    const struct reg_cache_header *header;
+    struct stat st, cache_st;
+    const char *pos, *end;
+    char *cache;
+    void *ptr;
+    int fd, ret = 0;
+
+    if (stat( path, &st ) == -1) return 0;
+    if (!(cache = get_registry_cache_path( path ))) return 0;
+    fd = open( cache, O_RDONLY );
+    free( cache );
+    if (fd == -1) return 0;
+    if (fstat( fd, &cache_st ) == -1 || cache_st.st_size < sizeof(*header) ||
+        (ULONGLONG)cache_st.st_size > (size_t)~0 / 2 ||
+        (ptr = mmap( NULL, cache_st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 )) == MAP_FAILED)
+    {
+        close( fd );
+        return 0;
+    }
+    close( fd );
+
+    header = ptr;
+    pos = (const char *)(header + 1);
+    end = (const char *)ptr + cache_st.st_size;
+    if (header->magic != REG_CACHE_MAGIC || header->version != REG_CACHE_VERSION) goto done;
+    if (header->size != cache_st.st_size || header->size % 8) goto done;
+    if (header->file_size != st.st_size || header->mtime != st.st_mtime ||
+        header->mtime_nsec != get_mtime_nsec( &st ))
+        goto done;
+    /* let the text parser report architecture mismatches */
+    if (header->prefix_type != PREFIX_UNKNOWN && prefix_type != PREFIX_UNKNOWN &&
+        header->prefix_type != prefix_type)
+        goto done;
+
+    /* validate everything first, so that we can still fall back to the text file */
+    if (!load_cache_key( NULL, &pos, end ) || pos != end) goto done;
+
+    if (prefix_type == PREFIX_UNKNOWN) prefix_type = header->prefix_type;
+    pos = (const char *)(header + 1);
+    ret = load_cache_key( key, &pos, end );
+    if (debug_level > 1) fprintf( stderr, "%s: loaded from cache\n", path );
+
+done:
+    munmap( ptr, cache_st.st_size );
+    return ret;
+}
+
 /* load one of the initial registry files */
 static int load_init_registry_from_file( const char *filename, struct key *key )
 {
     FILE *f;
+    int ret = 1;
 
-    if ((f = fopen( filename, "r" )))
+    if (!load_registry_cache( key, filename ))
     {
-        load_keys( key, filename, f, 0 );
-        fclose( f );
-        if (get_error() == STATUS_NOT_REGISTRY_FILE)
+        if ((f = fopen( filename, "r" )))
         {
-            fprintf( stderr, "%s is not a valid registry file\n", filename );
-            return 1;
+            load_keys( key, filename, f, 0 );
+            fclose( f );
+            if (get_error() == STATUS_NOT_REGISTRY_FILE)
+            {
+                fprintf( stderr, "%s is not a valid registry file\n", filename );
+                return 1;
+            }
         }
+        else ret = 0;
     }
 
     assert( save_branch_count < MAX_SAVE_BRANCH_INFO );
@@ -1788,7 +2359,7 @@ static int load_init_registry_from_file( const char *filename, struct key *key )
     save_branch_info[save_branch_count].path = filename;
     save_branch_info[save_branch_count++].key = (struct key *)grab_object( key );
     make_object_permanent( &key->obj );
-    return (f != NULL);
+    return ret;
 }
 
 static WCHAR *format_user_registry_path( const struct sid *sid, struct unicode_str *path )
@@ -2077,10 +2648,176 @@ static int save_branch( struct key *key, const char *path )
 
 done:
     free( tmp );
-    if (ret) make_clean( key );
+    if (ret)
+    {
+        save_registry_cache( key, path );
+        make_clean( key );
+    }
     return ret;
 }
 
+/* periodic saves are done by a child process working on a snapshot of the registry, */
+/* so that writing large branches doesn't block the server */
+
+struct save_process
+{
+    struct object    obj;       /* object header */
+    struct fd       *fd;        /* pipe receiving the result of the save */
+    pid_t            pid;       /* pid of the save process */
+    unsigned int     branches;  /* mask of the branches being saved */
+};
+
+static void save_process_dump( struct object *obj, int verbose );
+static void save_process_destroy( struct object *obj );
+
+static const struct object_ops save_process_ops =
+{
+    sizeof(struct save_process), /* size */
+    &no_type,                    /* type */
+    save_process_dump,           /* dump */
+    no_add_queue,                /* add_queue */
+    NULL,                        /* remove_queue */
+    NULL,                        /* signaled */
+    NULL,                        /* satisfied */
+    no_signal,                   /* signal */
+    no_get_fd,                   /* get_fd */
+    default_map_access,          /* map_access */
+    default_get_sd,              /* get_sd */
+    default_set_sd,              /* set_sd */
+    no_get_full_name,            /* get_full_name */
+    no_lookup_name,              /* lookup_name */
+    no_link_name,                /* link_name */
+    NULL,                        /* unlink_name */
+    no_open_file,                /* open_file */
+    no_kernel_obj_list,          /* get_kernel_obj_list */
+    no_close_handle,             /* close_handle */
+    save_process_destroy         /* destroy */
+};
+
+static void save_process_poll_event( struct fd *fd, int event );
+
+static const struct fd_ops save_process_fd_ops =
+{
+    NULL,                        /* get_poll_events */
+    save_process_poll_event,     /* poll_event */
+    NULL,                        /* flush */
+    NULL,                        /* get_fd_type */
+    NULL,                        /* ioctl */
+    NULL,                        /* queue_async */
+    NULL                         /* reselect_async */
+};
+
+static struct save_process *save_process;  /* currently running save process */
+
+static void save_process_dump( struct object *obj, int verbose )
+{
+    struct save_process *save = (struct save_process *)obj;
+    fprintf( stderr, "Registry save process pid=%d branches=%x\n", (int)save->pid, save->branches );
+}
+
+static void save_process_destroy( struct object *obj )
+{
+    struct save_process *save = (struct save_process *)obj;
+    if (save->fd) release_object( save->fd );
+}
+
+/* collect the result of the running save process, waiting for it if necessary */
+static void end_background_save(void)
+{
+    unsigned char saved = 0;
+    int i, ret;
+
+    if (!save_process) return;
+
+    do ret = read( get_unix_fd( save_process->fd ), &saved, 1 );
+    while (ret == -1 && errno == EINTR);
+    if (ret != 1) saved = 0;
+
+    for (i = 0; i < save_branch_count; i++)
+    {
+        if (!(save_process->branches & (1 << i)) || (saved & (1 << i))) continue;
+        fprintf( stderr, "wineserver: could not save registry branch to %s\n", save_branch_info[i].path );
+        make_dirty( save_branch_info[i].key );  /* try again next time */
+    }
+    waitpid( save_process->pid, NULL, WNOHANG );  /* otherwise reaped on SIGCHLD */
+    release_object( save_process );
+    save_process = NULL;
+}
+
+static void save_process_poll_event( struct fd *fd, int event )
+{
+    end_background_save();
+}
+
+/* save the dirty branches from a child process; the current dir must be the config dir */
+/* return 0 if the branches have to be saved synchronously */
+static int start_background_save(void)
+{
+    unsigned char saved = 0;
+    unsigned int branches = 0;
+    int i, ret, fd[2];
+    pid_t pid;
+
+    if (save_process) return 1;  /* the previous save is still running */
+
+    for (i = 0; i < save_branch_count; i++)
+        if (save_branch_info[i].key->flags & KEY_DIRTY) branches |= 1 << i;
+    if (!branches) return 1;
+
+    if (pipe( fd ) == -1) return 0;
+    if (!(save_process = alloc_object( &save_process_ops )))
+    {
+        close( fd[0] );
+        close( fd[1] );
+        return 0;
+    }
+    save_process->fd = NULL;
+    save_process->branches = branches;
+
+    /* the worker threads must not hold the malloc or stdio locks across the fork */
+    suspend_worker_threads();
+    pid = fork();
+    resume_worker_threads();
+
+    switch (pid)
+    {
+    case -1:
+        close( fd[0] );
+        close( fd[1] );
+        release_object( save_process );
+        save_process = NULL;
+        return 0;
+    case 0:
+        signal( SIGHUP, SIG_DFL );
+        signal( SIGINT, SIG_DFL );
+        signal( SIGQUIT, SIG_DFL );
+        signal( SIGTERM, SIG_DFL );
+        close( fd[0] );
+        for (i = 0; i < save_branch_count; i++)
+            if ((branches & (1 << i)) && save_branch( save_branch_info[i].key, save_branch_info[i].path ))
+                saved |= 1 << i;
+        do ret = write( fd[1], &saved, 1 );
+        while (ret == -1 && errno == EINTR);
+        _exit( ret == 1 ? 0 : 1 );
+    }
+
+    close( fd[1] );
+    save_process->pid = pid;
+    if (!(save_process->fd = create_anonymous_fd( &save_process_fd_ops, fd[0], &save_process->obj, 0 )))
+    {
+        /* leave the branches dirty, they will be saved again */
+        release_object( save_process );
+        save_process = NULL;
+        return 1;
+    }
+    set_fd_events( save_process->fd, POLLIN );
+
+    /* further changes will be saved next time */
+    for (i = 0; i < save_branch_count; i++)
+        if (branches & (1 << i)) make_clean( save_branch_info[i].key );
+    return 1;
+}
+
 /* periodic saving of the registry */
 static void periodic_save( void *arg )
 {
@@ -2088,8 +2825,11 @@ static void periodic_save( void *arg )
 
     if (fchdir( config_dir_fd ) == -1) return;
     save_timeout_user = NULL;
-    for (i = 0; i < save_branch_count; i++)
-        save_branch( save_branch_info[i].key, save_branch_info[i].path );
+    if (!start_background_save())
+    {
+        for (i = 0; i < save_branch_count; i++)
+            save_branch( save_branch_info[i].key, save_branch_info[i].path );
+    }
     if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
     set_periodic_save_timer();
 }
@@ -2106,6 +2846,8 @@ void flush_registry(void)
 {
     int i;
 
+    /* changes made since the background save was started are still marked dirty */
+    end_background_save();
     if (fchdir( config_dir_fd ) == -1) return;
     for (i = 0; i < save_branch_count; i++)
     {
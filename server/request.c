@@ -324,6 +324,85 @@ static void call_req_handler( struct thread *thread )
     current = NULL;
 }
 
+/* execute a batch of independent requests */
+DECL_HANDLER(batch_requests)
+{
+    const union generic_request batch_req = current->req;
+    void *batch_data = current->req_data;
+    const char *ptr = get_req_data();
+    data_size_t size = get_req_data_size(), reply_max = get_reply_max_size();
+    data_size_t req_size, reply_size, pos = 0;
+    union generic_reply sub_reply;
+    unsigned int error = STATUS_SUCCESS, count = 0;
+    enum request sub_req;
+    char *replies;
+
+    if (!reply_max)
+    {
+        set_error( STATUS_BUFFER_OVERFLOW );
+        return;
+    }
+    if (!(replies = set_reply_data_size( reply_max ))) return;
+
+    while (size)
+    {
+        if (size < sizeof(union generic_request))
+        {
+            error = STATUS_INVALID_PARAMETER;
+            break;
+        }
+        memcpy( &current->req, ptr, sizeof(current->req) );
+        req_size = (sizeof(union generic_request) + current->req.request_header.request_size + 7) & ~7;
+        if (req_size > size || req_size < sizeof(union generic_request))
+        {
+            error = STATUS_INVALID_PARAMETER;
+            break;
+        }
+        reply_size = (sizeof(union generic_reply) + current->req.request_header.reply_size + 7) & ~7;
+        if (current->req.request_header.reply_size > reply_max ||
+            reply_size < sizeof(union generic_reply) || reply_size > reply_max - pos)
+        {
+            error = STATUS_BUFFER_OVERFLOW;
+            break;
+        }
+
+        sub_req = current->req.request_header.req;
+        current->req_data = (void *)(ptr + sizeof(union generic_request));
+        current->reply_data = NULL;
+        current->reply_size = 0;
+        clear_error();
+        memset( &sub_reply, 0, sizeof(sub_reply) );
+
+        if (debug_level) trace_request();
+
+        if (sub_req < REQ_NB_REQUESTS && batch_handlers[sub_req])
+            batch_handlers[sub_req]( &current->req, &sub_reply );
+        else
+            set_error( STATUS_NOT_SUPPORTED );
+
+        sub_reply.reply_header.error = current->error;
+        sub_reply.reply_header.reply_size = current->reply_size;
+        if (debug_level) trace_reply( sub_req, &sub_reply );
+
+        memcpy( replies + pos, &sub_reply, sizeof(sub_reply) );
+        if (current->reply_size)
+            memcpy( replies + pos + sizeof(sub_reply), current->reply_data, current->reply_size );
+        free( current->reply_data );
+
+        ptr  += req_size;
+        size -= req_size;
+        pos  += reply_size;
+        count++;
+    }
+
+    current->req = batch_req;
+    current->req_data = batch_data;
+    current->reply_data = replies;
+    current->reply_size = pos;
+    current->error = error;
+    reply->count = count;
+}
+
 /* read a request from a thread */
 void read_request( struct thread *thread )
 {
@@ -162,6 +162,11 @@ DECL_HANDLER(create_semaphore);
 DECL_HANDLER(release_semaphore);
 DECL_HANDLER(query_semaphore);
 DECL_HANDLER(open_semaphore);
+DECL_HANDLER(get_fsync_shm);
+DECL_HANDLER(get_fsync_idx);
+DECL_HANDLER(get_fsync_thread);
+DECL_HANDLER(fsync_wake);
+DECL_HANDLER(batch_requests);
 DECL_HANDLER(create_file);
 DECL_HANDLER(open_file_object);
 DECL_HANDLER(alloc_file_handle);
@@ -175,8 +180,10 @@ DECL_HANDLER(lock_file);
 DECL_HANDLER(unlock_file);
 DECL_HANDLER(recv_socket);
 DECL_HANDLER(send_socket);
+DECL_HANDLER(rio_socket);
 DECL_HANDLER(socket_send_icmp_id);
 DECL_HANDLER(socket_get_icmp_id);
+DECL_HANDLER(get_socket_poll_state);
 DECL_HANDLER(get_next_console_request);
 DECL_HANDLER(read_directory_changes);
 DECL_HANDLER(read_change);
@@ -445,6 +452,11 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_release_semaphore,
     (req_handler)req_query_semaphore,
     (req_handler)req_open_semaphore,
+    (req_handler)req_get_fsync_shm,
+    (req_handler)req_get_fsync_idx,
+    (req_handler)req_get_fsync_thread,
+    (req_handler)req_fsync_wake,
+    (req_handler)req_batch_requests,
     (req_handler)req_create_file,
     (req_handler)req_open_file_object,
     (req_handler)req_alloc_file_handle,
@@ -458,8 +470,10 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_unlock_file,
     (req_handler)req_recv_socket,
     (req_handler)req_send_socket,
+    (req_handler)req_rio_socket,
     (req_handler)req_socket_send_icmp_id,
     (req_handler)req_socket_get_icmp_id,
+    (req_handler)req_get_socket_poll_state,
     (req_handler)req_get_next_console_request,
     (req_handler)req_read_directory_changes,
     (req_handler)req_read_change,
@@ -681,6 +695,294 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_get_next_thread,
 };
 
+static const req_handler batch_handlers[REQ_NB_REQUESTS] =
+{
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    (req_handler)req_set_key_value,
+    (req_handler)req_get_key_value,
+    (req_handler)req_enum_key_value,
+    (req_handler)req_delete_key_value,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+};
+
 C_ASSERT( sizeof(abstime_t) == 8 );
 C_ASSERT( sizeof(affinity_t) == 8 );
 C_ASSERT( sizeof(apc_call_t) == 48 );
@@ -982,6 +1284,23 @@ C_ASSERT( FIELD_OFFSET(struct open_semaphore_request, rootdir) == 20 );
 C_ASSERT( sizeof(struct open_semaphore_request) == 24 );
 C_ASSERT( FIELD_OFFSET(struct open_semaphore_reply, handle) == 8 );
 C_ASSERT( sizeof(struct open_semaphore_reply) == 16 );
+C_ASSERT( sizeof(struct get_fsync_shm_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_fsync_shm_reply, size) == 8 );
+C_ASSERT( sizeof(struct get_fsync_shm_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_fsync_idx_request, handle) == 12 );
+C_ASSERT( sizeof(struct get_fsync_idx_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_fsync_idx_reply, type) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_fsync_idx_reply, index) == 12 );
+C_ASSERT( FIELD_OFFSET(struct get_fsync_idx_reply, access) == 16 );
+C_ASSERT( sizeof(struct get_fsync_idx_reply) == 24 );
+C_ASSERT( sizeof(struct get_fsync_thread_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_fsync_thread_reply, offset) == 8 );
+C_ASSERT( sizeof(struct get_fsync_thread_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct fsync_wake_request, handle) == 12 );
+C_ASSERT( sizeof(struct fsync_wake_request) == 16 );
+C_ASSERT( sizeof(struct batch_requests_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct batch_requests_reply, count) == 8 );
+C_ASSERT( sizeof(struct batch_requests_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct create_file_request, access) == 12 );
 C_ASSERT( FIELD_OFFSET(struct create_file_request, sharing) == 16 );
 C_ASSERT( FIELD_OFFSET(struct create_file_request, create) == 20 );
@@ -1061,6 +1380,13 @@ C_ASSERT( FIELD_OFFSET(struct send_socket_reply, wait) == 8 );
 C_ASSERT( FIELD_OFFSET(struct send_socket_reply, options) == 12 );
 C_ASSERT( FIELD_OFFSET(struct send_socket_reply, nonblocking) == 16 );
 C_ASSERT( sizeof(struct send_socket_reply) == 24 );
+C_ASSERT( FIELD_OFFSET(struct rio_socket_request, handle) == 12 );
+C_ASSERT( FIELD_OFFSET(struct rio_socket_request, recv) == 16 );
+C_ASSERT( FIELD_OFFSET(struct rio_socket_request, send) == 20 );
+C_ASSERT( sizeof(struct rio_socket_request) == 24 );
+C_ASSERT( FIELD_OFFSET(struct rio_socket_reply, recv_direct) == 8 );
+C_ASSERT( FIELD_OFFSET(struct rio_socket_reply, send_direct) == 12 );
+C_ASSERT( sizeof(struct rio_socket_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct socket_send_icmp_id_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct socket_send_icmp_id_request, icmp_id) == 16 );
 C_ASSERT( FIELD_OFFSET(struct socket_send_icmp_id_request, icmp_seq) == 18 );
@@ -1071,6 +1397,10 @@ C_ASSERT( FIELD_OFFSET(struct socket_get_icmp_id_request, icmp_seq) == 16 );
 C_ASSERT( sizeof(struct socket_get_icmp_id_request) == 24 );
 C_ASSERT( FIELD_OFFSET(struct socket_get_icmp_id_reply, icmp_id) == 8 );
 C_ASSERT( sizeof(struct socket_get_icmp_id_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_socket_poll_state_request, handle) == 12 );
+C_ASSERT( sizeof(struct get_socket_poll_state_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_socket_poll_state_reply, state) == 8 );
+C_ASSERT( sizeof(struct get_socket_poll_state_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_next_console_request_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct get_next_console_request_request, signal) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_next_console_request_request, read) == 20 );
@@ -1308,6 +1638,7 @@ C_ASSERT( FIELD_OFFSET(struct get_atom_information_reply, total) == 16 );
 C_ASSERT( sizeof(struct get_atom_information_reply) == 24 );
 C_ASSERT( sizeof(struct get_msg_queue_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_msg_queue_reply, handle) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_msg_queue_reply, shm_offset) == 12 );
 C_ASSERT( sizeof(struct get_msg_queue_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_queue_fd_request, handle) == 12 );
 C_ASSERT( sizeof(struct set_queue_fd_request) == 16 );
@@ -1497,7 +1828,8 @@ C_ASSERT( FIELD_OFFSET(struct get_window_info_reply, atom) == 24 );
 C_ASSERT( FIELD_OFFSET(struct get_window_info_reply, is_unicode) == 28 );
 C_ASSERT( FIELD_OFFSET(struct get_window_info_reply, dpi) == 32 );
 C_ASSERT( FIELD_OFFSET(struct get_window_info_reply, awareness) == 36 );
-C_ASSERT( sizeof(struct get_window_info_reply) == 40 );
+C_ASSERT( FIELD_OFFSET(struct get_window_info_reply, shm_offset) == 40 );
+C_ASSERT( sizeof(struct get_window_info_reply) == 48 );
 C_ASSERT( FIELD_OFFSET(struct set_window_info_request, flags) == 12 );
 C_ASSERT( FIELD_OFFSET(struct set_window_info_request, is_unicode) == 14 );
 C_ASSERT( FIELD_OFFSET(struct set_window_info_request, handle) == 16 );
@@ -1687,6 +2019,7 @@ C_ASSERT( sizeof(struct close_desktop_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_thread_desktop_request, tid) == 12 );
 C_ASSERT( sizeof(struct get_thread_desktop_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_thread_desktop_reply, handle) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_thread_desktop_reply, shm_offset) == 12 );
 C_ASSERT( sizeof(struct get_thread_desktop_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_thread_desktop_request, handle) == 12 );
 C_ASSERT( sizeof(struct set_thread_desktop_request) == 16 );
@@ -55,20 +55,24 @@ struct semaphore
     struct object  obj;    /* object header */
     unsigned int   count;  /* current count */
     unsigned int   max;    /* maximum possible count */
+    unsigned int   fsync_idx; /* fast synchronization object index */
 };
 
 static void semaphore_dump( struct object *obj, int verbose );
+static int semaphore_add_queue( struct object *obj, struct wait_queue_entry *entry );
+static void semaphore_remove_queue( struct object *obj, struct wait_queue_entry *entry );
 static int semaphore_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void semaphore_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static int semaphore_signal( struct object *obj, unsigned int access );
+static void semaphore_destroy( struct object *obj );
 
 static const struct object_ops semaphore_ops =
 {
     sizeof(struct semaphore),      /* size */
     &semaphore_type,               /* type */
     semaphore_dump,                /* dump */
-    add_queue,                     /* add_queue */
-    remove_queue,                  /* remove_queue */
+    semaphore_add_queue,           /* add_queue */
+    semaphore_remove_queue,        /* remove_queue */
     semaphore_signaled,            /* signaled */
     semaphore_satisfied,           /* satisfied */
     semaphore_signal,              /* signal */
@@ -83,7 +87,7 @@ static const struct object_ops semaphore_ops =
     no_open_file,                  /* open_file */
     no_kernel_obj_list,            /* get_kernel_obj_list */
     no_close_handle,               /* close_handle */
-    no_destroy                     /* destroy */
+    semaphore_destroy              /* destroy */
 };
 
 
@@ -105,14 +109,42 @@ static struct semaphore *create_semaphore( struct object *root, const struct uni
             /* initialize it if it didn't already exist */
             sem->count = initial;
             sem->max   = max;
+            sem->fsync_idx = alloc_fsync_object( &sem->obj, FSYNC_SEMAPHORE, initial, max );
         }
     }
     return sem;
 }
 
+static int release_fsync_semaphore( struct semaphore *sem, unsigned int count,
+                                    unsigned int *prev )
+{
+    struct fsync_object *obj = get_fsync_object( sem->fsync_idx );
+    unsigned int current = __atomic_load_n( &obj->state, __ATOMIC_SEQ_CST );
+
+    do
+    {
+        if (prev) *prev = current;
+        if (current + count < current || current + count > sem->max)
+        {
+            set_error( STATUS_SEMAPHORE_LIMIT_EXCEEDED );
+            return 0;
+        }
+    } while (!__atomic_compare_exchange_n( &obj->state, (int *)&current, current + count, 0,
+                                           __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ));
+
+    if (!current)
+    {
+        fsync_wake_futex( sem->fsync_idx, count );
+        wake_up( &sem->obj, count );
+    }
+    return 1;
+}
+
 static int release_semaphore( struct semaphore *sem, unsigned int count,
                               unsigned int *prev )
 {
+    if (sem->fsync_idx) return release_fsync_semaphore( sem, count, prev );
+
     if (prev) *prev = sem->count;
     if (sem->count + count < sem->count || sem->count + count > sem->max)
     {
@@ -132,17 +164,45 @@ static int release_semaphore( struct semaphore *sem, unsigned int count,
     return 1;
 }
 
+static unsigned int get_semaphore_count( struct semaphore *sem )
+{
+    if (sem->fsync_idx)
+        return __atomic_load_n( &get_fsync_object( sem->fsync_idx )->state, __ATOMIC_SEQ_CST );
+    return sem->count;
+}
+
+unsigned int get_semaphore_fsync_idx( struct object *obj )
+{
+    if (obj->ops != &semaphore_ops) return 0;
+    return ((struct semaphore *)obj)->fsync_idx;
+}
+
 static void semaphore_dump( struct object *obj, int verbose )
 {
     struct semaphore *sem = (struct semaphore *)obj;
     assert( obj->ops == &semaphore_ops );
-    fprintf( stderr, "Semaphore count=%d max=%d\n", sem->count, sem->max );
+    fprintf( stderr, "Semaphore count=%d max=%d\n", get_semaphore_count( sem ), sem->max );
+}
+
+static int semaphore_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    return fsync_add_queue( obj, entry, sem->fsync_idx );
+}
+
+static void semaphore_remove_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    fsync_remove_queue( obj, entry, sem->fsync_idx );
 }
 
 static int semaphore_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct semaphore *sem = (struct semaphore *)obj;
     assert( obj->ops == &semaphore_ops );
+    if (sem->fsync_idx) return fsync_signaled( sem->fsync_idx, entry );
     return (sem->count > 0);
 }
 
@@ -150,6 +210,8 @@ static void semaphore_satisfied( struct object *obj, struct wait_queue_entry *en
 {
     struct semaphore *sem = (struct semaphore *)obj;
     assert( obj->ops == &semaphore_ops );
+    /* fast synchronization objects are acquired when checking the wait */
+    if (sem->fsync_idx) return;
     assert( sem->count );
     sem->count--;
 }
@@ -167,6 +229,13 @@ static int semaphore_signal( struct object *obj, unsigned int access )
     return release_semaphore( sem, 1, NULL );
 }
 
+static void semaphore_destroy( struct object *obj )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    free_fsync_object( sem->fsync_idx );
+}
+
 /* create a semaphore */
 DECL_HANDLER(create_semaphore)
 {
@@ -221,7 +290,7 @@ DECL_HANDLER(query_semaphore)
     if ((sem = (struct semaphore *)get_handle_obj( current->process, req->handle,
                                                    SEMAPHORE_QUERY_STATE, &semaphore_ops )))
     {
-        reply->current = sem->count;
+        reply->current = get_semaphore_count( sem );
         reply->max = sem->max;
         release_object( sem );
     }
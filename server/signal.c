@@ -176,6 +176,7 @@ static void sighup_callback(void)
 #ifdef DEBUG_OBJECTS
     dump_objects();
 #endif
+    dump_timeout_stats();
 }
 
 /* SIGTERM callback */
@@ -1752,6 +1752,7 @@ static int init_socket( struct sock *sock, int family, int type, int protocol )
     /* We can't immediately allow caching for a connection-mode socket, since it
      * might be accepted into (changing the underlying fd object.) */
     if (sock->type != WS_SOCK_STREAM) allow_fd_caching( sock->fd );
+    else set_fd_may_linger( sock->fd );
 
     return 0;
 }
@@ -1817,6 +1818,7 @@ static struct sock *accept_socket( struct sock *sock )
             release_object( acceptsock );
             return NULL;
         }
+        set_fd_may_linger( acceptsock->fd );
         unix_len = sizeof(unix_addr);
         if (!getsockname( acceptfd, &unix_addr.addr, &unix_len ))
             acceptsock->addr_len = sockaddr_from_unix( &unix_addr, &acceptsock->addr.addr, sizeof(acceptsock->addr) );
@@ -1845,6 +1847,7 @@ static int accept_into_socket( struct sock *sock, struct sock *acceptsock )
             return FALSE;
 
         set_fd_user( newfd, &sock_fd_ops, &acceptsock->obj );
+        set_fd_may_linger( newfd );
 
         release_object( sock->deferred );
         sock->deferred = NULL;
@@ -1857,6 +1860,7 @@ static int accept_into_socket( struct sock *sock, struct sock *acceptsock )
         if (!(newfd = create_anonymous_fd( &sock_fd_ops, acceptfd, &acceptsock->obj,
                                             get_fd_options( acceptsock->fd ) )))
             return FALSE;
+        set_fd_may_linger( newfd );
     }
 
     acceptsock->state = SOCK_CONNECTED;
@@ -3619,6 +3623,26 @@ DECL_HANDLER(send_socket)
     release_object( sock );
 }
 
+DECL_HANDLER(rio_socket)
+{
+    struct sock *sock = (struct sock *)get_handle_obj( current->process, req->handle, 0, &sock_ops );
+
+    if (!sock) return;
+
+    /* asyncs already queued have to complete first, so the requests must be queued behind them */
+    reply->recv_direct = req->recv && !sock->rd_shutdown && !async_queued( &sock->read_q );
+    reply->send_direct = req->send && !sock->wr_shutdown && !async_queued( &sock->write_q );
+
+    if (reply->recv_direct)
+    {
+        /* same as recv_socket, the client is going to consume the pending data */
+        sock->pending_events &= ~AFD_POLL_READ;
+        sock->reported_events &= ~AFD_POLL_READ;
+        sock_reselect( sock );
+    }
+    release_object( sock );
+}
+
 DECL_HANDLER(socket_send_icmp_id)
 {
     struct sock *sock = (struct sock *)get_handle_obj( current->process, req->handle, 0, &sock_ops );
@@ -3662,3 +3686,48 @@ DECL_HANDLER(socket_get_icmp_id)
     set_error( STATUS_NOT_FOUND );
     release_object( sock );
 }
+
+DECL_HANDLER(get_socket_poll_state)
+{
+    struct sock *sock = (struct sock *)get_handle_obj( current->process, req->handle, 0, &sock_ops );
+    unsigned int i;
+
+    if (!sock) return;
+
+    reply->state = SOCK_POLL_SERVER;
+
+    /* anything that poll_socket() would need to act upon or report by itself
+     * keeps the socket on the server path */
+    if (sock->reset || sock->hangup || sock->aborted ||
+        async_queued( &sock->read_q ) || async_queued( &sock->write_q ) ||
+        !list_empty( &sock->accept_list ) || sock->accept_recv_req || sock->connect_req)
+    {
+        release_object( sock );
+        return;
+    }
+    for (i = 0; i < AFD_POLL_BIT_COUNT; ++i)
+    {
+        if (sock->errors[i])
+        {
+            release_object( sock );
+            return;
+        }
+    }
+
+    switch (sock->state)
+    {
+    case SOCK_LISTENING:
+        reply->state = SOCK_POLL_LISTENING;
+        break;
+    case SOCK_CONNECTED:
+        if (sock->type == WS_SOCK_STREAM) reply->state = SOCK_POLL_CONNECTED;
+        break;
+    case SOCK_CONNECTIONLESS:
+        reply->state = SOCK_POLL_CONNECTIONLESS;
+        break;
+    default:
+        break;
+    }
+
+    release_object( sock );
+}
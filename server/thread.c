@@ -253,6 +253,8 @@ static inline void init_thread_structure( struct thread *thread )
     thread->creation_time = current_time;
     thread->exit_time     = 0;
 
+    thread->fsync_thread  = 0;
+
     list_init( &thread->mutex_list );
     list_init( &thread->system_apc );
     list_init( &thread->user_apc );
@@ -451,6 +453,7 @@ static void destroy_thread( struct object *obj )
 
     list_remove( &thread->entry );
     cleanup_thread( thread );
+    free_fsync_thread( thread );
     release_object( thread->process );
     if (thread->id) free_ptid( thread->id );
     if (thread->token) release_object( thread->token );
@@ -799,6 +802,7 @@ static int wait_on( const select_op_t *select_op, unsigned int count, struct obj
     {
         struct object *obj = objects[i];
         entry->wait = wait;
+        entry->fsync_idx = 0;
         if (!obj->ops->add_queue( obj, entry ))
         {
             wait->count = i;
@@ -850,7 +854,7 @@ static int check_wait( struct thread *thread )
          * want to do something when signaled, even if others are not */
         for (i = 0, entry = wait->queues; i < wait->count; i++, entry++)
             not_ok |= !entry->obj->ops->signaled( entry->obj, entry );
-        if (!not_ok) return STATUS_WAIT_0;
+        if (!not_ok && fsync_satisfy_all( wait->queues, wait->count )) return STATUS_WAIT_0;
     }
     else
     {
@@ -1894,6 +1894,52 @@ static void dump_open_semaphore_reply( const struct open_semaphore_reply *req )
     fprintf( stderr, " handle=%04x", req->handle );
 }
 
+static void dump_get_fsync_shm_request( const struct get_fsync_shm_request *req )
+{
+}
+
+static void dump_get_fsync_shm_reply( const struct get_fsync_shm_reply *req )
+{
+    fprintf( stderr, " size=%u", req->size );
+}
+
+static void dump_get_fsync_idx_request( const struct get_fsync_idx_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_get_fsync_idx_reply( const struct get_fsync_idx_reply *req )
+{
+    fprintf( stderr, " type=%d", req->type );
+    fprintf( stderr, ", index=%08x", req->index );
+    fprintf( stderr, ", access=%08x", req->access );
+}
+
+static void dump_get_fsync_thread_request( const struct get_fsync_thread_request *req )
+{
+}
+
+static void dump_get_fsync_thread_reply( const struct get_fsync_thread_reply *req )
+{
+    fprintf( stderr, " offset=%u", req->offset );
+}
+
+static void dump_fsync_wake_request( const struct fsync_wake_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_batch_requests_request( const struct batch_requests_request *req )
+{
+    dump_varargs_bytes( " data=", cur_size );
+}
+
+static void dump_batch_requests_reply( const struct batch_requests_reply *req )
+{
+    fprintf( stderr, " count=%08x", req->count );
+    dump_varargs_bytes( ", data=", cur_size );
+}
+
 static void dump_create_file_request( const struct create_file_request *req )
 {
     fprintf( stderr, " access=%08x", req->access );
@@ -2055,6 +2101,19 @@ static void dump_send_socket_reply( const struct send_socket_reply *req )
     fprintf( stderr, ", nonblocking=%d", req->nonblocking );
 }
 
+static void dump_rio_socket_request( const struct rio_socket_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", recv=%d", req->recv );
+    fprintf( stderr, ", send=%d", req->send );
+}
+
+static void dump_rio_socket_reply( const struct rio_socket_reply *req )
+{
+    fprintf( stderr, " recv_direct=%d", req->recv_direct );
+    fprintf( stderr, ", send_direct=%d", req->send_direct );
+}
+
 static void dump_socket_send_icmp_id_request( const struct socket_send_icmp_id_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -2073,6 +2132,16 @@ static void dump_socket_get_icmp_id_reply( const struct socket_get_icmp_id_reply
     fprintf( stderr, " icmp_id=%04x", req->icmp_id );
 }
 
+static void dump_get_socket_poll_state_request( const struct get_socket_poll_state_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_get_socket_poll_state_reply( const struct get_socket_poll_state_reply *req )
+{
+    fprintf( stderr, " state=%d", req->state );
+}
+
 static void dump_get_next_console_request_request( const struct get_next_console_request_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -2581,6 +2650,7 @@ static void dump_get_msg_queue_request( const struct get_msg_queue_request *req
 static void dump_get_msg_queue_reply( const struct get_msg_queue_reply *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", shm_offset=%08x", req->shm_offset );
 }
 
 static void dump_set_queue_fd_request( const struct set_queue_fd_request *req )
@@ -2934,6 +3004,7 @@ static void dump_get_window_info_reply( const struct get_window_info_reply *req
     fprintf( stderr, ", is_unicode=%d", req->is_unicode );
     fprintf( stderr, ", dpi=%d", req->dpi );
     fprintf( stderr, ", awareness=%d", req->awareness );
+    fprintf( stderr, ", shm_offset=%08x", req->shm_offset );
 }
 
 static void dump_set_window_info_request( const struct set_window_info_request *req )
@@ -3320,6 +3391,7 @@ static void dump_get_thread_desktop_request( const struct get_thread_desktop_req
 static void dump_get_thread_desktop_reply( const struct get_thread_desktop_reply *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", shm_offset=%08x", req->shm_offset );
 }
 
 static void dump_set_thread_desktop_request( const struct set_thread_desktop_request *req )
@@ -4543,6 +4615,11 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_release_semaphore_request,
     (dump_func)dump_query_semaphore_request,
     (dump_func)dump_open_semaphore_request,
+    (dump_func)dump_get_fsync_shm_request,
+    (dump_func)dump_get_fsync_idx_request,
+    (dump_func)dump_get_fsync_thread_request,
+    (dump_func)dump_fsync_wake_request,
+    (dump_func)dump_batch_requests_request,
     (dump_func)dump_create_file_request,
     (dump_func)dump_open_file_object_request,
     (dump_func)dump_alloc_file_handle_request,
@@ -4556,8 +4633,10 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_unlock_file_request,
     (dump_func)dump_recv_socket_request,
     (dump_func)dump_send_socket_request,
+    (dump_func)dump_rio_socket_request,
     (dump_func)dump_socket_send_icmp_id_request,
     (dump_func)dump_socket_get_icmp_id_request,
+    (dump_func)dump_get_socket_poll_state_request,
     (dump_func)dump_get_next_console_request_request,
     (dump_func)dump_read_directory_changes_request,
     (dump_func)dump_read_change_request,
@@ -4823,6 +4902,11 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_release_semaphore_reply,
     (dump_func)dump_query_semaphore_reply,
     (dump_func)dump_open_semaphore_reply,
+    (dump_func)dump_get_fsync_shm_reply,
+    (dump_func)dump_get_fsync_idx_reply,
+    (dump_func)dump_get_fsync_thread_reply,
+    NULL,
+    (dump_func)dump_batch_requests_reply,
     (dump_func)dump_create_file_reply,
     (dump_func)dump_open_file_object_reply,
     (dump_func)dump_alloc_file_handle_reply,
@@ -4836,8 +4920,10 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     NULL,
     (dump_func)dump_recv_socket_reply,
     (dump_func)dump_send_socket_reply,
+    (dump_func)dump_rio_socket_reply,
     NULL,
     (dump_func)dump_socket_get_icmp_id_reply,
+    (dump_func)dump_get_socket_poll_state_reply,
     (dump_func)dump_get_next_console_request_reply,
     NULL,
     (dump_func)dump_read_change_reply,
@@ -5103,6 +5189,11 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "release_semaphore",
     "query_semaphore",
     "open_semaphore",
+    "get_fsync_shm",
+    "get_fsync_idx",
+    "get_fsync_thread",
+    "fsync_wake",
+    "batch_requests",
     "create_file",
     "open_file_object",
     "alloc_file_handle",
@@ -5116,8 +5207,10 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "unlock_file",
     "recv_socket",
     "send_socket",
+    "rio_socket",
     "socket_send_icmp_id",
     "socket_get_icmp_id",
+    "get_socket_poll_state",
     "get_next_console_request",
     "read_directory_changes",
     "read_change",
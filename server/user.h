@@ -77,6 +77,8 @@ struct desktop
     unsigned int         users;            /* processes and threads using this desktop */
     struct global_cursor cursor;           /* global cursor information */
     unsigned char        keystate[256];    /* asynchronous key state */
+    desktop_shm_t       *shared;           /* cursor and key state in the session shared memory */
+    unsigned int         shared_offset;    /* offset of the shared state in the session memory */
 };
 
 /* user handles functions */
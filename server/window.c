@@ -30,6 +30,7 @@
 #include "ntuser.h"
 
 #include "object.h"
+#include "file.h"
 #include "request.h"
 #include "thread.h"
 #include "process.h"
@@ -94,6 +95,8 @@ struct window
     struct property *properties;      /* window properties array */
     int              nb_extra_bytes;  /* number of extra bytes */
     char            *extra_bytes;     /* extra bytes storage */
+    window_shm_t    *shared;          /* window record in the session shared memory */
+    unsigned int     shared_offset;   /* offset of the shared record in the session memory */
 };
 
 static void window_dump( struct object *obj, int verbose );
@@ -178,6 +181,7 @@ static void window_destroy( struct object *obj )
     if (win->win_region) free_region( win->win_region );
     if (win->update_region) free_region( win->update_region );
     if (win->class) release_class( win->class );
+    if (win->shared) free_session_shm( win->shared, sizeof(*win->shared) );
     free( win->text );
 
     if (win->nb_extra_bytes)
@@ -195,6 +199,29 @@ static inline struct window *get_window( user_handle_t handle )
     return ret;
 }
 
+/* publish the window information that clients can read without a server round trip */
+static void update_window_shm( struct window *win )
+{
+    window_shm_t *shared = win->shared;
+
+    if (!shared) return;
+    shared_write_begin( &shared->seq );
+    shared->handle      = win->handle;
+    shared->parent      = win->parent ? win->parent->handle : 0;
+    shared->owner       = win->owner;
+    shared->tid         = win->thread ? get_thread_id( win->thread ) : 0;
+    shared->pid         = win->thread ? get_process_id( win->thread->process ) : 0;
+    shared->style       = win->style;
+    shared->ex_style    = win->ex_style;
+    shared->id          = win->id;
+    shared->instance    = win->instance;
+    shared->user_data   = win->user_data;
+    shared->dpi         = win->dpi;
+    shared->window_rect = win->window_rect;
+    shared->client_rect = win->client_rect;
+    shared_write_end( &shared->seq );
+}
+
 /* check if window is the desktop */
 static inline int is_desktop_window( const struct window *win )
 {
@@ -306,6 +333,7 @@ static void link_window( struct window *win, struct window *previous )
     }
 
     win->is_linked = 1;
+    update_window_shm( win );
 }
 
 /* change the parent of a window (or unlink the window if the new parent is NULL) */
@@ -350,6 +378,7 @@ static int set_parent_window( struct window *win, struct window *parent )
         win->is_linked = 0;
         win->is_orphan = 1;
     }
+    update_window_shm( win );
     return 1;
 }
 
@@ -488,6 +517,7 @@ static void detach_window_thread( struct window *win )
     /* destroyed when the desktop ref count reaches zero */
     release_object( win->desktop );
     win->thread = NULL;
+    update_window_shm( win );
 }
 
 /* get the process owning the top window of a given desktop */
@@ -580,6 +610,8 @@ static struct window *create_window( struct window *parent, struct window *owner
     win->properties     = NULL;
     win->nb_extra_bytes = 0;
     win->extra_bytes    = NULL;
+    win->shared         = NULL;
+    win->shared_offset  = 0;
     win->window_rect = win->visible_rect = win->surface_rect = win->client_rect = empty_rect;
     list_init( &win->children );
     list_init( &win->unlinked );
@@ -591,6 +623,7 @@ static struct window *create_window( struct window *parent, struct window *owner
         win->nb_extra_bytes = extra_bytes;
     }
     if (!(win->handle = alloc_user_handle( win, USER_WINDOW ))) goto failed;
+    win->shared = alloc_session_shm( sizeof(*win->shared), &win->shared_offset );
 
     /* if parent belongs to a different thread and the window isn't */
     /* top-level, attach the two threads */
@@ -622,6 +655,7 @@ static struct window *create_window( struct window *parent, struct window *owner
     }
 
     current->desktop_users++;
+    update_window_shm( win );
     return win;
 
 failed:
@@ -1780,6 +1814,7 @@ static void set_window_pos( struct window *win, struct window *previous,
     if (!(swp_flags & SWP_NOZORDER) && win->parent) link_window( win, previous );
     if (swp_flags & SWP_SHOWWINDOW) win->style |= WS_VISIBLE;
     else if (swp_flags & SWP_HIDEWINDOW) win->style &= ~WS_VISIBLE;
+    update_window_shm( win );
 
     /* keep children at the same position relative to top right corner when the parent is mirrored */
     if (win->ex_style & WS_EX_LAYOUTRTL)
@@ -1794,6 +1829,7 @@ static void set_window_pos( struct window *win, struct window *previous,
             offset_rect( &child->visible_rect, new_size - old_size, 0 );
             offset_rect( &child->surface_rect, new_size - old_size, 0 );
             offset_rect( &child->client_rect, new_size - old_size, 0 );
+            update_window_shm( child );
         }
     }
 
@@ -1960,6 +1996,7 @@ void free_window_handle( struct window *win )
     {
         struct region *vis_rgn = get_visible_region( win, DCX_WINDOW );
         win->style &= ~WS_VISIBLE;
+        update_window_shm( win );
         if (vis_rgn)
         {
             struct region *exposed_rgn = expose_window( win, &win->window_rect, vis_rgn );
@@ -2013,6 +2050,7 @@ void free_window_handle( struct window *win )
     if (win->parent) set_parent_window( win, NULL );
     free_user_handle( win->handle );
     win->handle = 0;
+    update_window_shm( win );
     release_object( win );
 }
 
@@ -2066,6 +2104,7 @@ DECL_HANDLER(create_window)
     }
     win->style = req->style;
     win->ex_style = req->ex_style;
+    update_window_shm( win );
 
     reply->handle    = win->handle;
     reply->parent    = win->parent ? win->parent->handle : 0;
@@ -2133,6 +2172,7 @@ DECL_HANDLER(get_desktop_window)
         {
             detach_window_thread( desktop->top_window );
             desktop->top_window->style  = WS_POPUP | WS_VISIBLE | WS_CLIPSIBLINGS | WS_CLIPCHILDREN;
+            update_window_shm( desktop->top_window );
         }
     }
 
@@ -2145,6 +2185,7 @@ DECL_HANDLER(get_desktop_window)
         {
             detach_window_thread( desktop->msg_window );
             desktop->msg_window->style = WS_POPUP | WS_CLIPSIBLINGS | WS_CLIPCHILDREN;
+            update_window_shm( desktop->msg_window );
         }
     }
 
@@ -2180,6 +2221,7 @@ DECL_HANDLER(set_window_owner)
 
     reply->prev_owner = win->owner;
     reply->full_owner = win->owner = owner ? owner->handle : 0;
+    update_window_shm( win );
 }
 
 
@@ -2195,6 +2237,7 @@ DECL_HANDLER(get_window_info)
     reply->is_unicode  = win->is_unicode;
     reply->awareness   = win->dpi_awareness;
     reply->dpi         = win->dpi ? win->dpi : get_monitor_dpi( win );
+    reply->shm_offset  = win->shared_offset;
     if (get_user_object( win->last_active, USER_WINDOW )) reply->last_active = win->last_active;
     if (win->thread)
     {
@@ -2251,6 +2294,7 @@ DECL_HANDLER(set_window_info)
     if (req->flags & SET_WIN_USERDATA) win->user_data = req->user_data;
     if (req->flags & SET_WIN_EXTRA) memcpy( win->extra_bytes + req->extra_offset,
                                             &req->extra_value, req->extra_size );
+    if (req->flags & ~SET_WIN_EXTRA) update_window_shm( win );
 
     /* changing window style triggers a non-client paint */
     if (req->flags & SET_WIN_STYLE) win->paint_flags |= PAINT_NONCLIENT;
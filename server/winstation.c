@@ -237,6 +237,7 @@ static struct desktop *create_desktop( const struct unicode_str *name, unsigned
             desktop->users = 0;
             memset( &desktop->cursor, 0, sizeof(desktop->cursor) );
             memset( desktop->keystate, 0, sizeof(desktop->keystate) );
+            desktop->shared = alloc_session_shm( sizeof(*desktop->shared), &desktop->shared_offset );
             list_add_tail( &winstation->desktops, &desktop->entry );
             list_init( &desktop->hotkeys );
         }
@@ -291,6 +292,7 @@ static void desktop_destroy( struct object *obj )
     if (desktop->msg_window) free_window_handle( desktop->msg_window );
     if (desktop->global_hooks) release_object( desktop->global_hooks );
     if (desktop->close_timeout) remove_timeout_user( desktop->close_timeout );
+    free_session_shm( desktop->shared, sizeof(*desktop->shared) );
     list_remove( &desktop->entry );
     release_object( desktop->winstation );
 }
@@ -597,9 +599,16 @@ DECL_HANDLER(close_desktop)
 DECL_HANDLER(get_thread_desktop)
 {
     struct thread *thread;
+    struct desktop *desktop;
 
     if (!(thread = get_thread_from_id( req->tid ))) return;
     reply->handle = thread->desktop;
+    if ((desktop = get_desktop_obj( thread->process, thread->desktop, 0 )))
+    {
+        reply->shm_offset = desktop->shared_offset;
+        release_object( desktop );
+    }
+    else clear_error();
     release_object( thread );
 }
 
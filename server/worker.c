@@ -0,0 +1,312 @@
+/*
+ * Server worker threads
+ *
+ * Copyright 2026 The Wine Project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * The server remains single-threaded: requests are always dispatched and
+ * processed by the main thread, which owns all server objects. Workers only
+ * run self-contained jobs that may block in the kernel, currently closing
+ * stream sockets that have a SO_LINGER timeout set, and must not touch server
+ * objects; the job completion callback is then called on the main thread
+ * from the main loop. Jobs may only make async-signal-safe calls, and workers
+ * only use other libc functions while holding worker_mutex, so that holding
+ * it makes the pool quiescent for fork().
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winternl.h"
+
+#include "file.h"
+#include "object.h"
+#include "request.h"
+
+int worker_threads = 2;  /* number of worker threads, 0 to run jobs synchronously */
+
+struct worker_job
+{
+    struct list      entry;     /* entry in pending or completed list */
+    worker_callback  work;      /* job function, called on a worker thread */
+    worker_callback  done;      /* completion function, called on the main thread */
+    void            *arg;       /* callback argument */
+};
+
+#ifdef HAVE_PTHREAD_H
+
+struct worker_pool
+{
+    struct object    obj;       /* object header */
+    struct fd       *fd;        /* file descriptor for the completion pipe */
+    int              pipe_write;  /* unix fd for the pipe write side */
+};
+
+static void worker_pool_dump( struct object *obj, int verbose );
+static void worker_pool_destroy( struct object *obj );
+
+static const struct object_ops worker_pool_ops =
+{
+    sizeof(struct worker_pool), /* size */
+    &no_type,                   /* type */
+    worker_pool_dump,           /* dump */
+    no_add_queue,               /* add_queue */
+    NULL,                       /* remove_queue */
+    NULL,                       /* signaled */
+    NULL,                       /* satisfied */
+    no_signal,                  /* signal */
+    no_get_fd,                  /* get_fd */
+    default_map_access,         /* map_access */
+    default_get_sd,             /* get_sd */
+    default_set_sd,             /* set_sd */
+    no_get_full_name,           /* get_full_name */
+    no_lookup_name,             /* lookup_name */
+    no_link_name,               /* link_name */
+    NULL,                       /* unlink_name */
+    no_open_file,               /* open_file */
+    no_kernel_obj_list,         /* get_kernel_obj_list */
+    no_close_handle,            /* close_handle */
+    worker_pool_destroy         /* destroy */
+};
+
+static void worker_pool_poll_event( struct fd *fd, int event );
+
+static const struct fd_ops worker_pool_fd_ops =
+{
+    NULL,                       /* get_poll_events */
+    worker_pool_poll_event,     /* poll_event */
+    NULL,                       /* flush */
+    NULL,                       /* get_fd_type */
+    NULL,                       /* ioctl */
+    NULL,                       /* queue_async */
+    NULL                        /* reselect_async */
+};
+
+static struct worker_pool *worker_pool;
+static pthread_mutex_t worker_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t worker_cond = PTHREAD_COND_INITIALIZER;
+static struct list pending_jobs = LIST_INIT( pending_jobs );
+static struct list completed_jobs = LIST_INIT( completed_jobs );
+static int completion_signaled;
+
+static void worker_pool_dump( struct object *obj, int verbose )
+{
+    fprintf( stderr, "Worker pool threads=%d\n", worker_threads );
+}
+
+static void worker_pool_destroy( struct object *obj )
+{
+    struct worker_pool *pool = (struct worker_pool *)obj;
+    if (pool->fd) release_object( pool->fd );
+    close( pool->pipe_write );
+}
+
+/* run the completion callbacks of finished jobs */
+static void worker_pool_poll_event( struct fd *fd, int event )
+{
+    struct worker_pool *pool = get_fd_user( fd );
+    struct list completed = LIST_INIT( completed );
+    struct worker_job *job, *next;
+    char buffer[64];
+
+    if (event & (POLLERR | POLLHUP))
+    {
+        /* this is not supposed to happen */
+        fprintf( stderr, "wineserver: Error on worker completion pipe\n" );
+        set_fd_events( fd, -1 );
+        return;
+    }
+
+    while (read( get_unix_fd( pool->fd ), buffer, sizeof(buffer) ) == sizeof(buffer)) /* nothing */;
+
+    pthread_mutex_lock( &worker_mutex );
+    list_move_tail( &completed, &completed_jobs );
+    completion_signaled = 0;
+    pthread_mutex_unlock( &worker_mutex );
+
+    LIST_FOR_EACH_ENTRY_SAFE( job, next, &completed, struct worker_job, entry )
+    {
+        list_remove( &job->entry );
+        if (job->done) job->done( job->arg );
+        free( job );
+    }
+}
+
+static void *worker_thread( void *arg )
+{
+    struct worker_job *job;
+    struct list *ptr;
+    char dummy = 0;
+
+    pthread_mutex_lock( &worker_mutex );
+    for (;;)
+    {
+        while (!(ptr = list_head( &pending_jobs ))) pthread_cond_wait( &worker_cond, &worker_mutex );
+        job = LIST_ENTRY( ptr, struct worker_job, entry );
+        list_remove( &job->entry );
+        pthread_mutex_unlock( &worker_mutex );
+
+        job->work( job->arg );
+
+        pthread_mutex_lock( &worker_mutex );
+        list_add_tail( &completed_jobs, &job->entry );
+        if (!completion_signaled)
+        {
+            int ret;
+
+            while ((ret = write( worker_pool->pipe_write, &dummy, 1 )) == -1 && errno == EINTR) /* nothing */;
+            if (ret == 1) completion_signaled = 1;
+            else fprintf( stderr, "wineserver: failed to signal worker completion: %s\n", strerror( errno ));
+        }
+    }
+    return NULL;
+}
+
+/* create the worker pool and start its threads; return 0 if running single-threaded */
+static int init_worker_pool(void)
+{
+    static int initialized;
+    sigset_t sigset, old_sigset;
+    pthread_attr_t attr;
+    pthread_t thread;
+    int i, fd[2];
+
+    if (initialized) return worker_pool != NULL;
+    initialized = 1;
+
+    if (worker_threads <= 0) return 0;
+    if (pipe( fd ) == -1) return 0;
+    fcntl( fd[0], F_SETFL, O_NONBLOCK );
+    if (!(worker_pool = alloc_object( &worker_pool_ops )))
+    {
+        close( fd[0] );
+        close( fd[1] );
+        return 0;
+    }
+    worker_pool->pipe_write = fd[1];
+    if (!(worker_pool->fd = create_anonymous_fd( &worker_pool_fd_ops, fd[0], &worker_pool->obj, 0 )))
+    {
+        release_object( worker_pool );
+        worker_pool = NULL;
+        return 0;
+    }
+    set_fd_events( worker_pool->fd, POLLIN );
+    make_object_permanent( &worker_pool->obj );
+
+    /* signals must be handled by the main thread */
+    sigfillset( &sigset );
+    pthread_sigmask( SIG_SETMASK, &sigset, &old_sigset );
+    pthread_attr_init( &attr );
+    pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+    pthread_attr_setstacksize( &attr, 256 * 1024 );
+    for (i = 0; i < worker_threads; i++)
+    {
+        if (pthread_create( &thread, &attr, worker_thread, NULL ))
+        {
+            fprintf( stderr, "wineserver: failed to create worker thread: %s\n", strerror( errno ));
+            break;
+        }
+    }
+    pthread_attr_destroy( &attr );
+    pthread_sigmask( SIG_SETMASK, &old_sigset, NULL );
+
+    if (!i)  /* no worker, run everything synchronously */
+    {
+        worker_threads = 0;
+        return 0;
+    }
+    worker_threads = i;
+    return 1;
+}
+
+#endif  /* HAVE_PTHREAD_H */
+
+/* prevent the workers from taking any lock that a forked child may need */
+void suspend_worker_threads(void)
+{
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_lock( &worker_mutex );
+#endif
+}
+
+/* resume the workers after fork(); called in both the parent and the child */
+void resume_worker_threads(void)
+{
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_unlock( &worker_mutex );
+#endif
+}
+
+/* queue a job to run on a worker thread; done() is called on the main thread once it's finished */
+void queue_worker_job( worker_callback work, worker_callback done, void *arg )
+{
+    struct worker_job *job;
+
+#ifdef HAVE_PTHREAD_H
+    if (init_worker_pool() && (job = malloc( sizeof(*job) )))
+    {
+        job->work = work;
+        job->done = done;
+        job->arg  = arg;
+        pthread_mutex_lock( &worker_mutex );
+        list_add_tail( &pending_jobs, &job->entry );
+        pthread_cond_signal( &worker_cond );
+        pthread_mutex_unlock( &worker_mutex );
+        return;
+    }
+#endif
+    /* single-threaded mode */
+    work( arg );
+    if (done) done( arg );
+}
+
+static void close_fd_job( void *arg )
+{
+    close( (int)(ULONG_PTR)arg );
+}
+
+/* close the unix fd of a stream socket, deferring it to a worker thread if SO_LINGER makes it block */
+void close_lingering_fd( int unix_fd )
+{
+    struct linger linger;
+    socklen_t len = sizeof(linger);
+
+    if (!worker_threads || getsockopt( unix_fd, SOL_SOCKET, SO_LINGER, &linger, &len ) ||
+        !linger.l_onoff || !linger.l_linger)
+    {
+        close( unix_fd );
+        return;
+    }
+    queue_worker_job( close_fd_job, NULL, (void *)(ULONG_PTR)unix_fd );
+}